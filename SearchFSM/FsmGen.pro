@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# FsmGen - generator of C++ headers with SearchFSM tables
+#
+#-------------------------------------------------
+
+# CMakeLists.txt builds it too, its "tables" target is the same as the one below
+TARGET = FsmGen
+CONFIG   += console c++11 thread
+CONFIG   -= app_bundle qt
+
+TEMPLATE = app
+
+
+SOURCES += SearchFsm/FsmCreator.cpp \
+	FsmGen/main.cpp
+
+HEADERS += \
+	SearchFsm/Common.h \
+	SearchFsm/Concurrent.h \
+	SearchFsm/SearchFsm.h \
+	SearchFsm/FsmCreator.h
+
+# regenerate the tables header from the patterns file:
+# qmake PATTERNS=SyncWords.txt TABLES=SyncWordsTables.h TABLES_NAME=SyncWords && make && make tables
+isEmpty(TABLES_NAME): TABLES_NAME = Fsm
+isEmpty(TABLES_BITS): TABLES_BITS = 8
+tables.commands = $$OUT_PWD/$$TARGET $$PATTERNS $$TABLES $$TABLES_NAME $$TABLES_BITS
+tables.depends = $$PATTERNS
+QMAKE_EXTRA_TARGETS += tables
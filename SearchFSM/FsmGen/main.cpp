@@ -0,0 +1,98 @@
+#line 2 "main.cpp" // Make __FILE__ omit the path
+
+// FsmGen - generates C++ header with SearchFSM tables for the patterns described in a text file.
+// Usage: FsmGen <patterns file> <output header> <name> [bits at once: 1, 4 or 8] [msb|lsb]
+//
+// Patterns file format: a pattern per line, bits as '0', '1' and '-' (insignificant bit), optionally
+// followed by the maximum errors count; '#' starts a comment (see ReadPatternsFile). Example:
+// 1110-0101100110 2 # sync word, 2 errors are acceptable
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sstream>
+#include <string>
+
+#include "../SearchFSM/SearchFsm.h"
+#include "../SearchFSM/FsmCreator.h"
+
+// the tables are held in memory and then printed as the source code, larger ones make no sense
+static const uint64_t g_qwMaxTableBytes = (uint64_t)1 << 30;
+
+std::string CreateSourceCode(const TPatterns &patterns, const std::string &sName, int nBitsAtOnce,
+	CFsmCreator::EBitOrder bitOrder, const std::string &sComment)
+{
+	// empty code is returned on failure
+	CFsmCreator fsm(patterns);
+	CFsmCreator::SSizeEstimate estimate;
+	if (!fsm.GenerateTablesFitting(g_qwMaxTableBytes, nBitsAtOnce, &estimate)) {
+		fprintf(stderr, "Failed to generate the SearchFSM: %s, %llu states predicted\n",
+			CFsmCreator::GetBuildStatusText(fsm.GetBuildStatus()), (unsigned long long)estimate.qwStatesCount);
+		return std::string();
+	}
+	if (nBitsAtOnce == 1) {
+		fsm.OptimizeTables();
+		return CFsmCreator::CreateSourceCode(fsm.CreateFsmWrap<CSearchFsm<> >(), sName, sComment);
+	}
+
+	// the unessential states removal is for the bit SearchFSM only
+	fsm.MinimizeTables();
+	if (nBitsAtOnce == 4) {
+		return CFsmCreator::CreateSourceCode(fsm.CreateByteFsmWrap<CSearchFsmByte<4> >(bitOrder), sName, sComment);
+	} else {
+		return CFsmCreator::CreateSourceCode(fsm.CreateByteFsmWrap<CSearchFsmByte<8> >(bitOrder), sName, sComment);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 4) {
+		fprintf(stderr, "Usage: FsmGen <patterns file> <output header> <name> [bits at once: 1, 4 or 8] [msb|lsb]\n");
+		return 1;
+	}
+
+	std::string sPatternsFile = argv[1];
+	std::string sHeaderFile = argv[2];
+	std::string sName = argv[3];
+	int nBitsAtOnce = (argc > 4)? atoi(argv[4]) : 8;
+	if (nBitsAtOnce != 1 && nBitsAtOnce != 4 && nBitsAtOnce != 8) {
+		fprintf(stderr, "Unsupported bits at once: %i\n", nBitsAtOnce);
+		return 1;
+	}
+	CFsmCreator::EBitOrder bitOrder = CFsmCreator::bitOrder_MsbFirst;
+	if (argc > 5 && strcmp(argv[5], "lsb") == 0) {
+		bitOrder = CFsmCreator::bitOrder_LsbFirst;
+	}
+
+	TPatterns patterns;
+	std::string sError;
+	if (!ReadPatternsFile(sPatternsFile, &patterns, &sError)) {
+		fprintf(stderr, "%s\n", sError.c_str());
+		return 1;
+	}
+
+	// the patterns are listed in the header's comment
+	std::ostringstream comment;
+	comment << nBitsAtOnce << " bit(s) at once, " << ((bitOrder == CFsmCreator::bitOrder_MsbFirst)? "MSB" : "LSB") <<
+		" first; patterns:\n";
+	int idx;
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		comment << idx << ": " << PatternToString(patterns[idx]) << ", " << patterns[idx].nMaxErrors << " error(s)\n";
+	}
+	std::string sCode = CreateSourceCode(patterns, sName, nBitsAtOnce, bitOrder, comment.str());
+	if (sCode.empty()) {
+		return 1;
+	}
+
+	FILE *pFile = fopen(sHeaderFile.c_str(), "wb");
+	bool fWritten = pFile != NULL && fwrite(sCode.data(), 1, sCode.size(), pFile) == sCode.size();
+	if (pFile != NULL && fclose(pFile) != 0) {
+		fWritten = false;
+	}
+	if (!fWritten) {
+		fprintf(stderr, "Can't write %s\n", sHeaderFile.c_str());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,234 @@
+#line 2 "main.cpp" // Make __FILE__ omit the path
+
+// FsmScan - searches the capture files for the patterns described in a text file and streams the hits.
+// Usage: FsmScan [-s <bits at once: 1, 4 or 8>] [-f text|binary] [-o <hits file>] <patterns file> <capture file>...
+//
+// Patterns file format is the one of FsmGen (see ReadPatternsFile). The bits of each byte are scanned MSB first,
+// every file is scanned from the initial state. The hits are written to the hits file or to the standard output:
+// - text: a line per hit "<file name>\t<bit offset>\t<pattern index>\t<errors count>";
+// - binary: SHitRecord per hit in the host byte order, the file is given by its index in the command line.
+// The bit offset is the offset of the pattern's first bit from the beginning of the file.
+// The statistics and the throughput go to the standard error at the end.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../SearchFSM/SearchFsm.h"
+#include "../SearchFSM/FsmCreator.h"
+#include "../SearchFSM/FsmFile.h"
+
+// the tables are built in memory, larger ones make no sense
+static const uint64_t g_qwMaxTableBytes = (uint64_t)1 << 30;
+
+static const size_t g_nOutputBufferBytes = 1024 * 1024;
+
+enum EFormat {
+	format_Text,
+	format_Binary
+};
+
+/// compact binary hit record
+struct SHitRecord {
+	uint64_t qwBitOffset;
+	uint32_t dwPatternIdx;
+	uint16_t wFileIdx; // in the command line, 0 for the first capture file
+	uint8_t bErrorsCount;
+	uint8_t bReserved; // zero
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CHitsWriter - sink for SearchFSM Scan methods, writes the hits as text lines or binary records.
+class CHitsWriter {
+public:
+	CHitsWriter(FILE *pFile, EFormat format): m_pFile(pFile), m_format(format), m_pszFileName(NULL), m_nFileIdx(0),
+		m_qwHits(0)
+	{}
+
+public:
+	void StartFile(int nFileIdx, const char *szFileName) {
+		m_nFileIdx = nFileIdx;
+		m_pszFileName = szFileName;
+	}
+
+	template <class TOutput>
+	void operator()(uint64_t qwBitsProcessed, const TOutput &out) {
+		if (out.stepBack > qwBitsProcessed) { // the pattern would start before the file
+			return;
+		}
+		Write(qwBitsProcessed - out.stepBack, out.patternIdx, out.errorsCount);
+	}
+
+	uint64_t GetHitsCount() const {
+		return m_qwHits;
+	}
+
+private:
+	void Write(uint64_t qwBitOffset, unsigned int dwPatternIdx, unsigned int dwErrorsCount) {
+		if (m_format == format_Binary) {
+			SHitRecord record = {qwBitOffset, dwPatternIdx, (uint16_t)m_nFileIdx, (uint8_t)dwErrorsCount, 0};
+			fwrite(&record, sizeof(record), 1, m_pFile);
+		} else {
+			fprintf(m_pFile, "%s\t%llu\t%u\t%u\n", m_pszFileName, (unsigned long long)qwBitOffset, dwPatternIdx,
+				dwErrorsCount);
+		}
+		m_qwHits++;
+	}
+
+private:
+	FILE *m_pFile;
+	EFormat m_format;
+	const char *m_pszFileName;
+	int m_nFileIdx;
+	uint64_t m_qwHits;
+};
+
+template <class TSearchFsm>
+bool ScanFiles(const typename TSearchFsm::STable &table, const std::vector<std::string> &files, CHitsWriter *pWriter,
+	/* out */ uint64_t *pqwBytes)
+{
+	TSearchFsm fsm(table);
+	*pqwBytes = 0;
+	int idxFile;
+	for (idxFile = 0; idxFile < (int)files.size(); idxFile++) {
+		CDataFileMapping mapping;
+		if (mapping.Open(files[idxFile]) != CFsmFile::status_Ok) {
+			fprintf(stderr, "Can't map %s\n", files[idxFile].c_str());
+			return false;
+		}
+
+		// the whole file at once, the positions are 64-bit
+		fsm.Reset();
+		pWriter->StartFile(idxFile, files[idxFile].c_str());
+		fsm.Scan(mapping.GetData(), (size_t)mapping.GetSize(), *pWriter);
+		*pqwBytes += mapping.GetSize();
+	}
+
+	return true;
+}
+
+void PrintUsage() {
+	fprintf(stderr, "Usage: FsmScan [-s <bits at once: 1, 4 or 8>] [-f text|binary] [-o <hits file>] <patterns file> "
+		"<capture file>...\n");
+}
+
+int main(int argc, char *argv[]) {
+	typedef char TRecordCheck[(sizeof(SHitRecord) == 16)? 1 : -1]; // no padding in the records
+	(void)sizeof(TRecordCheck);
+
+	int nBitsAtOnce = BITS_IN_BYTE;
+	EFormat format = format_Text;
+	std::string sHitsFile;
+	int idxArg = 1;
+	while (idxArg + 1 < argc && argv[idxArg][0] == '-') {
+		const char *szOption = argv[idxArg];
+		const char *szValue = argv[idxArg + 1];
+		if (strcmp(szOption, "-s") == 0) {
+			nBitsAtOnce = atoi(szValue);
+		} else if (strcmp(szOption, "-f") == 0 && strcmp(szValue, "text") == 0) {
+			format = format_Text;
+		} else if (strcmp(szOption, "-f") == 0 && strcmp(szValue, "binary") == 0) {
+			format = format_Binary;
+		} else if (strcmp(szOption, "-o") == 0) {
+			sHitsFile = szValue;
+		} else {
+			PrintUsage();
+			return 1;
+		}
+		idxArg += 2;
+	}
+	if (argc - idxArg < 2) {
+		PrintUsage();
+		return 1;
+	}
+	if (nBitsAtOnce != 1 && nBitsAtOnce != 4 && nBitsAtOnce != 8) {
+		fprintf(stderr, "Unsupported bits at once: %i\n", nBitsAtOnce);
+		return 1;
+	}
+
+	std::string sPatternsFile = argv[idxArg];
+	std::vector<std::string> files(argv + idxArg + 1, argv + argc);
+	if (format == format_Binary && files.size() > 0xffff) {
+		fprintf(stderr, "Too many capture files for the binary records: %i\n", (int)files.size());
+		return 1;
+	}
+
+	TPatterns patterns;
+	std::string sError;
+	if (!ReadPatternsFile(sPatternsFile, &patterns, &sError)) {
+		fprintf(stderr, "%s\n", sError.c_str());
+		return 1;
+	}
+
+	FILE *pHitsFile = stdout;
+	if (!sHitsFile.empty()) {
+		pHitsFile = fopen(sHitsFile.c_str(), (format == format_Binary)? "wb" : "w");
+		if (pHitsFile == NULL) {
+			fprintf(stderr, "Can't open %s\n", sHitsFile.c_str());
+			return 1;
+		}
+	}
+	setvbuf(pHitsFile, NULL, _IOFBF, g_nOutputBufferBytes);
+
+	// build the tables
+	typedef std::chrono::steady_clock TClock;
+	TClock::time_point timeStart = TClock::now();
+	CFsmCreator fsm(patterns);
+	CFsmCreator::SSizeEstimate estimate;
+	if (!fsm.GenerateTablesFitting(g_qwMaxTableBytes, nBitsAtOnce, &estimate)) {
+		fprintf(stderr, "Failed to generate the SearchFSM: %s, %llu states predicted\n",
+			CFsmCreator::GetBuildStatusText(fsm.GetBuildStatus()), (unsigned long long)estimate.qwStatesCount);
+		return 1;
+	}
+
+	// the bit SearchFSM is optimized, the byte ones are built of the minimized states
+	CHitsWriter writer(pHitsFile, format);
+	uint64_t qwBytes = 0;
+	bool fScanned = false;
+	TClock::time_point timeScan;
+	if (nBitsAtOnce == 1) {
+		fsm.OptimizeTables();
+		CFsmCreator::SFsmWrap<CSearchFsm<> > wrap = fsm.CreateFsmWrap<CSearchFsm<> >();
+		timeScan = TClock::now();
+		fScanned = ScanFiles<CSearchFsm<> >(wrap.fsm.GetTable(), files, &writer, &qwBytes);
+	} else if (nBitsAtOnce == 4) {
+		fsm.MinimizeTables();
+		CFsmCreator::SFsmWrap<CSearchFsmByte<4> > wrap = fsm.CreateByteFsmWrap<CSearchFsmByte<4> >();
+		timeScan = TClock::now();
+		fScanned = ScanFiles<CSearchFsmByte<4> >(wrap.fsm.GetTable(), files, &writer, &qwBytes);
+	} else {
+		fsm.MinimizeTables();
+		CFsmCreator::SFsmWrap<CSearchFsmByte<8> > wrap = fsm.CreateByteFsmWrap<CSearchFsmByte<8> >();
+		timeScan = TClock::now();
+		fScanned = ScanFiles<CSearchFsmByte<8> >(wrap.fsm.GetTable(), files, &writer, &qwBytes);
+	}
+	bool fWritten = fflush(pHitsFile) == 0 && ferror(pHitsFile) == 0;
+	TClock::time_point timeEnd = TClock::now();
+	if (pHitsFile != stdout && fclose(pHitsFile) != 0) {
+		fWritten = false;
+	}
+	if (!fWritten) {
+		fprintf(stderr, "Can't write the hits\n");
+		return 1;
+	}
+	if (!fScanned) {
+		return 1;
+	}
+
+	// the hits output is included, as the data can't be scanned without it
+	double dBuildTime = std::chrono::duration<double>(timeScan - timeStart).count();
+	double dScanTime = std::chrono::duration<double>(timeEnd - timeScan).count();
+	double dRate = (dScanTime > 0)? qwBytes / dScanTime : 0;
+	fprintf(stderr, "SearchFSM of %i bit(s) at once: %i states, built in %.3f s\n", nBitsAtOnce, fsm.GetStatesCount(),
+		dBuildTime);
+	fprintf(stderr, "Scanned %llu bytes in %i file(s) in %.3f s, found %llu hits\n", (unsigned long long)qwBytes,
+		(int)files.size(), dScanTime, (unsigned long long)writer.GetHitsCount());
+	fprintf(stderr, "Throughput: %.3f GB/s (%.1f MiB/s)\n", dRate / 1e9, dRate / (1024 * 1024));
+
+	return 0;
+}
@@ -4,29 +4,48 @@
 #
 #-------------------------------------------------
 
-QT       += core
-
-QT       -= gui
-
+# the benchmark only, CMakeLists.txt builds the library, the benchmark and the correctness suite
 TARGET = FSM
-CONFIG   += console
-CONFIG   -= app_bundle
+CONFIG   += console c++11 thread
+CONFIG   -= app_bundle qt
 
 TEMPLATE = app
 
 
-SOURCES += SearchFsm/FsmCreator.cpp \
+SOURCES += SearchFsm/BitapMatcher.cpp \
+	SearchFsm/FsmCreator.cpp \
+	SearchFsm/FsmFile.cpp \
+	SearchFsm/LazySearchFsm.cpp \
+	SearchFsm/RegisterMatcher.cpp \
 	Test/main.cpp \
+	Test/BenchmarkRunner.cpp \
+	Test/EngineTuner.cpp \
 	Test/FsmTest.cpp \
 	Test/ShiftRegister.cpp
 
 HEADERS += \
+	SearchFsm/BitapMatcher.h \
 	SearchFsm/Common.h \
+	SearchFsm/CompiledFsm.h \
+	SearchFsm/Concurrent.h \
+	SearchFsm/FindingsBuffer.h \
 	SearchFsm/SearchFsm.h \
+	SearchFsm/ParallelSearchFsm.h \
+	SearchFsm/SearchFsmAuto.h \
+	SearchFsm/SearchFsmClassed.h \
+	SearchFsm/SearchFsmComb.h \
+	SearchFsm/SearchFsmSplit.h \
 	SearchFsm/FsmCreator.h \
+	SearchFsm/FsmFile.h \
+	SearchFsm/LazySearchFsm.h \
+	SearchFsm/RegisterMatcher.h \
+	Test/BenchmarkRunner.h \
+	Test/EngineTuner.h \
 	Test/FsmTest.h \
 	Test/SearchEngines.h \
 	Test/ShiftRegister.h \
 	Test/WinTimer.h \
+	Test/PosixTimer.h \
+	Test/Timer.h \
 	Test/Lcg.h
 
@@ -0,0 +1,180 @@
+#line 2 "BitapMatcher.cpp" // Make __FILE__ omit the path
+
+#include "BitapMatcher.h"
+
+//////////////////////////////////////////////////////////////////////////
+// CBitapMatcher
+CBitapMatcher::CBitapMatcher(const TPatterns &patterns) {
+	int nStateSize = 0, nMaxLevelsSize = 0;
+	int idx;
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		SPattern pattern = CompilePattern(patterns[idx]);
+		pattern.nStateOffset = nStateSize;
+		int nLevelsSize = (pattern.nMaxErrors + 1) * pattern.nChunksCount;
+		nStateSize += nLevelsSize;
+		nMaxLevelsSize = std::max(nMaxLevelsSize, nLevelsSize);
+		m_patterns.push_back(pattern);
+	}
+
+	m_state.resize(nStateSize);
+	m_shifted.resize(nMaxLevelsSize);
+	m_found.resize((int)patterns.size());
+	Reset();
+}
+
+void CBitapMatcher::Reset() {
+	std::fill(m_state.begin(), m_state.end(), 0);
+	m_outputs.resize(0);
+}
+
+unsigned int CBitapMatcher::GetMemoryUsage() const {
+	unsigned int dwSize = ((int)m_state.size() + (int)m_shifted.size()) * sizeof(TChunk) + (int)m_found.size();
+	int idx;
+	for (idx = 0; idx < (int)m_patterns.size(); idx++) {
+		dwSize += sizeof(SPattern) + (int)m_patterns[idx].masks.size() * sizeof(TChunk);
+	}
+
+	return dwSize;
+}
+
+CBitapMatcher::SPattern CBitapMatcher::CompilePattern(const ::SPattern &pattern) {
+	const int g_nBytesCount = 1 << BITS_IN_BYTE;
+
+	SPattern result;
+	result.nLength = pattern.nLength;
+	result.nMaxErrors = pattern.nMaxErrors;
+	result.nChunksCount = (pattern.nLength + BITS_IN_BYTE - 1) / g_nChunkLength + 1;
+	result.nMasksCount = std::min(pattern.nMaxErrors, BITS_IN_BYTE) + 1;
+	result.nStateOffset = 0;
+	result.masks.assign(g_nBytesCount * result.nMasksCount * result.nChunksCount, 0);
+
+	// the byte ends the prefix of length L, so its bit i is compared with the pattern's bit L - 8 + i;
+	// the bits before the pattern's beginning and after its end don't matter
+	int nByte;
+	for (nByte = 0; nByte < g_nBytesCount; nByte++) {
+		TChunk *pMasks = result.masks.data() + nByte * result.nMasksCount * result.nChunksCount;
+		int nPrefixLength;
+		for (nPrefixLength = 1; nPrefixLength < pattern.nLength + BITS_IN_BYTE; nPrefixLength++) {
+			int nMismatches = 0;
+			int nBit;
+			for (nBit = 0; nBit < BITS_IN_BYTE; nBit++) {
+				int nPatternBit = nPrefixLength - BITS_IN_BYTE + nBit;
+				if (nPatternBit >= 0 && nPatternBit < pattern.nLength && GetMaskBit(pattern, nPatternBit) != 0 &&
+					GetHiBit((unsigned char)nByte, nBit) != GetBit(pattern, nPatternBit))
+				{
+					nMismatches++;
+				}
+			}
+
+			int nMask;
+			for (nMask = nMismatches; nMask < result.nMasksCount; nMask++) {
+				pMasks[nMask * result.nChunksCount + nPrefixLength / g_nChunkLength] |=
+					(TChunk)1 << (nPrefixLength % g_nChunkLength);
+			}
+		}
+	}
+
+	return result;
+}
+
+bool CBitapMatcher::PushByte(unsigned int dwByte) {
+	const SPattern *pPatterns = m_patterns.data();
+	const int nPatternsCount = (int)m_patterns.size();
+	TChunk *pState = m_state.data();
+	TChunk *pShifted = m_shifted.data();
+	unsigned char *pFound = m_found.data();
+
+	bool fFound = false;
+	int idx;
+	for (idx = 0; idx < nPatternsCount; idx++) {
+		const SPattern &pattern = pPatterns[idx];
+		const int nChunksCount = pattern.nChunksCount;
+		TChunk *pLevels = pState + pattern.nStateOffset;
+
+		// extend all the prefixes with the empty one by 8 bits; the prefixes beginning inside the byte are
+		// the bits [0, 8)
+		int nLevel, nChunk;
+		for (nLevel = 0; nLevel <= pattern.nMaxErrors; nLevel++) {
+			const TChunk *pLevel = pLevels + nLevel * nChunksCount;
+			TChunk *pShiftedLevel = pShifted + nLevel * nChunksCount;
+			pShiftedLevel[0] = ((pLevel[0] | 1) << BITS_IN_BYTE) | 0xff;
+			for (nChunk = 1; nChunk < nChunksCount; nChunk++) {
+				pShiftedLevel[nChunk] = (pLevel[nChunk] << BITS_IN_BYTE) | (pLevel[nChunk - 1] >> (g_nChunkLength - BITS_IN_BYTE));
+			}
+		}
+
+		// the prefix goes from the level K - j to the level K, if the byte adds j mismatches at most
+		const TChunk *pMasks = pattern.masks.data() + dwByte * pattern.nMasksCount * nChunksCount;
+		for (nLevel = 0; nLevel <= pattern.nMaxErrors; nLevel++) {
+			TChunk *pLevel = pLevels + nLevel * nChunksCount;
+			int nMasks = std::min(nLevel + 1, pattern.nMasksCount);
+			for (nChunk = 0; nChunk < nChunksCount; nChunk++) {
+				TChunk chunk = 0;
+				int nMask;
+				for (nMask = 0; nMask < nMasks; nMask++) {
+					chunk |= pShifted[(nLevel - nMask) * nChunksCount + nChunk] & pMasks[nMask * nChunksCount + nChunk];
+				}
+				pLevel[nChunk] = chunk;
+			}
+		}
+
+		// the prefixes of length nLength + r are the pattern ended r bits before the byte's end; the levels
+		// are nested, so the last one has them all
+		const TChunk *pLastLevel = pLevels + pattern.nMaxErrors * nChunksCount;
+		const int nEndChunk = pattern.nLength / g_nChunkLength;
+		const int nEndShift = pattern.nLength % g_nChunkLength;
+		TChunk found = pLastLevel[nEndChunk] >> nEndShift;
+		if (nEndShift > g_nChunkLength - BITS_IN_BYTE && nEndChunk + 1 < nChunksCount) {
+			found |= pLastLevel[nEndChunk + 1] << (g_nChunkLength - nEndShift);
+		}
+		pFound[idx] = (unsigned char)found;
+		if (pFound[idx] != 0) {
+			fFound = true;
+		}
+	}
+
+	if (!fFound) {
+		return false;
+	}
+
+	// the outputs of the earlier ends go first, as the bits are processed
+	m_outputs.resize(0);
+	int nEndBit;
+	for (nEndBit = BITS_IN_BYTE - 1; nEndBit >= 0; nEndBit--) {
+		for (idx = 0; idx < nPatternsCount; idx++) {
+			if ((pFound[idx] >> nEndBit) & 0x01) {
+				const SPattern &pattern = pPatterns[idx];
+				const TChunk *pLevels = pState + pattern.nStateOffset;
+				int nFoundBit = pattern.nLength + nEndBit;
+				TChunk bit = (TChunk)1 << (nFoundBit % g_nChunkLength);
+				int nErrors = 0;
+				while ((pLevels[nErrors * pattern.nChunksCount + nFoundBit / g_nChunkLength] & bit) == 0) {
+					nErrors++;
+				}
+
+				SOutput output;
+				output.patternIdx = idx;
+				output.stepBack = nFoundBit;
+				output.errorsCount = nErrors;
+				m_outputs.push_back(output);
+			}
+		}
+	}
+
+	// the found patterns aren't kept as prefixes
+	for (idx = 0; idx < nPatternsCount; idx++) {
+		if (pFound[idx] != 0) {
+			const SPattern &pattern = pPatterns[idx];
+			TChunk *pLevels = pState + pattern.nStateOffset;
+			int nLevel;
+			for (nLevel = 0; nLevel <= pattern.nMaxErrors; nLevel++) {
+				int nBit;
+				for (nBit = pattern.nLength; nBit < pattern.nLength + BITS_IN_BYTE; nBit++) {
+					pLevels[nLevel * pattern.nChunksCount + nBit / g_nChunkLength] &= ~((TChunk)1 << (nBit % g_nChunkLength));
+				}
+			}
+		}
+	}
+
+	return true;
+}
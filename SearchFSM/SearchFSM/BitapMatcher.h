@@ -0,0 +1,77 @@
+#line 2 "BitapMatcher.h" // Make __FILE__ omit the path
+
+#ifndef BITAPMATCHER_H
+#define BITAPMATCHER_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Common.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CBitapMatcher - bit-parallel search of the patterns with Hamming distance (Wu-Manber bitap).
+/// No tables of states are built, so the memory is predictable for any errors count: each pattern keeps
+/// nMaxErrors + 1 bitvectors of the found prefixes' lengths (bit L of the level K is set if the prefix of
+/// length L is found with K errors at most) and the masks of the prefixes matching each byte value with
+/// j = 0..8 mismatches. A byte advances a level by ORing at most 9 shifted and masked lower levels, so the
+/// cost is linear in the errors count. The bits are processed MSB first, as in patterns; the outputs are
+/// the same as of SearchFSM.
+class CBitapMatcher {
+public:
+	typedef uint64_t TChunk;
+	static const int g_nChunkLength = 64;
+
+	struct SOutput { // the same fields as of CSearchFsm::SOutput
+		unsigned int patternIdx;
+		unsigned int stepBack; // bits from the end of the processed data to the pattern's beginning
+		unsigned int errorsCount;
+	};
+	typedef SOutput TOutput;
+
+public: // constructor
+	CBitapMatcher(const TPatterns &patterns);
+
+public: // working methods
+	void Reset();
+
+	/// Push all the bytes of the buffer, the same as CSearchFsmByte::Scan
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink) {
+		size_t idx;
+		for (idx = 0; idx < nBytes; idx++) {
+			if (PushByte(pData[idx])) { // rare case - found something
+				int nOutput;
+				for (nOutput = 0; nOutput < (int)m_outputs.size(); nOutput++) {
+					sink(((uint64_t)idx + 1) * BITS_IN_BYTE, m_outputs[nOutput]);
+				}
+			}
+		}
+	}
+
+public: // statistics
+	unsigned int GetMemoryUsage() const; // bytes
+
+private:
+	struct SPattern { // compiled pattern
+		int nLength;
+		int nMaxErrors;
+		int nChunksCount; // chunks of a bitvector, bits [0, nLength + 8) are used
+		int nMasksCount; // mismatches counts of the byte masks, min(nMaxErrors, 8) + 1
+		int nStateOffset; // chunks of m_state before the pattern's levels
+		std::vector<TChunk> masks; // 256 bytes x nMasksCount x nChunksCount
+	};
+
+	static SPattern CompilePattern(const ::SPattern &pattern);
+	bool PushByte(unsigned int dwByte); // true if something is found, see m_outputs
+
+private:
+	std::vector<SPattern> m_patterns;
+	std::vector<TChunk> m_state; // levels of all the patterns
+	std::vector<TChunk> m_shifted; // levels of a pattern extended by the byte
+	std::vector<unsigned char> m_found; // per pattern, bit r is set if the pattern has ended r bits before the byte's end
+	std::vector<SOutput> m_outputs; // of the last byte, ordered by the end position, then by the pattern
+};
+
+#endif // BITAPMATCHER_H
@@ -3,7 +3,8 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-#include <QList>
+#include <memory>
+#include <vector>
 
 // bits manipulation routine
 #ifndef BITS_IN_BYTE
@@ -49,7 +50,7 @@ inline unsigned char LoNibble(const unsigned char bData) {
 /// Examples:
 /// pattern 011--111 is stored like this: data = 0x67, mask = 0xe7, length = 8.
 struct SPattern {
-	typedef QList <unsigned char> TData;
+	typedef std::vector<unsigned char> TData;
 
 	int nLength; // bits count
 	int nMaxErrors; // maximum errors count acceptable by the searching FSM
@@ -57,7 +58,7 @@ struct SPattern {
 	TData mask; // positions marked by zero bits are insignificant - optional field
 };
 
-typedef QList<SPattern> TPatterns;
+typedef std::vector<SPattern> TPatterns;
 
 inline unsigned char GetBit(const SPattern::TData &data, int nBit, int nLength) {
 	int nBytesCount = (nLength - 1) / BITS_IN_BYTE + 1;
@@ -76,11 +77,41 @@ inline unsigned char GetBit(const SPattern &pattern, int nBit) {
 }
 
 inline unsigned char GetMaskBit(const SPattern &pattern, int nBit) {
-	if (pattern.mask.isEmpty()) { // no mask given
+	if (pattern.mask.empty()) { // no mask given
 		return 0x01; // aways true
 	}
 
 	return GetBit(pattern.mask, nBit, pattern.nLength);
 }
 
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CSharedTable<T> - immutable array shared by its copies.
+/// SearchFSMs point into their tables, so the tables kept next to them (see CFsmCreator::SFsmWrap) mustn't
+/// move when the holder is copied. The elements are taken from the vector they are built in, without copying.
+template <class T>
+class CSharedTable {
+public:
+	CSharedTable() {}
+
+	/// takes the elements, *pElements is left empty; the pointers into its buffer stay valid
+	explicit CSharedTable(std::vector<T> *pElements): m_pElements(new std::vector<T>()) {
+		m_pElements->swap(*pElements);
+	}
+
+public:
+	const T* data() const {return m_pElements? m_pElements->data() : NULL;}
+	size_t size() const {return m_pElements? m_pElements->size() : 0;}
+	bool empty() const {return size() == 0;}
+	const T& operator[](size_t idx) const {return (*m_pElements)[idx];}
+
+private:
+	std::shared_ptr<std::vector<T> > m_pElements;
+};
+
+template <class T>
+CSharedTable<T> ShareTable(std::vector<T> *pElements) {
+	return CSharedTable<T>(pElements);
+}
+
 #endif // COMMON_H
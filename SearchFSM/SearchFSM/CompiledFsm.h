@@ -0,0 +1,141 @@
+#line 2 "CompiledFsm.h" // Make __FILE__ omit the path
+
+#ifndef COMPILEDFSM_H
+#define COMPILEDFSM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "SearchFsm.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CCompiledFsm<TSearchFsm> - immutable SearchFSM tables shared by reference counting, scanned through cursors.
+/// A SearchFSM instance keeps its own copy of STable next to the state, and the tables belong to a wrap
+/// (see CFsmCreator::SFsmWrap) or a mapping the instance mustn't outlive. CCompiledFsm holds a reference to the
+/// tables' owner instead: its copies are cheap, and the last one releases the tables. The tables are never
+/// changed, so the copies may be used by any threads at once.
+/// The state of a stream is kept by the caller in a cursor of a few bytes, so any number of streams (channels)
+/// are scanned over the same tables:
+/// - SCursor holds the state only, the positions passed to the sink are counted from the scanned buffer;
+/// - SOffsetCursor also counts the bits of the stream, the positions are counted from the stream beginning.
+/// TSearchFsm is any table-driven SearchFSM (CSearchFsm, CSearchFsmByte, CSearchFsmClassed, CSearchFsmComb,
+/// CSearchFsmSplit). A cursor mustn't be advanced by two threads at once.
+template <class TSearchFsm>
+class CCompiledFsm {
+public:
+	typedef typename TSearchFsm::STable STable;
+	typedef typename TSearchFsm::TStateIdx TStateIdx;
+	typedef typename TSearchFsm::TOutput TOutput;
+
+	struct SCursor {
+		TStateIdx state;
+	};
+	struct SOffsetCursor {
+		TStateIdx state;
+		uint64_t qwBitsProcessed; // of the stream, before the next buffer
+	};
+
+public: // constructors
+	CCompiledFsm(): m_table() {} // no tables, to be assigned
+
+	/// the tables belong to *pOwner (e.g. CFsmFileMapping), it is released with the last copy
+	CCompiledFsm(const STable &table, const std::shared_ptr<const void> &pOwner): m_pOwner(pOwner), m_table(table) {}
+
+	/// takes the tables of a wrap created by CFsmCreator (SFsmWrap, SFsmClassedWrap, ...)
+	template <class TWrap>
+	static CCompiledFsm FromWrap(const TWrap &wrap) {
+		// the copy shares the tables with the wrap, so its fsm points into the same tables
+		std::shared_ptr<const TWrap> pWrap(new TWrap(wrap));
+		return CCompiledFsm(pWrap->fsm.GetTable(), pWrap);
+	}
+
+public: // cursors
+	void Reset(/* out */ SCursor *pCursor, TStateIdx state = 0) const {
+		ASSERT(state < m_table.statesCount);
+		pCursor->state = state;
+	}
+
+	void Reset(/* out */ SOffsetCursor *pCursor, TStateIdx state = 0) const {
+		ASSERT(state < m_table.statesCount);
+		pCursor->state = state;
+		pCursor->qwBitsProcessed = 0;
+	}
+
+public: // scanning
+	/// advance the cursor over the buffer, sink(qwBitsProcessed, output) is called as by TSearchFsm::Scan
+	template <class TSink>
+	void Scan(/* in-out */ SCursor *pCursor, const unsigned char *pData, size_t nBytes, TSink &sink) const {
+		Scan(&pCursor->state, pData, nBytes, sink);
+	}
+
+	/// the same, qwBitsProcessed passed to the sink is counted from the stream beginning
+	template <class TSink>
+	void Scan(/* in-out */ SOffsetCursor *pCursor, const unsigned char *pData, size_t nBytes, TSink &sink) const {
+		SOffsetSink<TSink> offsetSink = {sink, pCursor->qwBitsProcessed};
+		Scan(&pCursor->state, pData, nBytes, offsetSink);
+		pCursor->qwBitsProcessed += (uint64_t)nBytes * BITS_IN_BYTE;
+	}
+
+	/// Advance nCursors cursors, each over its own buffer: ppData[idx] of pnBytes[idx] bytes (the lengths may
+	/// differ, zero too). sink(idxCursor, qwBitsProcessed, output) is called for every found pattern.
+	template <class TCursor, class TSink>
+	void ScanBatch(/* in-out */ TCursor *pCursors, const unsigned char *const *ppData, const size_t *pnBytes,
+		size_t nCursors, TSink &sink) const
+	{
+		size_t idxCursor;
+		for (idxCursor = 0; idxCursor < nCursors; idxCursor++) {
+			SCursorSink<TSink> cursorSink = {sink, idxCursor};
+			Scan(&pCursors[idxCursor], ppData[idxCursor], pnBytes[idxCursor], cursorSink);
+		}
+	}
+
+public: // properties
+	const STable& GetTable() const {
+		return m_table;
+	}
+
+	bool IsEmpty() const {
+		return m_table.statesCount == 0;
+	}
+
+private:
+	// adapter adding the bits of the stream scanned before
+	template <class TSink>
+	struct SOffsetSink {
+		TSink &sink;
+		uint64_t qwBitsBefore;
+
+		void operator()(uint64_t qwBitsProcessed, const TOutput &output) {
+			sink(qwBitsBefore + qwBitsProcessed, output);
+		}
+	};
+
+	// adapter passing cursor index to the sink of ScanBatch
+	template <class TSink>
+	struct SCursorSink {
+		TSink &sink;
+		size_t idxCursor;
+
+		void operator()(uint64_t qwBitsProcessed, const TOutput &output) {
+			sink(idxCursor, qwBitsProcessed, output);
+		}
+	};
+
+	// the engine is a table copy and a state, so it lives in registers for the time of a buffer
+	template <class TSink>
+	void Scan(/* in-out */ TStateIdx *pState, const unsigned char *pData, size_t nBytes, TSink &sink) const {
+		ASSERT(!IsEmpty());
+		TSearchFsm fsm(m_table);
+		fsm.Reset(*pState);
+		fsm.Scan(pData, nBytes, sink);
+		*pState = fsm.GetState();
+	}
+
+private:
+	std::shared_ptr<const void> m_pOwner;
+	STable m_table;
+};
+
+#endif // COMPILEDFSM_H
@@ -0,0 +1,59 @@
+#line 2 "Concurrent.h" // Make __FILE__ omit the path
+
+#ifndef CONCURRENT_H
+#define CONCURRENT_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// threads helpers of the parallel generation and scanning
+
+/// threads count to keep all the cores busy, 1 at least
+inline int GetIdealThreadCount() {
+	int nThreads = (int)std::thread::hardware_concurrency();
+	return (nThreads > 0)? nThreads : 1;
+}
+
+/// \brief calls the function for every task on nThreads threads (0 - GetIdealThreadCount()) and waits for all of them.
+/// The tasks are taken by the threads one by one, so they may be of different lengths. No more threads than
+/// the tasks are started, the calling thread is one of them.
+template <class TTask>
+void BlockingMap(std::vector<TTask> &tasks, void (*pfnFunction)(TTask&), int nThreads = 0) {
+	int nTasksCount = (int)tasks.size();
+	if (nThreads <= 0) {
+		nThreads = GetIdealThreadCount();
+	}
+	nThreads = std::min(nThreads, nTasksCount);
+	if (nThreads <= 1) { // no need in the threads
+		int idx;
+		for (idx = 0; idx < nTasksCount; idx++) {
+			pfnFunction(tasks[idx]);
+		}
+		return;
+	}
+
+	struct SWorker {
+		static void Run(std::vector<TTask> *pTasks, void (*pfnFunction)(TTask&), std::atomic<int> *pnNextTask) {
+			int idx;
+			while ((idx = (*pnNextTask)++) < (int)pTasks->size()) {
+				pfnFunction((*pTasks)[idx]);
+			}
+		}
+	};
+
+	std::atomic<int> nNextTask(0);
+	std::vector<std::thread> threads;
+	int nThread;
+	for (nThread = 1; nThread < nThreads; nThread++) {
+		threads.push_back(std::thread(&SWorker::Run, &tasks, pfnFunction, &nNextTask));
+	}
+	SWorker::Run(&tasks, pfnFunction, &nNextTask); // the calling thread works too
+	for (nThread = 0; nThread < (int)threads.size(); nThread++) {
+		threads[nThread].join();
+	}
+}
+
+#endif // CONCURRENT_H
@@ -0,0 +1,127 @@
+#line 2 "FindingsBuffer.h" // Make __FILE__ omit the path
+
+#ifndef FINDINGSBUFFER_H
+#define FINDINGSBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ASSERT
+#define ASSERT(x)
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief SFinding - a pattern found in the stream
+struct SFinding {
+	int nPatternIdx;
+	int nErrors;
+	uint64_t qwPosition; // of the first bit of the pattern, from the beginning of the stream
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CFindingsBuffer - storage of the findings shared by all the search engines, it never allocates.
+/// The findings are stored into the caller's array, the overflow policy is chosen by the constructor:
+/// - drop: the findings not fitting into the array are counted but not stored;
+/// - flush: the full array is passed to the callback and emptied. The callback may wait for a consumer
+///   to take the findings, so the scanning blocks until there is room. Without the array (zero capacity)
+///   each finding is passed to the callback at once.
+/// The buffer is a sink for the Scan methods of the engines: sink(qwBitsProcessed, output) stores the
+/// finding at GetBitsBefore() + qwBitsProcessed - output.stepBack, unless the pattern starts before the stream.
+class CFindingsBuffer {
+public:
+	typedef void (*TFlushCallback)(void *pContext, const SFinding *pFindings, size_t nCount);
+
+public: // constructors
+	CFindingsBuffer(SFinding *pFindings, size_t nCapacity):
+		m_pFindings(pFindings), m_nCapacity(nCapacity), m_pfnFlush(NULL), m_pContext(NULL), m_qwBitsBefore(0)
+	{
+		Clear();
+	}
+
+	CFindingsBuffer(SFinding *pFindings, size_t nCapacity, TFlushCallback pfnFlush, void *pContext):
+		m_pFindings(pFindings), m_nCapacity(nCapacity), m_pfnFlush(pfnFlush), m_pContext(pContext), m_qwBitsBefore(0)
+	{
+		Clear();
+	}
+
+public: // sink method
+	template <class TOutput>
+	void operator()(uint64_t qwBitsProcessed, const TOutput &output) {
+		uint64_t qwBits = m_qwBitsBefore + qwBitsProcessed;
+		if (output.stepBack <= qwBits) { // enough data
+			Add(output.patternIdx, output.errorsCount, qwBits - output.stepBack);
+		}
+	}
+
+public: // working methods
+	void Add(int nPatternIdx, int nErrors, uint64_t qwPosition) {
+		if (m_nCount == m_nCapacity) { // rare case - overflow
+			if (m_pfnFlush == NULL) {
+				m_nDropped++;
+				return;
+			}
+			if (m_nCapacity == 0) { // nothing to store into
+				SFinding finding = {nPatternIdx, nErrors, qwPosition};
+				m_pfnFlush(m_pContext, &finding, 1);
+				return;
+			}
+			Flush();
+		}
+		SFinding &finding = m_pFindings[m_nCount++];
+		finding.nPatternIdx = nPatternIdx;
+		finding.nErrors = nErrors;
+		finding.qwPosition = qwPosition;
+	}
+
+	/// bits of the stream scanned before the data passed to Scan, the positions are counted from them
+	void SetBitsBefore(uint64_t qwBits) {
+		m_qwBitsBefore = qwBits;
+	}
+
+	uint64_t GetBitsBefore() const {
+		return m_qwBitsBefore;
+	}
+
+	/// pass the stored findings to the callback, if any
+	void Flush() {
+		if (m_pfnFlush != NULL && m_nCount > 0) {
+			m_pfnFlush(m_pContext, m_pFindings, m_nCount);
+			m_nCount = 0;
+		}
+	}
+
+	void Clear() {
+		m_nCount = 0;
+		m_nDropped = 0;
+	}
+
+public: // results
+	size_t GetCount() const { // stored
+		return m_nCount;
+	}
+
+	size_t GetDroppedCount() const {
+		return m_nDropped;
+	}
+
+	const SFinding& operator[](size_t idx) const {
+		ASSERT(idx < m_nCount);
+		return m_pFindings[idx];
+	}
+
+private: // the storage mustn't be shared
+	CFindingsBuffer(const CFindingsBuffer&);
+	CFindingsBuffer& operator=(const CFindingsBuffer&);
+
+private:
+	SFinding *m_pFindings;
+	size_t m_nCapacity;
+	TFlushCallback m_pfnFlush; // NULL to drop the findings not fitting
+	void *m_pContext;
+	uint64_t m_qwBitsBefore;
+	size_t m_nCount;
+	size_t m_nDropped;
+};
+
+#endif // FINDINGSBUFFER_H
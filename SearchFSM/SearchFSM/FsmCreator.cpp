@@ -2,52 +2,164 @@
 
 #include "FsmCreator.h"
 
-#include <QQueue>
+#include <string.h>
 
-QString PatternToString(const SPattern &pattern) {
-	QString sPattern;
+#include <limits.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <utility>
+
+#include "Concurrent.h"
+
+std::string PatternToString(const SPattern &pattern) {
+	std::string sPattern;
 	int nBit;
 	for (nBit = 0; nBit < pattern.nLength; nBit++) {
 		if (GetMaskBit(pattern, nBit) != 0) {
-			sPattern.append(QString::number(GetBit(pattern, nBit)));
+			sPattern.push_back((char)('0' + GetBit(pattern, nBit)));
 		} else {
-			sPattern.append("-");
+			sPattern.push_back('-');
 		}
 	}
 
 	return sPattern;
 }
 
+bool StringToPattern(const std::string &sPattern, int nMaxErrors, SPattern *pPattern) {
+	// the pattern is a string of '0', '1' and '-' (insignificant bit)
+	int nLength = (int)sPattern.length();
+	if (nLength == 0) {
+		return false;
+	}
+
+	int nBytesCount = (nLength - 1) / BITS_IN_BYTE + 1;
+	int nBitsInLastByte = (nLength - 1) % BITS_IN_BYTE + 1;
+	SPattern pattern;
+	pattern.nLength = nLength;
+	pattern.nMaxErrors = nMaxErrors;
+	bool fMasked = false;
+	int nBit;
+	for (nBit = 0; nBit < nLength; nBit++) {
+		int nByteIdx = nBit / BITS_IN_BYTE;
+		int nBitIdx = nBit % BITS_IN_BYTE;
+		if (nByteIdx == nBytesCount - 1) { // last byte (possibly not whole) - bits are in the LSBs
+			nBitIdx += BITS_IN_BYTE - nBitsInLastByte;
+		}
+		if (nBit % BITS_IN_BYTE == 0) {
+			pattern.data.push_back(0);
+			pattern.mask.push_back(0);
+		}
+
+		unsigned char bBit = (unsigned char)(0x80 >> nBitIdx);
+		char cBit = sPattern[nBit];
+		if (cBit == '1') {
+			pattern.data[nByteIdx] |= bBit;
+			pattern.mask[nByteIdx] |= bBit;
+		} else if (cBit == '0') {
+			pattern.mask[nByteIdx] |= bBit;
+		} else if (cBit == '-') {
+			fMasked = true;
+		} else { // wrong symbol
+			return false;
+		}
+	}
+	if (!fMasked) { // no need in the mask
+		pattern.mask.clear();
+	}
+
+	*pPattern = pattern;
+	return true;
+}
+
+bool ReadPatternsFile(const std::string &sFileName, TPatterns *pPatterns, std::string *psError) {
+	std::ifstream file(sFileName.c_str());
+	if (!file) {
+		*psError = "can't open patterns file " + sFileName;
+		return false;
+	}
+
+	TPatterns patterns;
+	int nLine = 0;
+	std::string sLine;
+	while (std::getline(file, sLine)) {
+		nLine++;
+		size_t nComment = sLine.find('#');
+		if (nComment != std::string::npos) {
+			sLine.erase(nComment);
+		}
+
+		// the fields are separated by the whitespaces
+		std::istringstream line(sLine);
+		std::vector<std::string> fields;
+		std::string sField;
+		while (line >> sField) {
+			fields.push_back(sField);
+		}
+		if (fields.empty()) {
+			continue;
+		}
+
+		int nMaxErrors = 0;
+		bool fOk = fields.size() <= 2;
+		if (fOk && fields.size() == 2) {
+			char *pEnd = NULL;
+			nMaxErrors = (int)strtol(fields[1].c_str(), &pEnd, 10);
+			fOk = *pEnd == '\0';
+		}
+		SPattern pattern;
+		if (!fOk || nMaxErrors < 0 || !StringToPattern(fields[0], nMaxErrors, &pattern)) {
+			std::ostringstream error;
+			error << sFileName << "(" << nLine << "): wrong pattern";
+			*psError = error.str();
+			return false;
+		}
+		patterns.push_back(pattern);
+	}
+
+	if (patterns.empty()) {
+		*psError = "no patterns in " + sFileName;
+		return false;
+	}
+
+	*pPatterns = patterns;
+	return true;
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 // CFsmCreator
 CFsmCreator::CFsmCreator(const TPatterns &patterns):
-	m_patterns(patterns)
-{}
+	m_patterns(patterns), m_compiledPatterns(CompilePatterns(patterns)), m_buildStatus(buildStatus_Ok), m_dwCollisions(0),
+	m_nUnoptimizedStatesCount(0)
+{
+	SBuildBudget budget = {0, 0, 0}; // no limits
+	m_budget = budget;
+}
 
 bool CFsmCreator::GenerateTables(bool fVerbose) {
-	m_states.clear();
-	m_idxStates.clear();
+	TClock::time_point timeStart = TClock::now();
+	m_buildStatus = buildStatus_Ok;
+	m_states.Init(m_compiledPatterns);
 	m_dwCollisions = 0;
-
-	{ // create initial state - all the parts are empty
-		SStateDescription state0;
-		SStatePart emptyPart;
-		int idx, nCount = m_patterns.count();
-		for (idx = 0; idx < nCount; idx++) {
-			state0.parts << emptyPart;
-		}
-		AddState(state0);
-	}
+	AddState(CreateInitialState(m_compiledPatterns));
 
 	m_table.clear();
 	int nCurrentState;
-	for (nCurrentState = 0; nCurrentState < m_states.count(); nCurrentState++) {
+	for (nCurrentState = 0; nCurrentState < m_states.GetCount(); nCurrentState++) {
 		STableRow row;
-		const SStateDescription &state = m_states[nCurrentState];
+		SStateDescription state;
+		m_states.Unpack(nCurrentState, &state);
 		row.cell0 = TransitState(state, 0);
 		row.cell1 = TransitState(state, 1);
-		m_table.append(row);
+		m_table.push_back(row);
+
+		EBuildStatus status = CheckBuildBudget(timeStart);
+		if (status != buildStatus_Ok) {
+			return AbortGeneration(status);
+		}
 
 		if (fVerbose) {
 			// output (for debug reason)
@@ -64,56 +176,309 @@ bool CFsmCreator::GenerateTables(bool fVerbose) {
 	}
 
 	// no needed anymore
-	m_states.clear();
-	m_idxStates.clear();
+	m_states.Clear();
+	m_nUnoptimizedStatesCount = (int)m_table.size();
 
 	return true;
 }
 
-bool CFsmCreator::OptimizeTables(bool fVerbose) {
-	const int g_nNoState = -1; // index for states to be removed
+bool CFsmCreator::GenerateTablesParallel(int nThreads) {
+	// breadth-first: the frontier states are expanded by batches, the batch's transitions are computed and
+	// looked up among the known states concurrently, then the new states are deduplicated concurrently in
+	// shards by hash; only the numbering is sequential, in the same order as GenerateTables does
+	const int g_nBatchStates = 1 << 14;
+	if (nThreads <= 0) {
+		nThreads = GetIdealThreadCount();
+	}
+
+	TClock::time_point timeStart = TClock::now();
+	m_buildStatus = buildStatus_Ok;
+	m_states.Init(m_compiledPatterns);
+	m_dwCollisions = 0;
+	AddState(CreateInitialState(m_compiledPatterns));
+
+	m_table.clear();
+	int nBatchBegin;
+	for (nBatchBegin = 0; nBatchBegin < m_states.GetCount(); nBatchBegin = (int)m_table.size()) {
+		int nBatchEnd = std::min(m_states.GetCount(), nBatchBegin + g_nBatchStates);
+		int nExpansionsCount = 2 * (nBatchEnd - nBatchBegin);
+		std::vector<SExpansion> expansions(nExpansionsCount);
+
+		// transitions
+		std::vector<SExpandTask> expandTasks(nThreads);
+		int nTask;
+		for (nTask = 0; nTask < nThreads; nTask++) {
+			SExpandTask &task = expandTasks[nTask];
+			task.pCreator = this;
+			task.nBatchBegin = nBatchBegin;
+			task.nBegin = nBatchBegin + (nBatchEnd - nBatchBegin) * nTask / nThreads;
+			task.nEnd = nBatchBegin + (nBatchEnd - nBatchBegin) * (nTask + 1) / nThreads;
+			task.pExpansions = expansions.data();
+		}
+		BlockingMap(expandTasks, &CFsmCreator::ExpandStates, nThreads);
 
-	QSet<int> nsUnessentialStates = FindUnessentialStates(fVerbose);
-	if (nsUnessentialStates.isEmpty()) { // no unessential states
-		return true;
+		// new states deduplication
+		std::vector<int> nsFirst(nExpansionsCount, -1);
+		std::vector<SDedupTask> dedupTasks(nThreads);
+		for (nTask = 0; nTask < nThreads; nTask++) {
+			SDedupTask &task = dedupTasks[nTask];
+			task.pCreator = this;
+			task.pExpansions = expansions.data();
+			task.nExpansionsCount = nExpansionsCount;
+			task.nShard = nTask;
+			task.nShards = nThreads;
+			task.pnsFirst = nsFirst.data();
+			task.dwCollisions = 0;
+		}
+		BlockingMap(dedupTasks, &CFsmCreator::DeduplicateStates, nThreads);
+		for (nTask = 0; nTask < nThreads; nTask++) {
+			m_dwCollisions += dedupTasks[nTask].dwCollisions;
+		}
+
+		// numbering
+		int idx;
+		for (idx = 0; idx < nExpansionsCount; idx++) {
+			SExpansion &expansion = expansions[idx];
+			if (expansion.nNextState < 0) {
+				if (nsFirst[idx] == idx) { // the first occurrence of the new state
+					expansion.nNextState = m_states.Add(expansion.state, expansion.hash);
+				} else {
+					expansion.nNextState = expansions[nsFirst[idx]].nNextState;
+				}
+			}
+		}
+
+		int nState;
+		for (nState = nBatchBegin; nState < nBatchEnd; nState++) {
+			const SExpansion &expansion0 = expansions[2 * (nState - nBatchBegin)];
+			const SExpansion &expansion1 = expansions[2 * (nState - nBatchBegin) + 1];
+			STableRow row;
+			row.cell0.nNextState = expansion0.nNextState;
+			row.cell0.output = expansion0.output;
+			row.cell1.nNextState = expansion1.nNextState;
+			row.cell1.output = expansion1.output;
+			m_table.push_back(row);
+		}
+
+		EBuildStatus status = CheckBuildBudget(timeStart);
+		if (status != buildStatus_Ok) {
+			return AbortGeneration(status);
+		}
 	}
 
-	// reindex essential states (for removing unessential ones)
-	int nState, nStatesCount = m_table.count();
-	QVector<int> nsStatesShift(nStatesCount); // old state -> new state
-	int cEssentialStates = 0;
-	for (nState = 0; nState < nStatesCount; nState++) {
-		if (nsUnessentialStates.contains(nState)) { // unessential state -> -1
-			nsStatesShift[nState] = g_nNoState;
+	// no needed anymore
+	m_states.Clear();
+	m_nUnoptimizedStatesCount = (int)m_table.size();
 
-		} else { // essential state
-			nsStatesShift[nState] = cEssentialStates;
-			cEssentialStates++;
+	return true;
+}
+
+bool CFsmCreator::GenerateTablesFitting(uint64_t qwMaxTableBytes, int nBitsAtOnce, SSizeEstimate *pEstimate) {
+	// the tables of nBitsAtOnce predicted larger are refused at once; the prediction may be several times low,
+	// so the generation stops at the states of the limit (a byte SearchFSM has the states of the bit one at most)
+	SSizeEstimate estimate = EstimateSize();
+	if (pEstimate != NULL) {
+		*pEstimate = estimate;
+	}
+	if (GetTableBytes(estimate.qwStatesCount, nBitsAtOnce) > qwMaxTableBytes) {
+		return AbortGeneration(buildStatus_StatesExceeded);
+	}
+
+	SBuildBudget budgetCaller = m_budget;
+	uint64_t qwMaxStates = qwMaxTableBytes / GetTableBytes(1, nBitsAtOnce);
+	m_budget.nMaxStates = (int)std::min(qwMaxStates, (uint64_t)INT_MAX);
+	m_budget.qwMaxBytes = qwMaxTableBytes;
+	bool fGenerated = GenerateTables();
+	m_budget = budgetCaller;
+	return fGenerated;
+}
+
+void CFsmCreator::SetBuildBudget(const SBuildBudget &budget) {
+	m_budget = budget;
+}
+
+CFsmCreator::EBuildStatus CFsmCreator::GetBuildStatus() const {
+	return m_buildStatus;
+}
+
+const char* CFsmCreator::GetBuildStatusText(EBuildStatus status) {
+	switch (status) {
+	case buildStatus_Ok:
+		return "OK";
+	case buildStatus_StatesExceeded:
+		return "states count budget exceeded";
+	case buildStatus_BytesExceeded:
+		return "memory budget exceeded";
+	case buildStatus_TimeExceeded:
+		return "time budget exceeded";
+	default:
+		return "unknown status";
+	}
+}
+
+CFsmCreator::SSizeEstimate CFsmCreator::EstimateSize(int nSampleStates) const {
+	const int g_nDepthPoints = 12; // sampled levels, the levels between them are interpolated
+	const int g_nLevelSamples = 1024;
+
+	// the upper bound: a part depends on the last nLength bits only, so it has 2^(nLength + 1) - 1 values at
+	// most (the windows and the shorter beginnings), the whole state is bound the same by the longest pattern;
+	// an exact pattern without the mask has a part per its prefix, all such patterns have a state per prefix
+	// of any pattern, as in Aho-Corasick
+	int nMaxLength = 0;
+	bool fAllExact = true;
+	long double dPartsBound = 1, dPrefixesBound = 1;
+	int idx;
+	for (idx = 0; idx < (int)m_patterns.size(); idx++) {
+		const SPattern &pattern = m_patterns[idx];
+		nMaxLength = std::max(nMaxLength, pattern.nLength);
+		dPrefixesBound += pattern.nLength;
+		if (pattern.nMaxErrors == 0 && pattern.mask.empty()) {
+			dPartsBound *= pattern.nLength;
+		} else {
+			dPartsBound *= GetWindowStatesBound(pattern.nLength);
+			fAllExact = false;
 		}
 	}
+	long double dBound = std::min(dPartsBound, GetWindowStatesBound(nMaxLength));
+	if (fAllExact) {
+		dBound = std::min(dBound, dPrefixesBound);
+	}
 
-	// create new FSM table (with new indexes)
-	QVector<STableRow> tableNew(cEssentialStates);
-	for (nState = 0; nState < nStatesCount; nState++) {
-		int nNewStateIdx = nsStatesShift[nState];
-		if (nNewStateIdx != g_nNoState) {
-			STableRow row = m_table[nState];
-			row.cell0.nNextState = nsStatesShift[row.cell0.nNextState];
-			row.cell1.nNextState = nsStatesShift[row.cell1.nNextState];
-			tableNew[nNewStateIdx] = row;
+	// the generation order is breadth-first and a state's depth is its longest prefix found (the last bits
+	// are enough to reach it), so the first states give the exact sizes of the first levels
+	CStateArena states;
+	states.Init(m_compiledPatterns);
+	std::vector<int> nsDepths;
+	SStateDescription state = CreateInitialState(m_compiledPatterns), stateNext = state;
+	states.Add(states.Pack(state), CStateArena::Hash(states.Pack(state)));
+	nsDepths.push_back(0);
+	int nState, nExpandedDepth = 0;
+	for (nState = 0; nState < states.GetCount() && states.GetCount() <= nSampleStates; nState++) {
+		states.Unpack(nState, &state);
+		nExpandedDepth = nsDepths[nState];
+		unsigned char bBit;
+		for (bBit = 0; bBit <= 1; bBit++) {
+			AdvanceState(m_compiledPatterns, state.words.data(), bBit, stateNext.words.data());
+			TPackedState packed = states.Pack(stateNext);
+			TStateHash hash = CStateArena::Hash(packed);
+			if (states.Find(packed, hash) < 0) {
+				states.Add(packed, hash);
+				nsDepths.push_back(GetStateDepth(m_compiledPatterns, stateNext.words.data()));
+			}
 		}
 	}
 
-	// substitute FSM table with a newly created one
-	m_table = tableNew;
+	SSizeEstimate estimate;
+	estimate.qwMaxStatesCount = (uint64_t)dBound;
+	estimate.fExact = nState >= states.GetCount();
+	long double dPredicted = states.GetCount();
+	if (!estimate.fExact) {
+		// the levels up to the expanded one are complete, the deeper ones are sampled
+		dPredicted = 0;
+		for (idx = 0; idx < (int)nsDepths.size(); idx++) {
+			if (nsDepths[idx] <= nExpandedDepth) {
+				dPredicted++;
+			}
+		}
+
+		int nFirstDepth = nExpandedDepth + 1, nLastDepth = nMaxLength - 1;
+		int nStep = std::max(1, (nLastDepth - nFirstDepth) / g_nDepthPoints);
+		unsigned int dwRandom = 0;
+		int nPrevDepth = -1;
+		long double dPrevSize = 0;
+		int nDepth = nFirstDepth;
+		while (nDepth <= nLastDepth) {
+			long double dSize = EstimateLevelSize(nDepth, g_nLevelSamples, &dwRandom);
+			dPredicted += dSize;
+			if (nPrevDepth >= 0) { // the levels in between are linear
+				int nSkipped = nDepth - nPrevDepth - 1;
+				dPredicted += (dPrevSize + dSize) / 2 * nSkipped;
+			}
+			nPrevDepth = nDepth;
+			dPrevSize = dSize;
+			if (nDepth == nLastDepth) {
+				break;
+			}
+			nDepth = std::min(nDepth + nStep, nLastDepth);
+		}
+	}
+
+	estimate.qwStatesCount = (uint64_t)std::min(dPredicted, dBound);
+	estimate.qwBitTableBytes = GetTableBytes(estimate.qwStatesCount, 1);
+	estimate.qwNibbleTableBytes = GetTableBytes(estimate.qwStatesCount, 4);
+	estimate.qwOctetTableBytes = GetTableBytes(estimate.qwStatesCount, BITS_IN_BYTE);
+	estimate.qwOctetCombTableBytes = GetCombTableBytes(estimate.qwStatesCount, BITS_IN_BYTE);
+	return estimate;
+}
+
+uint64_t CFsmCreator::GetTableBytes(uint64_t qwStatesCount, int nBitsAtOnce, int nCellSize) {
+	// a byte SearchFSM has the states of the bit one at most
+	return qwStatesCount * ((uint64_t)nCellSize << nBitsAtOnce);
+}
+
+uint64_t CFsmCreator::GetCombTableBytes(uint64_t qwStatesCount, int nBitsAtOnce, int nCellSize) {
+	// the state info is a cell, a comb cell is two cells (with the check) and a half (the base's state),
+	// a default cell is one and a half; each row is expected to differ from its default row within the limit
+	uint64_t qwColumns = (uint64_t)1 << nBitsAtOnce;
+	uint64_t qwExceptions = std::max(qwColumns / g_nCombExceptionsShare, (uint64_t)1);
+	return qwStatesCount * (nCellSize + qwExceptions * nCellSize * 5 / 2) + g_nCombMaxDefaultRows * qwColumns * nCellSize * 3 / 2;
+}
+
+bool CFsmCreator::OptimizeTables(bool fVerbose) {
+	const int g_nNoState = -1; // index for states to be removed
+
+	int nStatesBefore = (int)m_table.size();
+	std::set<int> nsUnessentialStates = FindUnessentialStates(fVerbose);
+	if (!nsUnessentialStates.empty()) {
+		// reindex essential states (for removing unessential ones)
+		int nState, nStatesCount = (int)m_table.size();
+		std::vector<int> nsStatesShift(nStatesCount); // old state -> new state
+		int cEssentialStates = 0;
+		for (nState = 0; nState < nStatesCount; nState++) {
+			if (nsUnessentialStates.count(nState) > 0) { // unessential state -> -1
+				nsStatesShift[nState] = g_nNoState;
+
+			} else { // essential state
+				nsStatesShift[nState] = cEssentialStates;
+				cEssentialStates++;
+			}
+		}
+
+		// substitute FSM table with a newly created one (with new indexes)
+		RemapStates(nsStatesShift, cEssentialStates);
+	}
+
+	// merge equivalent states
+	MinimizeTables(fVerbose);
+	m_nUnoptimizedStatesCount = nStatesBefore;
+
+	if (fVerbose) {
+		printf("optimization: %i states -> %i states\n", nStatesBefore, (int)m_table.size());
+	}
+
+	return true;
+}
+
+bool CFsmCreator::MinimizeTables(bool fVerbose) {
+	// unlike OptimizeTables it keeps the FSM exactly equivalent from the very beginning of the stream
+	std::vector<int> nsStateClasses;
+	int nStatesBefore = (int)m_table.size();
+	int nClassesCount = FindEquivalentStates(&nsStateClasses);
+	if (nClassesCount < nStatesBefore) { // some states are merged
+		RemapStates(nsStateClasses, nClassesCount);
+	}
+
+	if (fVerbose) {
+		printf("minimization: %i states -> %i states\n", nStatesBefore, (int)m_table.size());
+	}
 
 	return true;
 }
 
-QSet<int> CFsmCreator::FindUnessentialStates(bool fVerbose) const {
+std::set<int> CFsmCreator::FindUnessentialStates(bool fVerbose) const {
 	// count incoming arcs for each state
-	int nStatesCount = m_table.count();
-	QVector<int> nsIncomingArcs(nStatesCount, 0);
+	int nStatesCount = (int)m_table.size();
+	std::vector<int> nsIncomingArcs(nStatesCount, 0);
 	int nState;
 	for (nState = 0; nState < nStatesCount; nState++) {
 		const STableRow &row = m_table[nState];
@@ -122,24 +487,25 @@ QSet<int> CFsmCreator::FindUnessentialStates(bool fVerbose) const {
 	}
 
 	// locate unessential states
-	QQueue<int> qsZeroStates; // states with zero incoming arcs
+	std::queue<int> qsZeroStates; // states with zero incoming arcs
 	if (nsIncomingArcs[0] == 0) { // only this state might be with zero incoming arcs at the beginning
-		qsZeroStates.enqueue(0); // zero state
+		qsZeroStates.push(0); // zero state
 	}
-	QSet<int> nsUnessentialStates;
-	while (!qsZeroStates.isEmpty()) {
-		int nZeroState = qsZeroStates.dequeue();
-		nsUnessentialStates << nZeroState;
+	std::set<int> nsUnessentialStates;
+	while (!qsZeroStates.empty()) {
+		int nZeroState = qsZeroStates.front();
+		qsZeroStates.pop();
+		nsUnessentialStates.insert(nZeroState);
 		const STableRow &row = m_table[nZeroState];
 		int nNextState0 = row.cell0.nNextState;
 		nsIncomingArcs[nNextState0]--;
 		if (nsIncomingArcs[nNextState0] == 0) {
-			qsZeroStates.enqueue(nNextState0);
+			qsZeroStates.push(nNextState0);
 		}
 		int nNextState1 = row.cell1.nNextState;
 		nsIncomingArcs[nNextState1]--;
 		if (nsIncomingArcs[nNextState1] == 0) {
-			qsZeroStates.enqueue(nNextState1);
+			qsZeroStates.push(nNextState1);
 		}
 
 		if (fVerbose) {
@@ -150,52 +516,275 @@ QSet<int> CFsmCreator::FindUnessentialStates(bool fVerbose) const {
 	return nsUnessentialStates;
 }
 
+int CFsmCreator::FindEquivalentStates(std::vector<int> *pnsStateClasses) const {
+	// Hopcroft's partition refinement; outputs belong to the transitions (Mealy FSM), so the initial
+	// partition groups the states with equal output lists in both columns
+	const int g_nColumnsCount = 2;
+	const unsigned int g_dwHashColumnMultiplier = 1907;
+	int nState, nStatesCount = (int)m_table.size();
+	if (nStatesCount == 0) {
+		pnsStateClasses->clear();
+		return 0;
+	}
+
+	// partition: states are stored by blocks in nsElements, each block is a continuous range
+	std::vector<int> nsElements(nStatesCount); // states ordered by blocks
+	std::vector<int> nsLocations(nStatesCount); // state -> its position in nsElements
+	std::vector<int> nsBlockOf(nStatesCount); // state -> block
+	std::vector<int> nsBlockBegin, nsBlockEnd; // block -> range in nsElements
+	std::vector<int> nsBlockMarked; // block -> count of marked states (at the beginning of the block)
+
+	{ // initial partition by the outputs
+		std::unordered_map<TStateHash, TIndexList> idxBlocks; // hash -> indexes of blocks (by their first states)
+		std::vector<int> nsFirstStates; // block -> state representing it
+		std::vector<int> nsBlockSizes;
+		for (nState = 0; nState < nStatesCount; nState++) {
+			const STableRow &row = m_table[nState];
+			TStateHash hash = Hash(row.cell0.output) * g_dwHashColumnMultiplier + Hash(row.cell1.output);
+			TIndexList &list = idxBlocks[hash];
+			int nBlock = -1;
+			int idx;
+			for (idx = 0; idx < (int)list.size(); idx++) {
+				const STableRow &rowBlock = m_table[nsFirstStates[list[idx]]];
+				if (AreEqual(row.cell0.output, rowBlock.cell0.output) && AreEqual(row.cell1.output, rowBlock.cell1.output)) {
+					nBlock = list[idx];
+					break;
+				}
+			}
+			if (nBlock < 0) { // new block
+				nBlock = (int)nsFirstStates.size();
+				nsFirstStates.push_back(nState);
+				nsBlockSizes.push_back(0);
+				list.push_back(nBlock);
+			}
+			nsBlockOf[nState] = nBlock;
+			nsBlockSizes[nBlock]++;
+		}
+
+		int nBlock, nPosition = 0;
+		for (nBlock = 0; nBlock < (int)nsBlockSizes.size(); nBlock++) {
+			nsBlockBegin.push_back(nPosition);
+			nsBlockEnd.push_back(nPosition);
+			nsBlockMarked.push_back(0);
+			nPosition += nsBlockSizes[nBlock];
+		}
+		for (nState = 0; nState < nStatesCount; nState++) {
+			int &nEnd = nsBlockEnd[nsBlockOf[nState]];
+			nsElements[nEnd] = nState;
+			nsLocations[nState] = nEnd;
+			nEnd++;
+		}
+	}
+
+	// inverse transitions for each column: predecessors of the state are stored continuously
+	std::vector<int> nsPredBegin[g_nColumnsCount], nsPredecessors[g_nColumnsCount];
+	int nColumn;
+	for (nColumn = 0; nColumn < g_nColumnsCount; nColumn++) {
+		std::vector<int> &nsBegin = nsPredBegin[nColumn];
+		nsBegin.assign(nStatesCount + 1, 0);
+		for (nState = 0; nState < nStatesCount; nState++) {
+			const STableRow &row = m_table[nState];
+			nsBegin[((nColumn == 0)? row.cell0.nNextState : row.cell1.nNextState) + 1]++;
+		}
+		for (nState = 0; nState < nStatesCount; nState++) {
+			nsBegin[nState + 1] += nsBegin[nState];
+		}
+		std::vector<int> nsFill = nsBegin;
+		nsPredecessors[nColumn].resize(nStatesCount);
+		for (nState = 0; nState < nStatesCount; nState++) {
+			const STableRow &row = m_table[nState];
+			int nNextState = (nColumn == 0)? row.cell0.nNextState : row.cell1.nNextState;
+			nsPredecessors[nColumn][nsFill[nNextState]++] = nState;
+		}
+	}
+
+	// worklist of splitters (block, column)
+	std::vector<std::pair<int, int> > splitters;
+	std::vector<bool> fsInWorklist[g_nColumnsCount];
+	for (nColumn = 0; nColumn < g_nColumnsCount; nColumn++) {
+		fsInWorklist[nColumn].assign((int)nsBlockBegin.size(), true);
+		int nBlock;
+		for (nBlock = 0; nBlock < (int)nsBlockBegin.size(); nBlock++) {
+			splitters.push_back(std::make_pair(nBlock, nColumn));
+		}
+	}
+
+	std::vector<int> nsSplitterStates;
+	std::vector<int> nsTouchedBlocks;
+	while (!splitters.empty()) {
+		std::pair<int, int> splitter = splitters.back();
+		splitters.pop_back();
+		int nSplitterBlock = splitter.first;
+		nColumn = splitter.second;
+		fsInWorklist[nColumn][nSplitterBlock] = false;
+
+		// mark the states leading into the splitter block (the block may split itself, so copy it)
+		nsSplitterStates.clear();
+		int nPosition;
+		for (nPosition = nsBlockBegin[nSplitterBlock]; nPosition < nsBlockEnd[nSplitterBlock]; nPosition++) {
+			nsSplitterStates.push_back(nsElements[nPosition]);
+		}
+		nsTouchedBlocks.clear();
+		int idx;
+		for (idx = 0; idx < (int)nsSplitterStates.size(); idx++) {
+			int nTarget = nsSplitterStates[idx];
+			int nPred;
+			for (nPred = nsPredBegin[nColumn][nTarget]; nPred < nsPredBegin[nColumn][nTarget + 1]; nPred++) {
+				int nPredState = nsPredecessors[nColumn][nPred];
+				int nBlock = nsBlockOf[nPredState];
+				int nMarkedEnd = nsBlockBegin[nBlock] + nsBlockMarked[nBlock];
+				if (nsLocations[nPredState] < nMarkedEnd) { // already marked
+					continue;
+				}
+				if (nsBlockMarked[nBlock] == 0) {
+					nsTouchedBlocks.push_back(nBlock);
+				}
+
+				// move the state to the marked part of its block
+				int nOtherState = nsElements[nMarkedEnd];
+				int nPredLocation = nsLocations[nPredState];
+				nsElements[nMarkedEnd] = nPredState;
+				nsLocations[nPredState] = nMarkedEnd;
+				nsElements[nPredLocation] = nOtherState;
+				nsLocations[nOtherState] = nPredLocation;
+				nsBlockMarked[nBlock]++;
+			}
+		}
+
+		// split the touched blocks: marked part becomes a new block
+		for (idx = 0; idx < (int)nsTouchedBlocks.size(); idx++) {
+			int nBlock = nsTouchedBlocks[idx];
+			int nMarked = nsBlockMarked[nBlock];
+			int nBlockSize = nsBlockEnd[nBlock] - nsBlockBegin[nBlock];
+			nsBlockMarked[nBlock] = 0;
+			if (nMarked == nBlockSize) { // the whole block is marked - nothing to split
+				continue;
+			}
+
+			int nNewBlock = (int)nsBlockBegin.size();
+			nsBlockBegin.push_back(nsBlockBegin[nBlock]);
+			nsBlockEnd.push_back(nsBlockBegin[nBlock] + nMarked);
+			nsBlockMarked.push_back(0);
+			nsBlockBegin[nBlock] += nMarked;
+			for (nPosition = nsBlockBegin[nNewBlock]; nPosition < nsBlockEnd[nNewBlock]; nPosition++) {
+				nsBlockOf[nsElements[nPosition]] = nNewBlock;
+			}
+
+			// update the worklist: whole pair if the block is waiting, otherwise the smaller part is enough
+			int nSplitColumn;
+			for (nSplitColumn = 0; nSplitColumn < g_nColumnsCount; nSplitColumn++) {
+				fsInWorklist[nSplitColumn].push_back(false);
+				int nAddBlock = nNewBlock;
+				if (!fsInWorklist[nSplitColumn][nBlock] && nMarked > nBlockSize - nMarked) {
+					nAddBlock = nBlock;
+				}
+				splitters.push_back(std::make_pair(nAddBlock, nSplitColumn));
+				fsInWorklist[nSplitColumn][nAddBlock] = true;
+			}
+		}
+	}
+
+	// enumerate classes in order of their first states, so the initial state stays zero
+	std::vector<int> nsClassOfBlock((int)nsBlockBegin.size(), -1);
+	pnsStateClasses->resize(nStatesCount);
+	int cClasses = 0;
+	for (nState = 0; nState < nStatesCount; nState++) {
+		int &nClass = nsClassOfBlock[nsBlockOf[nState]];
+		if (nClass < 0) {
+			nClass = cClasses;
+			cClasses++;
+		}
+		(*pnsStateClasses)[nState] = nClass;
+	}
+
+	return cClasses;
+}
+
 CFsmCreator::TByteTable CFsmCreator::CreateByteTable(int nBitsAtOnce, CFsmCreator::EBitOrder bitOrder) const {
-	const unsigned int dwColumnsCount = 1 << nBitsAtOnce;
-	const int nRowsCount = m_table.count();
+	const int nRowsCount = (int)m_table.size();
 	TByteTable table;
 	table.rows.resize(nRowsCount);
 	int nRow;
 	for (nRow = 0; nRow < nRowsCount; nRow++) {
-		table.rows[nRow].cells.resize(dwColumnsCount);
-		unsigned int dwValue;
-		for (dwValue = 0; dwValue < dwColumnsCount; dwValue++) {
-			// in the state nRow got byte dwValue bit-by-bit
-			int nState = nRow;
-			TOutputList outputList;
-			int nBit;
-			for (nBit = 0; nBit < nBitsAtOnce; nBit++) {
-				unsigned char bBit;
-				if (bitOrder == bitOrder_LsbFirst) {
-					bBit = (dwValue >> nBit) & 0x01;
-				} else {
-					bBit = (dwValue >> (nBitsAtOnce - nBit - 1)) & 0x01;
-				}
+		CreateByteRow(nRow, nBitsAtOnce, bitOrder, &table.rows[nRow]);
+	}
 
-				const STableRow &row = m_table[nState];
-				const STableCell &cell = (bBit == 0)? row.cell0 : row.cell1;
-				nState = cell.nNextState;
-				int nBitsRemained = nBitsAtOnce - nBit - 1;
-				int idxOut;
-				for (idxOut = 0; idxOut < cell.output.count(); idxOut++) {
-					SOutput output = cell.output[idxOut];
-					output.nStepBack += nBitsRemained;
-					outputList.append(output);
-				}
+	table.nClassesCount = FindSymbolClasses(table, &table.symbolClasses);
+
+	return table;
+}
+
+void CFsmCreator::CreateByteRow(int nRow, int nBitsAtOnce, CFsmCreator::EBitOrder bitOrder, CFsmCreator::SByteTableRow *pRow) const {
+	const unsigned int dwColumnsCount = 1 << nBitsAtOnce;
+	pRow->cells.resize(dwColumnsCount);
+	unsigned int dwValue;
+	for (dwValue = 0; dwValue < dwColumnsCount; dwValue++) {
+		// in the state nRow got byte dwValue bit-by-bit
+		int nState = nRow;
+		STableCell &cellByte = pRow->cells[dwValue];
+		cellByte.output.clear();
+		int nBit;
+		for (nBit = 0; nBit < nBitsAtOnce; nBit++) {
+			unsigned char bBit;
+			if (bitOrder == bitOrder_LsbFirst) {
+				bBit = (dwValue >> nBit) & 0x01;
+			} else {
+				bBit = (dwValue >> (nBitsAtOnce - nBit - 1)) & 0x01;
 			}
 
-			STableCell cell;
-			cell.nNextState = nState;
-			cell.output = outputList;
-			table.rows[nRow].cells[dwValue] = cell;
+			const STableRow &row = m_table[nState];
+			const STableCell &cell = (bBit == 0)? row.cell0 : row.cell1;
+			nState = cell.nNextState;
+			int nBitsRemained = nBitsAtOnce - nBit - 1;
+			int idxOut;
+			for (idxOut = 0; idxOut < (int)cell.output.size(); idxOut++) {
+				SOutput output = cell.output[idxOut];
+				output.nStepBack += nBitsRemained;
+				cellByte.output.push_back(output);
+			}
 		}
+		cellByte.nNextState = nState;
 	}
+}
 
-	return table;
+int CFsmCreator::GetMinimalDataSize(unsigned int dwMaxValue) {
+	if (dwMaxValue <= 0xff) { // single-byte integer is enough
+		return 1;
+	} else if (dwMaxValue <= 0xffff) { // two-byte integer is enough
+		return 2;
+	} else { // four-byte integer is enough
+		return 4;
+	}
+}
+
+const char* CFsmCreator::GetTypeName(int nSize) {
+	switch (nSize) {
+	case 1:
+		return "unsigned char";
+	case 2:
+		return "unsigned short";
+	default:
+		return "unsigned int";
+	}
+}
+
+unsigned int CFsmCreator::GetOutputNull(int nSize) {
+	switch (nSize) {
+	case 1:
+		return 0xff;
+	case 2:
+		return 0xffff;
+	default:
+		return 0xffffffff;
+	}
 }
 
 int CFsmCreator::GetStatesCount() const {
-	return m_table.count();
+	return (int)m_table.size();
+}
+
+int CFsmCreator::GetUnoptimizedStatesCount() const {
+	return m_nUnoptimizedStatesCount;
 }
 
 unsigned int CFsmCreator::GetCollisionsCount() const {
@@ -206,171 +795,796 @@ const CFsmCreator::STableRow &CFsmCreator::GetTableRow(int nRow) const {
 	return m_table[nRow];
 }
 
+CFsmCreator::EBuildStatus CFsmCreator::CheckBuildBudget(TClock::time_point timeStart) const {
+	if (m_budget.nMaxStates > 0 && m_states.GetCount() > m_budget.nMaxStates) {
+		return buildStatus_StatesExceeded;
+	}
+
+	uint64_t qwBytes = m_states.GetMemoryUsage() + (uint64_t)m_table.size() * sizeof(STableRow);
+	if (m_budget.qwMaxBytes > 0 && qwBytes > m_budget.qwMaxBytes) {
+		return buildStatus_BytesExceeded;
+	}
+
+	long long nElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - timeStart).count();
+	if (m_budget.nMaxMilliseconds > 0 && nElapsed > m_budget.nMaxMilliseconds) {
+		return buildStatus_TimeExceeded;
+	}
+
+	return buildStatus_Ok;
+}
+
+bool CFsmCreator::AbortGeneration(EBuildStatus status) {
+	m_states.Clear();
+	m_table.clear();
+	m_nUnoptimizedStatesCount = 0;
+	m_buildStatus = status;
+	return false;
+}
+
+long double CFsmCreator::GetWindowStatesBound(int nLength) {
+	// 2^(nLength + 1) - 1, saturated far below uint64_t overflow
+	const int g_nMaxPower = 62;
+	if (nLength + 1 >= g_nMaxPower) {
+		return (long double)((uint64_t)1 << g_nMaxPower);
+	}
+
+	return (long double)(((uint64_t)1 << (nLength + 1)) - 1);
+}
+
+long double CFsmCreator::EstimateLevelSize(int nDepth, int nSamples, unsigned int *pdwRandom) const {
+	// every state of the level is reached by the bits of some pattern's prefix of nDepth bits with its errors
+	// and insignificant bits; the state keeps the prefix's errors count, so the generators are split by the
+	// pattern and the errors count, each part is sampled uniformly and its unseen states are estimated by
+	// the visits counts (ACE estimator); the errors far from the end merge many generators into one state,
+	// so the deep levels of the large error budgets are rather underestimated
+	const int g_nMinPartSamples = 16;
+	const int g_nRareVisits = 10;
+
+	std::vector<int> nsPatterns, nsErrors;
+	std::vector<long double> dsGenerators;
+	int idx;
+	for (idx = 0; idx < (int)m_patterns.size(); idx++) {
+		const SPattern &pattern = m_patterns[idx];
+		if (pattern.nLength <= nDepth) { // the whole pattern isn't kept in the state
+			continue;
+		}
+
+		int nSignificant = 0;
+		long double dInsignificant = 1;
+		int nBit;
+		for (nBit = 0; nBit < nDepth; nBit++) {
+			if (GetMaskBit(pattern, nBit) != 0) {
+				nSignificant++;
+			} else {
+				dInsignificant *= 2;
+			}
+		}
+		long double dCombinations = 1;
+		int nErrors;
+		for (nErrors = 0; nErrors <= std::min(pattern.nMaxErrors, nSignificant); nErrors++) {
+			nsPatterns.push_back(idx);
+			nsErrors.push_back(nErrors);
+			dsGenerators.push_back(dCombinations * dInsignificant);
+			dCombinations = dCombinations * (nSignificant - nErrors) / (nErrors + 1);
+		}
+	}
+	if (nsPatterns.empty()) {
+		return 0;
+	}
+
+	const SStateDescription stateInitial = CreateInitialState(m_compiledPatterns);
+	SStateDescription state = stateInitial, stateNext = stateInitial;
+	std::vector<unsigned char> bsBits(nDepth);
+	long double dGenerators = 0;
+	int nPart;
+	for (nPart = 0; nPart < (int)dsGenerators.size(); nPart++) {
+		dGenerators += dsGenerators[nPart];
+	}
+
+	long double dPredicted = 0;
+	for (nPart = 0; nPart < (int)nsPatterns.size(); nPart++) {
+		// the samples are proportional to the generators, but the small parts are still estimated
+		const int nPartSamples = std::max((int)(nSamples * dsGenerators[nPart] / dGenerators), g_nMinPartSamples);
+		const SPattern &pattern = m_patterns[nsPatterns[nPart]];
+		std::vector<int> nsSignificant;
+		int nBit;
+		for (nBit = 0; nBit < nDepth; nBit++) {
+			if (GetMaskBit(pattern, nBit) != 0) {
+				nsSignificant.push_back(nBit);
+			}
+		}
+
+		CStateArena states;
+		states.Init(m_compiledPatterns);
+		std::vector<int> nsVisits;
+		int nSample;
+		for (nSample = 0; nSample < nPartSamples; nSample++) {
+			// the prefix with random insignificant bits, then random errors among the significant ones
+			for (nBit = 0; nBit < nDepth; nBit++) {
+				bsBits[nBit] = (GetMaskBit(pattern, nBit) != 0)? GetBit(pattern, nBit) : (unsigned char)(NextRandom(pdwRandom) >> 23);
+			}
+			int nError;
+			for (nError = 0; nError < nsErrors[nPart]; nError++) {
+				int nPlace = nError + NextRandom(pdwRandom) % ((int)nsSignificant.size() - nError);
+				std::swap(nsSignificant[nError], nsSignificant[nPlace]);
+				bsBits[nsSignificant[nError]] ^= 1;
+			}
+
+			state = stateInitial;
+			for (nBit = 0; nBit < nDepth; nBit++) {
+				AdvanceState(m_compiledPatterns, state.words.data(), bsBits[nBit], stateNext.words.data());
+				std::swap(state, stateNext);
+			}
+
+			TPackedState packed = states.Pack(state);
+			TStateHash hash = CStateArena::Hash(packed);
+			int nState = states.Find(packed, hash);
+			if (nState < 0) {
+				nState = states.Add(packed, hash);
+				nsVisits.push_back(0);
+			}
+			nsVisits[nState]++;
+		}
+
+		// ACE: the rare states give the coverage and the visits variation
+		long double dRare = 0, dRareVisits = 0, dOnce = 0, dPairs = 0, dAbundant = 0;
+		for (idx = 0; idx < (int)nsVisits.size(); idx++) {
+			long double dVisits = nsVisits[idx];
+			if (nsVisits[idx] > g_nRareVisits) {
+				dAbundant++;
+				continue;
+			}
+			dRare++;
+			dRareVisits += dVisits;
+			dPairs += dVisits * (dVisits - 1);
+			if (nsVisits[idx] == 1) {
+				dOnce++;
+			}
+		}
+		long double dPartPredicted = dAbundant;
+		if (dOnce < dRareVisits) {
+			long double dCoverage = 1 - dOnce / dRareVisits;
+			long double dVariation = std::max(dRare / dCoverage * dPairs / (dRareVisits * (dRareVisits - 1)) - 1, (long double)0);
+			dPartPredicted += dRare / dCoverage + dOnce / dCoverage * dVariation;
+		} else { // no repeats to measure the coverage by, as Chao1 does
+			dPartPredicted += dRare + dOnce * (dOnce - 1) / 2;
+		}
+		dPredicted += std::min(dPartPredicted, dsGenerators[nPart]);
+	}
+
+	return std::min(dPredicted, GetWindowStatesBound(nDepth));
+}
+
+void CFsmCreator::AdvanceState(const TCompiledPatterns &patterns, const TBitsWord *pqwState, unsigned char bBit,
+	TBitsWord *pqwNewState)
+{
+	int idx;
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		int nOffset = patterns[idx].nOffset;
+		ProcessBitForPattern(pqwState + nOffset, patterns[idx], bBit, pqwNewState + nOffset);
+	}
+}
+
+int CFsmCreator::GetStateDepth(const TCompiledPatterns &patterns, const TBitsWord *pqwState) {
+	// the levels are nested, so the last one has all the prefixes found
+	int nDepth = 0;
+	int idx;
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		const SCompiledPattern &pattern = patterns[idx];
+		const TBitsWord *pqwLevel = pqwState + pattern.nOffset + pattern.nMaxErrors * pattern.nWordsCount;
+		int nLength;
+		for (nLength = pattern.nLength - 1; nLength > nDepth; nLength--) {
+			if ((pqwLevel[nLength / g_nBitsInWord] >> (nLength % g_nBitsInWord)) & 0x01) {
+				nDepth = nLength;
+				break;
+			}
+		}
+	}
+
+	return nDepth;
+}
+
+unsigned int CFsmCreator::NextRandom(unsigned int *pdwRandom) {
+	// LCG, its low bits are poor
+	*pdwRandom = *pdwRandom * 1664525u + 1013904223u;
+	return *pdwRandom >> 8;
+}
+
+void CFsmCreator::RemapStates(const std::vector<int> &nsStatesMap, int nNewStatesCount) {
+	// nsStatesMap: old state -> new state (negative for removed states); states mapped to the same
+	// new state must be equivalent, so any of them gives the new row
+	std::vector<STableRow> tableNew(nNewStatesCount);
+	int nState, nStatesCount = (int)m_table.size();
+	for (nState = 0; nState < nStatesCount; nState++) {
+		int nNewStateIdx = nsStatesMap[nState];
+		if (nNewStateIdx >= 0) {
+			STableRow row = m_table[nState];
+			row.cell0.nNextState = nsStatesMap[row.cell0.nNextState];
+			row.cell1.nNextState = nsStatesMap[row.cell1.nNextState];
+			tableNew[nNewStateIdx] = row;
+		}
+	}
+
+	m_table = tableNew;
+}
+
 CFsmCreator::STableCell CFsmCreator::TransitState(const SStateDescription &state, unsigned char bBit) {
 	// create next state
-	int idx, nCount = state.parts.count();
 	TOutputList outputList;
 	SStateDescription newState;
+	ProcessBit(state, m_compiledPatterns, bBit, &newState, &outputList);
+
+	STableCell cell;
+	cell.nNextState = AddState(newState);
+	cell.output = outputList;
+	return cell;
+}
+
+void CFsmCreator::ProcessBit(const SStateDescription &state, const TCompiledPatterns &patterns, unsigned char bBit,
+	SStateDescription *pNewState, TOutputList *pOutputList)
+{
+	// the out-params are filled in place, so the callers' loops reuse their buffers
+	int idx, nCount = (int)patterns.size();
+	pOutputList->clear();
+	pNewState->words.resize(state.words.size());
 	for (idx = 0; idx < nCount; idx++) {
-		SBitResultForPattern bitResult = ProcessBitForPattern(state.parts[idx], m_patterns[idx], bBit);
-		newState.parts << bitResult.newStatePart;
+		int nOffset = patterns[idx].nOffset;
+		SBitResultForPattern bitResult = ProcessBitForPattern(state.words.data() + nOffset, patterns[idx], bBit,
+			pNewState->words.data() + nOffset);
 		if (bitResult.fFound) {
 			// pattern found
 			SOutput output;
 			output.nPatternIdx = idx;
 			output.nErrors = bitResult.nErrors;
-			output.nStepBack = m_patterns[idx].nLength;
-			outputList << output;
+			output.nStepBack = patterns[idx].nLength;
+			pOutputList->push_back(output);
 		}
 	}
+}
 
-	STableCell cell;
-	cell.nNextState = AddState(newState);
-	cell.output = outputList;
-	return cell;
+void CFsmCreator::ExpandStates(SExpandTask &task) {
+	const CFsmCreator &creator = *task.pCreator;
+	SStateDescription state, newState;
+	int nState;
+	for (nState = task.nBegin; nState < task.nEnd; nState++) {
+		creator.m_states.Unpack(nState, &state);
+		unsigned char bBit;
+		for (bBit = 0; bBit <= 1; bBit++) {
+			SExpansion &expansion = task.pExpansions[2 * (nState - task.nBatchBegin) + bBit];
+			ProcessBit(state, creator.m_compiledPatterns, bBit, &newState, &expansion.output);
+			creator.m_states.Pack(newState, &expansion.state);
+			expansion.hash = CStateArena::Hash(expansion.state);
+			expansion.nNextState = creator.m_states.Find(expansion.state, expansion.hash);
+		}
+	}
 }
 
-int CFsmCreator::AddState(const CFsmCreator::SStateDescription &state) {
-	TStateHash hash = Hash(state);
-	TIndexList list = m_idxStates[hash];
-	// look for the same state in the list of the states with the same hash
-	int idx, nStatesCount = list.count();
-	for (idx = 0; idx < nStatesCount; idx++) {
-		int nStateIdx = list[idx];
-		if (AreEqual(state, m_states[nStateIdx])) { // found the same state
-			return nStateIdx;
-		} else if (idx == nStatesCount - 1) { // no equal state in the list - hash collision
-			m_dwCollisions++;
+void CFsmCreator::DeduplicateStates(SDedupTask &task) {
+	// the first occurrences of the new states of the shard, hash -> expansion indexes
+	std::unordered_map<TStateHash, TIndexList> idxFirsts;
+	int idx;
+	for (idx = 0; idx < task.nExpansionsCount; idx++) {
+		const SExpansion &expansion = task.pExpansions[idx];
+		if (expansion.nNextState >= 0 || (int)(expansion.hash % task.nShards) != task.nShard) {
+			continue;
+		}
+
+		TIndexList &list = idxFirsts[expansion.hash];
+		int nFirst = -1;
+		int idxList;
+		for (idxList = 0; idxList < (int)list.size() && nFirst < 0; idxList++) {
+			if (expansion.state == task.pExpansions[list[idxList]].state) {
+				nFirst = list[idxList];
+			}
 		}
+
+		if (nFirst < 0) { // a new state - the collision is counted as GenerateTables does
+			if (!list.empty() || task.pCreator->m_states.HasHash(expansion.hash)) {
+				task.dwCollisions++;
+			}
+			list.push_back(idx);
+			nFirst = idx;
+		}
+		task.pnsFirst[idx] = nFirst;
+	}
+}
+
+int CFsmCreator::AddState(const CFsmCreator::SStateDescription &state) {
+	TPackedState packed = m_states.Pack(state);
+	TStateHash hash = CStateArena::Hash(packed);
+	int nStateIdx = m_states.Find(packed, hash);
+	if (nStateIdx >= 0) { // found the same state
+		return nStateIdx;
 	}
 
 	// the state is not found - store it
-	m_states.append(state);
-	int nNewStateIdx = m_states.count() - 1;
-	m_idxStates[hash] << nNewStateIdx;
-	return nNewStateIdx;
+	if (m_states.HasHash(hash)) { // no equal state with the same hash - hash collision
+		m_dwCollisions++;
+	}
+	return m_states.Add(packed, hash);
 }
 
-CFsmCreator::SBitResultForPattern CFsmCreator::ProcessBitForPattern(const SStatePart &part, const SPattern &pattern, unsigned char bBit) {
+CFsmCreator::TCompiledPatterns CFsmCreator::CompilePatterns(const TPatterns &patterns) {
+	TCompiledPatterns compiledPatterns;
+	int nOffset = 0;
+	int idx;
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		const SPattern &pattern = patterns[idx];
+		SCompiledPattern compiled;
+		compiled.nLength = pattern.nLength;
+		compiled.nMaxErrors = pattern.nMaxErrors;
+		compiled.nWordsCount = pattern.nLength / g_nBitsInWord + 1;
+		compiled.nOffset = nOffset;
+		compiled.qwsMatches[0].assign(compiled.nWordsCount, 0);
+		compiled.qwsMatches[1].assign(compiled.nWordsCount, 0);
+		int nBit;
+		for (nBit = 0; nBit < pattern.nLength; nBit++) {
+			// the prefix of length nBit + 1 ends with the bit
+			int nLength = nBit + 1;
+			TBitsWord qwBit = (TBitsWord)1 << (nLength % g_nBitsInWord);
+			unsigned char bBit;
+			for (bBit = 0; bBit <= 1; bBit++) {
+				if (GetMaskBit(pattern, nBit) == 0 || GetBit(pattern, nBit) == bBit) {
+					compiled.qwsMatches[bBit][nLength / g_nBitsInWord] |= qwBit;
+				}
+			}
+		}
+
+		nOffset += (compiled.nMaxErrors + 1) * compiled.nWordsCount;
+		compiledPatterns.push_back(compiled);
+	}
+
+	return compiledPatterns;
+}
+
+CFsmCreator::SStateDescription CFsmCreator::CreateInitialState(const TCompiledPatterns &patterns) {
+	int nWordsCount = 0;
+	if (!patterns.empty()) {
+		const SCompiledPattern &patternLast = patterns.back();
+		nWordsCount = patternLast.nOffset + (patternLast.nMaxErrors + 1) * patternLast.nWordsCount;
+	}
+
+	SStateDescription state;
+	state.words.assign(nWordsCount, 0);
+	return state;
+}
+
+CFsmCreator::SBitResultForPattern CFsmCreator::ProcessBitForPattern(const TBitsWord *pqwPart, const SCompiledPattern &pattern,
+	unsigned char bBit, TBitsWord *pqwNewPart)
+{
+	// Wu-Manber: all the prefixes with the empty one are extended by the bit, the prefix of the level K goes to
+	// the same level if the bit matches, otherwise (or anyway - the levels are nested) to the level K + 1
+	const int nWordsCount = pattern.nWordsCount;
+	const TBitsWord *pqwMatches = pattern.qwsMatches[bBit].data();
+	int nWord;
+	for (nWord = 0; nWord < nWordsCount; nWord++) {
+		TBitsWord qwMatches = pqwMatches[nWord];
+		TBitsWord qwExtendedPrev = 0; // of the previous level
+		int nLevel;
+		for (nLevel = 0; nLevel <= pattern.nMaxErrors; nLevel++) {
+			const TBitsWord *pqwLevel = pqwPart + nLevel * nWordsCount;
+			TBitsWord qwExtended = pqwLevel[nWord] << 1;
+			if (nWord == 0) { // the empty prefix
+				qwExtended |= 0x02;
+			} else {
+				qwExtended |= pqwLevel[nWord - 1] >> (g_nBitsInWord - 1);
+			}
+			pqwNewPart[nLevel * nWordsCount + nWord] = (qwExtended & qwMatches) | qwExtendedPrev;
+			qwExtendedPrev = qwExtended;
+		}
+	}
+
+	// the whole pattern is found, if it is in the last level; it isn't kept in the state
 	SBitResultForPattern result;
 	result.fFound = false;
 	result.nErrors = -1;
+	const int nFoundWord = pattern.nLength / g_nBitsInWord;
+	const TBitsWord qwFoundBit = (TBitsWord)1 << (pattern.nLength % g_nBitsInWord);
+	int nLevel;
+	for (nLevel = pattern.nMaxErrors; nLevel >= 0; nLevel--) {
+		TBitsWord &qwWord = pqwNewPart[nLevel * nWordsCount + nFoundWord];
+		if ((qwWord & qwFoundBit) != 0) {
+			result.fFound = true;
+			result.nErrors = nLevel;
+			qwWord &= ~qwFoundBit;
+		}
+	}
+
+	return result;
+}
 
-	SStatePart nextStatePart;
-	// process prefix of length 1
-	int nErrors1 = 0;
-	if (GetMaskBit(pattern, 0) != 0) { // first bit is significnt
-		nErrors1 += bBit ^ GetBit(pattern, 0);
+bool CFsmCreator::AreEqual(const TOutputList &output1, const TOutputList &output2) {
+	if ((int)output1.size() != (int)output2.size()) {
+		return false;
 	}
-	if (nErrors1 <= pattern.nMaxErrors) {
-		SPrefix prefix1 = {1, nErrors1};
-		nextStatePart.prefixes << prefix1;
+	int idx, nCount = (int)output1.size();
+	for (idx = 0; idx < nCount; idx++) {
+		if (output1[idx].nPatternIdx != output2[idx].nPatternIdx || output1[idx].nErrors != output2[idx].nErrors ||
+			output1[idx].nStepBack != output2[idx].nStepBack)
+		{
+			return false;
+		}
 	}
 
-	// process all the other bits
-	int idx, nCount = part.prefixes.count();
+	return true;
+}
+
+CFsmCreator::TStateHash CFsmCreator::Hash(const TOutputList &output) {
+	const unsigned int g_dwHashMultiplier = 3571;
+
+	unsigned int dwHash = (int)output.size();
+	int idx, nCount = (int)output.size();
 	for (idx = 0; idx < nCount; idx++) {
-		const SPrefix &prefix = part.prefixes[idx];
-		int nNextLength = prefix.nLength + 1;
-		int nNextErrors = prefix.nErrors;
-		int nBit = nNextLength - 1;
-		if (GetMaskBit(pattern, nBit) != 0) {
-			nNextErrors += bBit ^ GetBit(pattern, nBit);
+		dwHash = dwHash * g_dwHashMultiplier + output[idx].nPatternIdx;
+		dwHash = dwHash * g_dwHashMultiplier + output[idx].nErrors;
+		dwHash = dwHash * g_dwHashMultiplier + output[idx].nStepBack;
+	}
+
+	return dwHash;
+}
+
+int CFsmCreator::CountDifferences(const std::vector<SCellIdx> &row1, const std::vector<SCellIdx> &row2, int nMaxDifferences) {
+	// stops counting at nMaxDifferences
+	int nDifferences = 0;
+	int nColumn;
+	for (nColumn = 0; nColumn < (int)row1.size() && nDifferences < nMaxDifferences; nColumn++) {
+		if (row1[nColumn].nNextState != row2[nColumn].nNextState || row1[nColumn].idxOutput != row2[nColumn].idxOutput) {
+			nDifferences++;
 		}
+	}
+
+	return nDifferences;
+}
 
-		if (nNextErrors <= pattern.nMaxErrors) { // errors count is acceptable
-			if (nNextLength == pattern.nLength) { // the last bit
-				result.fFound = true;
-				result.nErrors = nNextErrors;
+// the first free index not less than nIdx: nsNext is a union-find over the used indices, a used one refers to a greater one
+static int FindFree(std::vector<int> *pnsNext, int nIdx) {
+	std::vector<int> &nsNext = *pnsNext;
+	while ((int)nsNext.size() <= nIdx) {
+		nsNext.push_back((int)nsNext.size());
+	}
+	int nFree = nIdx;
+	while (nsNext[nFree] != nFree) {
+		nFree = nsNext[nFree];
+	}
+	while (nsNext[nIdx] != nFree) { // path compression
+		int nNext = nsNext[nIdx];
+		nsNext[nIdx] = nFree;
+		nIdx = nNext;
+	}
 
+	return nFree;
+}
+
+static void MarkUsed(std::vector<int> *pnsNext, int nIdx) {
+	std::vector<int> &nsNext = *pnsNext;
+	while ((int)nsNext.size() <= nIdx + 1) {
+		nsNext.push_back((int)nsNext.size());
+	}
+	nsNext[nIdx] = nIdx + 1;
+}
+
+void CFsmCreator::PlaceCombRows(const std::vector<std::vector<int> > &exceptions, std::vector<int> *pnsBases) {
+	// first fit, the rows with more exceptions are placed first
+	int nStatesCount = (int)exceptions.size();
+	std::vector<std::pair<int, int> > order; // (-exceptions count, state)
+	int nState;
+	for (nState = 0; nState < nStatesCount; nState++) {
+		order.push_back(std::make_pair(-(int)exceptions[nState].size(), nState));
+	}
+	std::sort(order.begin(), order.end());
+
+	// The used bases and cells are skipped at once: the first column of a row is probed at the free cells only,
+	// and a row colliding in a column jumps to the base moving the column past the used cells. The nearly full
+	// blocks of cells collect the failed probes of every row, so a block failed too often isn't probed any more.
+	std::vector<int> nsBases(nStatesCount);
+	std::vector<int> nsNextBase; // every state has its own base
+	std::vector<int> nsNextCell;
+	std::vector<int> nsNextProbe; // the used cells and the cells of the closed blocks
+	std::vector<int> nsBlockFailures;
+	int nProbedSize = 0; // exceptions count of the rows the blocks are closed for
+	int idx;
+	for (idx = 0; idx < (int)order.size(); idx++) {
+		nState = order[idx].second;
+		const std::vector<int> &columns = exceptions[nState];
+		if ((int)columns.size() * 2 <= nProbedSize) { // the rows twice smaller are probed in the closed blocks again
+			nsNextProbe = nsNextCell;
+			nsBlockFailures.clear();
+		}
+		if (nsBlockFailures.empty()) {
+			nProbedSize = (int)columns.size();
+		}
+
+		int nBase = FindFree(&nsNextBase, 0);
+		int nCell = columns.empty()? 0 : columns[0];
+		while (!columns.empty()) {
+			nCell = FindFree(&nsNextProbe, nCell);
+			nBase = nCell - columns[0];
+			int nNextCell = nCell; // probed next if the row doesn't fit
+			int nFreeBase = FindFree(&nsNextBase, nBase);
+			if (nFreeBase != nBase) {
+				nNextCell = nFreeBase + columns[0];
 			} else {
-				SPrefix nextPrefix = {nNextLength, nNextErrors};
-				nextStatePart.prefixes << nextPrefix;
+				int nColumn;
+				for (nColumn = 1; nColumn < (int)columns.size(); nColumn++) {
+					int nFreeCell = FindFree(&nsNextCell, nBase + columns[nColumn]);
+					if (nFreeCell != nBase + columns[nColumn]) {
+						nNextCell = nFreeCell - columns[nColumn] + columns[0];
+						break;
+					}
+				}
+				if (nColumn == (int)columns.size()) { // fits
+					break;
+				}
 			}
+
+			int nBlock = nCell / g_nCombProbeBlock;
+			if ((int)nsBlockFailures.size() <= nBlock) {
+				nsBlockFailures.resize(nBlock + 1);
+			}
+			if (++nsBlockFailures[nBlock] == g_nCombMaxBlockFailures) { // close the block
+				int nBlockCell;
+				for (nBlockCell = nBlock * g_nCombProbeBlock; nBlockCell < (nBlock + 1) * g_nCombProbeBlock; nBlockCell++) {
+					MarkUsed(&nsNextProbe, nBlockCell);
+				}
+			}
+			nCell = nNextCell;
+		}
+
+		// occupy the base and the cells
+		nsBases[nState] = nBase;
+		MarkUsed(&nsNextBase, nBase);
+		int nColumn;
+		for (nColumn = 0; nColumn < (int)columns.size(); nColumn++) {
+			MarkUsed(&nsNextCell, nBase + columns[nColumn]);
+			MarkUsed(&nsNextProbe, nBase + columns[nColumn]);
 		}
 	}
 
-	result.newStatePart = nextStatePart;
-	return result;
+	*pnsBases = nsBases;
 }
 
-bool CFsmCreator::AreEqual(const SStateDescription &state1, const SStateDescription &state2) {
-	int nPart, nCount = state1.parts.count();
-	if (state2.parts.count() != nCount) {
-		puts("WTF? O_o");
-		return false;
+int CFsmCreator::FindSymbolClasses(const TByteTable &table, std::vector<int> *pnsClasses) {
+	const unsigned int g_dwHashMultiplier = 3571;
+
+	int nColumnsCount = table.rows.empty()? 0 : (int)table.rows[0].cells.size();
+	std::vector<int> nsClasses(nColumnsCount);
+	std::unordered_map<TStateHash, std::vector<int> > columnIndex; // column hash -> first columns of the classes
+	int nClassesCount = 0;
+	int nColumn;
+	for (nColumn = 0; nColumn < nColumnsCount; nColumn++) {
+		// hash the whole column
+		TStateHash hash = 0;
+		int nRow;
+		for (nRow = 0; nRow < (int)table.rows.size(); nRow++) {
+			const STableCell &cell = table.rows[nRow].cells[nColumn];
+			hash = hash * g_dwHashMultiplier + cell.nNextState;
+			hash = hash * g_dwHashMultiplier + Hash(cell.output);
+		}
+
+		// look for the equal column
+		std::vector<int> &columns = columnIndex[hash];
+		int idx;
+		for (idx = 0; idx < (int)columns.size(); idx++) {
+			if (AreEqualColumns(table, columns[idx], nColumn)) {
+				break;
+			}
+		}
+		if (idx < (int)columns.size()) { // found
+			nsClasses[nColumn] = nsClasses[columns[idx]];
+		} else { // new class
+			nsClasses[nColumn] = nClassesCount;
+			nClassesCount++;
+			columns.push_back(nColumn);
+		}
 	}
-	for (nPart = 0; nPart < nCount; nPart++) {
-		if (!AreEqual(state1.parts[nPart], state2.parts[nPart])) {
+
+	*pnsClasses = nsClasses;
+	return nClassesCount;
+}
+
+bool CFsmCreator::AreEqualColumns(const TByteTable &table, int nColumn1, int nColumn2) {
+	int nRow;
+	for (nRow = 0; nRow < (int)table.rows.size(); nRow++) {
+		const STableCell &cell1 = table.rows[nRow].cells[nColumn1];
+		const STableCell &cell2 = table.rows[nRow].cells[nColumn2];
+		if (cell1.nNextState != cell2.nNextState || !AreEqual(cell1.output, cell2.output)) {
 			return false;
 		}
 	}
+
 	return true;
 }
 
-bool CFsmCreator::AreEqual(const SStatePart &part1, const SStatePart &part2) {
-	if (part1.prefixes.count() != part2.prefixes.count()) {
-		return false;
+//////////////////////////////////////////////////////////////////////////
+// CFsmCreator::CStateArena
+CFsmCreator::CStateArena::CStateArena(): m_nWordsCount(0), m_nRecordSize(0) {
+	Clear();
+}
+
+void CFsmCreator::CStateArena::Init(const TCompiledPatterns &patterns) {
+	m_patterns = patterns;
+	m_nWordsCount = CreateInitialState(patterns).words.size();
+	m_nRecordSize = 0;
+	int idx;
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		// bits [1, nLength) are used between the steps
+		m_nRecordSize += (patterns[idx].nMaxErrors + 1) * ((patterns[idx].nLength - 1) / BITS_IN_BYTE + 1);
 	}
-	int nPrefix, nPrefixesCount = part1.prefixes.count();
-	for (nPrefix = 0; nPrefix < nPrefixesCount; nPrefix++) {
-		if (part1.prefixes[nPrefix].nLength != part2.prefixes[nPrefix].nLength ||
-			part1.prefixes[nPrefix].nErrors != part2.prefixes[nPrefix].nErrors)
-		{
-			return false;
+	Clear();
+}
+
+void CFsmCreator::CStateArena::Clear() {
+	// release the memory as well
+	const int g_nInitialSlotsCount = 1024;
+	m_arena = std::vector<unsigned char>();
+	m_hashes = std::vector<TStateHash>();
+	m_nsSlots = std::vector<int>(g_nInitialSlotsCount, -1);
+}
+
+int CFsmCreator::CStateArena::GetCount() const {
+	return (int)m_hashes.size();
+}
+
+uint64_t CFsmCreator::CStateArena::GetMemoryUsage() const {
+	return (uint64_t)m_arena.size() + (uint64_t)m_hashes.size() * sizeof(TStateHash) + (uint64_t)m_nsSlots.size() * sizeof(int);
+}
+
+CFsmCreator::TPackedState CFsmCreator::CStateArena::Pack(const SStateDescription &state) const {
+	TPackedState packed;
+	Pack(state, &packed);
+	return packed;
+}
+
+void CFsmCreator::CStateArena::Pack(const SStateDescription &state, TPackedState *pPacked) const {
+	pPacked->resize(m_nRecordSize);
+	unsigned char *pData = pPacked->data();
+	int idx;
+	for (idx = 0; idx < (int)m_patterns.size(); idx++) {
+		const SCompiledPattern &pattern = m_patterns[idx];
+		const int nBytesCount = (pattern.nLength - 1) / BITS_IN_BYTE + 1;
+		int nLevel;
+		for (nLevel = 0; nLevel <= pattern.nMaxErrors; nLevel++) {
+			const TBitsWord *pqwLevel = state.words.data() + pattern.nOffset + nLevel * pattern.nWordsCount;
+			int nByte;
+			for (nByte = 0; nByte < nBytesCount; nByte++) {
+				const int g_nBytesInWord = g_nBitsInWord / BITS_IN_BYTE;
+				*pData++ = (unsigned char)(pqwLevel[nByte / g_nBytesInWord] >> (nByte % g_nBytesInWord * BITS_IN_BYTE));
+			}
 		}
 	}
+}
 
-	return true;
+void CFsmCreator::CStateArena::Unpack(int nState, SStateDescription *pState) const {
+	const unsigned char *pData = m_arena.data() + (size_t)nState * m_nRecordSize;
+	pState->words.assign(m_nWordsCount, 0);
+	int idx;
+	for (idx = 0; idx < (int)m_patterns.size(); idx++) {
+		const SCompiledPattern &pattern = m_patterns[idx];
+		const int nBytesCount = (pattern.nLength - 1) / BITS_IN_BYTE + 1;
+		int nLevel;
+		for (nLevel = 0; nLevel <= pattern.nMaxErrors; nLevel++) {
+			TBitsWord *pqwLevel = pState->words.data() + pattern.nOffset + nLevel * pattern.nWordsCount;
+			int nByte;
+			for (nByte = 0; nByte < nBytesCount; nByte++) {
+				const int g_nBytesInWord = g_nBitsInWord / BITS_IN_BYTE;
+				pqwLevel[nByte / g_nBytesInWord] |= (TBitsWord)*pData++ << (nByte % g_nBytesInWord * BITS_IN_BYTE);
+			}
+		}
+	}
 }
 
-CFsmCreator::TStateHash CFsmCreator::Hash(const SStateDescription &state) {
-	const unsigned int g_dwHashMultiplier = 3571;
-	const unsigned int g_dwHashStatePartMultiplier = 1907;
+CFsmCreator::TStateHash CFsmCreator::CStateArena::Hash(const TPackedState &state) {
+	// 32-bit FNV-1a
+	const unsigned int g_dwOffsetBasis = 2166136261u;
+	const unsigned int g_dwPrime = 16777619u;
 
-	unsigned int dwHash = 0;
-	int nPart, nCount = state.parts.count();
-	for (nPart = 0; nPart < nCount; nPart++) {
-		dwHash += nPart;
-		dwHash *= g_dwHashStatePartMultiplier;
+	unsigned int dwHash = g_dwOffsetBasis;
+	int idx;
+	for (idx = 0; idx < (int)state.size(); idx++) {
+		dwHash ^= state[idx];
+		dwHash *= g_dwPrime;
+	}
 
-		const SStatePart &part = state.parts[nPart];
-		int nPrefix, nPrefixesCount = part.prefixes.count();
-		for (nPrefix = 0; nPrefix < nPrefixesCount; nPrefix++) {
-			const SPrefix &prefix = part.prefixes[nPrefix];
-			dwHash += prefix.nLength;
-			dwHash *= g_dwHashMultiplier;
-			dwHash += prefix.nErrors;
-			dwHash *= g_dwHashMultiplier;
+	return dwHash;
+}
+
+int CFsmCreator::CStateArena::Find(const TPackedState &state, TStateHash hash) const {
+	const unsigned int dwMask = (int)m_nsSlots.size() - 1;
+	unsigned int dwSlot;
+	for (dwSlot = hash & dwMask; m_nsSlots[dwSlot] >= 0; dwSlot = (dwSlot + 1) & dwMask) {
+		int nState = m_nsSlots[dwSlot];
+		if (m_hashes[nState] == hash && memcmp(m_arena.data() + (size_t)nState * m_nRecordSize, state.data(), m_nRecordSize) == 0) {
+			return nState;
 		}
 	}
 
-	return dwHash;
+	return -1;
+}
+
+bool CFsmCreator::CStateArena::HasHash(TStateHash hash) const {
+	const unsigned int dwMask = (int)m_nsSlots.size() - 1;
+	unsigned int dwSlot;
+	for (dwSlot = hash & dwMask; m_nsSlots[dwSlot] >= 0; dwSlot = (dwSlot + 1) & dwMask) {
+		if (m_hashes[m_nsSlots[dwSlot]] == hash) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int CFsmCreator::CStateArena::Add(const TPackedState &state, TStateHash hash) {
+	// keep the load factor under 1/2
+	if ((GetCount() + 1) * 2 > (int)m_nsSlots.size()) {
+		Rehash((int)m_nsSlots.size() * 2);
+	}
+
+	int nState = GetCount();
+	m_arena.insert(m_arena.end(), state.begin(), state.end());
+	m_hashes.push_back(hash);
+
+	const unsigned int dwMask = (int)m_nsSlots.size() - 1;
+	unsigned int dwSlot = hash & dwMask;
+	while (m_nsSlots[dwSlot] >= 0) {
+		dwSlot = (dwSlot + 1) & dwMask;
+	}
+	m_nsSlots[dwSlot] = nState;
+
+	return nState;
+}
+
+void CFsmCreator::CStateArena::Rehash(int nSlotsCount) {
+	// the records are reserved for the states fitting the new slots, so they don't grow by reallocations
+	m_arena.reserve((size_t)nSlotsCount / 2 * m_nRecordSize);
+	m_hashes.reserve(nSlotsCount / 2);
+
+	std::vector<int> nsSlots(nSlotsCount, -1);
+	const unsigned int dwMask = nSlotsCount - 1;
+	int nState;
+	for (nState = 0; nState < GetCount(); nState++) {
+		unsigned int dwSlot = m_hashes[nState] & dwMask;
+		while (nsSlots[dwSlot] >= 0) {
+			dwSlot = (dwSlot + 1) & dwMask;
+		}
+		nsSlots[dwSlot] = nState;
+	}
+
+	m_nsSlots.swap(nsSlots);
 }
 
 void CFsmCreator::DumpState(const SStateDescription &state) {
-	int nPart, nCount = state.parts.count();
+	int nPart, nCount = (int)m_compiledPatterns.size();
 	printf("{");
 	for (nPart = 0; nPart < nCount; nPart++) {
 		if (nPart > 0) { // separate state parts
 			printf(" | ");
 		}
-		DumpStatePart(state.parts[nPart]);
+		const SCompiledPattern &pattern = m_compiledPatterns[nPart];
+		DumpStatePart(state.words.data() + pattern.nOffset, pattern);
 	}
 	printf("}");
 }
 
-void CFsmCreator::DumpStatePart(const SStatePart &part) {
-	int idx, nCount = part.prefixes.count();
+void CFsmCreator::DumpStatePart(const TBitsWord *pqwPart, const SCompiledPattern &pattern) {
+	// the prefixes from the biggest to the least, with the lowest level they are found at
+	int nPrefixLength;
 	bool fFirst = true;
-	for (idx = nCount - 1; idx >= 0; idx--) {
+	for (nPrefixLength = pattern.nLength - 1; nPrefixLength > 0; nPrefixLength--) {
+		const int nWord = nPrefixLength / g_nBitsInWord;
+		const TBitsWord qwBit = (TBitsWord)1 << (nPrefixLength % g_nBitsInWord);
+		int nErrors = 0;
+		while (nErrors <= pattern.nMaxErrors && (pqwPart[nErrors * pattern.nWordsCount + nWord] & qwBit) == 0) {
+			nErrors++;
+		}
+		if (nErrors > pattern.nMaxErrors) { // no such prefix
+			continue;
+		}
+
 		if (fFirst) {
 			fFirst = false;
 		} else {
 			printf(", ");
 		}
-		int nErrors = part.prefixes[idx].nErrors;
-		int nPrefixLength = part.prefixes[idx].nLength;
 		if (nErrors == 0 ) {
 			printf("%i", nPrefixLength);
 		} else {
@@ -380,12 +1594,12 @@ void CFsmCreator::DumpStatePart(const SStatePart &part) {
 }
 
 void CFsmCreator::DumpOutput(const TOutputList &output) {
-	if (output.isEmpty()) {
+	if (output.empty()) {
 		return;
 	}
 
 	printf(" * {");
-	int idx, nCount = output.count();
+	int idx, nCount = (int)output.size();
 	bool fFirst = true;
 	for (idx = 0; idx < nCount; idx++) {
 		// print comma if necessary
@@ -3,26 +3,41 @@
 #ifndef FSMCREATOR_H
 #define FSMCREATOR_H
 
-#include <QList>
-#include <QVector>
-#include <QHash>
-#include <QSet>
-#include <QString>
+#include <ctype.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "Common.h"
 
-QString PatternToString(const SPattern &pattern);
+std::string PatternToString(const SPattern &pattern);
+bool StringToPattern(const std::string &sPattern, int nMaxErrors, /* out */ SPattern *pPattern);
+
+/// \brief reads the patterns file: a pattern per line as StringToPattern takes it, optionally followed by
+/// the maximum errors count; '#' starts a comment. Example:
+/// 1110-0101100110 2 # sync word, 2 errors are acceptable
+/// On failure the error description is returned and the patterns are left untouched.
+bool ReadPatternsFile(const std::string &sFileName, /* out */ TPatterns *pPatterns, /* out */ std::string *psError);
 
 //////////////////////////////////////////////////////////////////////////
 /// \brief The CFsmCreator class - builds tables for Searching FSM
 class CFsmCreator {
+	friend class CLazySearchFsm; // creates the states on demand
+
 public:
 	struct SOutput {
 		int nPatternIdx;
 		int nErrors;
 		int nStepBack;
 	};
-	typedef QList<SOutput> TOutputList;
+	typedef std::vector<SOutput> TOutputList;
 
 	struct STableCell {
 		int nNextState;
@@ -34,11 +49,15 @@ public:
 
 	// byte FSM structures
 	struct SByteTableRow {
-		QVector<STableCell> cells;
+		std::vector<STableCell> cells;
 	};
 
 	struct TByteTable {
-		QVector<SByteTableRow> rows;
+		std::vector<SByteTableRow> rows;
+
+		// input symbol equivalence classes: the symbols having identical columns in all the rows
+		std::vector<int> symbolClasses; // class of each symbol, classes are numbered by their first symbols
+		int nClassesCount;
 	};
 
 	enum EBitOrder {
@@ -46,6 +65,85 @@ public:
 		bitOrder_LsbFirst
 	};
 
+	// hard limits of the tables generation, 0 - no limit
+	struct SBuildBudget {
+		int nMaxStates;
+		uint64_t qwMaxBytes; // of the states and the bit table being built
+		int nMaxMilliseconds;
+	};
+
+	enum EBuildStatus {
+		buildStatus_Ok,
+		buildStatus_StatesExceeded,
+		buildStatus_BytesExceeded,
+		buildStatus_TimeExceeded
+	};
+
+	// states count and tables sizes predicted before the generation, see EstimateSize; the prediction is a hint,
+	// the deep levels of the large error budgets are underestimated (up to 3.6 times seen), so the generation
+	// is bound by SBuildBudget::nMaxStates or the prediction is multiplied by g_nEstimateSafetyFactor
+	struct SSizeEstimate {
+		uint64_t qwMaxStatesCount; // analytic upper bound
+		uint64_t qwStatesCount; // predicted, qwMaxStatesCount at most
+		bool fExact; // the states are counted by the generation itself
+		uint64_t qwBitTableBytes; // main tables with the default index types
+		uint64_t qwNibbleTableBytes;
+		uint64_t qwOctetTableBytes;
+		uint64_t qwOctetCombTableBytes; // comb-compressed, see GetCombTableBytes
+	};
+
+	static const int g_nEstimateSampleStates = 1 << 12; // states generated exactly before the sampling
+	static const int g_nEstimateSafetyFactor = 4; // of the predicted states count, if the generation isn't bound
+	static const int g_nDefaultCellSize = 2 * sizeof(unsigned int); // state and output indices
+
+	// comb-compressed table creation limits
+	static const int g_nCombMaxDefaultRows = 64; // limits the default row search time
+	static const int g_nCombExceptionsShare = 8; // a row differing in more than 1/8 of the cells becomes a default row
+	static const int g_nCombProbeBlock = 256; // cells, the rows aren't probed in a block failed too often
+	static const int g_nCombMaxBlockFailures = 1024;
+
+	// sizes (in bytes) of the narrowest types able to hold the fields of SearchFSM tables
+	struct SIndexSizes {
+		int nStateIdxSize;
+		int nOutputIdxSize; // with respect to sm_outputNull
+		int nPatternIdxSize;
+		int nStepBackSize;
+		int nErrorsCountSize;
+	};
+
+	// SearchFSM with symbol classes (CSearchFsmClassed) - the same for its tables
+	template <class TSearchFsm>
+	struct SFsmClassedWrap {
+		TSearchFsm fsm;
+
+		const CSharedTable<typename TSearchFsm::TClassIdx> m_symbolClasses;
+		const CSharedTable<typename TSearchFsm::TTableCell> m_cells;
+		const CSharedTable<typename TSearchFsm::TOutput> m_outputTable;
+	};
+
+	// SearchFSM with comb-compressed table (CSearchFsmComb) - the same for its tables
+	template <class TSearchFsm>
+	struct SFsmCombWrap {
+		TSearchFsm fsm;
+
+		const CSharedTable<typename TSearchFsm::SCombCell> m_combCells;
+		const CSharedTable<typename TSearchFsm::SDefaultCell> m_defaultCells;
+		const CSharedTable<typename TSearchFsm::SStateInfo> m_states;
+		const CSharedTable<typename TSearchFsm::TStateIdx> m_baseStates;
+		const CSharedTable<typename TSearchFsm::TOutput> m_outputTable;
+	};
+
+	// SearchFSM with split hot and cold tables (CSearchFsmSplit) - the same for its tables
+	template <class TSearchFsm>
+	struct SFsmSplitWrap {
+		TSearchFsm fsm;
+
+		const CSharedTable<typename TSearchFsm::TStateIdx> m_nextStates;
+		const CSharedTable<unsigned int> m_outputRefsStarts;
+		const CSharedTable<typename TSearchFsm::SOutputRef> m_outputRefs;
+		const CSharedTable<typename TSearchFsm::TOutput> m_outputTable;
+	};
+
 	// SearchFSM structures - to create FSM at once and store the tables inside the structure
 	template <class TSearchFsm>
 	struct SFsmWrap {
@@ -53,19 +151,32 @@ public:
 		TSearchFsm fsm;
 
 		// members for storing and releasing the tables
-		const QVector<typename TSearchFsm::STableRow> m_rows;
-		const QVector<typename TSearchFsm::TOutput> m_outputTable;
+		const CSharedTable<typename TSearchFsm::STableRow> m_rows;
+		const CSharedTable<typename TSearchFsm::TOutput> m_outputTable;
 	};
 
 public:
 	CFsmCreator(const TPatterns &patterns);
 
 public:
-	bool GenerateTables(bool fVerbose = false);
+	bool GenerateTables(bool fVerbose = false); // false if the budget is exceeded, see GetBuildStatus
+	bool GenerateTablesParallel(int nThreads = 0); // the same tables as of GenerateTables, 0 - ideal threads count
+	// generate the tables if the main table of nBitsAtOnce bits at once fits the limit, false as GenerateTables
+	bool GenerateTablesFitting(uint64_t qwMaxTableBytes, int nBitsAtOnce, /* out, optional */ SSizeEstimate *pEstimate = NULL);
+	void SetBuildBudget(const SBuildBudget &budget);
+	EBuildStatus GetBuildStatus() const; // of the last generation
+	static const char* GetBuildStatusText(EBuildStatus status);
+	SSizeEstimate EstimateSize(int nSampleStates = g_nEstimateSampleStates) const;
+	static uint64_t GetTableBytes(uint64_t qwStatesCount, int nBitsAtOnce, int nCellSize = g_nDefaultCellSize);
+	static uint64_t GetCombTableBytes(uint64_t qwStatesCount, int nBitsAtOnce, int nCellSize = g_nDefaultCellSize); // predicted
 	bool OptimizeTables(bool fVerbose = false);
-	QSet<int> FindUnessentialStates(bool fVerbose = false) const;
+	bool MinimizeTables(bool fVerbose = false);
+	std::set<int> FindUnessentialStates(bool fVerbose = false) const;
+	int FindEquivalentStates(/* out */ std::vector<int> *pnsStateClasses) const;
 	TByteTable CreateByteTable(int nBitsAtOnce, EBitOrder bitOrder = bitOrder_MsbFirst) const;
+	void CreateByteRow(int nRow, int nBitsAtOnce, EBitOrder bitOrder, /* out */ SByteTableRow *pRow) const; // of the bit table
 	int GetStatesCount() const;
+	int GetUnoptimizedStatesCount() const;
 	unsigned int GetCollisionsCount() const;
 	const STableRow &GetTableRow(int nRow) const;
 
@@ -76,77 +187,216 @@ public:
 	template <class TSearchFsm>
 	SFsmWrap<TSearchFsm> CreateByteFsmWrap(CFsmCreator::EBitOrder bitOrder = bitOrder_MsbFirst) const;
 
+	template <class TSearchFsm>
+	SFsmClassedWrap<TSearchFsm> CreateClassedFsmWrap(CFsmCreator::EBitOrder bitOrder = bitOrder_MsbFirst) const;
+
+	template <class TSearchFsm>
+	SFsmCombWrap<TSearchFsm> CreateCombFsmWrap(CFsmCreator::EBitOrder bitOrder = bitOrder_MsbFirst) const;
+
+	template <class TSearchFsm>
+	SFsmSplitWrap<TSearchFsm> CreateSplitFsmWrap(CFsmCreator::EBitOrder bitOrder = bitOrder_MsbFirst) const;
+
+	// index types handling
+	template <class TSearchFsm>
+	static SIndexSizes GetIndexSizes(const SFsmWrap<TSearchFsm> &wrap);
+
+	template <class TSearchFsm>
+	static SIndexSizes GetTableIndexSizes(const typename TSearchFsm::STable &table);
+
+	template <class TSearchFsmTo, class TSearchFsmFrom>
+	static SFsmWrap<TSearchFsmTo> ConvertFsmWrap(const SFsmWrap<TSearchFsmFrom> &wrap);
+
+	static int GetMinimalDataSize(unsigned int dwMaxValue);
+
+	// C++ header with constexpr tables of the narrowest types, the tables of the wrap are converted
+	template <class TSearchFsm>
+	static std::string CreateSourceCode(const SFsmWrap<TSearchFsm> &wrap, const std::string &sName,
+		const std::string &sComment);
+
+private: // source code creation
+	static const char* GetTypeName(int nSize);
+	static unsigned int GetOutputNull(int nSize);
+
 private: // output table handling
+	typedef unsigned int TOutputHash;
+	typedef std::unordered_map<TOutputHash, std::vector<int> > TOutputIndex; // hash -> output indexes list
+
 	template <class TSearchFsm>
 	static typename TSearchFsm::TOutputIdx StoreOutputList(const TOutputList &outputList,
-		/* in-out */ QVector<typename TSearchFsm::TOutput> *pOutputTable);
+		/* in-out */ std::vector<typename TSearchFsm::TOutput> *pOutputTable, /* in-out */ TOutputIndex *pOutputIndex);
 
 	template <class TSearchFsm>
 	static typename TSearchFsm::TOutputIdx StoreOutput(const typename TSearchFsm::TOutput &output,
-		/* in-out */ QVector<typename TSearchFsm::TOutput> *pOutputTable);
+		/* in-out */ std::vector<typename TSearchFsm::TOutput> *pOutputTable, /* in-out */ TOutputIndex *pOutputIndex);
 
 	template <class TSearchFsm>
 	static bool AreEqual(const typename TSearchFsm::TOutput &output1, const typename TSearchFsm::TOutput &output2);
 
+	template <class TSearchFsm>
+	static TOutputHash Hash(const typename TSearchFsm::TOutput &output);
+
 private:
-	struct SPrefix {
-		int nLength;
-		int nErrors;
-	};
+	typedef uint64_t TBitsWord;
+	static const int g_nBitsInWord = 64;
 
-	struct SStatePart {
-		QVector<SPrefix> prefixes; // found prefixes ordered by length from the least to the biggest
+	// the pattern unpacked for the bit-parallel processing, bit L of the bitvectors stands for the prefix of length L
+	struct SCompiledPattern {
+		int nLength;
+		int nMaxErrors;
+		int nWordsCount; // words of a bitvector, bits [0, nLength] are used
+		int nOffset; // words before the pattern's part in the state
+		std::vector<TBitsWord> qwsMatches[2]; // bit L is set if the pattern's bit L - 1 is 0/1 or insignificant
 	};
+	typedef std::vector<SCompiledPattern> TCompiledPatterns;
 
 	struct SBitResultForPattern {
-		SStatePart newStatePart;
 		bool fFound;
 		int nErrors; // valid only if fFound = true
 	};
 
+	// the part of the pattern is nMaxErrors + 1 error levels of nWordsCount words each: bit L of the level K is set
+	// if the prefix of length L is found with K errors at most, so each level includes the previous one
 	struct SStateDescription {
-		QVector<SStatePart> parts;
+		std::vector<TBitsWord> words; // parts of all the patterns
 	};
 
 	typedef unsigned int TStateHash;
-	typedef QList<int> TIndexList;
+	typedef std::vector<int> TIndexList;
+	typedef std::vector<unsigned char> TPackedState; // SStateDescription packed by CStateArena
+
+	//////////////////////////////////////////////////////////////////////////
+	/// \brief CFsmCreator::CStateArena - the builder states packed into a single blob.
+	/// A state is a record of the error levels' bitvectors of all the parts, each level is trimmed to the
+	/// bytes of the prefixes' lengths [0, nLength), so all the records are of the same size. The records are
+	/// equal iff the states are equal, so they are hashed and compared as bytes. The index is an
+	/// open-addressing hash table of the states' indexes; Find and HasHash don't change anything, so they
+	/// may be called concurrently.
+	class CStateArena {
+	public:
+		CStateArena();
+
+	public:
+		void Init(const TCompiledPatterns &patterns); // clears the arena and sets the records layout
+		void Clear();
+		int GetCount() const;
+		uint64_t GetMemoryUsage() const; // bytes
+
+		TPackedState Pack(const SStateDescription &state) const;
+		void Pack(const SStateDescription &state, /* out */ TPackedState *pPacked) const; // reuses the buffer
+		void Unpack(int nState, /* out */ SStateDescription *pState) const;
+		static TStateHash Hash(const TPackedState &state);
+
+		int Find(const TPackedState &state, TStateHash hash) const; // -1 if not found
+		bool HasHash(TStateHash hash) const; // a state with the same hash is stored
+		int Add(const TPackedState &state, TStateHash hash); // the state mustn't be stored yet
+
+	private:
+		void Rehash(int nSlotsCount);
+
+	private:
+		TCompiledPatterns m_patterns;
+		int m_nWordsCount; // of the unpacked state
+		int m_nRecordSize; // bytes
+		std::vector<unsigned char> m_arena; // GetCount() records
+		std::vector<TStateHash> m_hashes;
+		std::vector<int> m_nsSlots; // power of 2 elements, state index or -1
+	};
 
 private:
+	typedef std::chrono::steady_clock TClock;
+	EBuildStatus CheckBuildBudget(TClock::time_point timeStart) const;
+	bool AbortGeneration(EBuildStatus status); // releases everything, always false
+	static long double GetWindowStatesBound(int nLength);
+	long double EstimateLevelSize(int nDepth, int nSamples, /* in-out */ unsigned int *pdwRandom) const;
+	static void AdvanceState(const TCompiledPatterns &patterns, const TBitsWord *pqwState, unsigned char bBit,
+		/* out */ TBitsWord *pqwNewState);
+	static int GetStateDepth(const TCompiledPatterns &patterns, const TBitsWord *pqwState); // longest prefix found
+	static unsigned int NextRandom(/* in-out */ unsigned int *pdwRandom); // 24 bits
+	void RemapStates(const std::vector<int> &nsStatesMap, int nNewStatesCount);
 	STableCell TransitState(const SStateDescription &state, unsigned char bBit);
+	static void ProcessBit(const SStateDescription &state, const TCompiledPatterns &patterns, unsigned char bBit,
+		/* out */ SStateDescription *pNewState, /* out */ TOutputList *pOutputList);
 	int AddState(const SStateDescription &state);
-	static SBitResultForPattern ProcessBitForPattern(const SStatePart &part, const SPattern &pattern, unsigned char bBit);
+	static TCompiledPatterns CompilePatterns(const TPatterns &patterns);
+	static SStateDescription CreateInitialState(const TCompiledPatterns &patterns); // all the parts are empty
+	static SBitResultForPattern ProcessBitForPattern(const TBitsWord *pqwPart, const SCompiledPattern &pattern,
+		unsigned char bBit, /* out */ TBitsWord *pqwNewPart);
 
 private:
-	static bool AreEqual(const SStateDescription &state1, const SStateDescription &state2);
-	static bool AreEqual(const SStatePart &part1, const SStatePart &part2);
-	static TStateHash Hash(const SStateDescription &state);
+	static bool AreEqual(const TOutputList &output1, const TOutputList &output2);
+
+private: // parallel tables generation
+	struct SExpansion { // transition of a frontier state by a bit
+		TPackedState state;
+		TOutputList output;
+		TStateHash hash;
+		int nNextState; // -1 if the state is not known before the batch
+	};
+
+	struct SExpandTask { // frontier states [nBegin, nEnd), the expansions of nState are 2 * (nState - nBatchBegin) + bit
+		const CFsmCreator *pCreator;
+		int nBatchBegin, nBegin, nEnd;
+		SExpansion *pExpansions;
+	};
+
+	struct SDedupTask { // the new states with hash % nShards == nShard
+		const CFsmCreator *pCreator;
+		const SExpansion *pExpansions;
+		int nExpansionsCount;
+		int nShard, nShards;
+		int *pnsFirst; // the first expansion with the same state
+		unsigned int dwCollisions;
+	};
+
+	static void ExpandStates(SExpandTask &task);
+	static void DeduplicateStates(SDedupTask &task);
+
+private: // comb-compressed table creation
+	struct SCellIdx { // the cell of the SearchFSM table with the stored output
+		int nNextState;
+		unsigned int idxOutput;
+	};
+
+	template <class TSearchFsm>
+	static void StoreByteRow(const SByteTableRow &row, /* out */ std::vector<SCellIdx> *pCells,
+		/* in-out */ std::vector<typename TSearchFsm::TOutput> *pOutputs, TOutputIndex *pOutputIndex);
+	static int CountDifferences(const std::vector<SCellIdx> &row1, const std::vector<SCellIdx> &row2, int nMaxDifferences);
+	static void PlaceCombRows(const std::vector<std::vector<int> > &exceptions, /* out */ std::vector<int> *pnsBases);
+
+	static int FindSymbolClasses(const TByteTable &table, /* out */ std::vector<int> *pnsClasses);
+	static bool AreEqualColumns(const TByteTable &table, int nColumn1, int nColumn2);
+	static TStateHash Hash(const TOutputList &output);
 	void DumpState(const SStateDescription &state);
-	void DumpStatePart(const SStatePart &part);
+	void DumpStatePart(const TBitsWord *pqwPart, const SCompiledPattern &pattern);
 	void DumpOutput(const TOutputList &output);
 
 private:
 	const TPatterns m_patterns;
-	QList<SStateDescription> m_states;
-	QHash<TStateHash, TIndexList> m_idxStates; // hash -> indexes list
+	const TCompiledPatterns m_compiledPatterns;
+	CStateArena m_states;
+	SBuildBudget m_budget;
+	EBuildStatus m_buildStatus;
 	unsigned int m_dwCollisions;
-	QVector<STableRow> m_table;
+	std::vector<STableRow> m_table;
+	int m_nUnoptimizedStatesCount; // states count before optimization
 };
 
 // inline template members
 template<class TSearchFsm>
 CFsmCreator::SFsmWrap<TSearchFsm> CFsmCreator::CreateFsmWrap() const {
-	QVector<typename TSearchFsm::STableRow> rows(GetStatesCount());
-	QVector<typename TSearchFsm::TOutput> outputs;
+	std::vector<typename TSearchFsm::STableRow> rows(GetStatesCount());
+	std::vector<typename TSearchFsm::TOutput> outputs;
+	TOutputIndex outputIndex;
 	int nRow;
 	for (nRow = 0; nRow < GetStatesCount(); nRow++) {
 		const STableRow &row = GetTableRow(nRow);
 		typename TSearchFsm::TTableCell cell0;
 		cell0.idxNextState = row.cell0.nNextState;
-		cell0.idxOutput = StoreOutputList<TSearchFsm>(row.cell0.output, &outputs);
+		cell0.idxOutput = StoreOutputList<TSearchFsm>(row.cell0.output, &outputs, &outputIndex);
 
 		typename TSearchFsm::TTableCell cell1;
 		cell1.idxNextState = row.cell1.nNextState;
-		cell1.idxOutput = StoreOutputList<TSearchFsm>(row.cell1.output, &outputs);
+		cell1.idxOutput = StoreOutputList<TSearchFsm>(row.cell1.output, &outputs, &outputIndex);
 
 		typename TSearchFsm::STableRow fsmRow;
 		fsmRow.cell0 = cell0;
@@ -155,61 +405,428 @@ CFsmCreator::SFsmWrap<TSearchFsm> CFsmCreator::CreateFsmWrap() const {
 	}
 
 	// release redundant memory
-	outputs.squeeze();
+	outputs.shrink_to_fit();
 
 	// create the structure describing bit SearchFSM table
-	typename TSearchFsm::STable table = {rows.constData(), outputs.constData(),
-		(unsigned int)rows.count(), (unsigned int)outputs.count()};
-	SFsmWrap<TSearchFsm> fsm = {table, rows, outputs};
+	typename TSearchFsm::STable table = {rows.data(), outputs.data(),
+		(unsigned int)rows.size(), (unsigned int)outputs.size()};
+	SFsmWrap<TSearchFsm> fsm = {table, ShareTable(&rows), ShareTable(&outputs)};
 	return fsm;
 }
 
 template<class TSearchFsm>
 CFsmCreator::SFsmWrap<TSearchFsm> CFsmCreator::CreateByteFsmWrap(CFsmCreator::EBitOrder bitOrder) const {
-	QVector<typename TSearchFsm::STableRow> rows(GetStatesCount());
-	QVector<typename TSearchFsm::TOutput> outputs;
+	std::vector<typename TSearchFsm::STableRow> rows(GetStatesCount());
+	std::vector<typename TSearchFsm::TOutput> outputs;
+	TOutputIndex outputIndex;
 
 	CFsmCreator::TByteTable fsmTable = CreateByteTable(TSearchFsm::g_nBitsAtOnce, bitOrder);
 	int nRow;
 	for (nRow = 0; nRow < GetStatesCount(); nRow++) {
 		const CFsmCreator::SByteTableRow &row = fsmTable.rows[nRow];
 		int nColumn;
-		for (nColumn = 0; nColumn < row.cells.count(); nColumn++) {
+		for (nColumn = 0; nColumn < (int)row.cells.size(); nColumn++) {
 			STableCell &cell = fsmTable.rows[nRow].cells[nColumn];
 			rows[nRow].cells[nColumn].idxNextState = cell.nNextState;
-			rows[nRow].cells[nColumn].idxOutput = StoreOutputList<TSearchFsm>(cell.output, &outputs);
+			rows[nRow].cells[nColumn].idxOutput = StoreOutputList<TSearchFsm>(cell.output, &outputs, &outputIndex);
 		}
 	}
 
 	// release redundant memory
-	outputs.squeeze();
+	outputs.shrink_to_fit();
 
 	// create the structure describing bit SearchFSM table
-	typename TSearchFsm::STable table = {rows.constData(), outputs.constData(),
-		(unsigned int)rows.count(), (unsigned int)outputs.count()};
-	SFsmWrap<TSearchFsm> fsm = {table, rows, outputs};
+	typename TSearchFsm::STable table = {rows.data(), outputs.data(),
+		(unsigned int)rows.size(), (unsigned int)outputs.size()};
+	SFsmWrap<TSearchFsm> fsm = {table, ShareTable(&rows), ShareTable(&outputs)};
+	return fsm;
+}
+
+template<class TSearchFsm>
+CFsmCreator::SFsmClassedWrap<TSearchFsm> CFsmCreator::CreateClassedFsmWrap(CFsmCreator::EBitOrder bitOrder) const {
+	CFsmCreator::TByteTable fsmTable = CreateByteTable(TSearchFsm::g_nBitsAtOnce, bitOrder);
+	int nClassesCount = fsmTable.nClassesCount;
+
+	// the first symbol of each class represents the class
+	std::vector<typename TSearchFsm::TClassIdx> symbolClasses((int)fsmTable.symbolClasses.size());
+	std::vector<int> nsClassSymbols(nClassesCount, -1);
+	int nSymbol;
+	for (nSymbol = (int)fsmTable.symbolClasses.size() - 1; nSymbol >= 0; nSymbol--) {
+		int nClass = fsmTable.symbolClasses[nSymbol];
+		symbolClasses[nSymbol] = (typename TSearchFsm::TClassIdx)nClass;
+		nsClassSymbols[nClass] = nSymbol;
+	}
+
+	std::vector<typename TSearchFsm::TTableCell> cells(GetStatesCount() * nClassesCount);
+	std::vector<typename TSearchFsm::TOutput> outputs;
+	TOutputIndex outputIndex;
+	int nRow;
+	for (nRow = 0; nRow < GetStatesCount(); nRow++) {
+		const CFsmCreator::SByteTableRow &row = fsmTable.rows[nRow];
+		int nClass;
+		for (nClass = 0; nClass < nClassesCount; nClass++) {
+			const STableCell &cell = row.cells[nsClassSymbols[nClass]];
+			typename TSearchFsm::TTableCell &cellFsm = cells[nRow * nClassesCount + nClass];
+			cellFsm.idxNextState = cell.nNextState;
+			cellFsm.idxOutput = StoreOutputList<TSearchFsm>(cell.output, &outputs, &outputIndex);
+		}
+	}
+
+	// release redundant memory
+	outputs.shrink_to_fit();
+
+	// create the structure describing SearchFSM table
+	typename TSearchFsm::STable table = {symbolClasses.data(), cells.data(), outputs.data(),
+		(typename TSearchFsm::TStateIdx)GetStatesCount(), (typename TSearchFsm::TOutputIdx)outputs.size(), nClassesCount};
+	SFsmClassedWrap<TSearchFsm> fsm = {table, ShareTable(&symbolClasses), ShareTable(&cells), ShareTable(&outputs)};
+	return fsm;
+}
+
+template<class TSearchFsm>
+CFsmCreator::SFsmCombWrap<TSearchFsm> CFsmCreator::CreateCombFsmWrap(CFsmCreator::EBitOrder bitOrder) const {
+	typedef typename TSearchFsm::TStateIdx TStateIdx;
+	typedef typename TSearchFsm::TOutputIdx TOutputIdx;
+	const int g_nColumnsCount = TSearchFsm::g_nColumnsCount;
+	const int g_nMaxExceptions = g_nColumnsCount / g_nCombExceptionsShare;
+
+	int nStatesCount = GetStatesCount();
+	std::vector<typename TSearchFsm::TOutput> outputs;
+	TOutputIndex outputIndex;
+
+	// the byte rows are made one by one from the bit table, only the exceptions are kept, so the dense table
+	// never exists; the default row of each state is chosen greedily: the closest one of the rows chosen before,
+	// or the row itself, if there is no close enough row
+	std::vector<std::vector<SCellIdx> > defaultRows;
+	std::vector<int> nsDefaultRows(nStatesCount);
+	std::vector<std::vector<int> > exceptions(nStatesCount); // columns differing from the default row
+	std::vector<std::vector<SCellIdx> > exceptionCells(nStatesCount);
+	SByteTableRow row;
+	std::vector<SCellIdx> cells;
+	int nState;
+	for (nState = 0; nState < nStatesCount; nState++) {
+		CreateByteRow(nState, TSearchFsm::g_nBitsAtOnce, bitOrder, &row);
+		StoreByteRow<TSearchFsm>(row, &cells, &outputs, &outputIndex);
+		int nBestRow = -1, nBestDifferences = g_nColumnsCount + 1;
+		int nRow;
+		for (nRow = 0; nRow < (int)defaultRows.size() && nBestDifferences > 0; nRow++) {
+			int nDifferences = CountDifferences(defaultRows[nRow], cells, nBestDifferences);
+			if (nDifferences < nBestDifferences) {
+				nBestRow = nRow;
+				nBestDifferences = nDifferences;
+			}
+		}
+		if (nBestRow < 0 || (nBestDifferences > g_nMaxExceptions && (int)defaultRows.size() < g_nCombMaxDefaultRows)) {
+			nBestRow = (int)defaultRows.size();
+			defaultRows.push_back(cells);
+		}
+
+		nsDefaultRows[nState] = nBestRow;
+		const std::vector<SCellIdx> &defaultRow = defaultRows[nBestRow];
+		int nColumn;
+		for (nColumn = 0; nColumn < g_nColumnsCount; nColumn++) {
+			if (cells[nColumn].nNextState != defaultRow[nColumn].nNextState || cells[nColumn].idxOutput != defaultRow[nColumn].idxOutput) {
+				exceptions[nState].push_back(nColumn);
+				exceptionCells[nState].push_back(cells[nColumn]);
+			}
+		}
+	}
+
+	// pack the exceptions into the comb
+	std::vector<int> nsBases;
+	PlaceCombRows(exceptions, &nsBases);
+	int nMaxBase = 0;
+	for (nState = 0; nState < nStatesCount; nState++) {
+		nMaxBase = std::max(nMaxBase, nsBases[nState]);
+	}
+
+	// the bases and the default row offsets are stored in TStateIdx, sm_checkNull is reserved
+	if ((uint64_t)nMaxBase >= (uint64_t)TSearchFsm::sm_checkNull ||
+		(uint64_t)(defaultRows.size() - 1) * g_nColumnsCount >= (uint64_t)TSearchFsm::sm_checkNull)
+	{
+		throw std::length_error("the comb offsets don't fit into the state index type");
+	}
+
+	std::vector<typename TSearchFsm::SStateInfo> states(nStatesCount);
+	std::vector<TStateIdx> baseStates(nMaxBase + 1, 0); // every state has its own base
+	for (nState = 0; nState < nStatesCount; nState++) {
+		states[nState].base = (TStateIdx)nsBases[nState];
+		states[nState].defaultRow = (TStateIdx)(nsDefaultRows[nState] * g_nColumnsCount);
+		baseStates[nsBases[nState]] = (TStateIdx)nState;
+	}
+
+	// fill the cells
+	typename TSearchFsm::SCombCell cellUnused = {TSearchFsm::sm_checkNull, 0, 0, TSearchFsm::sm_outputNull};
+	std::vector<typename TSearchFsm::SCombCell> combCells(nMaxBase + g_nColumnsCount, cellUnused);
+	for (nState = 0; nState < nStatesCount; nState++) {
+		const std::vector<int> &columns = exceptions[nState];
+		int idx;
+		for (idx = 0; idx < (int)columns.size(); idx++) {
+			const SCellIdx &cell = exceptionCells[nState][idx];
+			typename TSearchFsm::SCombCell &cellComb = combCells[nsBases[nState] + columns[idx]];
+			cellComb.check = states[nState].base;
+			cellComb.base = states[cell.nNextState].base;
+			cellComb.defaultRow = states[cell.nNextState].defaultRow;
+			cellComb.idxOutput = (TOutputIdx)cell.idxOutput;
+		}
+	}
+
+	std::vector<typename TSearchFsm::SDefaultCell> defaultCells((int)defaultRows.size() * g_nColumnsCount);
+	int nRow;
+	for (nRow = 0; nRow < (int)defaultRows.size(); nRow++) {
+		int nColumn;
+		for (nColumn = 0; nColumn < g_nColumnsCount; nColumn++) {
+			const SCellIdx &cell = defaultRows[nRow][nColumn];
+			typename TSearchFsm::SDefaultCell &cellDefault = defaultCells[nRow * g_nColumnsCount + nColumn];
+			cellDefault.base = states[cell.nNextState].base;
+			cellDefault.defaultRow = states[cell.nNextState].defaultRow;
+			cellDefault.idxOutput = (TOutputIdx)cell.idxOutput;
+		}
+	}
+
+	// release redundant memory
+	outputs.shrink_to_fit();
+
+	// create the structure describing SearchFSM table
+	typename TSearchFsm::STable table = {combCells.data(), defaultCells.data(), states.data(), baseStates.data(),
+		outputs.data(), (TStateIdx)nStatesCount, (TOutputIdx)outputs.size(),
+		(unsigned int)combCells.size(), (unsigned int)defaultRows.size()};
+	SFsmCombWrap<TSearchFsm> fsm = {table, ShareTable(&combCells), ShareTable(&defaultCells), ShareTable(&states),
+		ShareTable(&baseStates), ShareTable(&outputs)};
+	return fsm;
+}
+
+template<class TSearchFsm>
+CFsmCreator::SFsmSplitWrap<TSearchFsm> CFsmCreator::CreateSplitFsmWrap(CFsmCreator::EBitOrder bitOrder) const {
+	typedef typename TSearchFsm::TStateIdx TStateIdx;
+	const int g_nColumnsCount = TSearchFsm::g_nColumnsCount;
+
+	// the high bit of the next state marks the outputs, the states count must be less than it
+	if ((uint64_t)GetStatesCount() >= (uint64_t)TSearchFsm::sm_flagOutput) {
+		throw std::length_error("the states don't fit into the state index type with the output flag");
+	}
+
+	CFsmCreator::TByteTable fsmTable = CreateByteTable(TSearchFsm::g_nBitsAtOnce, bitOrder);
+
+	// the outputs go to the cold table, the hot one gets the flags only
+	std::vector<TStateIdx> nextStates((size_t)GetStatesCount() * g_nColumnsCount);
+	std::vector<unsigned int> outputRefsStarts(GetStatesCount() + 1);
+	std::vector<typename TSearchFsm::SOutputRef> outputRefs;
+	std::vector<typename TSearchFsm::TOutput> outputs;
+	TOutputIndex outputIndex;
+	int nRow;
+	for (nRow = 0; nRow < GetStatesCount(); nRow++) {
+		const CFsmCreator::SByteTableRow &row = fsmTable.rows[nRow];
+		outputRefsStarts[nRow] = (int)outputRefs.size();
+		int nColumn;
+		for (nColumn = 0; nColumn < g_nColumnsCount; nColumn++) {
+			const STableCell &cell = row.cells[nColumn];
+			TStateIdx next = (TStateIdx)cell.nNextState;
+			typename TSearchFsm::TOutputIdx idxOutput = StoreOutputList<TSearchFsm>(cell.output, &outputs, &outputIndex);
+			if (idxOutput != TSearchFsm::sm_outputNull) {
+				typename TSearchFsm::SOutputRef ref = {(unsigned char)nColumn, idxOutput};
+				outputRefs.push_back(ref);
+				next |= TSearchFsm::sm_flagOutput;
+			}
+			nextStates[(size_t)nRow * g_nColumnsCount + nColumn] = next;
+		}
+	}
+	outputRefsStarts[GetStatesCount()] = (int)outputRefs.size();
+
+	// release redundant memory
+	outputRefs.shrink_to_fit();
+	outputs.shrink_to_fit();
+
+	// create the structure describing SearchFSM table
+	typename TSearchFsm::STable table = {nextStates.data(), outputRefsStarts.data(), outputRefs.data(),
+		outputs.data(), (TStateIdx)GetStatesCount(), (typename TSearchFsm::TOutputIdx)outputs.size(),
+		(unsigned int)outputRefs.size()};
+	SFsmSplitWrap<TSearchFsm> fsm = {table, ShareTable(&nextStates), ShareTable(&outputRefsStarts),
+		ShareTable(&outputRefs), ShareTable(&outputs)};
+	return fsm;
+}
+
+template<class TSearchFsm>
+void CFsmCreator::StoreByteRow(const SByteTableRow &row, std::vector<SCellIdx> *pCells,
+	std::vector<typename TSearchFsm::TOutput> *pOutputs, TOutputIndex *pOutputIndex)
+{
+	pCells->resize((int)row.cells.size());
+	int nColumn;
+	for (nColumn = 0; nColumn < (int)row.cells.size(); nColumn++) {
+		SCellIdx &cell = (*pCells)[nColumn];
+		cell.nNextState = row.cells[nColumn].nNextState;
+		cell.idxOutput = StoreOutputList<TSearchFsm>(row.cells[nColumn].output, pOutputs, pOutputIndex);
+	}
+}
+
+// index types handling
+template<class TSearchFsm>
+CFsmCreator::SIndexSizes CFsmCreator::GetIndexSizes(const SFsmWrap<TSearchFsm> &wrap) {
+	return GetTableIndexSizes<TSearchFsm>(wrap.fsm.GetTable());
+}
+
+template<class TSearchFsm>
+CFsmCreator::SIndexSizes CFsmCreator::GetTableIndexSizes(const typename TSearchFsm::STable &table) {
+	unsigned int dwMaxPatternIdx = 0, dwMaxStepBack = 0, dwMaxErrors = 0;
+	unsigned int idx;
+	for (idx = 0; idx < (unsigned int)table.outputsCount; idx++) {
+		const typename TSearchFsm::TOutput &out = table.pOutputs[idx];
+		if (dwMaxPatternIdx < out.patternIdx) {
+			dwMaxPatternIdx = out.patternIdx;
+		}
+		if (dwMaxStepBack < out.stepBack) {
+			dwMaxStepBack = out.stepBack;
+		}
+		if (dwMaxErrors < out.errorsCount) {
+			dwMaxErrors = out.errorsCount;
+		}
+	}
+
+	SIndexSizes sizes;
+	// STable::statesCount has the state index type too
+	sizes.nStateIdxSize = GetMinimalDataSize(table.statesCount);
+	// mustn't forget about sm_outputNull (the maximal value of the type)
+	sizes.nOutputIdxSize = GetMinimalDataSize(table.outputsCount);
+	sizes.nPatternIdxSize = GetMinimalDataSize(dwMaxPatternIdx);
+	sizes.nStepBackSize = GetMinimalDataSize(dwMaxStepBack);
+	sizes.nErrorsCountSize = GetMinimalDataSize(dwMaxErrors);
+
+	return sizes;
+}
+
+template<class TSearchFsmTo, class TSearchFsmFrom>
+CFsmCreator::SFsmWrap<TSearchFsmTo> CFsmCreator::ConvertFsmWrap(const SFsmWrap<TSearchFsmFrom> &wrap) {
+	// the types of TSearchFsmTo must be wide enough, see GetIndexSizes
+	typedef typename TSearchFsmTo::TStateIdx TStateIdxTo;
+	typedef typename TSearchFsmTo::TOutputIdx TOutputIdxTo;
+	int nRow, nRowsCount = (int)wrap.m_rows.size();
+	std::vector<typename TSearchFsmTo::STableRow> rows(nRowsCount);
+	for (nRow = 0; nRow < nRowsCount; nRow++) {
+		const typename TSearchFsmFrom::STableRow &rowFrom = wrap.m_rows[nRow];
+		typename TSearchFsmTo::STableRow &rowTo = rows[nRow];
+		int nColumn;
+		for (nColumn = 0; nColumn < TSearchFsmTo::g_nColumnsCount; nColumn++) {
+			const typename TSearchFsmFrom::TTableCell &cellFrom = rowFrom.GetCell(nColumn);
+			typename TSearchFsmTo::TTableCell &cellTo = rowTo.GetCell(nColumn);
+			cellTo.idxNextState = (TStateIdxTo)cellFrom.idxNextState;
+			cellTo.idxOutput = (cellFrom.idxOutput == TSearchFsmFrom::sm_outputNull)?
+				TSearchFsmTo::sm_outputNull : (TOutputIdxTo)cellFrom.idxOutput;
+		}
+	}
+
+	int idx, nOutputsCount = (int)wrap.m_outputTable.size();
+	std::vector<typename TSearchFsmTo::TOutput> outputs(nOutputsCount);
+	for (idx = 0; idx < nOutputsCount; idx++) {
+		const typename TSearchFsmFrom::TOutput &outFrom = wrap.m_outputTable[idx];
+		typename TSearchFsmTo::TOutput &outTo = outputs[idx];
+		outTo.patternIdx = outFrom.patternIdx;
+		outTo.stepBack = outFrom.stepBack;
+		outTo.errorsCount = outFrom.errorsCount;
+		outTo.idxNextOutput = (outFrom.idxNextOutput == TSearchFsmFrom::sm_outputNull)?
+			TSearchFsmTo::sm_outputNull : (TOutputIdxTo)outFrom.idxNextOutput;
+	}
+
+	// create the structure describing SearchFSM table
+	typename TSearchFsmTo::STable table = {rows.data(), outputs.data(),
+		(TStateIdxTo)rows.size(), (TOutputIdxTo)outputs.size()};
+	SFsmWrap<TSearchFsmTo> fsm = {table, ShareTable(&rows), ShareTable(&outputs)};
 	return fsm;
 }
 
+// source code creation
+template<class TSearchFsm>
+std::string CFsmCreator::CreateSourceCode(const SFsmWrap<TSearchFsm> &wrap, const std::string &sName,
+	const std::string &sComment)
+{
+	const typename TSearchFsm::STable &table = wrap.fsm.GetTable();
+	SIndexSizes sizes = GetIndexSizes(wrap);
+	unsigned int dwOutputNull = GetOutputNull(sizes.nOutputIdxSize);
+	std::string sFsmType = "T" + sName + "SearchFsm";
+	std::string sRows = "g_" + sName + "Rows";
+	std::string sOutputs = "g_" + sName + "Outputs";
+	std::string sGuard;
+	size_t idxChar;
+	for (idxChar = 0; idxChar < sName.size(); idxChar++) {
+		sGuard += (char)toupper((unsigned char)sName[idxChar]);
+	}
+	sGuard += "TABLES_H";
+
+	std::ostringstream code;
+	code << "// SearchFSM tables generated by CFsmCreator::CreateSourceCode, don't edit\n";
+	std::istringstream comments(sComment);
+	std::string sCommentLine;
+	while (std::getline(comments, sCommentLine)) {
+		if (!sCommentLine.empty()) {
+			code << "// " << sCommentLine << "\n";
+		}
+	}
+	code << "\n#ifndef " << sGuard << "\n#define " << sGuard << "\n\n#include \"SearchFsm.h\"\n\n";
+
+	// the type: CSearchFsm for the bit SearchFSM (the rows of CSearchFsmByte<1> are the same)
+	std::string sTypes = std::string(GetTypeName(sizes.nStateIdxSize)) + ", " + GetTypeName(sizes.nOutputIdxSize) + ", " +
+		GetTypeName(sizes.nPatternIdxSize) + ", " + GetTypeName(sizes.nStepBackSize) + ", " + GetTypeName(sizes.nErrorsCountSize);
+	if (TSearchFsm::g_nBitsAtOnce == 1) {
+		code << "typedef CSearchFsm<" << sTypes << "> " << sFsmType << ";\n\n";
+	} else {
+		code << "typedef CSearchFsmByte<" << TSearchFsm::g_nBitsAtOnce << ", " << sTypes << "> " << sFsmType << ";\n\n";
+	}
+
+	// main table, the cells are brace-elided to fit both CSearchFsm and CSearchFsmByte rows
+	code << "static constexpr " << sFsmType << "::STableRow " << sRows << "[" << (unsigned int)table.statesCount << "] = {\n";
+	unsigned int dwState;
+	for (dwState = 0; dwState < (unsigned int)table.statesCount; dwState++) {
+		const typename TSearchFsm::STableRow &row = table.pTableRows[dwState];
+		code << "\t{";
+		int nColumn;
+		for (nColumn = 0; nColumn < TSearchFsm::g_nColumnsCount; nColumn++) {
+			const typename TSearchFsm::TTableCell &cell = row.GetCell(nColumn);
+			unsigned int dwOutput = (cell.idxOutput == TSearchFsm::sm_outputNull)? dwOutputNull : cell.idxOutput;
+			code << (nColumn > 0? ", " : "") << (unsigned int)cell.idxNextState << ", " << dwOutput;
+		}
+		code << "},\n";
+	}
+	code << "};\n\n";
+
+	// output table (zero-sized arrays are illegal, so there is a dummy element for no outputs)
+	unsigned int dwOutputsCount = table.outputsCount;
+	code << "static constexpr " << sFsmType << "::TOutput " << sOutputs << "[" << ((dwOutputsCount > 0)? dwOutputsCount : 1) << "] = {\n";
+	unsigned int idx;
+	for (idx = 0; idx < dwOutputsCount; idx++) {
+		const typename TSearchFsm::TOutput &out = table.pOutputs[idx];
+		unsigned int dwNextOutput = (out.idxNextOutput == TSearchFsm::sm_outputNull)? dwOutputNull : out.idxNextOutput;
+		code << "\t{" << (unsigned int)out.patternIdx << ", " << (unsigned int)out.stepBack << ", " <<
+			(unsigned int)out.errorsCount << ", " << dwNextOutput << "},\n";
+	}
+	if (dwOutputsCount == 0) {
+		code << "\t{0, 0, 0, " << dwOutputNull << "}, // dummy\n";
+	}
+	code << "};\n\n";
+
+	code << "static constexpr " << sFsmType << "::STable g_" << sName << "Table = {" << sRows << ", " << sOutputs << ", " <<
+		(unsigned int)table.statesCount << ", " << dwOutputsCount << "};\n\n";
+	code << "#endif // " << sGuard << "\n";
+
+	return code.str();
+}
+
 // output table handling
 template<class TSearchFsm>
 typename TSearchFsm::TOutputIdx CFsmCreator::StoreOutputList(const TOutputList &outputList,
-	QVector<typename TSearchFsm::TOutput> *pOutputTable)
+	std::vector<typename TSearchFsm::TOutput> *pOutputTable, TOutputIndex *pOutputIndex)
 {
-	if (outputList.isEmpty()) {
+	if (outputList.empty()) {
 		return TSearchFsm::sm_outputNull;
 	}
 
 	int idx;
 	typename TSearchFsm::TOutputIdx idxNext = TSearchFsm::sm_outputNull;
-	for (idx = outputList.count() - 1; idx >= 0; idx--) {
+	for (idx = (int)outputList.size() - 1; idx >= 0; idx--) {
 		CFsmCreator::SOutput out = outputList[idx];
 		typename TSearchFsm::TOutput outputNew;
 		outputNew.patternIdx = out.nPatternIdx;
 		outputNew.errorsCount = out.nErrors;
 		outputNew.stepBack = out.nStepBack;
 		outputNew.idxNextOutput = idxNext;
-		idxNext = StoreOutput<TSearchFsm>(outputNew, pOutputTable);
+		idxNext = StoreOutput<TSearchFsm>(outputNew, pOutputTable, pOutputIndex);
 	}
 
 	return idxNext;
@@ -217,17 +834,23 @@ typename TSearchFsm::TOutputIdx CFsmCreator::StoreOutputList(const TOutputList &
 
 template<class TSearchFsm>
 typename TSearchFsm::TOutputIdx CFsmCreator::StoreOutput(const typename TSearchFsm::TOutput &output,
-	QVector<typename TSearchFsm::TOutput> *pOutputTable)
+	std::vector<typename TSearchFsm::TOutput> *pOutputTable, TOutputIndex *pOutputIndex)
 {
-	int idx;
-	for (idx = 0; idx < pOutputTable->count(); idx++) {
-		if (AreEqual<TSearchFsm>(output, pOutputTable->at(idx))) {
-			return idx;
+	// look for the same output among the outputs with the same hash
+	std::vector<int> &list = (*pOutputIndex)[Hash<TSearchFsm>(output)];
+	int idx, nCount = (int)list.size();
+	for (idx = 0; idx < nCount; idx++) {
+		int nOutputIdx = list[idx];
+		if (AreEqual<TSearchFsm>(output, pOutputTable->at(nOutputIdx))) {
+			return nOutputIdx;
 		}
 	}
 
+	// the output is not found - store it
 	pOutputTable->push_back(output);
-	return pOutputTable->count() - 1;
+	int nNewOutputIdx = (int)pOutputTable->size() - 1;
+	list.push_back(nNewOutputIdx);
+	return nNewOutputIdx;
 }
 
 template<class TSearchFsm>
@@ -236,4 +859,16 @@ bool CFsmCreator::AreEqual(const typename TSearchFsm::TOutput &output1, const ty
 		(output1.stepBack == output2.stepBack) && (output1.idxNextOutput == output2.idxNextOutput);
 }
 
+template<class TSearchFsm>
+CFsmCreator::TOutputHash CFsmCreator::Hash(const typename TSearchFsm::TOutput &output) {
+	const unsigned int g_dwHashMultiplier = 3571;
+
+	unsigned int dwHash = output.patternIdx;
+	dwHash = dwHash * g_dwHashMultiplier + output.stepBack;
+	dwHash = dwHash * g_dwHashMultiplier + output.errorsCount;
+	dwHash = dwHash * g_dwHashMultiplier + output.idxNextOutput;
+
+	return dwHash;
+}
+
 #endif // FSMCREATOR_H
@@ -0,0 +1,206 @@
+#line 2 "FsmFile.cpp" // Make __FILE__ omit the path
+
+#include "FsmFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char CFsmFile::g_szMagic[8] = {'S', 'r', 'c', 'h', 'F', 'S', 'M', '\0'};
+
+//////////////////////////////////////////////////////////////////////////
+// CFsmFile
+uint64_t CFsmFile::GetPatternsFingerprint(const TPatterns &patterns) {
+	// 64-bit FNV-1a
+	const uint64_t g_qwOffsetBasis = UINT64_C(0xcbf29ce484222325);
+	const uint64_t g_qwPrime = UINT64_C(0x100000001b3);
+
+	// the integers are hashed as little-endian 4-byte values to be platform independent
+	std::vector<unsigned char> bytes;
+	int idx;
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		const SPattern &pattern = patterns[idx];
+		uint32_t dwValues[] = {(uint32_t)pattern.nLength, (uint32_t)pattern.nMaxErrors,
+			(uint32_t)pattern.data.size(), (uint32_t)pattern.mask.size()};
+		unsigned int nValue;
+		for (nValue = 0; nValue < sizeof(dwValues) / sizeof(dwValues[0]); nValue++) {
+			int nByte;
+			for (nByte = 0; nByte < 4; nByte++) {
+				bytes.push_back((unsigned char)(dwValues[nValue] >> (nByte * BITS_IN_BYTE)));
+			}
+		}
+		bytes.insert(bytes.end(), pattern.data.begin(), pattern.data.end());
+		bytes.insert(bytes.end(), pattern.mask.begin(), pattern.mask.end());
+	}
+
+	uint64_t qwHash = g_qwOffsetBasis;
+	for (idx = 0; idx < (int)bytes.size(); idx++) {
+		qwHash ^= bytes[idx];
+		qwHash *= g_qwPrime;
+	}
+
+	return qwHash;
+}
+
+CFsmFile::EStatus CFsmFile::CheckHeader(const SHeader &header, const SHeader &headerExpected, uint64_t qwFileSize) {
+	if (memcmp(header.szMagic, g_szMagic, sizeof(header.szMagic)) != 0) {
+		return status_BadFormat;
+	}
+	if (header.dwByteOrderMark != g_dwByteOrderMark) { // written on a platform with other byte order
+		return status_TypeMismatch;
+	}
+	if (header.dwVersion != g_dwVersion) {
+		return status_VersionMismatch;
+	}
+	if (header.dwHeaderSize != sizeof(SHeader)) {
+		return status_BadFormat;
+	}
+
+	// table type
+	if (header.dwBitsAtOnce != headerExpected.dwBitsAtOnce || header.dwBitOrder != headerExpected.dwBitOrder ||
+		header.dwStateIdxSize != headerExpected.dwStateIdxSize || header.dwOutputIdxSize != headerExpected.dwOutputIdxSize ||
+		header.dwPatternIdxSize != headerExpected.dwPatternIdxSize || header.dwStepBackSize != headerExpected.dwStepBackSize ||
+		header.dwErrorsCountSize != headerExpected.dwErrorsCountSize ||
+		header.dwRowSize != headerExpected.dwRowSize || header.dwOutputSize != headerExpected.dwOutputSize)
+	{
+		return status_TypeMismatch;
+	}
+
+	// layout
+	if (header.qwRowsOffset % g_dwAlignment != 0 || header.qwOutputsOffset % g_dwAlignment != 0 ||
+		header.qwRowsOffset < sizeof(SHeader) ||
+		header.qwOutputsOffset < header.qwRowsOffset + (uint64_t)header.dwStatesCount * header.dwRowSize ||
+		header.qwFileSize < header.qwOutputsOffset + (uint64_t)header.dwOutputsCount * header.dwOutputSize ||
+		header.qwFileSize > qwFileSize || header.dwStatesCount == 0)
+	{
+		return status_BadFormat;
+	}
+
+	if (header.qwPatternsFingerprint != headerExpected.qwPatternsFingerprint) {
+		return status_PatternsMismatch;
+	}
+
+	return status_Ok;
+}
+
+bool CFsmFile::WritePadding(FILE *pFile, uint64_t qwOffset) {
+	long nPosition = ftell(pFile);
+	if (nPosition < 0 || (uint64_t)nPosition > qwOffset) {
+		return false;
+	}
+
+	std::vector<char> padding((size_t)(qwOffset - nPosition), '\0');
+	return fwrite(padding.data(), 1, padding.size(), pFile) == padding.size();
+}
+
+CFsmFile::EStatus CFsmFile::MapFile(const std::string &sFileName, uint64_t qwMinSize, unsigned char **ppMap,
+	uint64_t *pqwSize)
+{
+	// the file itself may be closed right after the mapping, the mapping keeps it open
+	*ppMap = NULL;
+	*pqwSize = 0;
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(sFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return status_IoError;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size)) {
+		CloseHandle(hFile);
+		return status_IoError;
+	}
+	uint64_t qwSize = (uint64_t)size.QuadPart;
+	if (qwSize < qwMinSize) {
+		CloseHandle(hFile);
+		return status_BadFormat;
+	}
+	HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (hMapping == NULL) {
+		return status_IoError;
+	}
+	void *pMap = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	if (pMap == NULL) {
+		return status_IoError;
+	}
+#else
+	int nFile = open(sFileName.c_str(), O_RDONLY);
+	if (nFile < 0) {
+		return status_IoError;
+	}
+	struct stat fileStat;
+	if (fstat(nFile, &fileStat) != 0) {
+		close(nFile);
+		return status_IoError;
+	}
+	uint64_t qwSize = (uint64_t)fileStat.st_size;
+	if (qwSize < qwMinSize || qwSize == 0) {
+		close(nFile);
+		return status_BadFormat;
+	}
+	void *pMap = mmap(NULL, (size_t)qwSize, PROT_READ, MAP_SHARED, nFile, 0);
+	close(nFile);
+	if (pMap == MAP_FAILED) {
+		return status_IoError;
+	}
+#endif
+
+	*ppMap = static_cast<unsigned char*>(pMap);
+	*pqwSize = qwSize;
+	return status_Ok;
+}
+
+void CFsmFile::UnmapFile(unsigned char *pMap, uint64_t qwSize) {
+#ifdef _WIN32
+	(void)qwSize;
+	UnmapViewOfFile(pMap);
+#else
+	munmap(pMap, (size_t)qwSize);
+#endif
+}
+
+void CFsmFile::AdviseSequential(unsigned char *pMap, uint64_t qwSize) {
+#if !defined(_WIN32) && defined(MADV_SEQUENTIAL)
+	madvise(pMap, (size_t)qwSize, MADV_SEQUENTIAL);
+#else
+	(void)pMap;
+	(void)qwSize;
+#endif
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// CDataFileMapping
+CFsmFile::EStatus CDataFileMapping::Open(const std::string &sFileName) {
+	Close();
+
+	CFsmFile::EStatus status = CFsmFile::MapFile(sFileName, 0, &m_pMap, &m_qwMapSize);
+	if (status == CFsmFile::status_BadFormat) { // empty file, nothing to map
+		status = CFsmFile::status_Ok;
+	}
+	if (status != CFsmFile::status_Ok) {
+		return status;
+	}
+
+	if (m_pMap != NULL) {
+		CFsmFile::AdviseSequential(m_pMap, m_qwMapSize);
+	}
+	m_fOpen = true;
+	return CFsmFile::status_Ok;
+}
+
+void CDataFileMapping::Close() {
+	if (m_pMap != NULL) {
+		CFsmFile::UnmapFile(m_pMap, m_qwMapSize);
+		m_pMap = NULL;
+	}
+	m_qwMapSize = 0;
+	m_fOpen = false;
+}
@@ -0,0 +1,272 @@
+#line 2 "FsmFile.h" // Make __FILE__ omit the path
+
+#ifndef FSMFILE_H
+#define FSMFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "Common.h"
+#include "FsmCreator.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CFsmFile - binary file format for SearchFSM tables.
+/// The file consists of the header (SHeader), the main table rows and the output table, both tables
+/// are stored exactly as they are in memory and start at g_dwAlignment-aligned offsets. So a mapped
+/// file may be used by CSearchFsm/CSearchFsmByte directly, without any copying or parsing (see
+/// CFsmFileMapping).
+/// The data is stored in the host byte order and with the host types; the header describes the
+/// stride, the bit order, the sizes of all the table fields and the fingerprint of the patterns,
+/// so a file built for another table type, another platform or other patterns is refused.
+class CFsmFile {
+public:
+	static const uint32_t g_dwVersion = 1;
+	static const uint32_t g_dwAlignment = 64; // cache line size, tables start at such offsets
+	static const uint32_t g_dwByteOrderMark = 0x01020304;
+
+	struct SHeader {
+		char szMagic[8]; // g_szMagic
+		uint32_t dwVersion;
+		uint32_t dwByteOrderMark; // g_dwByteOrderMark in the byte order of the file
+		uint32_t dwHeaderSize; // sizeof(SHeader)
+
+		// table type
+		uint32_t dwBitsAtOnce; // stride: 1 for CSearchFsm, nBitsAtOnce for CSearchFsmByte
+		uint32_t dwBitOrder; // CFsmCreator::EBitOrder
+		uint32_t dwStateIdxSize;
+		uint32_t dwOutputIdxSize;
+		uint32_t dwPatternIdxSize;
+		uint32_t dwStepBackSize;
+		uint32_t dwErrorsCountSize;
+		uint32_t dwRowSize; // sizeof(STableRow)
+		uint32_t dwOutputSize; // sizeof(TOutput)
+
+		// table contents
+		uint32_t dwStatesCount;
+		uint32_t dwOutputsCount;
+		uint32_t dwReserved;
+		uint64_t qwRowsOffset;
+		uint64_t qwOutputsOffset;
+		uint64_t qwFileSize;
+		uint64_t qwPatternsFingerprint; // see GetPatternsFingerprint
+	};
+
+	enum EStatus {
+		status_Ok,
+		status_IoError, // can't open, write or map the file
+		status_BadFormat, // not a SearchFSM file or the file is damaged
+		status_VersionMismatch, // unsupported version of the format
+		status_TypeMismatch, // other stride, bit order, byte order or table field types
+		status_PatternsMismatch // the tables are built for other patterns
+	};
+
+public:
+	/// 64-bit FNV-1a hash of the patterns (lengths, errors counts, data and masks)
+	static uint64_t GetPatternsFingerprint(const TPatterns &patterns);
+
+	/// header for the table of TSearchFsm (the counts and offsets are filled too)
+	template <class TSearchFsm>
+	static SHeader CreateHeader(const typename TSearchFsm::STable &table, CFsmCreator::EBitOrder bitOrder, uint64_t qwPatternsFingerprint);
+
+	/// validate the header read from the file against the expected one
+	static EStatus CheckHeader(const SHeader &header, const SHeader &headerExpected, uint64_t qwFileSize);
+
+	template <class TSearchFsm>
+	static EStatus Save(const std::string &sFileName, const typename TSearchFsm::STable &table, CFsmCreator::EBitOrder bitOrder,
+		uint64_t qwPatternsFingerprint);
+
+private:
+	static const char g_szMagic[8];
+
+	static uint64_t AlignOffset(uint64_t qwOffset) {
+		return (qwOffset + g_dwAlignment - 1) / g_dwAlignment * g_dwAlignment;
+	}
+
+	static bool WritePadding(FILE *pFile, uint64_t qwOffset);
+
+	// read-only mapping of the whole file, see CFsmFileMapping and CDataFileMapping
+	template <class TSearchFsm>
+	friend class CFsmFileMapping;
+	friend class CDataFileMapping;
+	static EStatus MapFile(const std::string &sFileName, uint64_t qwMinSize, /* out */ unsigned char **ppMap,
+		/* out */ uint64_t *pqwSize);
+	static void UnmapFile(unsigned char *pMap, uint64_t qwSize);
+	static void AdviseSequential(unsigned char *pMap, uint64_t qwSize); // read-ahead hint, may be ignored
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CFsmFileMapping<TSearchFsm> - SearchFSM tables loaded from the file by memory mapping.
+/// The STable points straight into the mapping, the pages are loaded on demand and several processes
+/// mapping the same file share the page cache. The table is valid while the object exists and is open.
+template <class TSearchFsm>
+class CFsmFileMapping {
+public:
+	typedef typename TSearchFsm::STable STable;
+
+public: // constructor & destructor
+	CFsmFileMapping(): m_pMap(NULL), m_qwMapSize(0) {
+		STable table = {NULL, NULL, 0, 0};
+		m_table = table;
+	}
+
+	~CFsmFileMapping() {
+		Close();
+	}
+
+public: // working methods
+	CFsmFile::EStatus Open(const std::string &sFileName, CFsmCreator::EBitOrder bitOrder, uint64_t qwPatternsFingerprint) {
+		Close();
+
+		// the header is read through the mapping too
+		CFsmFile::EStatus status = CFsmFile::MapFile(sFileName, sizeof(CFsmFile::SHeader), &m_pMap, &m_qwMapSize);
+		if (status != CFsmFile::status_Ok) {
+			return status;
+		}
+
+		const CFsmFile::SHeader &header = *reinterpret_cast<const CFsmFile::SHeader*>(m_pMap);
+		STable tableEmpty = {NULL, NULL, 0, 0};
+		CFsmFile::SHeader headerExpected = CFsmFile::CreateHeader<TSearchFsm>(tableEmpty, bitOrder, qwPatternsFingerprint);
+		status = CFsmFile::CheckHeader(header, headerExpected, m_qwMapSize);
+		if (status != CFsmFile::status_Ok) {
+			Close();
+			return status;
+		}
+
+		STable table = {reinterpret_cast<const typename TSearchFsm::STableRow*>(m_pMap + header.qwRowsOffset),
+			reinterpret_cast<const typename TSearchFsm::TOutput*>(m_pMap + header.qwOutputsOffset),
+			(typename TSearchFsm::TStateIdx)header.dwStatesCount, (typename TSearchFsm::TOutputIdx)header.dwOutputsCount};
+		m_table = table;
+
+		return CFsmFile::status_Ok;
+	}
+
+	void Close() {
+		if (m_pMap != NULL) {
+			CFsmFile::UnmapFile(m_pMap, m_qwMapSize);
+			m_pMap = NULL;
+			m_qwMapSize = 0;
+		}
+		STable table = {NULL, NULL, 0, 0};
+		m_table = table;
+	}
+
+	bool IsOpen() const {
+		return m_pMap != NULL;
+	}
+
+	const STable& GetTable() const {
+		return m_table;
+	}
+
+private: // the mapping mustn't be copied
+	CFsmFileMapping(const CFsmFileMapping&);
+	CFsmFileMapping& operator=(const CFsmFileMapping&);
+
+private:
+	unsigned char *m_pMap;
+	uint64_t m_qwMapSize;
+	STable m_table;
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CDataFileMapping - the data to scan (a capture file) loaded by memory mapping.
+/// The file is read once from the beginning to the end, so the system is advised to read ahead and
+/// to drop the pages behind. An empty file is mapped as empty data.
+class CDataFileMapping {
+public: // constructor & destructor
+	CDataFileMapping(): m_pMap(NULL), m_qwMapSize(0), m_fOpen(false) {}
+
+	~CDataFileMapping() {
+		Close();
+	}
+
+public: // working methods
+	CFsmFile::EStatus Open(const std::string &sFileName);
+	void Close();
+
+	bool IsOpen() const {
+		return m_fOpen;
+	}
+
+	const unsigned char* GetData() const {
+		return m_pMap;
+	}
+
+	uint64_t GetSize() const {
+		return m_qwMapSize;
+	}
+
+private: // the mapping mustn't be copied
+	CDataFileMapping(const CDataFileMapping&);
+	CDataFileMapping& operator=(const CDataFileMapping&);
+
+private:
+	unsigned char *m_pMap; // NULL for an empty file
+	uint64_t m_qwMapSize;
+	bool m_fOpen;
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// template methods implementation
+template <class TSearchFsm>
+CFsmFile::SHeader CFsmFile::CreateHeader(const typename TSearchFsm::STable &table, CFsmCreator::EBitOrder bitOrder,
+	uint64_t qwPatternsFingerprint)
+{
+	typedef typename TSearchFsm::TOutput TOutput;
+	SHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.szMagic, g_szMagic, sizeof(header.szMagic));
+	header.dwVersion = g_dwVersion;
+	header.dwByteOrderMark = g_dwByteOrderMark;
+	header.dwHeaderSize = sizeof(SHeader);
+
+	header.dwBitsAtOnce = TSearchFsm::g_nBitsAtOnce;
+	header.dwBitOrder = bitOrder;
+	header.dwStateIdxSize = sizeof(typename TSearchFsm::TStateIdx);
+	header.dwOutputIdxSize = sizeof(typename TSearchFsm::TOutputIdx);
+	header.dwPatternIdxSize = sizeof(static_cast<const TOutput*>(NULL)->patternIdx);
+	header.dwStepBackSize = sizeof(static_cast<const TOutput*>(NULL)->stepBack);
+	header.dwErrorsCountSize = sizeof(static_cast<const TOutput*>(NULL)->errorsCount);
+	header.dwRowSize = sizeof(typename TSearchFsm::STableRow);
+	header.dwOutputSize = sizeof(TOutput);
+
+	header.dwStatesCount = table.statesCount;
+	header.dwOutputsCount = table.outputsCount;
+	header.qwRowsOffset = AlignOffset(sizeof(SHeader));
+	header.qwOutputsOffset = AlignOffset(header.qwRowsOffset + (uint64_t)header.dwStatesCount * header.dwRowSize);
+	header.qwFileSize = header.qwOutputsOffset + (uint64_t)header.dwOutputsCount * header.dwOutputSize;
+	header.qwPatternsFingerprint = qwPatternsFingerprint;
+
+	return header;
+}
+
+template <class TSearchFsm>
+CFsmFile::EStatus CFsmFile::Save(const std::string &sFileName, const typename TSearchFsm::STable &table,
+	CFsmCreator::EBitOrder bitOrder, uint64_t qwPatternsFingerprint)
+{
+	SHeader header = CreateHeader<TSearchFsm>(table, bitOrder, qwPatternsFingerprint);
+	FILE *pFile = fopen(sFileName.c_str(), "wb");
+	if (pFile == NULL) {
+		return status_IoError;
+	}
+
+	// header, rows, outputs - each table is aligned
+	size_t nRowsSize = (size_t)header.dwStatesCount * header.dwRowSize;
+	size_t nOutputsSize = (size_t)header.dwOutputsCount * header.dwOutputSize;
+	bool fSuccess = fwrite(&header, 1, sizeof(header), pFile) == sizeof(header) &&
+		WritePadding(pFile, header.qwRowsOffset) &&
+		fwrite(table.pTableRows, 1, nRowsSize, pFile) == nRowsSize &&
+		WritePadding(pFile, header.qwOutputsOffset) &&
+		fwrite(table.pOutputs, 1, nOutputsSize, pFile) == nOutputsSize;
+	fSuccess = (fclose(pFile) == 0) && fSuccess;
+
+	return fSuccess? status_Ok : status_IoError;
+}
+
+#endif // FSMFILE_H
@@ -0,0 +1,113 @@
+#line 2 "LazySearchFsm.cpp" // Make __FILE__ omit the path
+
+#include "LazySearchFsm.h"
+
+//////////////////////////////////////////////////////////////////////////
+// CLazySearchFsm
+CLazySearchFsm::CLazySearchFsm(const TPatterns &patterns, int nMaxStates):
+	m_patterns(CFsmCreator::CompilePatterns(patterns)), m_nMaxStates(std::max(nMaxStates, 2)), m_state(0), m_dwTransitionsCount(0), m_dwFlushesCount(0)
+{
+	m_states.Init(m_patterns);
+	m_stateInitial = m_states.Pack(CFsmCreator::CreateInitialState(m_patterns));
+	Reset();
+}
+
+void CLazySearchFsm::Reset() {
+	CFsmCreator::TStateHash hash = CFsmCreator::CStateArena::Hash(m_stateInitial);
+	int nState = m_states.Find(m_stateInitial, hash);
+	if (nState < 0) {
+		if (m_states.GetCount() >= m_nMaxStates) {
+			Flush();
+		}
+		nState = AddState(m_stateInitial, hash);
+	}
+	m_state = (TStateIdx)nState;
+}
+
+int CLazySearchFsm::GetStatesCount() const {
+	return m_states.GetCount();
+}
+
+int CLazySearchFsm::GetMaxStatesCount() const {
+	return m_nMaxStates;
+}
+
+unsigned int CLazySearchFsm::GetTransitionsCount() const {
+	return m_dwTransitionsCount;
+}
+
+unsigned int CLazySearchFsm::GetFlushesCount() const {
+	return m_dwFlushesCount;
+}
+
+uint64_t CLazySearchFsm::GetMemoryUsage() const {
+	return (uint64_t)m_cells.size() * sizeof(TTableCell) + (uint64_t)m_outputs.size() * sizeof(TOutput) + m_states.GetMemoryUsage();
+}
+
+CLazySearchFsm::TTableCell CLazySearchFsm::CreateTransition(TStateIdx state, unsigned int dwByte) {
+	// process the byte bit-by-bit, the same as CFsmCreator::TransitState and CreateByteTable do
+	SStateDescription stateNext, stateTemp;
+	m_states.Unpack(state, &stateNext);
+	stateTemp.words.resize((int)stateNext.words.size());
+	CFsmCreator::TOutputList outputList;
+	int nBit;
+	for (nBit = 0; nBit < BITS_IN_BYTE; nBit++) {
+		unsigned char bBit = (dwByte >> (BITS_IN_BYTE - nBit - 1)) & 0x01;
+		int nBitsRemained = BITS_IN_BYTE - nBit - 1;
+		int idx;
+		for (idx = 0; idx < (int)m_patterns.size(); idx++) {
+			int nOffset = m_patterns[idx].nOffset;
+			CFsmCreator::SBitResultForPattern bitResult = CFsmCreator::ProcessBitForPattern(stateNext.words.data() + nOffset,
+				m_patterns[idx], bBit, stateTemp.words.data() + nOffset);
+			if (bitResult.fFound) {
+				CFsmCreator::SOutput output;
+				output.nPatternIdx = idx;
+				output.nErrors = bitResult.nErrors;
+				output.nStepBack = m_patterns[idx].nLength + nBitsRemained;
+				outputList.push_back(output);
+			}
+		}
+		std::swap(stateNext, stateTemp);
+	}
+	m_dwTransitionsCount++;
+
+	// the cache is flushed, if there is no place for the new state; the transition isn't stored then
+	bool fFlushed = false;
+	CFsmCreator::TPackedState packedNext = m_states.Pack(stateNext);
+	CFsmCreator::TStateHash hash = CFsmCreator::CStateArena::Hash(packedNext);
+	int nStateNext = m_states.Find(packedNext, hash);
+	if (nStateNext < 0) {
+		if (m_states.GetCount() >= m_nMaxStates) {
+			Flush();
+			fFlushed = true;
+		}
+		nStateNext = AddState(packedNext, hash);
+	}
+
+	TTableCell cell;
+	cell.idxNextState = (TStateIdx)nStateNext;
+	cell.idxOutput = CFsmCreator::StoreOutputList<TSearchFsm>(outputList, &m_outputs, &m_outputIndex);
+	if (!fFlushed) {
+		m_cells[state * g_nColumnsCount + dwByte] = cell;
+	}
+
+	return cell;
+}
+
+CLazySearchFsm::TStateIdx CLazySearchFsm::AddState(const CFsmCreator::TPackedState &state, CFsmCreator::TStateHash hash) {
+	// the new row has no transitions yet
+	TTableCell cellUnknown;
+	cellUnknown.idxNextState = sm_stateUnknown;
+	cellUnknown.idxOutput = sm_outputNull;
+	m_cells.insert(m_cells.end(), g_nColumnsCount, cellUnknown);
+
+	return (TStateIdx)m_states.Add(state, hash);
+}
+
+void CLazySearchFsm::Flush() {
+	m_states.Clear(); // the fields widths are kept
+	m_cells.clear();
+	m_outputs.clear();
+	m_outputIndex.clear();
+	m_dwFlushesCount++;
+}
@@ -0,0 +1,100 @@
+#line 2 "LazySearchFsm.h" // Make __FILE__ omit the path
+
+#ifndef LAZYSEARCHFSM_H
+#define LAZYSEARCHFSM_H
+
+#include <vector>
+
+#include "Common.h"
+#include "SearchFsm.h"
+#include "FsmCreator.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CLazySearchFsm - octet SearchFSM built on demand while scanning.
+/// The full table for many long patterns with several errors is too large to be generated, but the
+/// scanning visits a small part of the states only. This engine keeps the states' descriptions and
+/// creates a transition (and the state it leads to) when it is met for the first time; the cached
+/// transitions are used as the table of CSearchFsmByte<8>. The cache is limited by nMaxStates: when
+/// it is full, all the states are dropped and the cache is started anew from the current state, as
+/// RE2's DFA does. The bits are processed MSB first, as in patterns.
+class CLazySearchFsm {
+public:
+	typedef CSearchFsmByte<BITS_IN_BYTE> TSearchFsm; // for table types
+	typedef TSearchFsm::TStateIdx TStateIdx;
+	typedef TSearchFsm::TOutputIdx TOutputIdx;
+	typedef TSearchFsm::TTableCell TTableCell;
+	typedef TSearchFsm::TOutput TOutput;
+
+	static const TOutputIdx sm_outputNull = TSearchFsm::sm_outputNull;
+	static const TStateIdx sm_stateUnknown = (TStateIdx)(-1); // the transition is not created yet
+	static const int g_nBitsAtOnce = BITS_IN_BYTE;
+	static const int g_nColumnsCount = (1 << BITS_IN_BYTE);
+	static const int g_nDefaultMaxStates = 4096;
+
+public: // constructor
+	CLazySearchFsm(const TPatterns &patterns, int nMaxStates = g_nDefaultMaxStates);
+
+public: // working methods
+	/// return to the initial state, the cache is kept
+	void Reset();
+
+	/// Push all the bytes of the buffer, the same as CSearchFsmByte::Scan
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink) {
+		const TTableCell *pCells = m_cells.data();
+		TStateIdx state = m_state;
+		size_t idx;
+		for (idx = 0; idx < nBytes; idx++) {
+			TTableCell cell = pCells[state * g_nColumnsCount + pData[idx]];
+			if (cell.idxNextState == sm_stateUnknown) { // rare case - new transition
+				cell = CreateTransition(state, pData[idx]);
+				pCells = m_cells.data(); // the cache could grow or be flushed
+			}
+			if (cell.idxOutput != sm_outputNull) { // rare case - found something
+				PutOutputs(cell.idxOutput, ((uint64_t)idx + 1) * BITS_IN_BYTE, sink);
+			}
+			state = cell.idxNextState;
+		}
+		m_state = state;
+	}
+
+public: // statistics
+	int GetStatesCount() const; // states in the cache now
+	int GetMaxStatesCount() const;
+	unsigned int GetTransitionsCount() const; // transitions created (cache misses)
+	unsigned int GetFlushesCount() const;
+	uint64_t GetMemoryUsage() const; // approximate size of the cache, bytes
+
+private:
+	typedef CFsmCreator::SStateDescription SStateDescription;
+
+	TTableCell CreateTransition(TStateIdx state, unsigned int dwByte);
+	TStateIdx AddState(const CFsmCreator::TPackedState &state, CFsmCreator::TStateHash hash);
+	void Flush();
+
+	template <class TSink>
+	void PutOutputs(TOutputIdx idxOutput, uint64_t qwBitsProcessed, TSink &sink) const {
+		while (idxOutput != sm_outputNull) {
+			const TOutput &output = m_outputs[idxOutput];
+			sink(qwBitsProcessed, output);
+			idxOutput = output.idxNextOutput;
+		}
+	}
+
+private:
+	const CFsmCreator::TCompiledPatterns m_patterns;
+	const int m_nMaxStates;
+	CFsmCreator::TPackedState m_stateInitial;
+
+	// the cache
+	CFsmCreator::CStateArena m_states;
+	std::vector<TTableCell> m_cells; // m_states.GetCount() rows of g_nColumnsCount cells
+	std::vector<TOutput> m_outputs;
+	CFsmCreator::TOutputIndex m_outputIndex;
+
+	TStateIdx m_state;
+	unsigned int m_dwTransitionsCount;
+	unsigned int m_dwFlushesCount;
+};
+
+#endif // LAZYSEARCHFSM_H
@@ -0,0 +1,158 @@
+#line 2 "ParallelSearchFsm.h" // Make __FILE__ omit the path
+
+#ifndef PARALLELSEARCHFSM_H
+#define PARALLELSEARCHFSM_H
+
+#include <vector>
+
+#include "Concurrent.h"
+#include "SearchFsm.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CParallelSearchFsm<TSearchFsm> - scans one big buffer with a byte SearchFSM in several threads.
+/// The buffer is split into chunks, each chunk is scanned by its own worker from a speculative state.
+/// The speculative state is obtained by a warm-up: running the FSM from the state 0 over \p nWarmUpBytes
+/// bytes preceding the chunk. The state of a SearchFSM depends on the last (max pattern length) bits only,
+/// so the warm-up longer than the longest pattern always converges to the true state.
+/// Then the chunks are stitched: the end state of each chunk must be equal to the state the next chunk was
+/// started from, otherwise the next chunk is rescanned from the right state. So the findings are always
+/// exactly the same as of the sequential scan, including the patterns straddling chunk boundaries.
+template <class TSearchFsm>
+class CParallelSearchFsm {
+public:
+	typedef typename TSearchFsm::STable STable;
+	typedef typename TSearchFsm::TStateIdx TStateIdx;
+	typedef typename TSearchFsm::TOutputIdx TOutputIdx;
+	typedef typename TSearchFsm::TOutput TOutput;
+
+public: // constructor
+	CParallelSearchFsm(const STable &table, size_t nWarmUpBytes):
+		m_table(table), m_nWarmUpBytes(nWarmUpBytes)
+	{
+		Reset();
+	}
+
+public: // working methods
+	void Reset(TStateIdx state = 0) {
+		ASSERT(state < m_table.statesCount);
+		m_state = state;
+		m_cMisspeculations = 0;
+	}
+
+	/// Scan the buffer with nChunks workers, sink(qwBitsProcessed, output) is called in the same order and
+	/// with the same arguments as the TSearchFsm::Scan does
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink, int nChunks) {
+		size_t nMaxChunks = nBytes / (m_nWarmUpBytes + 1) + 1; // shorter chunks make no sense
+		if ((size_t)nChunks > nMaxChunks) {
+			nChunks = (int)nMaxChunks;
+		}
+		if (nChunks < 1) {
+			nChunks = 1;
+		}
+
+		// prepare the chunks
+		std::vector<SChunk> chunks(nChunks);
+		int nChunk;
+		for (nChunk = 0; nChunk < nChunks; nChunk++) {
+			SChunk &chunk = chunks[nChunk];
+			chunk.pTable = &m_table;
+			chunk.pData = pData;
+			chunk.nBegin = nBytes * nChunk / nChunks;
+			chunk.nEnd = nBytes * (nChunk + 1) / nChunks;
+			chunk.nWarmUpBytes = m_nWarmUpBytes;
+			chunk.fKnownState = (nChunk == 0);
+			chunk.stateStart = m_state; // used for the first chunk only
+		}
+
+		// scan all the chunks in parallel
+		BlockingMap(chunks, &CParallelSearchFsm::ScanChunk, nChunks); // a thread per chunk
+
+		// stitch the chunks and put the findings
+		for (nChunk = 0; nChunk < nChunks; nChunk++) {
+			SChunk &chunk = chunks[nChunk];
+			if (nChunk > 0 && chunk.stateStart != chunks[nChunk - 1].stateEnd) { // misspeculation
+				m_cMisspeculations++;
+				chunk.stateStart = chunks[nChunk - 1].stateEnd;
+				chunk.fKnownState = true;
+				ScanChunk(chunk);
+			}
+
+			int idx;
+			for (idx = 0; idx < (int)chunk.hits.size(); idx++) {
+				const SHit &hit = chunk.hits[idx];
+				sink(hit.qwBitsProcessed, *hit.pOutput);
+			}
+		}
+
+		m_state = chunks[nChunks - 1].stateEnd;
+	}
+
+	TStateIdx GetState() const {
+		return m_state;
+	}
+
+	/// count of chunks rescanned because of wrong speculative state since the last Reset
+	unsigned int GetMisspeculationsCount() const {
+		return m_cMisspeculations;
+	}
+
+private:
+	struct SHit {
+		uint64_t qwBitsProcessed; // from the beginning of the whole buffer
+		const TOutput *pOutput;
+	};
+
+	struct SChunk {
+		// task
+		const STable *pTable;
+		const unsigned char *pData; // the whole buffer
+		size_t nBegin, nEnd; // chunk bounds (bytes)
+		size_t nWarmUpBytes;
+		bool fKnownState; // stateStart is true state, no warm-up needed
+		// results
+		TStateIdx stateStart, stateEnd;
+		std::vector<SHit> hits;
+	};
+
+	// sink collecting hits of a chunk
+	struct SChunkSink {
+		std::vector<SHit> *pHits;
+		uint64_t qwBitsBefore;
+
+		void operator()(uint64_t qwBitsProcessed, const TOutput &output) {
+			SHit hit = {qwBitsBefore + qwBitsProcessed, &output};
+			pHits->push_back(hit);
+		}
+	};
+
+	// sink for the warm-up
+	struct SIdleSink {
+		void operator()(uint64_t, const TOutput&) {}
+	};
+
+	static void ScanChunk(SChunk &chunk) {
+		TSearchFsm fsm(*chunk.pTable);
+		if (chunk.fKnownState) {
+			fsm.Reset(chunk.stateStart);
+		} else { // speculate: warm up from the state 0
+			size_t nWarmUpBegin = (chunk.nBegin > chunk.nWarmUpBytes)? chunk.nBegin - chunk.nWarmUpBytes : 0;
+			SIdleSink idleSink;
+			fsm.Scan(chunk.pData + nWarmUpBegin, chunk.nBegin - nWarmUpBegin, idleSink);
+			chunk.stateStart = fsm.GetState();
+		}
+
+		chunk.hits.clear();
+		SChunkSink sink = {&chunk.hits, (uint64_t)chunk.nBegin * BITS_IN_BYTE};
+		fsm.Scan(chunk.pData + chunk.nBegin, chunk.nEnd - chunk.nBegin, sink);
+		chunk.stateEnd = fsm.GetState();
+	}
+
+private:
+	const STable m_table;
+	const size_t m_nWarmUpBytes;
+	TStateIdx m_state;
+	unsigned int m_cMisspeculations;
+};
+
+#endif // PARALLELSEARCHFSM_H
@@ -0,0 +1,353 @@
+#line 2 "RegisterMatcher.cpp" // Make __FILE__ omit the path
+
+#include "RegisterMatcher.h"
+
+// GCC and Clang compile each vector kernel for its target and the processor is checked at run time,
+// other compilers have the kernel of the build's instruction set only (e.g. /arch:AVX2)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define REGISTER_MATCHER_DISPATCH
+#define REGISTER_MATCHER_AVX512
+#define REGISTER_MATCHER_AVX2
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512vpopcntdq")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+#define REGISTER_MATCHER_AVX512
+#endif
+#if defined(__AVX2__)
+#define REGISTER_MATCHER_AVX2
+#endif
+#define TARGET_AVX512
+#define TARGET_AVX2
+#endif
+
+#if defined(REGISTER_MATCHER_AVX512) || defined(REGISTER_MATCHER_AVX2)
+#include <immintrin.h>
+#endif
+
+// the input word beginning at the byte, the first byte is the most significant one
+static inline uint64_t LoadBigEndian(const unsigned char *pBytes) {
+	return ((uint64_t)pBytes[0] << 56) | ((uint64_t)pBytes[1] << 48) | ((uint64_t)pBytes[2] << 40) |
+		((uint64_t)pBytes[3] << 32) | ((uint64_t)pBytes[4] << 24) | ((uint64_t)pBytes[5] << 16) |
+		((uint64_t)pBytes[6] << 8) | (uint64_t)pBytes[7];
+}
+
+static inline unsigned int Weight(CRegisterMatcher::TChunk vector) {
+	vector = vector - ((vector >> 1) & 0x55555555);
+	vector = (vector & 0x33333333) + ((vector >> 2) & 0x33333333);
+	vector = (vector + (vector >> 4)) & 0x0f0f0f0f;
+	return (vector * 0x01010101) >> 24;
+}
+
+#ifdef REGISTER_MATCHER_AVX2
+static inline TARGET_AVX2 __m256i Weight(__m256i vector) {
+	// the weights of the nibbles are looked up, then the bytes of a lane are summed
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(vector, nibble));
+	__m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(vector, 4), nibble));
+	__m256i bytes = _mm256_add_epi8(low, high);
+	return _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, _mm256_set1_epi8(1)), _mm256_set1_epi16(1));
+}
+#endif
+
+// the kernels: the lane o takes the chunk of the input word shifted by nShift + o bits
+static unsigned int TestOffsetsScalar(const CRegisterMatcher::TChunk *pPatternChunks,
+	const CRegisterMatcher::TChunk *pMaskChunks, int nChunksCount, unsigned int dwMaxErrors, const unsigned char *pStart,
+	int nShift)
+{
+	typedef CRegisterMatcher::TChunk TChunk;
+	const int g_nLanesCount = 8;
+
+	unsigned int dwsErrors[g_nLanesCount] = {0};
+	int nChunk, nLane;
+	for (nChunk = 0; nChunk < nChunksCount; nChunk++) {
+		uint64_t qwWord = LoadBigEndian(pStart + nChunk * sizeof(TChunk));
+		TChunk patternChunk = pPatternChunks[nChunk], maskChunk = pMaskChunks[nChunk];
+		bool fAlive = false;
+		for (nLane = 0; nLane < g_nLanesCount; nLane++) {
+			TChunk window = (TChunk)((qwWord << (nShift + nLane)) >> CRegisterMatcher::g_nChunkLength);
+			dwsErrors[nLane] += Weight((window ^ patternChunk) & maskChunk);
+			if (dwsErrors[nLane] <= dwMaxErrors) {
+				fAlive = true;
+			}
+		}
+		if (!fAlive) {
+			return 0;
+		}
+	}
+
+	unsigned int dwFound = 0;
+	for (nLane = 0; nLane < g_nLanesCount; nLane++) {
+		if (dwsErrors[nLane] <= dwMaxErrors) {
+			dwFound |= 1u << nLane;
+		}
+	}
+	return dwFound;
+}
+
+#ifdef REGISTER_MATCHER_AVX2
+static TARGET_AVX2 unsigned int TestOffsetsAvx2(const CRegisterMatcher::TChunk *pPatternChunks,
+	const CRegisterMatcher::TChunk *pMaskChunks, int nChunksCount, unsigned int dwMaxErrors, const unsigned char *pStart,
+	int nShift)
+{
+	typedef CRegisterMatcher::TChunk TChunk;
+
+	const __m256i shiftsLeft = _mm256_add_epi32(_mm256_set1_epi32(nShift), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	const __m256i shiftsRight = _mm256_sub_epi32(_mm256_set1_epi32(CRegisterMatcher::g_nChunkLength), shiftsLeft);
+	const __m256i maxErrors = _mm256_set1_epi32((int)dwMaxErrors);
+	__m256i errors = _mm256_setzero_si256();
+	int nChunk;
+	for (nChunk = 0; nChunk < nChunksCount; nChunk++) {
+		uint64_t qwWord = LoadBigEndian(pStart + nChunk * sizeof(TChunk));
+		__m256i window = _mm256_or_si256(
+			_mm256_sllv_epi32(_mm256_set1_epi32((int)(qwWord >> CRegisterMatcher::g_nChunkLength)), shiftsLeft),
+			_mm256_srlv_epi32(_mm256_set1_epi32((int)(TChunk)qwWord), shiftsRight));
+		__m256i diff = _mm256_and_si256(_mm256_xor_si256(window, _mm256_set1_epi32((int)pPatternChunks[nChunk])),
+			_mm256_set1_epi32((int)pMaskChunks[nChunk]));
+		errors = _mm256_add_epi32(errors, Weight(diff));
+		if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(errors, maxErrors))) == 0xff) {
+			return 0;
+		}
+	}
+
+	return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(errors, maxErrors))) & 0xff;
+}
+#endif
+
+#ifdef REGISTER_MATCHER_AVX512
+static TARGET_AVX512 unsigned int TestOffsetsAvx512(const CRegisterMatcher::TChunk *pPatternChunks,
+	const CRegisterMatcher::TChunk *pMaskChunks, int nChunksCount, unsigned int dwMaxErrors, const unsigned char *pStart,
+	int nShift)
+{
+	typedef CRegisterMatcher::TChunk TChunk;
+
+	const __m512i shiftsLeft = _mm512_add_epi32(_mm512_set1_epi32(nShift),
+		_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+	const __m512i shiftsRight = _mm512_sub_epi32(_mm512_set1_epi32(CRegisterMatcher::g_nChunkLength), shiftsLeft);
+	const __m512i maxErrors = _mm512_set1_epi32((int)dwMaxErrors);
+	__m512i errors = _mm512_setzero_si512();
+	int nChunk;
+	for (nChunk = 0; nChunk < nChunksCount; nChunk++) {
+		uint64_t qwWord = LoadBigEndian(pStart + nChunk * sizeof(TChunk));
+		__m512i window = _mm512_or_si512(
+			_mm512_sllv_epi32(_mm512_set1_epi32((int)(qwWord >> CRegisterMatcher::g_nChunkLength)), shiftsLeft),
+			_mm512_srlv_epi32(_mm512_set1_epi32((int)(TChunk)qwWord), shiftsRight));
+		__m512i diff = _mm512_and_si512(_mm512_xor_si512(window, _mm512_set1_epi32((int)pPatternChunks[nChunk])),
+			_mm512_set1_epi32((int)pMaskChunks[nChunk]));
+		errors = _mm512_add_epi32(errors, _mm512_popcnt_epi32(diff));
+		if (_mm512_cmple_epu32_mask(errors, maxErrors) == 0) {
+			return 0;
+		}
+	}
+
+	return _mm512_cmple_epu32_mask(errors, maxErrors);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// CRegisterMatcher
+CRegisterMatcher::CRegisterMatcher(const TPatterns &patterns, EKernel kernel) {
+	m_kernel = (kernel == kernel_Auto)? GetBestKernel() : kernel;
+	if (!IsKernelSupported(m_kernel)) {
+		m_kernel = kernel_Scalar;
+	}
+	switch (m_kernel) {
+#ifdef REGISTER_MATCHER_AVX512
+	case kernel_Avx512:
+		m_pTestOffsets = TestOffsetsAvx512;
+		m_nLanesCount = 16;
+		break;
+#endif
+#ifdef REGISTER_MATCHER_AVX2
+	case kernel_Avx2:
+		m_pTestOffsets = TestOffsetsAvx2;
+		m_nLanesCount = 8;
+		break;
+#endif
+	default:
+		m_kernel = kernel_Scalar;
+		m_pTestOffsets = TestOffsetsScalar;
+		m_nLanesCount = 8;
+		break;
+	}
+
+	int nMaxLength = 0;
+	int idx;
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		const ::SPattern &pattern = patterns[idx];
+		SPattern compiled;
+		compiled.nLength = pattern.nLength;
+		compiled.nMaxErrors = pattern.nMaxErrors;
+		compiled.nChunksCount = (pattern.nLength + g_nChunkLength - 1) / g_nChunkLength;
+		compiled.nChunksOffset = (int)m_patternChunks.size();
+		m_patternChunks.insert(m_patternChunks.end(), compiled.nChunksCount, 0);
+		m_maskChunks.insert(m_maskChunks.end(), compiled.nChunksCount, 0);
+
+		int nBit;
+		for (nBit = 0; nBit < pattern.nLength; nBit++) {
+			int nChunk = compiled.nChunksOffset + nBit / g_nChunkLength;
+			TChunk bit = (TChunk)1 << (g_nChunkLength - 1 - nBit % g_nChunkLength);
+			if (GetBit(pattern, nBit) != 0) {
+				m_patternChunks[nChunk] |= bit;
+			}
+			if (GetMaskBit(pattern, nBit) != 0) {
+				m_maskChunks[nChunk] |= bit;
+			}
+		}
+
+		m_patterns.push_back(compiled);
+		nMaxLength = std::max(nMaxLength, pattern.nLength);
+	}
+
+	m_nHistoryBytes = nMaxLength / BITS_IN_BYTE + 1;
+	m_history.resize(m_nHistoryBytes + g_nBufferBytes + g_nPaddingBytes);
+	m_found.resize((int)patterns.size());
+	Reset();
+}
+
+void CRegisterMatcher::Reset() {
+	std::fill(m_history.begin(), m_history.end(), 0);
+	m_qwBitsCount = 0;
+	m_outputs.resize(0);
+}
+
+unsigned int CRegisterMatcher::GetMemoryUsage() const {
+	return (int)m_patterns.size() * sizeof(SPattern) + ((int)m_patternChunks.size() + (int)m_maskChunks.size()) * sizeof(TChunk) +
+		(int)m_history.size() + (int)m_found.size() * sizeof(unsigned int);
+}
+
+CRegisterMatcher::EKernel CRegisterMatcher::GetKernel() const {
+	return m_kernel;
+}
+
+bool CRegisterMatcher::IsKernelSupported(EKernel kernel) {
+	switch (kernel) {
+	case kernel_Auto:
+	case kernel_Scalar:
+		return true;
+	case kernel_Avx2:
+#if defined(REGISTER_MATCHER_DISPATCH)
+		return __builtin_cpu_supports("avx2") != 0;
+#elif defined(REGISTER_MATCHER_AVX2)
+		return true;
+#else
+		return false;
+#endif
+	case kernel_Avx512:
+#if defined(REGISTER_MATCHER_DISPATCH)
+		return __builtin_cpu_supports("avx512f") != 0 && __builtin_cpu_supports("avx512vpopcntdq") != 0;
+#elif defined(REGISTER_MATCHER_AVX512)
+		return true;
+#else
+		return false;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* CRegisterMatcher::GetKernelName(EKernel kernel) {
+	if (kernel == kernel_Auto) {
+		kernel = GetBestKernel();
+	}
+
+	switch (kernel) {
+	case kernel_Avx512:
+		return "AVX-512";
+	case kernel_Avx2:
+		return "AVX2";
+	default:
+		return "scalar";
+	}
+}
+
+// private
+CRegisterMatcher::EKernel CRegisterMatcher::GetBestKernel() {
+	if (IsKernelSupported(kernel_Avx512)) {
+		return kernel_Avx512;
+	} else if (IsKernelSupported(kernel_Avx2)) {
+		return kernel_Avx2;
+	}
+
+	return kernel_Scalar;
+}
+
+bool CRegisterMatcher::PushBlock(int nBlockOffset, int nBytes) {
+	const int nBits = nBytes * BITS_IN_BYTE;
+	const int nBlockBit = (m_nHistoryBytes + nBlockOffset) * BITS_IN_BYTE; // the block's first bit in the history
+	const unsigned char *pHistory = m_history.data();
+
+	bool fFound = false;
+	int idx;
+	for (idx = 0; idx < (int)m_patterns.size(); idx++) {
+		const SPattern &pattern = m_patterns[idx];
+		if (m_qwBitsCount + nBits < (uint64_t)pattern.nLength) { // no window fits yet
+			m_found[idx] = 0;
+			continue;
+		}
+
+		// the window ending at the o-th bit of the block begins at the bit nBlockBit + o + 1 - nLength
+		unsigned int dwFound = 0;
+		int nLane;
+		const TChunk *pPatternChunks = m_patternChunks.data() + pattern.nChunksOffset;
+		const TChunk *pMaskChunks = m_maskChunks.data() + pattern.nChunksOffset;
+		for (nLane = 0; nLane < nBits; nLane += m_nLanesCount) {
+			int nStart = nBlockBit + nLane + 1 - pattern.nLength;
+			dwFound |= m_pTestOffsets(pPatternChunks, pMaskChunks, pattern.nChunksCount, pattern.nMaxErrors,
+				pHistory + nStart / BITS_IN_BYTE, nStart % BITS_IN_BYTE) << nLane;
+		}
+
+		// the lanes beyond the block and the windows beginning before the data are dropped
+		if (nBits < g_nOffsetsAtOnce) {
+			dwFound &= (1u << nBits) - 1;
+		}
+		if (m_qwBitsCount + 1 < (uint64_t)pattern.nLength) {
+			dwFound &= ~((1u << (pattern.nLength - 1 - (int)m_qwBitsCount)) - 1);
+		}
+		m_found[idx] = dwFound;
+		if (dwFound != 0) {
+			fFound = true;
+		}
+	}
+	m_qwBitsCount += nBits;
+
+	if (!fFound) {
+		return false;
+	}
+
+	// the outputs of the earlier ends go first, as the bits are processed
+	m_outputs.resize(0);
+	int nEnd;
+	for (nEnd = 0; nEnd < nBits; nEnd++) {
+		for (idx = 0; idx < (int)m_patterns.size(); idx++) {
+			if ((m_found[idx] >> nEnd) & 0x01) {
+				const SPattern &pattern = m_patterns[idx];
+				int nStart = nBlockBit + nEnd + 1 - pattern.nLength;
+
+				SOutput output;
+				output.patternIdx = idx;
+				output.stepBack = pattern.nLength + nBits - 1 - nEnd;
+				output.errorsCount = CountErrors(pattern, pHistory + nStart / BITS_IN_BYTE, nStart % BITS_IN_BYTE);
+				m_outputs.push_back(output);
+			}
+		}
+	}
+
+	return true;
+}
+
+unsigned int CRegisterMatcher::CountErrors(const SPattern &pattern, const unsigned char *pStart, int nShift) const {
+	const TChunk *pPatternChunks = m_patternChunks.data() + pattern.nChunksOffset;
+	const TChunk *pMaskChunks = m_maskChunks.data() + pattern.nChunksOffset;
+	unsigned int dwErrors = 0;
+	int nChunk;
+	for (nChunk = 0; nChunk < pattern.nChunksCount; nChunk++) {
+		uint64_t qwWord = LoadBigEndian(pStart + nChunk * sizeof(TChunk));
+		TChunk window = (TChunk)((qwWord << nShift) >> g_nChunkLength);
+		dwErrors += Weight((window ^ pPatternChunks[nChunk]) & pMaskChunks[nChunk]);
+	}
+
+	return dwErrors;
+}
@@ -0,0 +1,124 @@
+#line 2 "RegisterMatcher.h" // Make __FILE__ omit the path
+
+#ifndef REGISTERMATCHER_H
+#define REGISTERMATCHER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Common.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CRegisterMatcher - the shift register search of the patterns with Hamming distance, vectorized.
+/// The input isn't shifted bit by bit: the windows ending at g_nOffsetsAtOnce consecutive bits are compared
+/// with a pattern at once. Each lane takes a 32-bit chunk of its window by two shifts of the same input
+/// word, the masked differences are counted by the vector popcount (VPOPCNTDQ with AVX-512, the nibble
+/// lookup with AVX2, the bit counting in scalar code otherwise), and the lanes are dropped together as soon
+/// as all of them exceed the errors. The kernel is chosen at run time by the processor (GCC and Clang on x86,
+/// the kernels are compiled for their targets), by the build's instruction set otherwise; a pass tests a
+/// single pattern. No tables are built, the cost depends on the patterns' total length
+/// only, so the matcher is the baseline and the fallback for the patterns too large for SearchFSM.
+/// The bits are processed MSB first, as in patterns; the outputs are the same as of CBitapMatcher, but are
+/// reported at the end of a block of g_nBlockBytes.
+class CRegisterMatcher {
+public:
+	typedef unsigned int TChunk;
+	static const int g_nChunkLength = 32;
+	static const int g_nOffsetsAtOnce = 32; // window ends tested for a pattern at once, by the kernel's lanes count
+	static const int g_nBlockBytes = g_nOffsetsAtOnce / BITS_IN_BYTE;
+
+	struct SOutput { // the same fields as of CSearchFsm::SOutput
+		unsigned int patternIdx;
+		unsigned int stepBack; // bits from the end of the processed data to the pattern's beginning
+		unsigned int errorsCount;
+	};
+	typedef SOutput TOutput;
+
+	enum EKernel {
+		kernel_Auto, // the fastest one supported
+		kernel_Scalar,
+		kernel_Avx2,
+		kernel_Avx512
+	};
+
+public: // constructor
+	CRegisterMatcher(const TPatterns &patterns, EKernel kernel = kernel_Auto); // the scalar one if unsupported
+
+public: // working methods
+	void Reset();
+
+	/// Push all the bytes of the buffer, the same as CSearchFsmByte::Scan
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink);
+
+public: // statistics
+	unsigned int GetMemoryUsage() const; // bytes
+	EKernel GetKernel() const;
+	static bool IsKernelSupported(EKernel kernel); // by the build and the processor
+	static const char* GetKernelName(EKernel kernel = kernel_Auto);
+
+private:
+	struct SPattern { // compiled pattern
+		int nLength;
+		int nMaxErrors;
+		int nChunksCount; // 32-bit chunks, MSB first, the bits beyond nLength are insignificant
+		int nChunksOffset; // in m_patternChunks and m_maskChunks
+	};
+
+	static const int g_nBufferBytes = 4096; // input copied after the history at once
+	static const int g_nPaddingBytes = sizeof(uint64_t); // input word loaded at the end of a window
+
+	// the kernel: a bit per lane, set if the window of the lane has the errors of the pattern at most
+	typedef unsigned int (*TTestOffsets)(const TChunk *pPatternChunks, const TChunk *pMaskChunks, int nChunksCount,
+		unsigned int dwMaxErrors, const unsigned char *pStart, int nShift);
+
+	static EKernel GetBestKernel();
+
+	bool PushBlock(int nBlockOffset, int nBytes); // true if something is found, see m_outputs
+	unsigned int CountErrors(const SPattern &pattern, const unsigned char *pStart, int nShift) const;
+
+private:
+	EKernel m_kernel;
+	TTestOffsets m_pTestOffsets;
+	int m_nLanesCount; // of the kernel, the offsets tested at once
+	std::vector<SPattern> m_patterns;
+	std::vector<TChunk> m_patternChunks;
+	std::vector<TChunk> m_maskChunks;
+	std::vector<unsigned char> m_history; // the last bytes before the buffer, the buffer and the padding
+	int m_nHistoryBytes; // the longest window with a byte to spare
+	uint64_t m_qwBitsCount; // processed, the windows aren't tested before the pattern fits
+	std::vector<unsigned int> m_found; // per pattern, bit o is set if the window ending at the o-th bit of the block matches
+	std::vector<SOutput> m_outputs; // of the last block, ordered by the end position, then by the pattern
+};
+
+// implementation
+template <class TSink>
+void CRegisterMatcher::Scan(const unsigned char *pData, size_t nBytes, TSink &sink) {
+	size_t nProcessed = 0;
+	while (nProcessed < nBytes) {
+		int nBuffer = (int)std::min(nBytes - nProcessed, (size_t)g_nBufferBytes);
+		unsigned char *pBuffer = m_history.data() + m_nHistoryBytes;
+		memcpy(pBuffer, pData + nProcessed, nBuffer);
+
+		int nBlock;
+		for (nBlock = 0; nBlock < nBuffer; nBlock += g_nBlockBytes) {
+			int nBlockBytes = std::min(nBuffer - nBlock, g_nBlockBytes);
+			if (PushBlock(nBlock, nBlockBytes)) { // rare case - found something
+				uint64_t qwBitsProcessed = ((uint64_t)nProcessed + nBlock + nBlockBytes) * BITS_IN_BYTE;
+				int nOutput;
+				for (nOutput = 0; nOutput < (int)m_outputs.size(); nOutput++) {
+					sink(qwBitsProcessed, m_outputs[nOutput]);
+				}
+			}
+		}
+
+		// the last bytes are the history of the next buffer
+		memmove(m_history.data(), pBuffer + nBuffer - m_nHistoryBytes, m_nHistoryBytes);
+		nProcessed += nBuffer;
+	}
+}
+
+#endif // REGISTERMATCHER_H
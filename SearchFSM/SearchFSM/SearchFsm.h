@@ -3,10 +3,29 @@
 #ifndef SEARCHFSM_H
 #define SEARCHFSM_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifndef ASSERT
 #define ASSERT(x)
 #endif
 
+#ifndef BITS_IN_BYTE
+#define BITS_IN_BYTE 8
+#endif
+
+// software prefetch hint (used by the interleaved scanning)
+#ifndef SEARCHFSM_PREFETCH
+#if defined(__GNUC__)
+#define SEARCHFSM_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define SEARCHFSM_PREFETCH(p) _mm_prefetch((const char *)(p), _MM_HINT_T0)
+#else
+#define SEARCHFSM_PREFETCH(p)
+#endif
+#endif
+
 
 //////////////////////////////////////////////////////////////////////////
 /// \brief CSearchFsm<TStateIdx, TOutputIdx, TPatternIdx, TStepBack, TErrorsCount> class - template for SearchFSM
@@ -18,6 +37,7 @@ public:
 	typedef TOutputIdx_ TOutputIdx;
 
 	static const TOutputIdx sm_outputNull = (TOutputIdx)(-1);
+	static const int g_nBitsAtOnce = 1;
 	static const int g_nColumnsCount = 2;
 
 	// FSM table structures
@@ -27,6 +47,14 @@ public:
 	};
 	struct STableRow {
 		STableCell cell0, cell1;
+
+		// uniform access to the cells (as in CSearchFsmByte)
+		const STableCell& GetCell(int nColumn) const {
+			return (nColumn == 0)? cell0 : cell1;
+		}
+		STableCell& GetCell(int nColumn) {
+			return (nColumn == 0)? cell0 : cell1;
+		}
 	};
 
 	// Output table structures
@@ -67,15 +95,52 @@ public: // working methods
 		return cell.idxOutput;
 	}
 
+	/// Push all the bits of the buffer, MSB of each byte first (as GetHiBit does).
+	/// For every found pattern sink(qwBitsProcessed, output) is called, where qwBitsProcessed counts bits
+	/// from the beginning of the buffer up to the current one inclusive.
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink) {
+		const STableRow *pRows = m_table.pTableRows;
+		TStateIdx state = m_state;
+		size_t idx;
+		for (idx = 0; idx < nBytes; idx++) {
+			const unsigned int dwByte = pData[idx];
+			int nBit;
+			for (nBit = 0; nBit < BITS_IN_BYTE; nBit++) {
+				const STableRow &row = pRows[state];
+				const STableCell &cell = ((dwByte >> (BITS_IN_BYTE - nBit - 1)) & 0x01)? row.cell1 : row.cell0;
+				state = cell.idxNextState;
+				if (cell.idxOutput != sm_outputNull) { // rare case - found something
+					PutOutputs(cell.idxOutput, (uint64_t)idx * BITS_IN_BYTE + nBit + 1, sink);
+				}
+			}
+		}
+		m_state = state;
+	}
+
 	TStateIdx GetState() const {
 		return m_state;
 	}
 
+	const STable& GetTable() const {
+		return m_table;
+	}
+
 	const SOutput& GetOutput(TOutputIdx idxOutput) const {
 		ASSERT(idxOutput<m_table.outputsCount);
 		return m_table.pOutputs[idxOutput];
 	}
 
+private:
+	template <class TSink>
+	void PutOutputs(TOutputIdx idxOutput, uint64_t qwBitsProcessed, TSink &sink) const {
+		while (idxOutput != sm_outputNull) {
+			const SOutput &output = m_table.pOutputs[idxOutput];
+			sink(qwBitsProcessed, output);
+			idxOutput = output.idxNextOutput;
+		}
+	}
+
 private:
 	const STable m_table;
 	TStateIdx m_state;
@@ -105,6 +170,13 @@ public:
 	// FSM table structures
 	struct STableRow {
 		TTableCell cells[g_nColumnsCount];
+
+		const TTableCell& GetCell(int nColumn) const {
+			return cells[nColumn];
+		}
+		TTableCell& GetCell(int nColumn) {
+			return cells[nColumn];
+		}
 	};
 
 	// Whole automaton table structure
@@ -133,15 +205,127 @@ public: // working methods
 		return cell.idxOutput;
 	}
 
+	/// Push all the bytes of the buffer by nBitsAtOnce-bit symbols, MSBs of each byte first.
+	/// nBitsAtOnce must divide BITS_IN_BYTE. For every found pattern sink(qwBitsProcessed, output) is called,
+	/// where qwBitsProcessed counts bits from the beginning of the buffer up to the current symbol inclusive.
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink) {
+		typedef char TStrideCheck[(BITS_IN_BYTE % nBitsAtOnce == 0)? 1 : -1];
+		const int g_nSymbolsInByte = BITS_IN_BYTE / nBitsAtOnce;
+
+		const STableRow *pRows = m_table.pTableRows;
+		TStateIdx state = m_state;
+		size_t idx;
+		for (idx = 0; idx < nBytes; idx++) {
+			const unsigned int dwByte = pData[idx];
+			int nSymbol;
+			for (nSymbol = 0; nSymbol < g_nSymbolsInByte; nSymbol++) {
+				const int nShift = BITS_IN_BYTE - (nSymbol + 1) * nBitsAtOnce;
+				const TTableCell &cell = pRows[state].cells[(dwByte >> nShift) & g_dwByteMask];
+				state = cell.idxNextState;
+				if (cell.idxOutput != sm_outputNull) { // rare case - found something
+					PutOutputs(cell.idxOutput, (uint64_t)idx * BITS_IN_BYTE + (nSymbol + 1) * nBitsAtOnce, sink);
+				}
+			}
+		}
+		m_state = state;
+		(void)sizeof(TStrideCheck);
+	}
+
+	/// Push nStreams independent buffers of the same length over the same table in lockstep.
+	/// Lookups of different streams don't depend on each other, so their loads overlap and the table
+	/// access latency is hidden; fPrefetch additionally prefetches the cells for the next byte.
+	/// pStates holds the current state of each stream (in-out), sink(nStream, qwBitsProcessed, output)
+	/// is called for every found pattern, qwBitsProcessed is counted as in Scan.
+	template <int nStreams, bool fPrefetch, class TSink>
+	static void ScanInterleaved(const STable &table, /* in-out */ TStateIdx *pStates,
+		const unsigned char *const *ppData, size_t nBytes, TSink &sink)
+	{
+		typedef char TStrideCheck[(BITS_IN_BYTE % nBitsAtOnce == 0)? 1 : -1];
+		const int g_nSymbolsInByte = BITS_IN_BYTE / nBitsAtOnce;
+
+		const STableRow *pRows = table.pTableRows;
+		TStateIdx states[nStreams];
+		int nStream;
+		for (nStream = 0; nStream < nStreams; nStream++) {
+			states[nStream] = pStates[nStream];
+		}
+
+		size_t idx;
+		for (idx = 0; idx < nBytes; idx++) {
+			int nSymbol;
+			for (nSymbol = 0; nSymbol < g_nSymbolsInByte; nSymbol++) {
+				const int nShift = BITS_IN_BYTE - (nSymbol + 1) * nBitsAtOnce;
+				// all the loads of the step are issued before any of them is used
+				TOutputIdx outputs[nStreams];
+				for (nStream = 0; nStream < nStreams; nStream++) {
+					const unsigned int dwSymbol = (ppData[nStream][idx] >> nShift) & g_dwByteMask;
+					const TTableCell &cell = pRows[states[nStream]].cells[dwSymbol];
+					states[nStream] = cell.idxNextState;
+					outputs[nStream] = cell.idxOutput;
+				}
+
+				if (fPrefetch && idx + 1 < nBytes && nShift == 0) { // cells for the first symbol of the next byte
+					for (nStream = 0; nStream < nStreams; nStream++) {
+						const unsigned int dwSymbol = (ppData[nStream][idx + 1] >> (BITS_IN_BYTE - nBitsAtOnce)) & g_dwByteMask;
+						SEARCHFSM_PREFETCH(&pRows[states[nStream]].cells[dwSymbol]);
+					}
+				}
+
+				for (nStream = 0; nStream < nStreams; nStream++) {
+					if (outputs[nStream] != sm_outputNull) { // rare case - found something
+						SStreamSink<TSink> streamSink = {sink, nStream};
+						PutOutputs(table, outputs[nStream], (uint64_t)idx * BITS_IN_BYTE + (nSymbol + 1) * nBitsAtOnce, streamSink);
+					}
+				}
+			}
+		}
+
+		for (nStream = 0; nStream < nStreams; nStream++) {
+			pStates[nStream] = states[nStream];
+		}
+		(void)sizeof(TStrideCheck);
+	}
+
 	TStateIdx GetState() const {
 		return m_state;
 	}
 
+	const STable& GetTable() const {
+		return m_table;
+	}
+
 	const TOutput& GetOutput(TOutputIdx idxOutput) const {
 		ASSERT(idxOutput<m_table.outputsCount);
 		return m_table.pOutputs[idxOutput];
 	}
 
+private:
+	// adapter passing stream number to the sink of ScanInterleaved
+	template <class TSink>
+	struct SStreamSink {
+		TSink &sink;
+		int nStream;
+
+		void operator()(uint64_t qwBitsProcessed, const TOutput &output) {
+			sink(nStream, qwBitsProcessed, output);
+		}
+	};
+
+	template <class TSink>
+	void PutOutputs(TOutputIdx idxOutput, uint64_t qwBitsProcessed, TSink &sink) const {
+		PutOutputs(m_table, idxOutput, qwBitsProcessed, sink);
+	}
+
+	template <class TSink>
+	static void PutOutputs(const STable &table, TOutputIdx idxOutput, uint64_t qwBitsProcessed, TSink &sink) {
+		while (idxOutput != sm_outputNull) {
+			const TOutput &output = table.pOutputs[idxOutput];
+			sink(qwBitsProcessed, output);
+			idxOutput = output.idxNextOutput;
+		}
+	}
+
 private:
 	const STable m_table;
 	TStateIdx m_state;
@@ -0,0 +1,138 @@
+#line 2 "SearchFsmAuto.h" // Make __FILE__ omit the path
+
+#ifndef SEARCHFSMAUTO_H
+#define SEARCHFSMAUTO_H
+
+#include <memory>
+
+#include "FsmCreator.h"
+#include "SearchFsm.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CSearchFsmAuto<nBitsAtOnce> - byte SearchFSM with the narrowest index types.
+/// The tables are built with the widest types, then the narrowest types able to hold the actual maxima
+/// are chosen and the tables are converted. The concrete CSearchFsmByte instantiation is hidden, it is
+/// passed to a visitor by Dispatch, so the hot loop runs on the concrete type without any dispatching.
+/// The state and output indices are chosen independently; the cold output fields (pattern index, step back
+/// and errors count) share the widest of their three sizes to keep the number of instantiations sane.
+template <int nBitsAtOnce>
+class CSearchFsmAuto {
+public:
+	typedef CSearchFsmByte<nBitsAtOnce> TSearchFsmWide;
+
+	template <class TStateIdx, class TOutputIdx, class TPayload>
+	struct STypes {
+		typedef CSearchFsmByte<nBitsAtOnce, TStateIdx, TOutputIdx, TPayload, TPayload, TPayload> TSearchFsm;
+	};
+
+public: // constructor
+	CSearchFsmAuto(const CFsmCreator &creator, CFsmCreator::EBitOrder bitOrder = CFsmCreator::bitOrder_MsbFirst) {
+		CFsmCreator::SFsmWrap<TSearchFsmWide> wrapWide = creator.CreateByteFsmWrap<TSearchFsmWide>(bitOrder);
+		m_sizes = CFsmCreator::GetIndexSizes(wrapWide);
+		SCreator functor = {&wrapWide, NULL};
+		DispatchTypes(functor);
+		m_pHolder = std::shared_ptr<SHolderBase>(functor.pHolder);
+	}
+
+public: // working methods
+	/// call visitor(CFsmCreator::SFsmWrap<TSearchFsm> &wrap) for the concrete TSearchFsm
+	template <class TVisitor>
+	void Dispatch(TVisitor &visitor) {
+		SVisit<TVisitor> functor = {m_pHolder.get(), &visitor};
+		DispatchTypes(functor);
+	}
+
+	const CFsmCreator::SIndexSizes& GetIndexSizes() const {
+		return m_sizes;
+	}
+
+	int GetPayloadSize() const {
+		return std::max(m_sizes.nPatternIdxSize, std::max(m_sizes.nStepBackSize, m_sizes.nErrorsCountSize));
+	}
+
+private:
+	struct SHolderBase {
+		virtual ~SHolderBase() {}
+	};
+
+	template <class TSearchFsm>
+	struct SHolder: public SHolderBase {
+		SHolder(const CFsmCreator::SFsmWrap<TSearchFsm> &wrap_): wrap(wrap_) {}
+		CFsmCreator::SFsmWrap<TSearchFsm> wrap;
+	};
+
+	// functor converting the wide tables to the chosen types
+	struct SCreator {
+		const CFsmCreator::SFsmWrap<TSearchFsmWide> *pWrapWide;
+		SHolderBase *pHolder;
+
+		template <class TSearchFsm>
+		void operator()(TSearchFsm *) {
+			pHolder = new SHolder<TSearchFsm>(CFsmCreator::ConvertFsmWrap<TSearchFsm>(*pWrapWide));
+		}
+	};
+
+	// functor passing the concrete tables to the visitor
+	template <class TVisitor>
+	struct SVisit {
+		SHolderBase *pHolder;
+		TVisitor *pVisitor;
+
+		template <class TSearchFsm>
+		void operator()(TSearchFsm *) {
+			(*pVisitor)(static_cast<SHolder<TSearchFsm>*>(pHolder)->wrap);
+		}
+	};
+
+	// three-level dispatching: state index, output index, payload
+	template <class TFunctor>
+	void DispatchTypes(TFunctor &functor) const {
+		switch (m_sizes.nStateIdxSize) {
+		case 1:
+			DispatchOutputIdx<unsigned char>(functor);
+			break;
+		case 2:
+			DispatchOutputIdx<unsigned short>(functor);
+			break;
+		default:
+			DispatchOutputIdx<unsigned int>(functor);
+			break;
+		}
+	}
+
+	template <class TStateIdx, class TFunctor>
+	void DispatchOutputIdx(TFunctor &functor) const {
+		switch (m_sizes.nOutputIdxSize) {
+		case 1:
+			DispatchPayload<TStateIdx, unsigned char>(functor);
+			break;
+		case 2:
+			DispatchPayload<TStateIdx, unsigned short>(functor);
+			break;
+		default:
+			DispatchPayload<TStateIdx, unsigned int>(functor);
+			break;
+		}
+	}
+
+	template <class TStateIdx, class TOutputIdx, class TFunctor>
+	void DispatchPayload(TFunctor &functor) const {
+		switch (GetPayloadSize()) {
+		case 1:
+			functor((typename STypes<TStateIdx, TOutputIdx, unsigned char>::TSearchFsm *)NULL);
+			break;
+		case 2:
+			functor((typename STypes<TStateIdx, TOutputIdx, unsigned short>::TSearchFsm *)NULL);
+			break;
+		default:
+			functor((typename STypes<TStateIdx, TOutputIdx, unsigned int>::TSearchFsm *)NULL);
+			break;
+		}
+	}
+
+private:
+	CFsmCreator::SIndexSizes m_sizes;
+	std::shared_ptr<SHolderBase> m_pHolder;
+};
+
+#endif // SEARCHFSMAUTO_H
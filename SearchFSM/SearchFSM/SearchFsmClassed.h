@@ -0,0 +1,115 @@
+#line 2 "SearchFsmClassed.h" // Make __FILE__ omit the path
+
+#ifndef SEARCHFSMCLASSED_H
+#define SEARCHFSMCLASSED_H
+
+#include "SearchFsm.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CSearchFsmClassed<nBitsAtOnce, TStateIdx, TOutputIdx, TPatternIdx, TStepBack, TErrorsCount>
+/// byte SearchFSM with input symbol equivalence classes.
+/// The symbols having identical columns in the whole table (typical for masked patterns) form a class,
+/// so the rows are only nClassesCount cells wide. Each step takes one more lookup in the small class
+/// map (2^nBitsAtOnce bytes), which always stays in the cache.
+template <const int nBitsAtOnce, class TStateIdx_ = unsigned int, class TOutputIdx_ = unsigned int,
+	class TPatternIdx = unsigned int, class TStepBack = unsigned int, class TErrorsCount = unsigned int>
+class CSearchFsmClassed {
+public:
+	typedef TStateIdx_ TStateIdx;
+	typedef TOutputIdx_ TOutputIdx;
+	typedef unsigned char TClassIdx; // there are at most 256 classes for an octet
+
+	static const TOutputIdx sm_outputNull = (TOutputIdx)(-1);
+	static const int g_nBitsAtOnce = nBitsAtOnce;
+	static const int g_nColumnsCount = (1 << nBitsAtOnce); // symbols count, not classes count
+	static const unsigned int g_dwByteMask = g_nColumnsCount - 1;
+
+	// alias to the similar CSearchFsm and its types
+	typedef CSearchFsm<TStateIdx, TOutputIdx, TPatternIdx, TStepBack, TErrorsCount> TSearchFsm;
+	typedef typename TSearchFsm::STableCell TTableCell;
+	typedef typename TSearchFsm::SOutput TOutput;
+
+	// Whole automaton table structure
+	struct STable {
+		const TClassIdx *pSymbolClasses; // g_nColumnsCount elements
+		const TTableCell *pCells; // statesCount rows of nClassesCount cells
+		const TOutput *pOutputs;
+		TStateIdx statesCount;
+		TOutputIdx outputsCount;
+		int nClassesCount;
+	};
+
+public: // constructor
+	CSearchFsmClassed(const STable &table): m_table(table) {
+		Reset();
+	}
+
+public: // working methods
+	void Reset(TStateIdx state = 0) {
+		ASSERT(state < m_table.statesCount);
+		m_state = state;
+	}
+
+	TOutputIdx PushByte(unsigned int dwValue) {
+		const TTableCell &cell = m_table.pCells[m_state * m_table.nClassesCount +
+			m_table.pSymbolClasses[dwValue & g_dwByteMask]];
+		m_state = cell.idxNextState;
+		return cell.idxOutput;
+	}
+
+	/// Push all the bytes of the buffer, the same as CSearchFsmByte::Scan
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink) {
+		typedef char TStrideCheck[(BITS_IN_BYTE % nBitsAtOnce == 0)? 1 : -1];
+		const int g_nSymbolsInByte = BITS_IN_BYTE / nBitsAtOnce;
+
+		const TClassIdx *pSymbolClasses = m_table.pSymbolClasses;
+		const TTableCell *pCells = m_table.pCells;
+		const size_t nClassesCount = m_table.nClassesCount;
+		TStateIdx state = m_state;
+		size_t idx;
+		for (idx = 0; idx < nBytes; idx++) {
+			const unsigned int dwByte = pData[idx];
+			int nSymbol;
+			for (nSymbol = 0; nSymbol < g_nSymbolsInByte; nSymbol++) {
+				const int nShift = BITS_IN_BYTE - (nSymbol + 1) * nBitsAtOnce;
+				const TTableCell &cell = pCells[state * nClassesCount + pSymbolClasses[(dwByte >> nShift) & g_dwByteMask]];
+				state = cell.idxNextState;
+				if (cell.idxOutput != sm_outputNull) { // rare case - found something
+					PutOutputs(cell.idxOutput, (uint64_t)idx * BITS_IN_BYTE + (nSymbol + 1) * nBitsAtOnce, sink);
+				}
+			}
+		}
+		m_state = state;
+		(void)sizeof(TStrideCheck);
+	}
+
+	TStateIdx GetState() const {
+		return m_state;
+	}
+
+	const STable& GetTable() const {
+		return m_table;
+	}
+
+	const TOutput& GetOutput(TOutputIdx idxOutput) const {
+		ASSERT(idxOutput<m_table.outputsCount);
+		return m_table.pOutputs[idxOutput];
+	}
+
+private:
+	template <class TSink>
+	void PutOutputs(TOutputIdx idxOutput, uint64_t qwBitsProcessed, TSink &sink) const {
+		while (idxOutput != sm_outputNull) {
+			const TOutput &output = m_table.pOutputs[idxOutput];
+			sink(qwBitsProcessed, output);
+			idxOutput = output.idxNextOutput;
+		}
+	}
+
+private:
+	const STable m_table;
+	TStateIdx m_state;
+};
+
+#endif // SEARCHFSMCLASSED_H
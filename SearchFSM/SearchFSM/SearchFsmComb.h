@@ -0,0 +1,146 @@
+#line 2 "SearchFsmComb.h" // Make __FILE__ omit the path
+
+#ifndef SEARCHFSMCOMB_H
+#define SEARCHFSMCOMB_H
+
+#include "SearchFsm.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CSearchFsmComb<nBitsAtOnce, TStateIdx, TOutputIdx, TPatternIdx, TStepBack, TErrorsCount>
+/// byte SearchFSM with comb-compressed (double-array) transition table for FSMs too large for dense rows.
+/// Each state has a default row - one of a few dense rows shared by many states - and the exceptions:
+/// the cells differing from the default row. The exceptions of all the states are packed into a single
+/// comb array: the cell for the symbol c of the state with base b is pCombCells[b + c], if its check is b.
+/// Every state has its own base, so the base identifies the state; the running state is the pair
+/// (base, default row offset), and the cells hold the pairs of the next states. Thus a step takes at most
+/// two memory accesses: the comb cell and, if it doesn't belong to the state, the default row cell.
+/// The state index is restored from the base by a separate map, for GetState only.
+template <const int nBitsAtOnce, class TStateIdx_ = unsigned int, class TOutputIdx_ = unsigned int,
+	class TPatternIdx = unsigned int, class TStepBack = unsigned int, class TErrorsCount = unsigned int>
+class CSearchFsmComb {
+public:
+	typedef TStateIdx_ TStateIdx; // used for bases and default row offsets too, CreateCombFsmWrap checks they fit
+	typedef TOutputIdx_ TOutputIdx;
+
+	static const TOutputIdx sm_outputNull = (TOutputIdx)(-1);
+	static const TStateIdx sm_checkNull = (TStateIdx)(-1); // unused comb cell
+	static const int g_nBitsAtOnce = nBitsAtOnce;
+	static const int g_nColumnsCount = (1 << nBitsAtOnce);
+	static const unsigned int g_dwByteMask = g_nColumnsCount - 1;
+
+	// alias to the similar CSearchFsm and its types
+	typedef CSearchFsm<TStateIdx, TOutputIdx, TPatternIdx, TStepBack, TErrorsCount> TSearchFsm;
+	typedef typename TSearchFsm::SOutput TOutput;
+
+	// the next state is given by its base and default row offset
+	struct SDefaultCell {
+		TStateIdx base;
+		TStateIdx defaultRow; // offset of the default row in pDefaultCells
+		TOutputIdx idxOutput;
+	};
+
+	struct SCombCell {
+		TStateIdx check; // base of the state owning the cell or sm_checkNull
+		TStateIdx base;
+		TStateIdx defaultRow;
+		TOutputIdx idxOutput;
+	};
+
+	struct SStateInfo { // for Reset only
+		TStateIdx base;
+		TStateIdx defaultRow;
+	};
+
+	// Whole automaton table structure
+	struct STable {
+		const SCombCell *pCombCells; // combCellsCount elements, (max base + g_nColumnsCount)
+		const SDefaultCell *pDefaultCells; // defaultRowsCount rows of g_nColumnsCount cells
+		const SStateInfo *pStates;
+		const TStateIdx *pBaseStates; // state of each base, (max base + 1) elements
+		const TOutput *pOutputs;
+		TStateIdx statesCount;
+		TOutputIdx outputsCount;
+		unsigned int combCellsCount;
+		unsigned int defaultRowsCount;
+	};
+
+public: // constructor
+	CSearchFsmComb(const STable &table): m_table(table) {
+		Reset();
+	}
+
+public: // working methods
+	void Reset(TStateIdx state = 0) {
+		ASSERT(state < m_table.statesCount);
+		m_base = m_table.pStates[state].base;
+		m_defaultRow = m_table.pStates[state].defaultRow;
+	}
+
+	/// Push all the bytes of the buffer, the same as CSearchFsmByte::Scan
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink) {
+		typedef char TStrideCheck[(BITS_IN_BYTE % nBitsAtOnce == 0)? 1 : -1];
+		const int g_nSymbolsInByte = BITS_IN_BYTE / nBitsAtOnce;
+
+		const SCombCell *pCombCells = m_table.pCombCells;
+		const SDefaultCell *pDefaultCells = m_table.pDefaultCells;
+		TStateIdx base = m_base, defaultRow = m_defaultRow;
+		size_t idx;
+		for (idx = 0; idx < nBytes; idx++) {
+			const unsigned int dwByte = pData[idx];
+			int nSymbol;
+			for (nSymbol = 0; nSymbol < g_nSymbolsInByte; nSymbol++) {
+				const int nShift = BITS_IN_BYTE - (nSymbol + 1) * nBitsAtOnce;
+				const unsigned int dwSymbol = (dwByte >> nShift) & g_dwByteMask;
+				const SCombCell &cell = pCombCells[base + dwSymbol];
+				TOutputIdx idxOutput;
+				if (cell.check == base) { // exception
+					base = cell.base;
+					defaultRow = cell.defaultRow;
+					idxOutput = cell.idxOutput;
+				} else { // the default row
+					const SDefaultCell &cellDefault = pDefaultCells[defaultRow + dwSymbol];
+					base = cellDefault.base;
+					defaultRow = cellDefault.defaultRow;
+					idxOutput = cellDefault.idxOutput;
+				}
+				if (idxOutput != sm_outputNull) { // rare case - found something
+					PutOutputs(idxOutput, (uint64_t)idx * BITS_IN_BYTE + (nSymbol + 1) * nBitsAtOnce, sink);
+				}
+			}
+		}
+		m_base = base;
+		m_defaultRow = defaultRow;
+		(void)sizeof(TStrideCheck);
+	}
+
+	TStateIdx GetState() const {
+		return m_table.pBaseStates[m_base];
+	}
+
+	const STable& GetTable() const {
+		return m_table;
+	}
+
+	const TOutput& GetOutput(TOutputIdx idxOutput) const {
+		ASSERT(idxOutput<m_table.outputsCount);
+		return m_table.pOutputs[idxOutput];
+	}
+
+private:
+	template <class TSink>
+	void PutOutputs(TOutputIdx idxOutput, uint64_t qwBitsProcessed, TSink &sink) const {
+		while (idxOutput != sm_outputNull) {
+			const TOutput &output = m_table.pOutputs[idxOutput];
+			sink(qwBitsProcessed, output);
+			idxOutput = output.idxNextOutput;
+		}
+	}
+
+private:
+	const STable m_table;
+	TStateIdx m_base;
+	TStateIdx m_defaultRow;
+};
+
+#endif // SEARCHFSMCOMB_H
@@ -0,0 +1,143 @@
+#line 2 "SearchFsmSplit.h" // Make __FILE__ omit the path
+
+#ifndef SEARCHFSMSPLIT_H
+#define SEARCHFSMSPLIT_H
+
+#include "SearchFsm.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CSearchFsmSplit<nBitsAtOnce, TStateIdx, TOutputIdx, TPatternIdx, TStepBack, TErrorsCount>
+/// byte SearchFSM with hot and cold parts of the table split.
+/// The hot table holds the next state indexes only, the transitions having an output are marked by the
+/// high bit of the index (sm_flagOutput). Their outputs are stored in the cold table: (symbol, output)
+/// pairs sorted by the symbol, per state. So the scanning touches half of the memory per step, and the
+/// cold table is read only when something is found. The states count must be less than sm_flagOutput
+/// (CreateSplitFsmWrap refuses to build otherwise).
+template <const int nBitsAtOnce, class TStateIdx_ = unsigned int, class TOutputIdx_ = unsigned int,
+	class TPatternIdx = unsigned int, class TStepBack = unsigned int, class TErrorsCount = unsigned int>
+class CSearchFsmSplit {
+public:
+	typedef TStateIdx_ TStateIdx;
+	typedef TOutputIdx_ TOutputIdx;
+
+	static const TOutputIdx sm_outputNull = (TOutputIdx)(-1);
+	static const TStateIdx sm_flagOutput = (TStateIdx)((TStateIdx)1 << (sizeof(TStateIdx) * BITS_IN_BYTE - 1));
+	static const TStateIdx sm_stateMask = (TStateIdx)~sm_flagOutput;
+	static const int g_nBitsAtOnce = nBitsAtOnce;
+	static const int g_nColumnsCount = (1 << nBitsAtOnce);
+	static const unsigned int g_dwByteMask = g_nColumnsCount - 1;
+
+	// alias to the similar CSearchFsm and its types
+	typedef CSearchFsm<TStateIdx, TOutputIdx, TPatternIdx, TStepBack, TErrorsCount> TSearchFsm;
+	typedef typename TSearchFsm::SOutput TOutput;
+
+	// cold table cell - the output of the transition
+	struct SOutputRef {
+		unsigned char symbol;
+		TOutputIdx idxOutput;
+	};
+
+	// Whole automaton table structure
+	struct STable {
+		const TStateIdx *pNextStates; // hot table, statesCount rows of g_nColumnsCount cells
+		const unsigned int *pOutputRefsStarts; // statesCount + 1 elements, the state's refs are [start[s], start[s + 1])
+		const SOutputRef *pOutputRefs; // cold table, outputRefsCount elements
+		const TOutput *pOutputs;
+		TStateIdx statesCount;
+		TOutputIdx outputsCount;
+		unsigned int outputRefsCount;
+	};
+
+public: // constructor
+	CSearchFsmSplit(const STable &table): m_table(table) {
+		Reset();
+	}
+
+public: // working methods
+	void Reset(TStateIdx state = 0) {
+		ASSERT(state < m_table.statesCount);
+		m_state = state;
+	}
+
+	TOutputIdx PushByte(unsigned int dwValue) {
+		const unsigned int dwSymbol = dwValue & g_dwByteMask;
+		const TStateIdx next = m_table.pNextStates[(size_t)m_state * g_nColumnsCount + dwSymbol];
+		TOutputIdx idxOutput = sm_outputNull;
+		if (next & sm_flagOutput) {
+			idxOutput = FindOutput(m_state, dwSymbol);
+		}
+		m_state = next & sm_stateMask;
+		return idxOutput;
+	}
+
+	/// Push all the bytes of the buffer, the same as CSearchFsmByte::Scan
+	template <class TSink>
+	void Scan(const unsigned char *pData, size_t nBytes, TSink &sink) {
+		typedef char TStrideCheck[(BITS_IN_BYTE % nBitsAtOnce == 0)? 1 : -1];
+		const int g_nSymbolsInByte = BITS_IN_BYTE / nBitsAtOnce;
+
+		const TStateIdx *pNextStates = m_table.pNextStates;
+		TStateIdx state = m_state;
+		size_t idx;
+		for (idx = 0; idx < nBytes; idx++) {
+			const unsigned int dwByte = pData[idx];
+			int nSymbol;
+			for (nSymbol = 0; nSymbol < g_nSymbolsInByte; nSymbol++) {
+				const int nShift = BITS_IN_BYTE - (nSymbol + 1) * nBitsAtOnce;
+				const unsigned int dwSymbol = (dwByte >> nShift) & g_dwByteMask;
+				const TStateIdx next = pNextStates[(size_t)state * g_nColumnsCount + dwSymbol];
+				if (next & sm_flagOutput) { // rare case - found something
+					PutOutputs(FindOutput(state, dwSymbol), (uint64_t)idx * BITS_IN_BYTE + (nSymbol + 1) * nBitsAtOnce, sink);
+				}
+				state = next & sm_stateMask;
+			}
+		}
+		m_state = state;
+		(void)sizeof(TStrideCheck);
+	}
+
+	TStateIdx GetState() const {
+		return m_state;
+	}
+
+	const STable& GetTable() const {
+		return m_table;
+	}
+
+	const TOutput& GetOutput(TOutputIdx idxOutput) const {
+		ASSERT(idxOutput<m_table.outputsCount);
+		return m_table.pOutputs[idxOutput];
+	}
+
+private:
+	TOutputIdx FindOutput(TStateIdx state, unsigned int dwSymbol) const {
+		// binary search in the state's refs, the flagged transition always has one
+		unsigned int dwLow = m_table.pOutputRefsStarts[state];
+		unsigned int dwHigh = m_table.pOutputRefsStarts[state + 1];
+		while (dwHigh - dwLow > 1) {
+			unsigned int dwMiddle = (dwLow + dwHigh) / 2;
+			if (m_table.pOutputRefs[dwMiddle].symbol <= dwSymbol) {
+				dwLow = dwMiddle;
+			} else {
+				dwHigh = dwMiddle;
+			}
+		}
+		ASSERT(m_table.pOutputRefs[dwLow].symbol == dwSymbol);
+		return m_table.pOutputRefs[dwLow].idxOutput;
+	}
+
+	template <class TSink>
+	void PutOutputs(TOutputIdx idxOutput, uint64_t qwBitsProcessed, TSink &sink) const {
+		while (idxOutput != sm_outputNull) {
+			const TOutput &output = m_table.pOutputs[idxOutput];
+			sink(qwBitsProcessed, output);
+			idxOutput = output.idxNextOutput;
+		}
+	}
+
+private:
+	const STable m_table;
+	TStateIdx m_state;
+};
+
+#endif // SEARCHFSMSPLIT_H
@@ -0,0 +1,283 @@
+#line 2 "BenchmarkRunner.cpp" // Make __FILE__ omit the path
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "BenchmarkRunner.h"
+
+//////////////////////////////////////////////////////////////////////////
+// CBenchmarkRunner
+CBenchmarkRunner::CBenchmarkRunner(const SSettings &settings): m_settings(settings), m_nRunsDone(0) {
+	m_settings.nWarmUpRuns = std::max(m_settings.nWarmUpRuns, 0);
+	m_settings.nRuns = std::max(m_settings.nRuns, 1);
+	Start(std::string());
+}
+
+void CBenchmarkRunner::Start(const std::string &sEngine) {
+	SStatistics statZero = {0, 0, 0, 0, 0};
+	m_result.sEngine = sEngine;
+	m_result.fSuccess = false;
+	m_result.nRuns = 0;
+	m_result.performance.fSuccess = false;
+	m_result.statInitialization = statZero;
+	m_result.statOperating = statZero;
+	m_result.statOperatingCpu = statZero;
+	m_result.statOperatingUser = statZero;
+	m_result.statOperatingKernel = statZero;
+	m_nRunsDone = 0;
+	m_runs.clear();
+}
+
+bool CBenchmarkRunner::AddRun(bool fSuccess, const CFsmTest::SEnginePerformance &performance) {
+	m_nRunsDone++;
+	bool fStable = m_runs.empty() || m_runs.front().qwHits == performance.qwHits;
+	if (!fSuccess || !performance.fSuccess || !fStable) { // no more runs
+		m_result.fSuccess = false;
+		m_result.nRuns = (int)m_runs.size();
+		m_result.performance = performance;
+		m_result.performance.fSuccess = false;
+		return false;
+	}
+
+	if (m_nRunsDone > m_settings.nWarmUpRuns) {
+		m_runs.push_back(performance);
+	}
+	if ((int)m_runs.size() < m_settings.nRuns) {
+		return true;
+	}
+
+	Summarize();
+	return false;
+}
+
+CBenchmarkRunner::SStatistics CBenchmarkRunner::GetStatistics(std::vector<long double> samples) {
+	SStatistics stat = {0, 0, 0, 0, 0};
+	if (samples.empty()) {
+		return stat;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	stat.dMin = samples.front();
+	stat.dMedian = GetPercentile(samples, 50);
+	stat.dPercentile90 = GetPercentile(samples, 90);
+	stat.dPercentile99 = GetPercentile(samples, 99);
+	stat.dMax = samples.back();
+	return stat;
+}
+
+long double CBenchmarkRunner::GetPercentile(const std::vector<long double> &sortedSamples, long double dPercentile) {
+	// linear interpolation between the closest ranks
+	if (sortedSamples.empty()) {
+		return 0;
+	}
+	long double dRank = dPercentile / 100 * ((int)sortedSamples.size() - 1);
+	int nLower = (int)dRank;
+	if (nLower >= (int)sortedSamples.size() - 1) {
+		return sortedSamples.back();
+	}
+	long double dFraction = dRank - nLower;
+	return sortedSamples[nLower] + (sortedSamples[nLower + 1] - sortedSamples[nLower]) * dFraction;
+}
+
+long double CBenchmarkRunner::GetRate(uint64_t qwBytesCount, long double dTime) {
+	return dTime > 0? qwBytesCount / dTime : 0;
+}
+
+// private
+void CBenchmarkRunner::Summarize() {
+	std::vector<long double> initialization, operating, operatingCpu, operatingUser, operatingKernel;
+	int idx;
+	for (idx = 0; idx < (int)m_runs.size(); idx++) {
+		const CFsmTest::SEnginePerformance &run = m_runs[idx];
+		initialization.push_back(run.timInitialization.dTotalTime);
+		operating.push_back(run.timOperating.dTotalTime);
+		operatingCpu.push_back(run.timOperating.dCpuTime);
+		operatingUser.push_back(run.timOperating.dUserTime);
+		operatingKernel.push_back(run.timOperating.dKernelTime);
+	}
+	m_result.statInitialization = GetStatistics(initialization);
+	m_result.statOperating = GetStatistics(operating);
+	m_result.statOperatingCpu = GetStatistics(operatingCpu);
+	m_result.statOperatingUser = GetStatistics(operatingUser);
+	m_result.statOperatingKernel = GetStatistics(operatingKernel);
+
+	// the lower median is a real run
+	std::vector<long double> sorted = operating;
+	std::sort(sorted.begin(), sorted.end());
+	long double dMedianTime = sorted[(sorted.size() - 1) / 2];
+	int idxMedian = (int)(std::find(operating.begin(), operating.end(), dMedianTime) - operating.begin());
+
+	m_result.fSuccess = true;
+	m_result.nRuns = (int)m_runs.size();
+	m_result.performance = m_runs[idxMedian];
+}
+
+//////////////////////////////////////////////////////////////////////////
+// CBenchmarkReport
+CBenchmarkReport::SField CBenchmarkReport::Field(const std::string &sName, const std::string &sValue) {
+	SField field = {sName, sValue, true};
+	return field;
+}
+
+CBenchmarkReport::SField CBenchmarkReport::Field(const std::string &sName, long double dValue) {
+	const int g_nPrecision = 10;
+	char szValue[32];
+	snprintf(szValue, sizeof(szValue), "%.*g", g_nPrecision, (double)dValue);
+	SField field = {sName, szValue, false};
+	return field;
+}
+
+CBenchmarkReport::SField CBenchmarkReport::Field(const std::string &sName, unsigned int dwValue) {
+	char szValue[16];
+	snprintf(szValue, sizeof(szValue), "%u", dwValue);
+	SField field = {sName, szValue, false};
+	return field;
+}
+
+CBenchmarkReport::SField CBenchmarkReport::Field(const std::string &sName, uint64_t qwValue) {
+	char szValue[24];
+	snprintf(szValue, sizeof(szValue), "%llu", (unsigned long long)qwValue);
+	SField field = {sName, szValue, false};
+	return field;
+}
+
+CBenchmarkReport::SField CBenchmarkReport::Field(const std::string &sName, bool fValue) {
+	SField field = {sName, fValue? "true" : "false", false};
+	return field;
+}
+
+CBenchmarkReport::SField CBenchmarkReport::MissingField(const std::string &sName) {
+	SField field = {sName, std::string(), false};
+	return field;
+}
+
+void CBenchmarkReport::Add(const TFields &testCase, const CBenchmarkRunner::SResult &result, bool fSameData,
+	uint64_t qwReferenceHits)
+{
+	const CFsmTest::SEnginePerformance &perf = result.performance;
+	bool fFsm = result.fSuccess && perf.fIsFsm;
+	bool fHitsOk = perf.qwHits == qwReferenceHits;
+
+	TFields record = testCase;
+	record.push_back(Field("engine", result.sEngine));
+	record.push_back(Field("success", result.fSuccess));
+	record.push_back(Field("runs", (unsigned int)result.nRuns));
+	if (result.fSuccess) {
+		const CBenchmarkRunner::SStatistics &stat = result.statOperating;
+		record.push_back(Field("hits", perf.qwHits));
+		record.push_back(fSameData? Field("hits_ok", fHitsOk) : MissingField("hits_ok"));
+		record.push_back(Field("init_time_median_s", result.statInitialization.dMedian));
+		record.push_back(Field("time_min_s", stat.dMin));
+		record.push_back(Field("time_median_s", stat.dMedian));
+		record.push_back(Field("time_p90_s", stat.dPercentile90));
+		record.push_back(Field("time_p99_s", stat.dPercentile99));
+		record.push_back(Field("time_max_s", stat.dMax));
+		record.push_back(Field("cpu_time_median_s", result.statOperatingCpu.dMedian));
+		record.push_back(Field("user_time_median_s", result.statOperatingUser.dMedian));
+		record.push_back(Field("kernel_time_median_s", result.statOperatingKernel.dMedian));
+		record.push_back(Field("rate_median_Bps", CBenchmarkRunner::GetRate(perf.qwBytesCount, stat.dMedian)));
+		record.push_back(Field("rate_p90_Bps", CBenchmarkRunner::GetRate(perf.qwBytesCount, stat.dPercentile90))); // the slow tail
+		record.push_back(Field("memory_B", perf.dwMemoryRequirements));
+	} else {
+		record.push_back(MissingField("hits"));
+		record.push_back(MissingField("hits_ok"));
+		record.push_back(MissingField("init_time_median_s"));
+		record.push_back(MissingField("time_min_s"));
+		record.push_back(MissingField("time_median_s"));
+		record.push_back(MissingField("time_p90_s"));
+		record.push_back(MissingField("time_p99_s"));
+		record.push_back(MissingField("time_max_s"));
+		record.push_back(MissingField("cpu_time_median_s"));
+		record.push_back(MissingField("user_time_median_s"));
+		record.push_back(MissingField("kernel_time_median_s"));
+		record.push_back(MissingField("rate_median_Bps"));
+		record.push_back(MissingField("rate_p90_Bps"));
+		record.push_back(MissingField("memory_B"));
+	}
+	record.push_back(fFsm? Field("states", perf.fsmStatistics.dwStatesCount) : MissingField("states"));
+	bool fClassed = fFsm && perf.fsmStatistics.dwSymbolClassesCount > 0;
+	record.push_back(fClassed? Field("classes", perf.fsmStatistics.dwSymbolClassesCount) : MissingField("classes"));
+
+	m_records.push_back(record);
+}
+
+void CBenchmarkReport::Write(FILE *pFile) const {
+	if (m_format == format_Json) {
+		WriteJson(pFile);
+	} else {
+		WriteCsv(pFile);
+	}
+	fflush(pFile);
+}
+
+// private
+void CBenchmarkReport::WriteCsv(FILE *pFile) const {
+	if (m_records.empty()) {
+		return;
+	}
+
+	// all the records have the same fields
+	const TFields &header = m_records.front();
+	std::string sLine;
+	int idxField;
+	for (idxField = 0; idxField < (int)header.size(); idxField++) {
+		sLine += (idxField > 0? "," : "") + QuoteCsv(header[idxField].sName);
+	}
+	fprintf(pFile, "%s\n", sLine.c_str());
+
+	int idxRecord;
+	for (idxRecord = 0; idxRecord < (int)m_records.size(); idxRecord++) {
+		const TFields &record = m_records[idxRecord];
+		sLine.clear();
+		for (idxField = 0; idxField < (int)record.size(); idxField++) {
+			sLine += (idxField > 0? "," : "") + QuoteCsv(record[idxField].sValue);
+		}
+		fprintf(pFile, "%s\n", sLine.c_str());
+	}
+}
+
+void CBenchmarkReport::WriteJson(FILE *pFile) const {
+	fprintf(pFile, "[");
+	int idxRecord;
+	for (idxRecord = 0; idxRecord < (int)m_records.size(); idxRecord++) {
+		const TFields &record = m_records[idxRecord];
+		std::string sLine = idxRecord > 0? ",\n{" : "\n{";
+		int idxField;
+		for (idxField = 0; idxField < (int)record.size(); idxField++) {
+			const SField &field = record[idxField];
+			std::string sValue = field.fString? QuoteJson(field.sValue) : (field.sValue.empty()? "null" : field.sValue);
+			sLine += (idxField > 0? ", " : "") + QuoteJson(field.sName) + ": " + sValue;
+		}
+		fprintf(pFile, "%s}", sLine.c_str());
+	}
+	fprintf(pFile, "\n]\n");
+}
+
+std::string CBenchmarkReport::QuoteCsv(const std::string &sValue) {
+	// RFC 4180: the fields with the separators or quotes are quoted, the quotes are doubled
+	if (sValue.find_first_of(",\"\n") == std::string::npos) {
+		return sValue;
+	}
+	std::string sQuoted = "\"";
+	size_t idx;
+	for (idx = 0; idx < sValue.length(); idx++) {
+		if (sValue[idx] == '"') {
+			sQuoted += '"';
+		}
+		sQuoted += sValue[idx];
+	}
+	return sQuoted + "\"";
+}
+
+std::string CBenchmarkReport::QuoteJson(const std::string &sValue) {
+	std::string sQuoted = "\"";
+	size_t idx;
+	for (idx = 0; idx < sValue.length(); idx++) {
+		if (sValue[idx] == '"' || sValue[idx] == '\\') {
+			sQuoted += '\\';
+		}
+		sQuoted += sValue[idx];
+	}
+	return sQuoted + "\"";
+}
@@ -0,0 +1,118 @@
+#line 2 "BenchmarkRunner.h" // Make __FILE__ omit the path
+
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "FsmTest.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CBenchmarkRunner - repeats the performance test of an engine and summarizes the runs.
+/// The first runs warm the caches, the heap and the CPU clock up and are dropped; the times of the others are
+/// reduced to the minimum, the median, the percentiles and the maximum, so a single preempted run doesn't
+/// spoil the rate. The test is repeated by the caller while the runner asks for more:
+///		runner.Start("FSM-8");
+///		do {
+///			fSuccess = tester.TestOctetFsmRate(dwBytes, &performance);
+///		} while (runner.AddRun(fSuccess, performance));
+/// A failed run stops the repetitions. The test data is the same for every run, so are the hits.
+class CBenchmarkRunner {
+public:
+	struct SSettings {
+		int nWarmUpRuns; // dropped
+		int nRuns; // measured, 1 at least
+	};
+
+	struct SStatistics { // of a duration, seconds
+		long double dMin;
+		long double dMedian;
+		long double dPercentile90;
+		long double dPercentile99;
+		long double dMax;
+	};
+
+	struct SResult {
+		std::string sEngine;
+		bool fSuccess; // all the runs succeeded with the same hits
+		int nRuns; // measured
+		CFsmTest::SEnginePerformance performance; // of the median run by the operating time
+		SStatistics statInitialization; // total time
+		SStatistics statOperating; // total time
+		SStatistics statOperatingCpu; // thread time
+		SStatistics statOperatingUser; // process user time
+		SStatistics statOperatingKernel; // process kernel time
+	};
+
+public:
+	CBenchmarkRunner(const SSettings &settings);
+
+public:
+	void Start(const std::string &sEngine);
+	bool AddRun(bool fSuccess, const CFsmTest::SEnginePerformance &performance); // true if one more run is needed
+	const SResult& GetResult() const {return m_result;}
+
+public:
+	static SStatistics GetStatistics(std::vector<long double> samples);
+	static long double GetPercentile(const std::vector<long double> &sortedSamples, long double dPercentile); // 0...100
+	static long double GetRate(uint64_t qwBytesCount, long double dTime); // bytes per second, 0 if unknown
+
+private:
+	void Summarize();
+
+private:
+	SSettings m_settings;
+	SResult m_result;
+	int m_nRunsDone; // the warm-up runs included
+	std::vector<CFsmTest::SEnginePerformance> m_runs; // measured
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CBenchmarkReport - the benchmark results as CSV or JSON, a record per test case and engine.
+/// The fields of a test case (patterns length, count...) are given by the caller and precede the engine's ones.
+/// The missing values are empty in CSV and null in JSON.
+class CBenchmarkReport {
+public:
+	enum EFormat {
+		format_Csv,
+		format_Json
+	};
+
+	struct SField {
+		std::string sName;
+		std::string sValue; // as written, empty for the missing values
+		bool fString; // quoted in JSON
+	};
+	typedef std::vector<SField> TFields;
+
+public:
+	CBenchmarkReport(EFormat format): m_format(format) {}
+
+public:
+	static SField Field(const std::string &sName, const std::string &sValue); // string
+	static SField Field(const std::string &sName, long double dValue);
+	static SField Field(const std::string &sName, unsigned int dwValue);
+	static SField Field(const std::string &sName, uint64_t qwValue);
+	static SField Field(const std::string &sName, bool fValue);
+	static SField MissingField(const std::string &sName);
+
+	/// Add the engine's results; the hits are verified against the reference engine's ones if the data is the same
+	void Add(const TFields &testCase, const CBenchmarkRunner::SResult &result, bool fSameData, uint64_t qwReferenceHits);
+	void Clear() {m_records.clear();}
+	void Write(FILE *pFile) const;
+
+private:
+	void WriteCsv(FILE *pFile) const;
+	void WriteJson(FILE *pFile) const;
+	static std::string QuoteCsv(const std::string &sValue);
+	static std::string QuoteJson(const std::string &sValue);
+
+private:
+	EFormat m_format;
+	std::vector<TFields> m_records;
+};
+
+#endif // BENCHMARKRUNNER_H
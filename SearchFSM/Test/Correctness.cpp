@@ -0,0 +1,165 @@
+#line 2 "Correctness.cpp" // Make __FILE__ omit the path
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../SearchFSM/Concurrent.h"
+#include "FsmTest.h"
+
+//////////////////////////////////////////////////////////////////////////
+// correctness suite: all the engines are compared with the shift register on the small pattern sets,
+// the exit code is nonzero if any of them differs
+
+const int g_nTestBytes = 64 * 1024; // 64 KiB
+const unsigned int g_dwSeed = 2016; // the same patterns on every run
+const int g_nChannels = 64; // streams scanned through the cursors
+const int g_nGenerationThreads = 4; // concurrent even on a single core
+const char *g_szFsmFileName = "FsmCorrectness.tbl"; // temporary file for the saved tables
+
+struct SCase {
+	int nLength;
+	int nCount;
+	int nErrors;
+	bool fMasked;
+};
+
+// the masked patterns with errors blow the octet tables up, so the cases are kept small to run in seconds
+const SCase g_cases[] = {
+	{8, 1, 0, false},
+	{8, 4, 1, true},
+	{28, 2, 0, false},
+	{28, 3, 2, false},
+	{28, 2, 0, true},
+	{65, 1, 1, false},
+	{65, 2, 0, true},
+	{65, 1, 3, false} // over 10^4 states, the comb rows placement mustn't be quadratic
+};
+
+struct SBoundaryCase {
+	const char *szPattern; // "0" and "1" of the bits
+	int nErrors;
+	int nStateIdxSize; // of the octet SearchFSM of minimal types
+};
+
+// the minimized tables of 255, 256, 65535 and 65536 states: STable::statesCount has the state index type,
+// so the index is widened at 256 and 65536 states already
+const SBoundaryCase g_boundaryCases[] = {
+	{
+		"0110011111000110011010010111001101010001111111110100101011101100001010011100110110111010101010111111"
+		"0010111110111110001101000110011111001100001001010100111110000001101111101000111001111000110101110110"
+		"0101101000101110011000110011001110011111110010011001101",
+		0, 1
+	},
+	{
+		"0110011111000110011010010111001101010001111111110100101011101100001010011100110110111010101010111111"
+		"0010111110111110001101000110011111001100001001010100111110000001101111101000111001111000110101110110"
+		"01011010001011100110001100110011100111111100100110011010",
+		0, 2
+	},
+	{
+		"0001101110000100000101110101101000000001101101001001011100101000110101110000101001110010101000000110"
+		"0000000011101010010001010001100111001110001010001001111001010011000000011101011110111010011010101100"
+		"0110011000000000010101000001101011010011000100000011011001011000001001111001000001011001110010110010"
+		"011100001",
+		3, 2
+	},
+	{
+		"0001101110000100000101110101101000000001101101001001011100101000110101110000101001110010101000000110"
+		"0000000011101010010001010001100111001110001010001001110001010011000000011101011110111010011010101100"
+		"0110011000000000010101000001101111010011000100000011011011011000001001111001000001011001110110110010"
+		"011100001",
+		3, 4
+	}
+};
+
+SPattern::TData GenerateData(int nBytes) {
+	SPattern::TData data;
+	int idx;
+	for (idx = 0; idx < nBytes; idx++) {
+		data.push_back((unsigned char)rand());
+	}
+
+	return data;
+}
+
+SPattern GeneratePattern(int nLength, int nErrors, bool fMasked) {
+	int nBytes = (nLength + BITS_IN_BYTE - 1) / BITS_IN_BYTE;
+	SPattern pat;
+	pat.nLength = nLength;
+	pat.nMaxErrors = nErrors;
+	pat.data = GenerateData(nBytes);
+	if (fMasked) {
+		pat.mask = GenerateData(nBytes);
+	}
+
+	return pat;
+}
+
+bool TestCase(const SCase &testCase) {
+	TPatterns patterns;
+	int idx;
+	for (idx = 0; idx < testCase.nCount; idx++) {
+		patterns.push_back(GeneratePattern(testCase.nLength, testCase.nErrors, testCase.fMasked));
+	}
+
+	printf("%i patterns of %i bits, %i errors%s: ", testCase.nCount, testCase.nLength, testCase.nErrors,
+		testCase.fMasked? ", masked" : "");
+	fflush(stdout);
+
+	CFsmTest tester(patterns);
+	unsigned int dwHits = 0;
+	bool fOk = tester.TestCorrectness(g_nTestBytes, 0, &dwHits);
+	fOk = fOk && tester.TestParallelCorrectness(g_nTestBytes, GetIdealThreadCount());
+	fOk = fOk && tester.TestInterleavedCorrectness(g_nTestBytes);
+	fOk = fOk && tester.TestKernelsCorrectness(g_nTestBytes);
+
+	// the tables generated in parallel must be identical to the sequential ones
+	CFsmTest::STimeings timSequential, timParallel;
+	fOk = fOk && tester.TestParallelGeneration(g_nGenerationThreads, &timSequential, &timParallel);
+	fOk = fOk && tester.TestCursorsCorrectness(g_nTestBytes, g_nChannels);
+	fOk = fOk && tester.TestFileCorrectness(g_nTestBytes, g_szFsmFileName);
+	printf("%s, %u hits\n", fOk? "OK" : "FAIL", dwHits);
+	return fOk;
+}
+
+bool TestBoundaryCase(const SBoundaryCase &boundaryCase) {
+	SPattern pattern;
+	if (!StringToPattern(boundaryCase.szPattern, boundaryCase.nErrors, &pattern)) {
+		puts("Wrong pattern!");
+		return false;
+	}
+
+	printf("pattern of %i bits, %i errors, %i-byte state index: ", pattern.nLength, pattern.nMaxErrors,
+		boundaryCase.nStateIdxSize);
+	fflush(stdout);
+
+	CFsmTest tester(TPatterns(1, pattern));
+	int nStateIdxSize = 0;
+	bool fOk = tester.TestAutoCorrectness(g_nTestBytes, &nStateIdxSize) && (nStateIdxSize == boundaryCase.nStateIdxSize);
+	printf("%s, %i-byte state index\n", fOk? "OK" : "FAIL", nStateIdxSize);
+	return fOk;
+}
+
+int main() {
+	srand(g_dwSeed);
+
+	int nFailed = 0;
+	int idx;
+	int nCasesCount = (int)(sizeof(g_cases) / sizeof(g_cases[0]));
+	for (idx = 0; idx < nCasesCount; idx++) {
+		if (!TestCase(g_cases[idx])) {
+			nFailed++;
+		}
+	}
+
+	int nBoundaryCasesCount = (int)(sizeof(g_boundaryCases) / sizeof(g_boundaryCases[0]));
+	for (idx = 0; idx < nBoundaryCasesCount; idx++) {
+		if (!TestBoundaryCase(g_boundaryCases[idx])) {
+			nFailed++;
+		}
+	}
+	nCasesCount += nBoundaryCasesCount;
+
+	printf("%i of %i cases failed\n", nFailed, nCasesCount);
+	return (nFailed == 0)? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,277 @@
+#line 2 "EngineTuner.cpp" // Make __FILE__ omit the path
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "EngineTuner.h"
+
+//////////////////////////////////////////////////////////////////////////
+// CEngineTuner
+CEngineTuner::CEngineTuner(const TPatterns &patterns): m_patterns(patterns), m_tester(patterns) {
+	m_decision.engine = engine_None;
+	m_decision.caches = DetectCacheSizes();
+	m_decision.dwStatesCount = 0;
+	m_decision.dwCalibrationBytes = 0;
+}
+
+bool CEngineTuner::Tune(unsigned int dwCalibrationBytes) {
+	m_decision.engine = engine_None;
+	m_decision.dwCalibrationBytes = dwCalibrationBytes;
+	m_decision.candidates.clear();
+	m_pHolder.reset();
+
+	// the tables are predicted by sampling, they are generated for the calibration of the fitting SearchFSMs only
+	CFsmCreator creator(m_patterns);
+	CFsmCreator::SBuildBudget budget = {0, CFsmTest::g_qwMaxTableBytes, 0};
+	creator.SetBuildBudget(budget);
+	CFsmCreator::SSizeEstimate estimateNone = {0, 0, false, 0, 0, 0, 0};
+	m_decision.sizeEstimate = estimateNone;
+	m_decision.dwStatesCount = 0;
+	bool fEstimated = false, fGenerated = false;
+	try {
+		m_decision.sizeEstimate = creator.EstimateSize();
+		fEstimated = true;
+	}
+	catch(...) {
+		m_decision.sizeEstimate = estimateNone;
+	}
+
+	unsigned int dwLastLevelCache = m_decision.caches.dwL3;
+	if (dwLastLevelCache == 0) {
+		dwLastLevelCache = std::max(m_decision.caches.dwL2, g_dwDefaultLastLevelCache);
+	}
+
+	long double dBestRate = 0;
+	int nEngine;
+	for (nEngine = 0; nEngine < engine_Count; nEngine++) {
+		EEngine engine = (EEngine)nEngine;
+		SCandidate candidate;
+		candidate.engine = engine;
+		candidate.dwEstimatedSize = EstimateSize(engine);
+		candidate.cacheLevel = GetCacheLevel(m_decision.caches, candidate.dwEstimatedSize);
+		candidate.fCalibrated = false;
+		candidate.dRate = 0;
+		candidate.performance.fSuccess = false;
+
+		bool fNeedsTables = engine == engine_Fsm1 || engine == engine_Fsm4 || engine == engine_Fsm8;
+		bool fTooLarge = !fEstimated || candidate.dwEstimatedSize > dwLastLevelCache;
+		if (fNeedsTables && !fTooLarge && !fGenerated) { // once for all the SearchFSMs, even if it has failed
+			fGenerated = true;
+			try {
+				if (creator.GenerateTables() && creator.MinimizeTables()) {
+					m_decision.dwStatesCount = creator.GetStatesCount();
+				}
+			}
+			catch(...) {
+				m_decision.dwStatesCount = 0;
+			}
+		}
+
+		std::shared_ptr<SHolderBase> pHolder; // the calibrated SearchFSM
+		if (!(fNeedsTables && (m_decision.dwStatesCount == 0 || fTooLarge))) {
+			candidate.fCalibrated = true;
+			if (Calibrate(engine, creator, &pHolder, &candidate.performance) &&
+				candidate.performance.timOperating.dTotalTime > 0)
+			{
+				candidate.dRate = candidate.performance.qwBytesCount / candidate.performance.timOperating.dTotalTime;
+			}
+		}
+
+		if (candidate.dRate > dBestRate) {
+			dBestRate = candidate.dRate;
+			m_decision.engine = engine;
+			m_pHolder = pHolder;
+		}
+		m_decision.candidates.push_back(candidate);
+	}
+
+	if (m_decision.engine == engine_None) {
+		return false;
+	}
+
+	try {
+		if (!m_pHolder) { // not a SearchFSM
+			Instantiate(m_decision.engine);
+		}
+		SResetter resetter;
+		Dispatch(resetter);
+	}
+	catch(...) {
+		m_decision.engine = engine_None;
+		m_pHolder.reset();
+		return false;
+	}
+
+	return true;
+}
+
+// host and engines information
+CEngineTuner::SCacheSizes CEngineTuner::DetectCacheSizes() {
+	SCacheSizes caches = {0, 0, 0};
+
+#ifdef _WIN32
+	DWORD dwLength = 0;
+	GetLogicalProcessorInformation(NULL, &dwLength);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(dwLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!infos.empty() && GetLogicalProcessorInformation(infos.data(), &dwLength)) {
+		int idx;
+		for (idx = 0; idx < (int)infos.size(); idx++) {
+			const SYSTEM_LOGICAL_PROCESSOR_INFORMATION &info = infos[idx];
+			if (info.Relationship != RelationCache || info.Cache.Type == CacheInstruction) {
+				continue;
+			}
+
+			unsigned int dwSize = info.Cache.Size;
+			switch (info.Cache.Level) {
+			case 1:
+				caches.dwL1 = std::max(caches.dwL1, dwSize);
+				break;
+			case 2:
+				caches.dwL2 = std::max(caches.dwL2, dwSize);
+				break;
+			case 3:
+				caches.dwL3 = std::max(caches.dwL3, dwSize);
+				break;
+			}
+		}
+	}
+#else
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+	long nSize = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+	caches.dwL1 = nSize > 0? (unsigned int)nSize : 0;
+	nSize = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	caches.dwL2 = nSize > 0? (unsigned int)nSize : 0;
+	nSize = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	caches.dwL3 = nSize > 0? (unsigned int)nSize : 0;
+#endif
+#endif
+
+	return caches;
+}
+
+CEngineTuner::ECacheLevel CEngineTuner::GetCacheLevel(const SCacheSizes &caches, unsigned int dwSize) {
+	if (dwSize <= caches.dwL1) {
+		return cache_L1;
+	} else if (dwSize <= caches.dwL2) {
+		return cache_L2;
+	} else if (dwSize <= caches.dwL3) {
+		return cache_L3;
+	} else {
+		return cache_Memory;
+	}
+}
+
+const char* CEngineTuner::GetEngineName(EEngine engine) {
+	switch (engine) {
+	case engine_Fsm1:
+		return "FSM-1";
+	case engine_Fsm4:
+		return "FSM-4";
+	case engine_Fsm8:
+		return "FSM-8";
+	case engine_Fsm8Lazy:
+		return "FSM-8lazy";
+	case engine_Bitap:
+		return "bitap";
+	case engine_Register:
+		return "register";
+	default:
+		return "none";
+	}
+}
+
+const char* CEngineTuner::GetCacheLevelName(ECacheLevel level) {
+	switch (level) {
+	case cache_L1:
+		return "L1";
+	case cache_L2:
+		return "L2";
+	case cache_L3:
+		return "L3";
+	default:
+		return "memory";
+	}
+}
+
+// private
+unsigned int CEngineTuner::EstimateSize(EEngine engine) const {
+	// the tables are predicted with the default index types; the size is saturated instead of overflowing
+	const CFsmCreator::SSizeEstimate &estimate = m_decision.sizeEstimate;
+	uint64_t qwSize = 0;
+	switch (engine) {
+	case engine_Fsm1:
+		qwSize = estimate.qwBitTableBytes;
+		break;
+	case engine_Fsm4:
+		qwSize = estimate.qwNibbleTableBytes;
+		break;
+	case engine_Fsm8:
+		qwSize = estimate.qwOctetTableBytes;
+		break;
+	case engine_Fsm8Lazy:
+		qwSize = (uint64_t)CFsmTest::g_nLazyFsmMaxStates * CLazySearchFsm::g_nColumnsCount * sizeof(CLazySearchFsm::TTableCell);
+		break;
+	case engine_Bitap:
+		qwSize = CBitapMatcher(m_patterns).GetMemoryUsage();
+		break;
+	case engine_Register:
+		qwSize = CRegisterMatcher(m_patterns).GetMemoryUsage();
+		break;
+	default:
+		break;
+	}
+
+	return (unsigned int)std::min(qwSize, (uint64_t)0xffffffff);
+}
+
+bool CEngineTuner::Calibrate(EEngine engine, const CFsmCreator &creator, std::shared_ptr<SHolderBase> *ppHolder,
+	CFsmTest::SEnginePerformance *pPerformance)
+{
+	// the SearchFSMs are measured on the tables of the creator, the holder keeps them
+	unsigned int dwBytes = m_decision.dwCalibrationBytes;
+	try {
+		switch (engine) {
+		case engine_Fsm1:
+			return CalibrateFsm(creator, creator.CreateFsmWrap<CFsmTest::TBitSearchFsm>(), ppHolder, pPerformance);
+		case engine_Fsm4:
+			return CalibrateFsm(creator, creator.CreateByteFsmWrap<CFsmTest::TNibbleSearchFsm>(), ppHolder, pPerformance);
+		case engine_Fsm8:
+			return CalibrateFsm(creator, creator.CreateByteFsmWrap<CFsmTest::TOctetSearchFsm>(), ppHolder, pPerformance);
+		case engine_Fsm8Lazy:
+			return m_tester.TestLazyFsmRate(dwBytes, pPerformance);
+		case engine_Bitap:
+			return m_tester.TestBitapRate(dwBytes, pPerformance);
+		case engine_Register:
+			return m_tester.TestRegisterMatcherRate(dwBytes, pPerformance);
+		default:
+			return false;
+		}
+	}
+	catch(...) {
+		ppHolder->reset();
+		pPerformance->fSuccess = false;
+		return false;
+	}
+}
+
+void CEngineTuner::Instantiate(EEngine engine) {
+	// the SearchFSMs' tables are kept from the calibration
+	SHolderBase *pHolder = NULL;
+	switch (engine) {
+	case engine_Fsm8Lazy:
+		pHolder = new SHolder<CLazySearchFsm>(CLazySearchFsm(m_patterns, CFsmTest::g_nLazyFsmMaxStates));
+		break;
+	case engine_Bitap:
+		pHolder = new SHolder<CBitapMatcher>(CBitapMatcher(m_patterns));
+		break;
+	case engine_Register:
+		pHolder = new SHolder<CRegisterMatcher>(CRegisterMatcher(m_patterns));
+		break;
+	default:
+		break;
+	}
+	m_pHolder = std::shared_ptr<SHolderBase>(pHolder);
+}
@@ -0,0 +1,168 @@
+#line 2 "EngineTuner.h" // Make __FILE__ omit the path
+
+#ifndef ENGINETUNER_H
+#define ENGINETUNER_H
+
+#include <memory>
+#include <vector>
+
+#include "../SearchFSM/BitapMatcher.h"
+#include "../SearchFSM/RegisterMatcher.h"
+#include "FsmTest.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// \brief CEngineTuner - picks the fastest search engine for the patterns on this host.
+/// The sizes of the SearchFSMs' tables are predicted by CFsmCreator::EstimateSize and compared with the
+/// detected caches: the tables beyond the last level cache are not even built. The bit SearchFSM is generated
+/// and minimized once for all the fitting SearchFSMs, the engines are calibrated by a short run of CFsmTest's
+/// performance tests. The fastest engine is passed to a visitor by Dispatch, as it is done by CSearchFsmAuto;
+/// the tables of the fastest SearchFSM so far are kept from its calibration, the other engines are cheap to
+/// instantiate again. The decision is kept with all the estimations and measurements for the inspection.
+class CEngineTuner {
+public:
+	enum EEngine {
+		engine_None = -1,
+		engine_Fsm1,
+		engine_Fsm4,
+		engine_Fsm8,
+		engine_Fsm8Lazy,
+		engine_Bitap,
+		engine_Register,
+		engine_Count
+	};
+
+	enum ECacheLevel {
+		cache_L1,
+		cache_L2,
+		cache_L3,
+		cache_Memory
+	};
+
+	struct SCacheSizes { // bytes, 0 if not detected
+		unsigned int dwL1;
+		unsigned int dwL2;
+		unsigned int dwL3;
+	};
+
+	struct SCandidate {
+		EEngine engine;
+		unsigned int dwEstimatedSize; // bytes of the tables or of the state
+		ECacheLevel cacheLevel; // the smallest cache holding the estimated size
+		bool fCalibrated; // false if skipped for its size
+		long double dRate; // bytes per second, 0 if not calibrated or failed
+		CFsmTest::SEnginePerformance performance; // of the calibration run
+	};
+
+	struct SDecision {
+		EEngine engine; // the fastest one, engine_None if all have failed
+		SCacheSizes caches;
+		CFsmCreator::SSizeEstimate sizeEstimate; // of the SearchFSMs' tables
+		unsigned int dwStatesCount; // of the minimized bit SearchFSM, 0 if it isn't generated or has failed
+		unsigned int dwCalibrationBytes;
+		std::vector<SCandidate> candidates;
+	};
+
+	// the tables beyond the last level cache run at the memory latency and are slow to build
+	static const unsigned int g_dwDefaultLastLevelCache = 8 * 1024 * 1024;
+
+public: // constructor
+	CEngineTuner(const TPatterns &patterns);
+
+public: // working methods
+	/// estimate and calibrate all the engines, then instantiate the fastest one; false if none works
+	bool Tune(unsigned int dwCalibrationBytes);
+
+	/// call visitor(TEngine &engine) for the instantiated engine, the engine has Reset and Scan methods
+	/// like CSearchFsmByte and is reset by Tune; false if there is no engine
+	template <class TVisitor>
+	bool Dispatch(TVisitor &visitor);
+
+	const SDecision& GetDecision() const {
+		return m_decision;
+	}
+
+public: // host and engines information
+	static SCacheSizes DetectCacheSizes();
+	static ECacheLevel GetCacheLevel(const SCacheSizes &caches, unsigned int dwSize);
+	static const char* GetEngineName(EEngine engine);
+	static const char* GetCacheLevelName(ECacheLevel level);
+
+private:
+	typedef CFsmCreator::SFsmWrap<CFsmTest::TBitSearchFsm> TBitFsmWrap;
+	typedef CFsmCreator::SFsmWrap<CFsmTest::TNibbleSearchFsm> TNibbleFsmWrap;
+	typedef CFsmCreator::SFsmWrap<CFsmTest::TOctetSearchFsm> TOctetFsmWrap;
+
+	struct SHolderBase {
+		virtual ~SHolderBase() {}
+	};
+
+	template <class TEngine>
+	struct SHolder: public SHolderBase {
+		SHolder(const TEngine &engine_): engine(engine_) {}
+		TEngine engine;
+	};
+
+	struct SResetter {
+		template <class TEngine>
+		void operator()(TEngine &engine) {
+			engine.Reset();
+		}
+	};
+
+	template <class TEngine>
+	TEngine& GetEngine() {
+		return static_cast<SHolder<TEngine>*>(m_pHolder.get())->engine;
+	}
+
+	unsigned int EstimateSize(EEngine engine) const;
+	bool Calibrate(EEngine engine, const CFsmCreator &creator, /* out */ std::shared_ptr<SHolderBase> *ppHolder,
+		/* out */ CFsmTest::SEnginePerformance *pPerformance);
+	void Instantiate(EEngine engine);
+
+	template <class TWrap>
+	bool CalibrateFsm(const CFsmCreator &creator, const TWrap &wrap, /* out */ std::shared_ptr<SHolderBase> *ppHolder,
+		/* out */ CFsmTest::SEnginePerformance *pPerformance);
+
+private:
+	const TPatterns m_patterns;
+	CFsmTest m_tester;
+	SDecision m_decision;
+	std::shared_ptr<SHolderBase> m_pHolder;
+};
+
+// implementation
+template <class TWrap>
+bool CEngineTuner::CalibrateFsm(const CFsmCreator &creator, const TWrap &wrap, std::shared_ptr<SHolderBase> *ppHolder,
+	CFsmTest::SEnginePerformance *pPerformance)
+{
+	*ppHolder = std::shared_ptr<SHolderBase>(new SHolder<TWrap>(wrap));
+	return m_tester.TestFsmWrapRate(m_decision.dwCalibrationBytes, creator, wrap, pPerformance);
+}
+
+template <class TVisitor>
+bool CEngineTuner::Dispatch(TVisitor &visitor) {
+	switch (m_decision.engine) {
+	case engine_Fsm1:
+		visitor(GetEngine<TBitFsmWrap>().fsm);
+		return true;
+	case engine_Fsm4:
+		visitor(GetEngine<TNibbleFsmWrap>().fsm);
+		return true;
+	case engine_Fsm8:
+		visitor(GetEngine<TOctetFsmWrap>().fsm);
+		return true;
+	case engine_Fsm8Lazy:
+		visitor(GetEngine<CLazySearchFsm>());
+		return true;
+	case engine_Bitap:
+		visitor(GetEngine<CBitapMatcher>());
+		return true;
+	case engine_Register:
+		visitor(GetEngine<CRegisterMatcher>());
+		return true;
+	default:
+		return false;
+	}
+}
+
+#endif // ENGINETUNER_H
@@ -1,18 +1,18 @@
 #line 2 "FsmTest.cpp" // Make __FILE__ omit the path
 
+#include <stdio.h>
 #include <stdlib.h>
 
+#include "../SearchFSM/ParallelSearchFsm.h"
 #include "FsmTest.h"
 #include "SearchEngines.h"
-#include "WinTimer.h"
+#include "Timer.h"
 #include "Lcg.h"
 
-// forward definitions
-CFsmTest::STimeings GetTimings(const CWinTimer &timer);
-
 // CFsmTest class
 CFsmTest::CFsmTest(const TPatterns &patterns) {
 	m_patterns = patterns;
+	m_fSizeEstimated = false;
 }
 
 CFsmTest::~CFsmTest() {}
@@ -58,25 +58,109 @@ bool CFsmTest::TestCorrectness(unsigned int dwTestBytesCount, int nPrintHits, un
 	// prepare engines (register and bit SearchFSM - must be created, Nibble and octet SearchFSM - try)
 	CRegisterSearch::TSearchData searchDataRegister = CRegisterSearch::InitEngine(m_patterns);
 	CBitFsmSearch<false>::TSearchData searchDataBitFsm = CBitFsmSearch<false>::InitEngine(m_patterns);
+	CBitapSearch::TSearchData searchDataBitap = CBitapSearch::InitEngine(m_patterns);
 
-	CNibbleFsmSearch::TSearchData *pSearchDataNibbleFsm = NULL;
-	try {
-		pSearchDataNibbleFsm = new CNibbleFsmSearch::TSearchData(CNibbleFsmSearch::InitEngine(m_patterns));
+	// every kernel of the vectorized register search the processor supports, not the chosen one only
+	const CRegisterMatcher::EKernel kernels[] = {CRegisterMatcher::kernel_Scalar, CRegisterMatcher::kernel_Avx2,
+		CRegisterMatcher::kernel_Avx512};
+	std::vector<CRegisterMatcherSearch::TSearchData> searchDataRegisterMatchers;
+	int idxKernel;
+	for (idxKernel = 0; idxKernel < (int)(sizeof(kernels) / sizeof(kernels[0])); idxKernel++) {
+		if (CRegisterMatcher::IsKernelSupported(kernels[idxKernel])) {
+			searchDataRegisterMatchers.push_back(CRegisterMatcherSearch::InitEngine(m_patterns, kernels[idxKernel]));
+		}
 	}
-	catch(...) {
-		puts("Failed to build Nibble SearchFSM!");
-		pSearchDataNibbleFsm = NULL;
+
+	// the tables predicted too large aren't built at all
+	uint64_t qwPredictedBytes = 0;
+	CNibbleFsmSearch::TSearchData *pSearchDataNibbleFsm = NULL;
+	if (!FitsTableBudget(g_nNibbleLength, &qwPredictedBytes)) {
+		printf("Nibble SearchFSM is too large: %llu bytes predicted\n", (unsigned long long)qwPredictedBytes);
+	} else {
+		try {
+			pSearchDataNibbleFsm = new CNibbleFsmSearch::TSearchData(CNibbleFsmSearch::InitEngine(m_patterns));
+		}
+		catch(...) {
+			puts("Failed to build Nibble SearchFSM!");
+			pSearchDataNibbleFsm = NULL;
+		}
 	}
 
 	COctetFsmSearch::TSearchData *pSearchDataOctetFsm = NULL;
-	try {
-		pSearchDataOctetFsm = new COctetFsmSearch::TSearchData(COctetFsmSearch::InitEngine(m_patterns));
+	if (!FitsTableBudget(g_nByteLength, &qwPredictedBytes)) {
+		printf("Octet SearchFSM is too large: %llu bytes predicted\n", (unsigned long long)qwPredictedBytes);
+	} else {
+		try {
+			pSearchDataOctetFsm = new COctetFsmSearch::TSearchData(COctetFsmSearch::InitEngine(m_patterns));
+		}
+		catch(...) {
+			puts("Failed to build Octet SearchFSM!");
+			pSearchDataOctetFsm = NULL;
+		}
 	}
-	catch(...) {
-		puts("Failed to build Octet SearchFSM!");
-		pSearchDataOctetFsm = NULL;
+
+	COctetClassedFsmSearch::TSearchData *pSearchDataClassedFsm = NULL;
+	if (!FitsTableBudget(g_nByteLength, &qwPredictedBytes)) {
+		printf("Octet SearchFSM with symbol classes is too large: %llu bytes predicted\n", (unsigned long long)qwPredictedBytes);
+	} else {
+		try {
+			pSearchDataClassedFsm = new COctetClassedFsmSearch::TSearchData(COctetClassedFsmSearch::InitEngine(m_patterns));
+		}
+		catch(...) {
+			puts("Failed to build Octet SearchFSM with symbol classes!");
+			pSearchDataClassedFsm = NULL;
+		}
+	}
+
+	COctetCombFsmSearch::TSearchData *pSearchDataCombFsm = NULL;
+	if (!FitsCombTableBudget(&qwPredictedBytes)) {
+		printf("Octet SearchFSM with comb-compressed table is too large: %llu bytes predicted\n", (unsigned long long)qwPredictedBytes);
+	} else {
+		try {
+			pSearchDataCombFsm = new COctetCombFsmSearch::TSearchData(COctetCombFsmSearch::InitEngine(m_patterns));
+		}
+		catch(...) {
+			puts("Failed to build Octet SearchFSM with comb-compressed table!");
+			pSearchDataCombFsm = NULL;
+		}
 	}
 
+	COctetSplitFsmSearch::TSearchData *pSearchDataSplitFsm = NULL;
+	if (!FitsTableBudget(g_nByteLength, &qwPredictedBytes)) {
+		printf("Octet SearchFSM with split table is too large: %llu bytes predicted\n", (unsigned long long)qwPredictedBytes);
+	} else {
+		try {
+			pSearchDataSplitFsm = new COctetSplitFsmSearch::TSearchData(COctetSplitFsmSearch::InitEngine(m_patterns));
+		}
+		catch(...) {
+			puts("Failed to build Octet SearchFSM with split table!");
+			pSearchDataSplitFsm = NULL;
+		}
+	}
+
+	CAutoFsmSearch::TSearchData *pSearchDataAutoFsm = NULL;
+	if (!FitsTableBudget(g_nByteLength, &qwPredictedBytes)) {
+		printf("Octet SearchFSM of minimal types is too large: %llu bytes predicted\n", (unsigned long long)qwPredictedBytes);
+	} else {
+		try {
+			pSearchDataAutoFsm = new CAutoFsmSearch::TSearchData(CAutoFsmSearch::InitEngine(m_patterns));
+		}
+		catch(...) {
+			puts("Failed to build Octet SearchFSM of minimal types!");
+			pSearchDataAutoFsm = NULL;
+		}
+	}
+
+	// the SearchFSM built on demand with a small cache, to check the flushes too
+	CLazyFsmSearch::TSearchData searchDataLazyFsm = {CLazySearchFsm(m_patterns, 64), 0};
+
+	// the findings of a byte: the reference ones and the tested engine's ones, a pattern is found once a bit at most
+	size_t nCapacity = m_patterns.size() * BITS_IN_BYTE;
+	TFindingsList findingsStorage(nCapacity * 3);
+	CFindingsBuffer finReg(findingsStorage.data(), nCapacity);
+	CFindingsBuffer finBitFsm(findingsStorage.data() + nCapacity, nCapacity);
+	CFindingsBuffer finEngine(findingsStorage.data() + nCapacity * 2, nCapacity);
+
 	// start test
 	CDoubleLcg lcg;
 	bool fCorrect = true;
@@ -85,37 +169,104 @@ bool CFsmTest::TestCorrectness(unsigned int dwTestBytesCount, int nPrintHits, un
 	unsigned int dwBytes;
 	for (dwBytes = 0; dwBytes < dwTestBytesCount; dwBytes++) {
 		unsigned char bData = lcg.RandomByte();
-		TFindingsList finReg = CRegisterSearch::ProcessByte(bData, &searchDataRegister);
-		TFindingsList finBitFsm = CBitFsmSearch<false>::ProcessByte(bData, &searchDataBitFsm);
+		finReg.Clear();
+		CRegisterSearch::ProcessByte(bData, &searchDataRegister, &finReg);
+		finBitFsm.Clear();
+		CBitFsmSearch<false>::ProcessByte(bData, &searchDataBitFsm, &finBitFsm);
 
 		if (!AreEqual(finBitFsm, finReg)) {
 			puts("FAIL! Bit SearchFSM != Test register!");
 			fCorrect = false;
 		}
 
+		finEngine.Clear();
+		CBitapSearch::ProcessByte(bData, &searchDataBitap, &finEngine);
+		if (!AreEqual(finReg, finEngine)) {
+			puts("FAIL! Test register != Bitap search!");
+			fCorrect = false;
+		}
+
+		for (idxKernel = 0; idxKernel < (int)searchDataRegisterMatchers.size(); idxKernel++) {
+			CRegisterMatcherSearch::TSearchData &searchData = searchDataRegisterMatchers[idxKernel];
+			finEngine.Clear();
+			CRegisterMatcherSearch::ProcessByte(bData, &searchData, &finEngine);
+			if (!AreEqual(finReg, finEngine)) {
+				printf("FAIL! Test register != Vectorized register search (%s)!\n",
+					CRegisterMatcher::GetKernelName(searchData.matcher.GetKernel()));
+				fCorrect = false;
+			}
+		}
+
 		if (pSearchDataNibbleFsm != NULL) { // Nibble SearchFSM is built
-			TFindingsList finNibbleFsm = CNibbleFsmSearch::ProcessByte(bData, pSearchDataNibbleFsm);
-			if (!AreEqual(finBitFsm, finNibbleFsm)) {
+			finEngine.Clear();
+			CNibbleFsmSearch::ProcessByte(bData, pSearchDataNibbleFsm, &finEngine);
+			if (!AreEqual(finBitFsm, finEngine)) {
 				puts("FAIL! Bit SearchFSM != Nibble SearchFSM!");
 				fCorrect = false;
 			}
 		}
 
 		if (pSearchDataOctetFsm != NULL) { // Octet SearchFSM is built
-			TFindingsList finOctetFsm = COctetFsmSearch::ProcessByte(bData, pSearchDataOctetFsm);
-			if (!AreEqual(finBitFsm, finOctetFsm)) {
+			finEngine.Clear();
+			COctetFsmSearch::ProcessByte(bData, pSearchDataOctetFsm, &finEngine);
+			if (!AreEqual(finBitFsm, finEngine)) {
 				puts("FAIL! Bit SearchFSM != Octet SearchFSM!");
 				fCorrect = false;
 			}
 		}
 
+		if (pSearchDataClassedFsm != NULL) { // Octet SearchFSM with symbol classes is built
+			finEngine.Clear();
+			COctetClassedFsmSearch::ProcessByte(bData, pSearchDataClassedFsm, &finEngine);
+			if (!AreEqual(finBitFsm, finEngine)) {
+				puts("FAIL! Bit SearchFSM != Octet SearchFSM with symbol classes!");
+				fCorrect = false;
+			}
+		}
+
+		if (pSearchDataCombFsm != NULL) { // Octet SearchFSM with comb-compressed table is built
+			finEngine.Clear();
+			COctetCombFsmSearch::ProcessByte(bData, pSearchDataCombFsm, &finEngine);
+			if (!AreEqual(finBitFsm, finEngine)) {
+				puts("FAIL! Bit SearchFSM != Octet SearchFSM with comb-compressed table!");
+				fCorrect = false;
+			}
+		}
+
+		if (pSearchDataSplitFsm != NULL) { // Octet SearchFSM with split table is built
+			finEngine.Clear();
+			COctetSplitFsmSearch::ProcessByte(bData, pSearchDataSplitFsm, &finEngine);
+			if (!AreEqual(finBitFsm, finEngine)) {
+				puts("FAIL! Bit SearchFSM != Octet SearchFSM with split table!");
+				fCorrect = false;
+			}
+		}
+
+		if (pSearchDataAutoFsm != NULL) { // Octet SearchFSM of minimal types is built
+			finEngine.Clear();
+			CAutoFsmSearch::ProcessByte(bData, pSearchDataAutoFsm, &finEngine);
+			if (!AreEqual(finBitFsm, finEngine)) {
+				puts("FAIL! Bit SearchFSM != Octet SearchFSM of minimal types!");
+				fCorrect = false;
+			}
+		}
+
+		finEngine.Clear();
+		CLazyFsmSearch::ProcessByte(bData, &searchDataLazyFsm, &finEngine);
+		if (!AreEqual(finBitFsm, finEngine)) {
+			puts("FAIL! Bit SearchFSM != Lazy SearchFSM!");
+			fCorrect = false;
+		}
+
 		unsigned int dwMask = (int)cHits >> 31; // either all ones or null
-		cHits += finReg.count();
+		cHits += (int)finReg.GetCount();
 		cHits |= dwMask;
 
-		while (cPrinted < nPrintHits && !finReg.isEmpty()) {
-			SFinding finding = finReg.takeFirst();
-			printf("Found #%i at %i with %i errors\n", finding.nPatternIdx, finding.dwPosition, finding.nErrors);
+		int idxFinding;
+		for (idxFinding = 0; cPrinted < nPrintHits && idxFinding < (int)finReg.GetCount(); idxFinding++) {
+			const SFinding &finding = finReg[idxFinding];
+			printf("Found #%i at %llu with %i errors\n", finding.nPatternIdx, (unsigned long long)finding.qwPosition,
+				finding.nErrors);
 			cPrinted++;
 		}
 	}
@@ -124,6 +275,340 @@ bool CFsmTest::TestCorrectness(unsigned int dwTestBytesCount, int nPrintHits, un
 		*pdwHits = cHits;
 	}
 
+	delete pSearchDataClassedFsm;
+	delete pSearchDataCombFsm;
+	delete pSearchDataSplitFsm;
+	delete pSearchDataAutoFsm;
+	return fCorrect;
+}
+
+bool CFsmTest::TestParallelCorrectness(unsigned int dwTestBytesCount, int nThreads, unsigned int *pdwHits) {
+	// compare sequential and parallel scanning by the same octet SearchFSM
+	COctetFsmSearch::TSearchData *pSearchData = NULL;
+	try {
+		pSearchData = new COctetFsmSearch::TSearchData(COctetFsmSearch::InitEngine(m_patterns));
+	}
+	catch(...) {
+		puts("Failed to build Octet SearchFSM!");
+		return false;
+	}
+
+	std::vector<unsigned char> data = GenerateTestData(dwTestBytesCount);
+	const TOctetSearchFsm::STable &table = pSearchData->wrap.fsm.GetTable();
+
+	// the findings are collected through the small buffers flushed into the lists
+	const size_t nCapacity = 4096;
+	TFindingsList findingsStorage(nCapacity * 2);
+
+	TFindingsList finSequential;
+	CFindingsBuffer bufferSequential(findingsStorage.data(), nCapacity, &AppendFindings, &finSequential);
+	TOctetSearchFsm fsm(table);
+	fsm.Scan(data.data(), data.size(), bufferSequential);
+	bufferSequential.Flush();
+
+	TFindingsList finParallel;
+	CFindingsBuffer bufferParallel(findingsStorage.data() + nCapacity, nCapacity, &AppendFindings, &finParallel);
+	CParallelSearchFsm<TOctetSearchFsm> fsmParallel(table, GetWarmUpBytes());
+	fsmParallel.Scan(data.data(), data.size(), bufferParallel, nThreads);
+	bufferParallel.Flush();
+
+	bool fCorrect = AreEqual(finSequential, finParallel) && (fsm.GetState() == fsmParallel.GetState());
+	if (!fCorrect) {
+		puts("FAIL! Octet SearchFSM != Parallel Octet SearchFSM!");
+	}
+
+	// the buffer without storage passes the findings one by one
+	TFindingsList finUnbuffered;
+	CFindingsBuffer bufferUnbuffered(NULL, 0, &AppendFindings, &finUnbuffered);
+	fsm.Reset();
+	fsm.Scan(data.data(), data.size(), bufferUnbuffered);
+	bufferUnbuffered.Flush();
+	if (!AreEqual(finSequential, finUnbuffered)) {
+		puts("FAIL! Octet SearchFSM != Octet SearchFSM with unbuffered findings!");
+		fCorrect = false;
+	}
+	if (pdwHits != NULL) {
+		*pdwHits = (int)finSequential.size();
+	}
+
+	delete pSearchData;
+	return fCorrect;
+}
+
+// sink collecting the findings of each stream into its own list, the positions are counted from qwBitsBefore
+struct SStreamsSink {
+	std::vector<std::vector<SFinding> > *pStreams;
+	uint64_t qwBitsBefore;
+
+	template <class TOutput>
+	void operator()(size_t idxStream, uint64_t qwBitsProcessed, const TOutput &output) {
+		uint64_t qwBits = qwBitsBefore + qwBitsProcessed;
+		if (output.stepBack <= qwBits) { // enough data
+			SFinding finding = {(int)output.patternIdx, (int)output.errorsCount, qwBits - output.stepBack};
+			(*pStreams)[idxStream].push_back(finding);
+		}
+	}
+};
+
+bool CFsmTest::TestInterleavedCorrectness(unsigned int dwTestBytesCount) {
+	// compare the streams scanned in lockstep and one by one with the same octet SearchFSM
+	COctetFsmSearch::TSearchData *pSearchData = NULL;
+	try {
+		pSearchData = new COctetFsmSearch::TSearchData(COctetFsmSearch::InitEngine(m_patterns));
+	}
+	catch(...) {
+		puts("Failed to build Octet SearchFSM!");
+		return false;
+	}
+
+	std::vector<unsigned char> data = GenerateTestData(dwTestBytesCount);
+	const TOctetSearchFsm::STable &table = pSearchData->wrap.fsm.GetTable();
+	bool fCorrect = TestInterleavedStreams<4, false>(table, data) && TestInterleavedStreams<4, true>(table, data) &&
+		TestInterleavedStreams<16, false>(table, data) && TestInterleavedStreams<16, true>(table, data);
+
+	delete pSearchData;
+	return fCorrect;
+}
+
+bool CFsmTest::TestCursorsCorrectness(unsigned int dwTestBytesCount, int nChannels) {
+	// compare the channels scanned at once through the cursors and one by one, for each table-driven SearchFSM
+	std::vector<unsigned char> data = GenerateTestData(dwTestBytesCount);
+	bool fCorrect = true;
+	try {
+		CFsmCreator fsm(m_patterns);
+		fsm.GenerateTables();
+		fsm.MinimizeTables();
+		fCorrect = TestCursors(CCompiledFsm<TBitSearchFsm>::FromWrap(fsm.CreateFsmWrap<TBitSearchFsm>()), data,
+			nChannels, "Bit SearchFSM");
+		if (FitsTableBudget(g_nByteLength)) {
+			fCorrect = TestCursors(CCompiledFsm<TOctetSearchFsm>::FromWrap(fsm.CreateByteFsmWrap<TOctetSearchFsm>()),
+				data, nChannels, "Octet SearchFSM") && fCorrect;
+			fCorrect = TestCursors(CCompiledFsm<TOctetClassedSearchFsm>::FromWrap(
+				fsm.CreateClassedFsmWrap<TOctetClassedSearchFsm>()), data, nChannels, "Octet SearchFSM with symbol classes") &&
+				fCorrect;
+			fCorrect = TestCursors(CCompiledFsm<TOctetSplitSearchFsm>::FromWrap(
+				fsm.CreateSplitFsmWrap<TOctetSplitSearchFsm>()), data, nChannels, "Octet SearchFSM with split table") &&
+				fCorrect;
+		}
+		if (FitsCombTableBudget()) {
+			fCorrect = TestCursors(CCompiledFsm<TOctetCombSearchFsm>::FromWrap(
+				fsm.CreateCombFsmWrap<TOctetCombSearchFsm>()), data, nChannels, "Octet SearchFSM with comb-compressed table") &&
+				fCorrect;
+		}
+	}
+	catch(...) {
+		puts("Failed to build SearchFSM!");
+		return false;
+	}
+
+	return fCorrect;
+}
+
+bool CFsmTest::TestKernelsCorrectness(unsigned int dwTestBytesCount) {
+	// the byte by byte search of TestCorrectness fills a part of the lanes, so the whole data is scanned at once
+	// by each kernel of the vectorized register search supported and compared with the scalar one
+	const CRegisterMatcher::EKernel kernels[] = {CRegisterMatcher::kernel_Scalar, CRegisterMatcher::kernel_Avx2,
+		CRegisterMatcher::kernel_Avx512};
+	std::vector<unsigned char> data = GenerateTestData(dwTestBytesCount);
+	const size_t nCapacity = 4096;
+	TFindingsList findingsStorage(nCapacity);
+
+	bool fCorrect = true;
+	TFindingsList finScalar;
+	int idxKernel;
+	for (idxKernel = 0; idxKernel < (int)(sizeof(kernels) / sizeof(kernels[0])); idxKernel++) {
+		if (!CRegisterMatcher::IsKernelSupported(kernels[idxKernel])) {
+			continue;
+		}
+
+		TFindingsList finKernel;
+		CFindingsBuffer buffer(findingsStorage.data(), nCapacity, &AppendFindings, &finKernel);
+		CRegisterMatcher matcher(m_patterns, kernels[idxKernel]);
+		matcher.Scan(data.data(), data.size(), buffer);
+		buffer.Flush();
+
+		if (kernels[idxKernel] == CRegisterMatcher::kernel_Scalar) {
+			finScalar.swap(finKernel);
+		} else if (!AreEqual(finScalar, finKernel)) {
+			printf("FAIL! Vectorized register search (scalar) != Vectorized register search (%s)!\n",
+				CRegisterMatcher::GetKernelName(kernels[idxKernel]));
+			fCorrect = false;
+		}
+	}
+
+	return fCorrect;
+}
+
+bool CFsmTest::TestAutoCorrectness(unsigned int dwTestBytesCount, int *pnStateIdxSize) {
+	// compare the octet SearchFSM of minimal types with the bit one only, the tables of the others may be too slow to build
+	CBitFsmSearch<false>::TSearchData searchDataBitFsm = CBitFsmSearch<false>::InitEngine(m_patterns);
+	CAutoFsmSearch::TSearchData *pSearchDataAutoFsm = NULL;
+	try {
+		pSearchDataAutoFsm = new CAutoFsmSearch::TSearchData(CAutoFsmSearch::InitEngine(m_patterns));
+	}
+	catch(...) {
+		puts("Failed to build Octet SearchFSM of minimal types!");
+		return false;
+	}
+	if (pnStateIdxSize != NULL) {
+		*pnStateIdxSize = pSearchDataAutoFsm->fsm.GetIndexSizes().nStateIdxSize;
+	}
+
+	// the random data hardly matches the long patterns, so they are planted with up to nMaxErrors flipped bits
+	std::vector<unsigned char> data = GenerateTestData(dwTestBytesCount);
+	uint64_t qwBitsCount = (uint64_t)data.size() * BITS_IN_BYTE;
+	uint64_t qwBitOffset = 0;
+	int idxPlanted;
+	for (idxPlanted = 0; idxPlanted < (int)m_patterns.size() * g_nPlantedCopies; idxPlanted++) {
+		const SPattern &pattern = m_patterns[idxPlanted % m_patterns.size()];
+		qwBitOffset += data[idxPlanted % data.size()] + 1; // a random gap
+		if (qwBitOffset + pattern.nLength > qwBitsCount) {
+			break;
+		}
+		PlantPattern(pattern, idxPlanted % (pattern.nMaxErrors + 1), qwBitOffset, &data);
+		qwBitOffset += pattern.nLength;
+	}
+
+	size_t nCapacity = m_patterns.size() * BITS_IN_BYTE;
+	TFindingsList findingsStorage(nCapacity * 2);
+	CFindingsBuffer finBitFsm(findingsStorage.data(), nCapacity);
+	CFindingsBuffer finEngine(findingsStorage.data() + nCapacity, nCapacity);
+
+	bool fCorrect = true;
+	size_t cHits = 0;
+	size_t nBytes;
+	for (nBytes = 0; nBytes < data.size() && fCorrect; nBytes++) {
+		finBitFsm.Clear();
+		CBitFsmSearch<false>::ProcessByte(data[nBytes], &searchDataBitFsm, &finBitFsm);
+		finEngine.Clear();
+		CAutoFsmSearch::ProcessByte(data[nBytes], pSearchDataAutoFsm, &finEngine);
+		if (!AreEqual(finBitFsm, finEngine)) {
+			puts("FAIL! Bit SearchFSM != Octet SearchFSM of minimal types!");
+			fCorrect = false;
+		}
+		cHits += finBitFsm.GetCount();
+	}
+	if (fCorrect && cHits == 0) { // the planted patterns must be found
+		puts("FAIL! Bit SearchFSM hasn't found the planted patterns!");
+		fCorrect = false;
+	}
+
+	delete pSearchDataAutoFsm;
+	return fCorrect;
+}
+
+bool CFsmTest::TestFileCorrectness(unsigned int dwTestBytesCount, const std::string &sFileName) {
+	// save the octet SearchFSM, map the file and compare with the register
+	if (!FitsTableBudget(g_nByteLength)) {
+		puts("Octet SearchFSM is too large to be saved");
+		return true;
+	}
+	uint64_t qwFingerprint = CFsmFile::GetPatternsFingerprint(m_patterns);
+	CFsmFile::SHeader header;
+	try {
+		COctetFsmSearch::TSearchData octetData = COctetFsmSearch::InitEngine(m_patterns);
+		const TOctetSearchFsm::STable &table = octetData.wrap.fsm.GetTable();
+		header = CFsmFile::CreateHeader<TOctetSearchFsm>(table, CFsmCreator::bitOrder_MsbFirst, qwFingerprint);
+		if (CFsmFile::Save<TOctetSearchFsm>(sFileName, table, CFsmCreator::bitOrder_MsbFirst, qwFingerprint) !=
+			CFsmFile::status_Ok)
+		{
+			puts("Failed to save Octet SearchFSM!");
+			remove(sFileName.c_str());
+			return false;
+		}
+	}
+	catch(...) {
+		puts("Failed to build Octet SearchFSM!");
+		return false;
+	}
+
+	std::shared_ptr<CMappedFsmSearch::TMapping> pMapping(new CMappedFsmSearch::TMapping);
+	if (pMapping->Open(sFileName, CFsmCreator::bitOrder_MsbFirst, qwFingerprint) != CFsmFile::status_Ok) {
+		puts("FAIL! Octet SearchFSM file isn't loaded!");
+		remove(sFileName.c_str());
+		return false;
+	}
+	CMappedFsmSearch::TSearchData searchData = {pMapping, TOctetSearchFsm(pMapping->GetTable()), 0, 0, STimeings(),
+		STimeings()};
+	CRegisterSearch::TSearchData searchDataRegister = CRegisterSearch::InitEngine(m_patterns);
+
+	size_t nCapacity = m_patterns.size() * BITS_IN_BYTE;
+	TFindingsList findingsStorage(nCapacity * 2);
+	CFindingsBuffer finReg(findingsStorage.data(), nCapacity);
+	CFindingsBuffer finEngine(findingsStorage.data() + nCapacity, nCapacity);
+
+	CDoubleLcg lcg;
+	bool fCorrect = true;
+	unsigned int dwBytes;
+	for (dwBytes = 0; dwBytes < dwTestBytesCount && fCorrect; dwBytes++) {
+		unsigned char bData = lcg.RandomByte();
+		finReg.Clear();
+		CRegisterSearch::ProcessByte(bData, &searchDataRegister, &finReg);
+		finEngine.Clear();
+		CMappedFsmSearch::ProcessByte(bData, &searchData, &finEngine);
+		if (!AreEqual(finReg, finEngine)) {
+			puts("FAIL! Test register != Octet SearchFSM loaded from the file!");
+			fCorrect = false;
+		}
+	}
+	pMapping->Close();
+
+	// the files of other patterns or types and the damaged ones must be refused
+	typedef CSearchFsmByte<g_nByteLength, unsigned short, TOutputIdx> TOctetShortSearchFsm;
+	fCorrect = TestFileRefused<TOctetSearchFsm>(sFileName, CFsmCreator::bitOrder_MsbFirst, qwFingerprint + 1,
+		CFsmFile::status_PatternsMismatch, "of other patterns") && fCorrect;
+	fCorrect = TestFileRefused<TNibbleSearchFsm>(sFileName, CFsmCreator::bitOrder_MsbFirst, qwFingerprint,
+		CFsmFile::status_TypeMismatch, "of other stride") && fCorrect;
+	fCorrect = TestFileRefused<TOctetShortSearchFsm>(sFileName, CFsmCreator::bitOrder_MsbFirst, qwFingerprint,
+		CFsmFile::status_TypeMismatch, "of other state index width") && fCorrect;
+	fCorrect = TestFileRefused<TOctetSearchFsm>(sFileName, CFsmCreator::bitOrder_LsbFirst, qwFingerprint,
+		CFsmFile::status_TypeMismatch, "of other bit order") && fCorrect;
+
+	std::string sPartFileName = sFileName + ".part";
+	fCorrect = SaveFilePart(sFileName, sPartFileName, header.qwFileSize - 1) &&
+		TestFileRefused<TOctetSearchFsm>(sPartFileName, CFsmCreator::bitOrder_MsbFirst, qwFingerprint,
+		CFsmFile::status_BadFormat, "truncated") && fCorrect;
+	fCorrect = SaveFilePart(sFileName, sPartFileName, sizeof(CFsmFile::SHeader) / 2) &&
+		TestFileRefused<TOctetSearchFsm>(sPartFileName, CFsmCreator::bitOrder_MsbFirst, qwFingerprint,
+		CFsmFile::status_BadFormat, "truncated in the header") && fCorrect;
+
+	remove(sPartFileName.c_str());
+	remove(sFileName.c_str());
+	return fCorrect;
+}
+
+bool CFsmTest::TestParallelGeneration(int nThreads, CFsmTest::STimeings *pSequential, CFsmTest::STimeings *pParallel) {
+	// compare the tables generated sequentially and in parallel, they must be identical
+	CFsmCreator fsmSequential(m_patterns);
+	CFsmCreator fsmParallel(m_patterns);
+	try {
+		CTimer timer;
+		fsmSequential.GenerateTables();
+		timer.Stop();
+		*pSequential = GetTimings(timer);
+
+		timer.Start();
+		fsmParallel.GenerateTablesParallel(nThreads);
+		timer.Stop();
+		*pParallel = GetTimings(timer);
+	}
+	catch(...) {
+		puts("Failed to generate SearchFSM tables!");
+		return false;
+	}
+
+	bool fCorrect = (fsmSequential.GetStatesCount() == fsmParallel.GetStatesCount()) &&
+		(fsmSequential.GetCollisionsCount() == fsmParallel.GetCollisionsCount());
+	int nState;
+	for (nState = 0; nState < fsmSequential.GetStatesCount() && fCorrect; nState++) {
+		const CFsmCreator::STableRow &rowSequential = fsmSequential.GetTableRow(nState);
+		const CFsmCreator::STableRow &rowParallel = fsmParallel.GetTableRow(nState);
+		fCorrect = AreEqual(rowSequential.cell0, rowParallel.cell0) && AreEqual(rowSequential.cell1, rowParallel.cell1);
+	}
+	if (!fCorrect) {
+		puts("FAIL! Sequential SearchFSM tables != Parallel SearchFSM tables!");
+	}
+
 	return fCorrect;
 }
 
@@ -137,23 +622,213 @@ bool CFsmTest::TestBitFsmRate(unsigned int dwTestBytesCount, bool fOptimize, CFs
 }
 
 bool CFsmTest::TestNibbleFsmRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
+	if (!CheckTableBudget(g_nNibbleLength, pResult)) {
+		return false;
+	}
 	return TestEnginePerformance<CNibbleFsmSearch>(dwTestBytesCount, pResult);
 }
 
 bool CFsmTest::TestOctetFsmRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
+	if (!CheckTableBudget(g_nByteLength, pResult)) {
+		return false;
+	}
 	return TestEnginePerformance<COctetFsmSearch>(dwTestBytesCount, pResult);
 }
 
+bool CFsmTest::TestOctetClassedFsmRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
+	if (!CheckTableBudget(g_nByteLength, pResult)) {
+		return false;
+	}
+	return TestEnginePerformance<COctetClassedFsmSearch>(dwTestBytesCount, pResult);
+}
+
+bool CFsmTest::TestOctetCombFsmRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
+	if (!FitsCombTableBudget()) { // the comb is built where the dense table doesn't fit
+		pResult->fSuccess = false;
+		return false;
+	}
+	return TestEnginePerformance<COctetCombFsmSearch>(dwTestBytesCount, pResult);
+}
+
+bool CFsmTest::TestOctetSplitFsmRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
+	if (!CheckTableBudget(g_nByteLength, pResult)) {
+		return false;
+	}
+	return TestEnginePerformance<COctetSplitFsmSearch>(dwTestBytesCount, pResult);
+}
+
+bool CFsmTest::TestLazyFsmRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
+	return TestEnginePerformance<CLazyFsmSearch>(dwTestBytesCount, pResult);
+}
+
+bool CFsmTest::TestOctetFsmInterleavedRate(unsigned int dwTestBytesCount, int nStreams, bool fPrefetch,
+	CFsmTest::SEnginePerformance *pResult)
+{
+	if (!CheckTableBudget(g_nByteLength, pResult)) {
+		return false;
+	}
+	switch (nStreams) {
+	case 4:
+		return fPrefetch? TestInterleavedPerformance<4, true>(dwTestBytesCount, pResult) :
+			TestInterleavedPerformance<4, false>(dwTestBytesCount, pResult);
+	case 8:
+		return fPrefetch? TestInterleavedPerformance<8, true>(dwTestBytesCount, pResult) :
+			TestInterleavedPerformance<8, false>(dwTestBytesCount, pResult);
+	case 16:
+		return fPrefetch? TestInterleavedPerformance<16, true>(dwTestBytesCount, pResult) :
+			TestInterleavedPerformance<16, false>(dwTestBytesCount, pResult);
+	default: // unsupported streams count
+		pResult->fSuccess = false;
+		return false;
+	}
+}
+
+bool CFsmTest::TestOctetFsmParallelRate(unsigned int dwTestBytesCount, int nThreads, CFsmTest::SEnginePerformance *pResult) {
+	if (!CheckTableBudget(g_nByteLength, pResult)) {
+		return false;
+	}
+	try {
+		// prepare engine
+		CTimer timer;
+		COctetFsmSearch::TSearchData searchData = COctetFsmSearch::InitEngine(m_patterns);
+		timer.Stop();
+		SEnginePerformance performance;
+		performance.timInitialization = GetTimings(timer);
+		performance.dwMemoryRequirements = COctetFsmSearch::GetMemoryRequirements(searchData);
+		performance.fIsFsm = true;
+		performance.fsmStatistics = COctetFsmSearch::GetFsmStatistics(searchData);
+
+		// the generator is sequential, so the data is prepared in advance (and isn't timed)
+		std::vector<unsigned char> data = GenerateTestData(dwTestBytesCount);
+		CParallelSearchFsm<TOctetSearchFsm> fsm(searchData.wrap.fsm.GetTable(), GetWarmUpBytes());
+
+		// start test
+		timer.Start();
+		CHitsCounter counter;
+		fsm.Scan(data.data(), data.size(), counter, nThreads);
+		timer.Stop();
+		performance.timOperating = GetTimings(timer);
+		performance.qwBytesCount = dwTestBytesCount;
+		performance.qwHits = counter.GetHitsCount();
+
+		performance.fSuccess = true;
+		*pResult = performance;
+	}
+	catch(...) {
+		pResult->fSuccess = false;
+		return false;
+	}
+
+	return true;
+}
+
+bool CFsmTest::TestMinimalTypesFsmRate(unsigned int dwTestBytesCount, int nBitsAtOnce, CFsmTest::SEnginePerformance *pResult) {
+	if (!CheckTableBudget(nBitsAtOnce, pResult)) {
+		return false;
+	}
+	switch (nBitsAtOnce) {
+	case g_nNibbleLength:
+		return TestMinimalTypesPerformance<g_nNibbleLength>(dwTestBytesCount, pResult);
+	case g_nByteLength:
+		return TestMinimalTypesPerformance<g_nByteLength>(dwTestBytesCount, pResult);
+	default: // unsupported stride
+		pResult->fSuccess = false;
+		return false;
+	}
+}
+
+bool CFsmTest::TestOctetFsmFileRate(unsigned int dwTestBytesCount, const std::string &sFileName,
+	CFsmTest::SEnginePerformance *pResult)
+{
+	if (!CheckTableBudget(g_nByteLength, pResult)) {
+		return false;
+	}
+	try {
+		// build the tables and save them (isn't a part of the initialization)
+		uint64_t qwFingerprint = CFsmFile::GetPatternsFingerprint(m_patterns);
+		COctetFsmSearch::TSearchData octetData = COctetFsmSearch::InitEngine(m_patterns);
+		if (CFsmFile::Save<TOctetSearchFsm>(sFileName, octetData.wrap.fsm.GetTable(), CFsmCreator::bitOrder_MsbFirst,
+			qwFingerprint) != CFsmFile::status_Ok)
+		{
+			pResult->fSuccess = false;
+			return false;
+		}
+
+		// prepare engine: map the file
+		CTimer timer;
+		std::shared_ptr<CMappedFsmSearch::TMapping> pMapping(new CMappedFsmSearch::TMapping);
+		CFsmFile::EStatus status = pMapping->Open(sFileName, CFsmCreator::bitOrder_MsbFirst, qwFingerprint);
+		timer.Stop();
+		if (status != CFsmFile::status_Ok) {
+			remove(sFileName.c_str());
+			pResult->fSuccess = false;
+			return false;
+		}
+		SEnginePerformance performance;
+		performance.timInitialization = GetTimings(timer);
+
+		CMappedFsmSearch::TSearchData searchData = {pMapping, TOctetSearchFsm(pMapping->GetTable()),
+			octetData.dwUnoptimizedStatesCount, 0, octetData.timTablesGeneration, performance.timInitialization};
+		MeasureEnginePerformance<CMappedFsmSearch>(dwTestBytesCount, &searchData, &performance);
+		*pResult = performance;
+	}
+	catch(...) {
+		remove(sFileName.c_str());
+		pResult->fSuccess = false;
+		return false;
+	}
+
+	remove(sFileName.c_str());
+	return true;
+}
+
 bool CFsmTest::TestRegisterRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
 	return TestEnginePerformance<CRegisterSearch>(dwTestBytesCount, pResult);
 }
 
+bool CFsmTest::TestBitapRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
+	return TestEnginePerformance<CBitapSearch>(dwTestBytesCount, pResult);
+}
+
+bool CFsmTest::TestRegisterMatcherRate(unsigned int dwTestBytesCount, CFsmTest::SEnginePerformance *pResult) {
+	return TestEnginePerformance<CRegisterMatcherSearch>(dwTestBytesCount, pResult);
+}
+
+bool CFsmTest::TestFsmWrapRate(unsigned int dwTestBytesCount, const CFsmCreator &creator,
+	const CFsmCreator::SFsmWrap<TBitSearchFsm> &wrap, CFsmTest::SEnginePerformance *pResult)
+{
+	return TestWrapPerformance<TBitSearchFsm>(dwTestBytesCount, creator, wrap, pResult);
+}
+
+bool CFsmTest::TestFsmWrapRate(unsigned int dwTestBytesCount, const CFsmCreator &creator,
+	const CFsmCreator::SFsmWrap<TNibbleSearchFsm> &wrap, CFsmTest::SEnginePerformance *pResult)
+{
+	return TestWrapPerformance<TNibbleSearchFsm>(dwTestBytesCount, creator, wrap, pResult);
+}
+
+bool CFsmTest::TestFsmWrapRate(unsigned int dwTestBytesCount, const CFsmCreator &creator,
+	const CFsmCreator::SFsmWrap<TOctetSearchFsm> &wrap, CFsmTest::SEnginePerformance *pResult)
+{
+	return TestWrapPerformance<TOctetSearchFsm>(dwTestBytesCount, creator, wrap, pResult);
+}
+
 // table size calculating methods
 template <class TSearchFsm>
 CFsmTest::SFsmTableSize CFsmTest::GetTableSize(const CFsmCreator::SFsmWrap<TSearchFsm> &wrap) {
+	return GetTableSize<TSearchFsm>(wrap.fsm.GetTable());
+}
+
+template <class TSearchFsm>
+CFsmTest::SFsmTableSize CFsmTest::GetMinimalTableSize(const CFsmCreator::SFsmWrap<TSearchFsm> &wrap) {
+	return GetMinimalTableSize<TSearchFsm>(wrap.fsm.GetTable());
+}
+
+template <class TSearchFsm>
+CFsmTest::SFsmTableSize CFsmTest::GetTableSize(const typename TSearchFsm::STable &table) {
 	SFsmTableSize size;
-	size.dwMainTableSize = wrap.m_rows.count() * sizeof(typename TSearchFsm::STableRow);
-	size.dwOutputTableSize = wrap.m_outputTable.count() * sizeof(typename TSearchFsm::TOutput);
+	size.dwMainTableSize = (unsigned int)table.statesCount * sizeof(typename TSearchFsm::STableRow);
+	size.dwColdTableSize = 0;
+	size.dwOutputTableSize = (unsigned int)table.outputsCount * sizeof(typename TSearchFsm::TOutput);
 	size.dwTotalSize = size.dwMainTableSize + size.dwOutputTableSize + sizeof(typename TSearchFsm::STable);
 
 	return size;
@@ -161,47 +836,19 @@ CFsmTest::SFsmTableSize CFsmTest::GetTableSize(const CFsmCreator::SFsmWrap<TSear
 }
 
 template <class TSearchFsm>
-CFsmTest::SFsmTableSize CFsmTest::GetMinimalTableSize(const CFsmCreator::SFsmWrap<TSearchFsm> &wrap) {
+CFsmTest::SFsmTableSize CFsmTest::GetMinimalTableSize(const typename TSearchFsm::STable &table) {
 	SFsmTableSize size;
-	unsigned int dwStatesCount = wrap.m_rows.count();
-	unsigned int dwOutputsCount = wrap.m_outputTable.count();
-	//	struct STableCell {
-	//		TStateIdx idxNextState;
-	//		TOutputIdx idxOutput;
-	//	};
-	unsigned int dwStateIndexSize = GetMinimalDataSize(dwStatesCount - 1);
-	// mustn't forget about CSearchFsm::sm_outputNull
-	unsigned int dwOutputIndexSize = GetMinimalDataSize(dwOutputsCount);
+	CFsmCreator::SIndexSizes sizes = CFsmCreator::GetTableIndexSizes<TSearchFsm>(table);
+	unsigned int dwStatesCount = table.statesCount;
+	unsigned int dwOutputsCount = table.outputsCount;
 	// table cell contains next state index and output index, and
-	unsigned int dwTableCellSize = dwStateIndexSize + dwOutputIndexSize;
+	unsigned int dwTableCellSize = sizes.nStateIdxSize + sizes.nOutputIdxSize;
 	unsigned int dwRowSize = dwTableCellSize * TSearchFsm::g_nColumnsCount;
 	size.dwMainTableSize = dwStatesCount * dwRowSize;
+	size.dwColdTableSize = 0;
 
-	//	struct SOutput {
-	//		TPatternIdx patternIdx;
-	//		TStepBack stepBack;
-	//		TErrorsCount errorsCount;
-	//		TOutputIdx idxNextOutput;
-	//	};
-	unsigned int dwMaxPatternIdx = 0, dwMaxStepBack = 0, dwMaxErrors = 0;
-	int idx;
-	for (idx = 0; idx < wrap.m_outputTable.count(); idx++) {
-		const typename TSearchFsm::TOutput& out = wrap.m_outputTable[idx];
-		if (dwMaxPatternIdx < out.patternIdx) {
-			dwMaxPatternIdx = out.patternIdx;
-		}
-		if (dwMaxStepBack < out.stepBack) {
-			dwMaxStepBack = out.stepBack;
-		}
-		if (dwMaxErrors < out.errorsCount) {
-			dwMaxErrors = out.errorsCount;
-		}
-	}
-	unsigned int dwPatternIdxSize = GetMinimalDataSize(dwMaxPatternIdx);
-	unsigned int dwStepBackSize = GetMinimalDataSize(dwMaxStepBack);
-	unsigned int dwErrorsSize = GetMinimalDataSize(dwMaxErrors);
-	unsigned int dwOutputCellSize = dwPatternIdxSize + dwStepBackSize + dwErrorsSize + dwOutputIndexSize;
-
+	// output cell contains pattern index, step back, errors count and next output index
+	unsigned int dwOutputCellSize = sizes.nPatternIdxSize + sizes.nStepBackSize + sizes.nErrorsCountSize + sizes.nOutputIdxSize;
 	size.dwOutputTableSize = dwOutputsCount * dwOutputCellSize;
 	size.dwTotalSize = size.dwMainTableSize + size.dwOutputTableSize + sizeof(typename TSearchFsm::STable);
 
@@ -214,7 +861,7 @@ CFsmTest::SPatternsStats CFsmTest::AnalysePatterns(const TPatterns &patterns) {
 	result.nMaxLength = 0;
 	result.nMaxErrorsCount = 0;
 	int idx;
-	for (idx = 0; idx < patterns.count(); idx++) {
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
 		int nLength = patterns[idx].nLength;
 		if (result.nMaxLength < nLength) {
 			result.nMaxLength = nLength;
@@ -229,61 +876,242 @@ CFsmTest::SPatternsStats CFsmTest::AnalysePatterns(const TPatterns &patterns) {
 	return result;
 }
 
-unsigned int CFsmTest::GetMinimalDataSize(unsigned int nMaxValue) {
-	if (nMaxValue <= 0xff) { // single-byte integer is enough
-		return 1;
-	} else if (nMaxValue <= 0xffff) { // two-byte integer is enough
-		return 2;
-	} else if (nMaxValue <= 0xffffffff){ // four-byte integer is enough
-		return 4;
-	} else {
-		return 8;
+std::vector<unsigned char> CFsmTest::GenerateTestData(unsigned int dwBytesCount) {
+	std::vector<unsigned char> data(dwBytesCount);
+	unsigned char *pData = data.data();
+	CLcg lcg;
+	unsigned int dwBytes;
+	for (dwBytes = 0; dwBytes < dwBytesCount; dwBytes++) {
+		pData[dwBytes] = lcg.RandomByte();
+	}
+
+	return data;
+}
+
+unsigned int CFsmTest::GetWarmUpBytes() const {
+	// SearchFSM state depends on the last (max pattern length) bits only
+	return AnalysePatterns(m_patterns).nMaxLength / BITS_IN_BYTE + 1;
+}
+
+const CFsmCreator::SSizeEstimate& CFsmTest::GetSizeEstimate() {
+	// the estimation is made once, it costs a fraction of the SearchFSM generation
+	if (!m_fSizeEstimated) {
+		CFsmCreator creator(m_patterns);
+		m_sizeEstimate = creator.EstimateSize();
+		m_fSizeEstimated = true;
+	}
+
+	return m_sizeEstimate;
+}
+
+bool CFsmTest::FitsTableBudget(int nBitsAtOnce, uint64_t *pqwPredictedBytes) {
+	const CFsmCreator::SSizeEstimate &estimate = GetSizeEstimate();
+	uint64_t qwBytes = estimate.qwBitTableBytes;
+	if (nBitsAtOnce == g_nNibbleLength) {
+		qwBytes = estimate.qwNibbleTableBytes;
+	} else if (nBitsAtOnce == g_nByteLength) {
+		qwBytes = estimate.qwOctetTableBytes;
+	}
+	if (pqwPredictedBytes != NULL) {
+		*pqwPredictedBytes = qwBytes;
+	}
+
+	// the engines are generated without the states budget, so the prediction is taken with the margin
+	uint64_t qwSafeStates = std::min(estimate.qwStatesCount * CFsmCreator::g_nEstimateSafetyFactor,
+		estimate.qwMaxStatesCount);
+	return CFsmCreator::GetTableBytes(qwSafeStates, nBitsAtOnce) <= g_qwMaxTableBytes;
+}
+
+bool CFsmTest::FitsCombTableBudget(uint64_t *pqwPredictedBytes) {
+	const CFsmCreator::SSizeEstimate &estimate = GetSizeEstimate();
+	if (pqwPredictedBytes != NULL) {
+		*pqwPredictedBytes = estimate.qwOctetCombTableBytes;
+	}
+
+	uint64_t qwSafeStates = std::min(estimate.qwStatesCount * CFsmCreator::g_nEstimateSafetyFactor,
+		estimate.qwMaxStatesCount);
+	return CFsmCreator::GetCombTableBytes(qwSafeStates, g_nByteLength) <= g_qwMaxTableBytes;
+}
+
+bool CFsmTest::CheckTableBudget(int nBitsAtOnce, CFsmTest::SEnginePerformance *pResult) {
+	if (!FitsTableBudget(nBitsAtOnce)) {
+		pResult->fSuccess = false;
+		return false;
 	}
+
+	return true;
 }
 
 template <class TSearchEngine>
 bool CFsmTest::TestEnginePerformance(unsigned int dwTestBytesCount, SEnginePerformance *pResult) {
 	try {
 		// prepare engine
-		CWinTimer timer;
+		CTimer timer;
 		typename TSearchEngine::TSearchData searchData = TSearchEngine::InitEngine(m_patterns);
 		timer.Stop();
 		SEnginePerformance performance;
 		performance.timInitialization = GetTimings(timer);
-		performance.dwMemoryRequirements = TSearchEngine::GetMemoryRequirements(searchData);
-		performance.fIsFsm = TSearchEngine::IsFsm();
-		if (performance.fIsFsm) {
-			performance.fsmStatistics = TSearchEngine::GetFsmStatistics(searchData);
-		}
+		MeasureEnginePerformance<TSearchEngine>(dwTestBytesCount, &searchData, &performance);
+		*pResult = performance;
+	}
+	catch(...) {
+		pResult->fSuccess = false;
+		return false;
+	}
+
+	return true;
+}
+
+template <class TSearchEngine>
+void CFsmTest::MeasureEnginePerformance(unsigned int dwTestBytesCount, typename TSearchEngine::TSearchData *pSearchData,
+	SEnginePerformance *pPerformance)
+{
+	SEnginePerformance &performance = *pPerformance;
+	typename TSearchEngine::TSearchData &searchData = *pSearchData;
+	performance.dwMemoryRequirements = TSearchEngine::GetMemoryRequirements(searchData);
+	performance.fIsFsm = TSearchEngine::IsFsm();
+	if (performance.fIsFsm) {
+		performance.fsmStatistics = TSearchEngine::GetFsmStatistics(searchData);
+	}
+
+	// preparing the test
+	unsigned int dwCheckLengthBytes = AnalysePatterns(m_patterns).nMaxLength / BITS_IN_BYTE + 1;
+	if (dwTestBytesCount < dwCheckLengthBytes) {
+		dwCheckLengthBytes = dwTestBytesCount;
+	}
+
+	// the findings of a byte, a pattern is found once a bit at most
+	size_t nCapacity = m_patterns.size() * BITS_IN_BYTE;
+	TFindingsList findingsStorage(nCapacity);
+	CFindingsBuffer findings(findingsStorage.data(), nCapacity);
+
+	// start test
+	CLcg lcg;
+	CTimer timer;
+	uint64_t cHits = 0;
+	unsigned int dwBytes;
+	for (dwBytes = 0; dwBytes < dwCheckLengthBytes; dwBytes++) {
+		unsigned char bData = lcg.RandomByte();
+		findings.Clear();
+		TSearchEngine::ProcessByte(bData, &searchData, &findings);
+		cHits += findings.GetCount() + findings.GetDroppedCount();
+	}
+	for (; dwBytes < dwTestBytesCount; dwBytes++) {
+		unsigned char bData = lcg.RandomByte();
+		cHits += TSearchEngine::ProcessByteIdle(bData, &searchData);
+	}
+	timer.Stop();
+	performance.timOperating = GetTimings(timer);
+	performance.qwBytesCount = dwTestBytesCount;
+	performance.qwHits = cHits;
+
+	performance.fSuccess = true;
+}
+
+template <class TSearchFsm>
+bool CFsmTest::TestWrapPerformance(unsigned int dwTestBytesCount, const CFsmCreator &creator,
+	const CFsmCreator::SFsmWrap<TSearchFsm> &wrap, SEnginePerformance *pResult)
+{
+	try {
+		// the engine is ready, it takes no initialization
+		typename CWrapFsmSearch<TSearchFsm>::TSearchData data = {wrap, creator.GetCollisionsCount(),
+			(unsigned int)creator.GetUnoptimizedStatesCount(), 0, STimeings(), STimeings()};
+		data.wrap.fsm.Reset();
+		SEnginePerformance performance;
+		performance.timInitialization = STimeings();
+		MeasureEnginePerformance<CWrapFsmSearch<TSearchFsm> >(dwTestBytesCount, &data, &performance);
+		*pResult = performance;
+	}
+	catch(...) {
+		pResult->fSuccess = false;
+		return false;
+	}
+
+	return true;
+}
+
+template <int nBitsAtOnce>
+bool CFsmTest::TestMinimalTypesPerformance(unsigned int dwTestBytesCount, SEnginePerformance *pResult) {
+	try {
+		// prepare engine, the index types are chosen at run time
+		CTimer timer, timerStage;
+		CFsmCreator fsm(m_patterns);
+		fsm.GenerateTables();
+		fsm.MinimizeTables();
+		timerStage.Stop();
+		STimeings timTablesGeneration = GetTimings(timerStage);
+		timerStage.Start();
+		CSearchFsmAuto<nBitsAtOnce> fsmAuto(fsm);
+		timerStage.Stop();
+		timer.Stop();
+		SEnginePerformance performance;
+		performance.timInitialization = GetTimings(timer);
+
+		// measure the concrete SearchFSM
+		CMeasureVisitor visitor(this, dwTestBytesCount, fsm, timTablesGeneration, GetTimings(timerStage), &performance);
+		fsmAuto.Dispatch(visitor);
+		*pResult = performance;
+	}
+	catch(...) {
+		pResult->fSuccess = false;
+		return false;
+	}
+
+	return true;
+}
+
+template <int nStreams, bool fPrefetch>
+bool CFsmTest::TestInterleavedPerformance(unsigned int dwTestBytesCount, SEnginePerformance *pResult) {
+	const unsigned int g_dwBlockBytes = 4096; // bytes generated for each stream at once
+
+	try {
+		// prepare engine (the same octet SearchFSM for all the streams)
+		CTimer timer;
+		COctetFsmSearch::TSearchData searchData = COctetFsmSearch::InitEngine(m_patterns);
+		timer.Stop();
+		SEnginePerformance performance;
+		performance.timInitialization = GetTimings(timer);
+		performance.dwMemoryRequirements = COctetFsmSearch::GetMemoryRequirements(searchData);
+		performance.fIsFsm = true;
+		performance.fsmStatistics = COctetFsmSearch::GetFsmStatistics(searchData);
 
-		// preparing the test
-		unsigned int dwCheckLengthBytes = AnalysePatterns(m_patterns).nMaxLength / BITS_IN_BYTE + 1;
-		if (dwTestBytesCount < dwCheckLengthBytes) {
-			dwCheckLengthBytes = dwTestBytesCount;
+		// each stream has its own generator, data block and state
+		CLcg lcgs[nStreams];
+		std::vector<unsigned char> blocks(nStreams * g_dwBlockBytes);
+		unsigned char *pBlocks = blocks.data();
+		const unsigned char *ppData[nStreams];
+		TOctetSearchFsm::TStateIdx states[nStreams];
+		int nStream;
+		for (nStream = 0; nStream < nStreams; nStream++) {
+			lcgs[nStream].Reset(nStream);
+			ppData[nStream] = pBlocks + nStream * g_dwBlockBytes;
+			states[nStream] = 0;
 		}
+		const TOctetSearchFsm::STable &table = searchData.wrap.fsm.GetTable();
+		unsigned int dwStreamBytes = dwTestBytesCount / nStreams;
 
 		// start test
-		CLcg lcg;
 		timer.Start();
-		unsigned int cHits = 0;
+		CHitsCounter counter;
 		unsigned int dwBytes;
-		for (dwBytes = 0; dwBytes < dwCheckLengthBytes; dwBytes++) {
-			unsigned char bData = lcg.RandomByte();
-			unsigned int dwMask = (int)cHits >> 31; // either all ones or null
-			TFindingsList findings = TSearchEngine::ProcessByte(bData, &searchData);
-			cHits += findings.count();
-			cHits |= dwMask;
-		}
-		for (; dwBytes < dwTestBytesCount; dwBytes++) {
-			unsigned char bData = lcg.RandomByte();
-			unsigned int dwMask = (int)cHits >> 31; // either all ones or null
-			cHits += TSearchEngine::ProcessByteIdle(bData, &searchData);
-			cHits |= dwMask;
+		for (dwBytes = 0; dwBytes < dwStreamBytes; dwBytes += g_dwBlockBytes) {
+			unsigned int dwBlockBytes = dwStreamBytes - dwBytes;
+			if (dwBlockBytes > g_dwBlockBytes) {
+				dwBlockBytes = g_dwBlockBytes;
+			}
+			for (nStream = 0; nStream < nStreams; nStream++) {
+				unsigned char *pBlock = pBlocks + nStream * g_dwBlockBytes;
+				unsigned int idx;
+				for (idx = 0; idx < dwBlockBytes; idx++) {
+					pBlock[idx] = lcgs[nStream].RandomByte();
+				}
+			}
+			TOctetSearchFsm::ScanInterleaved<nStreams, fPrefetch>(table, states, ppData, dwBlockBytes, counter);
 		}
 		timer.Stop();
 		performance.timOperating = GetTimings(timer);
-		performance.dwBytesCount = dwTestBytesCount;
-		performance.dwHits = cHits;
+		performance.qwBytesCount = (uint64_t)dwStreamBytes * nStreams;
+		performance.qwHits = counter.GetHitsCount();
 
 		performance.fSuccess = true;
 		*pResult = performance;
@@ -296,11 +1124,190 @@ bool CFsmTest::TestEnginePerformance(unsigned int dwTestBytesCount, SEnginePerfo
 	return true;
 }
 
+template <int nStreams, bool fPrefetch>
+bool CFsmTest::TestInterleavedStreams(const TOctetSearchFsm::STable &table, const std::vector<unsigned char> &data) {
+	const size_t g_nBlockBytes = 1000; // not a power of 2, the last block is shorter
+
+	// each stream is a slice of the data
+	size_t nStreamBytes = data.size() / nStreams;
+	const size_t nCapacity = 4096;
+	TFindingsList findingsStorage(nCapacity);
+	std::vector<TFindingsList> finSequential(nStreams);
+	TOctetSearchFsm::TStateIdx statesSequential[nStreams];
+	int nStream;
+	for (nStream = 0; nStream < nStreams; nStream++) {
+		CFindingsBuffer buffer(findingsStorage.data(), nCapacity, &AppendFindings, &finSequential[nStream]);
+		TOctetSearchFsm fsm(table);
+		fsm.Scan(data.data() + nStream * nStreamBytes, nStreamBytes, buffer);
+		buffer.Flush();
+		statesSequential[nStream] = fsm.GetState();
+	}
+
+	// the streams are scanned by blocks, the states are kept between them
+	std::vector<TFindingsList> finInterleaved(nStreams);
+	TOctetSearchFsm::TStateIdx states[nStreams];
+	const unsigned char *ppData[nStreams];
+	for (nStream = 0; nStream < nStreams; nStream++) {
+		states[nStream] = 0;
+	}
+	size_t nBytes;
+	for (nBytes = 0; nBytes < nStreamBytes; nBytes += g_nBlockBytes) {
+		size_t nBlockBytes = nStreamBytes - nBytes;
+		if (nBlockBytes > g_nBlockBytes) {
+			nBlockBytes = g_nBlockBytes;
+		}
+		for (nStream = 0; nStream < nStreams; nStream++) {
+			ppData[nStream] = data.data() + nStream * nStreamBytes + nBytes;
+		}
+		SStreamsSink sink = {&finInterleaved, (uint64_t)nBytes * BITS_IN_BYTE};
+		TOctetSearchFsm::ScanInterleaved<nStreams, fPrefetch>(table, states, ppData, nBlockBytes, sink);
+	}
+
+	bool fCorrect = true;
+	for (nStream = 0; nStream < nStreams && fCorrect; nStream++) {
+		fCorrect = AreEqual(finSequential[nStream], finInterleaved[nStream]) && (states[nStream] == statesSequential[nStream]);
+	}
+	if (!fCorrect) {
+		printf("FAIL! Octet SearchFSM != Interleaved Octet SearchFSM (%i streams%s)!\n", nStreams,
+			fPrefetch? ", prefetch" : "");
+	}
+
+	return fCorrect;
+}
+
+template <class TSearchFsm>
+bool CFsmTest::TestCursors(const CCompiledFsm<TSearchFsm> &compiled, const std::vector<unsigned char> &data, int nChannels,
+	const char *szName)
+{
+	// each channel is a slice of the data
+	size_t nChannelBytes = data.size() / nChannels;
+	const size_t nCapacity = 4096;
+	TFindingsList findingsStorage(nCapacity);
+	std::vector<TFindingsList> finSequential(nChannels);
+	std::vector<typename TSearchFsm::TStateIdx> statesSequential(nChannels);
+	int nChannel;
+	for (nChannel = 0; nChannel < nChannels; nChannel++) {
+		CFindingsBuffer buffer(findingsStorage.data(), nCapacity, &AppendFindings, &finSequential[nChannel]);
+		TSearchFsm fsm(compiled.GetTable());
+		fsm.Scan(data.data() + nChannel * nChannelBytes, nChannelBytes, buffer);
+		buffer.Flush();
+		statesSequential[nChannel] = fsm.GetState();
+	}
+
+	// the channels are advanced by pieces of different lengths, as the packets come
+	std::vector<TFindingsList> finBatch(nChannels);
+	SStreamsSink sink = {&finBatch, 0};
+	std::vector<typename CCompiledFsm<TSearchFsm>::SOffsetCursor> cursors(nChannels);
+	std::vector<const unsigned char*> pieces(nChannels);
+	std::vector<size_t> piecesBytes(nChannels);
+	for (nChannel = 0; nChannel < nChannels; nChannel++) {
+		compiled.Reset(&cursors[nChannel]);
+	}
+	bool fScanned = false;
+	int nRound;
+	for (nRound = 0; !fScanned; nRound++) {
+		fScanned = true;
+		for (nChannel = 0; nChannel < nChannels; nChannel++) {
+			size_t nDone = (size_t)(cursors[nChannel].qwBitsProcessed / BITS_IN_BYTE);
+			size_t nPiece = (nRound * 7 + nChannel * 13) % 97;
+			if (nPiece > nChannelBytes - nDone) {
+				nPiece = nChannelBytes - nDone;
+			}
+			pieces[nChannel] = data.data() + nChannel * nChannelBytes + nDone;
+			piecesBytes[nChannel] = nPiece;
+			fScanned = fScanned && (nDone + nPiece == nChannelBytes);
+		}
+		compiled.ScanBatch(cursors.data(), pieces.data(), piecesBytes.data(), cursors.size(), sink);
+	}
+
+	bool fCorrect = true;
+	for (nChannel = 0; nChannel < nChannels && fCorrect; nChannel++) {
+		fCorrect = AreEqual(finSequential[nChannel], finBatch[nChannel]) &&
+			(cursors[nChannel].state == statesSequential[nChannel]);
+	}
+	if (!fCorrect) {
+		printf("FAIL! %s != %s cursors!\n", szName, szName);
+	}
+
+	return fCorrect;
+}
+
+template <class TSearchFsm>
+bool CFsmTest::TestFileRefused(const std::string &sFileName, CFsmCreator::EBitOrder bitOrder, uint64_t qwFingerprint,
+	CFsmFile::EStatus statusExpected, const char *szCase)
+{
+	CFsmFileMapping<TSearchFsm> mapping;
+	CFsmFile::EStatus status = mapping.Open(sFileName, bitOrder, qwFingerprint);
+	if (status != statusExpected || mapping.IsOpen()) {
+		printf("FAIL! The file %s is loaded with status %i, %i expected!\n", szCase, (int)status, (int)statusExpected);
+		return false;
+	}
+
+	return true;
+}
+
+bool CFsmTest::SaveFilePart(const std::string &sFileName, const std::string &sPartFileName, uint64_t qwBytes) {
+	// copy the first qwBytes of the file
+	std::vector<unsigned char> data((size_t)qwBytes);
+	FILE *pFile = fopen(sFileName.c_str(), "rb");
+	if (pFile == NULL) {
+		return false;
+	}
+	bool fSuccess = fread(data.data(), 1, data.size(), pFile) == data.size();
+	fclose(pFile);
+
+	pFile = fopen(sPartFileName.c_str(), "wb");
+	if (pFile == NULL) {
+		return false;
+	}
+	fSuccess = fwrite(data.data(), 1, data.size(), pFile) == data.size() && fSuccess;
+	fSuccess = (fclose(pFile) == 0) && fSuccess;
+	if (!fSuccess) {
+		puts("Failed to copy the file!");
+	}
+
+	return fSuccess;
+}
+
+void CFsmTest::PlantPattern(const SPattern &pattern, int nErrors, uint64_t qwBitOffset, std::vector<unsigned char> *pData) {
+	// the bits are scanned from MSB of each byte, the errors are spread over the pattern
+	int nBit;
+	for (nBit = 0; nBit < pattern.nLength; nBit++) {
+		unsigned char bBit = GetBit(pattern, nBit);
+		if (nErrors > 0 && nBit % (pattern.nLength / nErrors + 1) == 0) {
+			bBit ^= 1;
+		}
+		uint64_t qwBit = qwBitOffset + nBit;
+		unsigned char bMask = (unsigned char)(0x80 >> (qwBit % BITS_IN_BYTE));
+		unsigned char &bData = (*pData)[(size_t)(qwBit / BITS_IN_BYTE)];
+		bData = bBit? (bData | bMask) : (bData & ~bMask);
+	}
+}
+
+void CFsmTest::AppendFindings(void *pList, const SFinding *pFindings, size_t nCount) {
+	TFindingsList *pFindingsList = static_cast<TFindingsList*>(pList);
+	pFindingsList->insert(pFindingsList->end(), pFindings, pFindings + nCount);
+}
+
+bool CFsmTest::AreEqual(const CFindingsBuffer &findings1, const CFindingsBuffer &findings2) {
+	if (findings1.GetCount() != findings2.GetCount() || findings1.GetDroppedCount() != findings2.GetDroppedCount()) {
+		return false;
+	}
+	size_t idx;
+	for (idx = 0; idx < findings1.GetCount(); idx++) {
+		if (!AreEqual(findings1[idx], findings2[idx])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool CFsmTest::AreEqual(const TFindingsList &list1, const TFindingsList &list2) {
-	if (list1.count() != list2.count()) {
+	if ((int)list1.size() != (int)list2.size()) {
 		return false;
 	}
-	int idx, nCount = list1.count();
+	int idx, nCount = (int)list1.size();
 	for (idx = 0; idx < nCount; idx++) {
 		if (!AreEqual(list1[idx], list2[idx])) {
 			return false;
@@ -312,15 +1319,34 @@ bool CFsmTest::AreEqual(const TFindingsList &list1, const TFindingsList &list2)
 
 bool CFsmTest::AreEqual(const SFinding &finding1, const SFinding &finding2) {
 	return (finding1.nPatternIdx == finding2.nPatternIdx) &&
-		(finding1.nErrors == finding2.nErrors) && (finding1.dwPosition == finding2.dwPosition);
+		(finding1.nErrors == finding2.nErrors) && (finding1.qwPosition == finding2.qwPosition);
+}
+
+bool CFsmTest::AreEqual(const CFsmCreator::STableCell &cell1, const CFsmCreator::STableCell &cell2) {
+	if (cell1.nNextState != cell2.nNextState || (int)cell1.output.size() != (int)cell2.output.size()) {
+		return false;
+	}
+
+	int idx;
+	for (idx = 0; idx < (int)cell1.output.size(); idx++) {
+		const CFsmCreator::SOutput &output1 = cell1.output[idx];
+		const CFsmCreator::SOutput &output2 = cell2.output[idx];
+		if (output1.nPatternIdx != output2.nPatternIdx || output1.nErrors != output2.nErrors ||
+			output1.nStepBack != output2.nStepBack)
+		{
+			return false;
+		}
+	}
+
+	return true;
 }
 
-void CFsmTest::DumpFinding(int nBitsProcessed, const TBitSearchFsm::TOutput &out) {
-	int nPosition = nBitsProcessed - out.stepBack;
+void CFsmTest::DumpFinding(uint64_t qwBitsProcessed, const TBitSearchFsm::TOutput &out) {
+	long long nPosition = (long long)qwBitsProcessed - (long long)out.stepBack; // negative before the data beginning
 	if (out.errorsCount == 0) {
-		printf("#%i at %i", out.patternIdx, nPosition);
+		printf("#%i at %lld", out.patternIdx, nPosition);
 	} else {
-		printf("#%i at %i (%i errors)", out.patternIdx, nPosition, out.errorsCount);
+		printf("#%i at %lld (%i errors)", out.patternIdx, nPosition, out.errorsCount);
 	}
 
 	if (out.idxNextOutput != TBitSearchFsm::sm_outputNull) {
@@ -329,10 +1355,11 @@ void CFsmTest::DumpFinding(int nBitsProcessed, const TBitSearchFsm::TOutput &out
 }
 
 // Ancillary functions
-CFsmTest::STimeings GetTimings(const CWinTimer &timer) {
+CFsmTest::STimeings GetTimings(const CTimer &timer) {
 	CFsmTest::STimeings results;
 	results.dTotalTime = timer.GetTotalDuration();
 	results.dCpuTime = timer.GetThreadDuration();
+	results.dUserTime = timer.GetUserDuration();
 	results.dKernelTime = timer.GetKernelDuration();
 	return results;
 }
@@ -3,10 +3,18 @@
 #ifndef FSMTEST_H
 #define FSMTEST_H
 
-#include <QVector>
+#include <string>
+#include <vector>
 
 #include "../SearchFSM/SearchFsm.h"
+#include "../SearchFSM/CompiledFsm.h"
+#include "../SearchFSM/SearchFsmClassed.h"
+#include "../SearchFSM/SearchFsmComb.h"
+#include "../SearchFSM/SearchFsmSplit.h"
+#include "../SearchFSM/LazySearchFsm.h"
 #include "../SearchFSM/FsmCreator.h"
+#include "../SearchFSM/FsmFile.h"
+#include "../SearchFSM/FindingsBuffer.h"
 
 class CFsmTest {
 public:
@@ -17,39 +25,51 @@ public:
 	// constants
 	static const int g_nNibbleLength = 4;
 	static const int g_nByteLength = 8;
+	static const int g_nLazyFsmMaxStates = 4096; // cache limit of the SearchFSM built on demand
+	static const uint64_t g_qwMaxTableBytes = (uint64_t)1 << 30; // the predicted larger tables aren't built
+	static const int g_nPlantedCopies = 16; // of each pattern in the data of TestAutoCorrectness
 
 	// FSM types
 	typedef CSearchFsm<TStateIdx, TOutputIdx> TBitSearchFsm;
 	typedef CSearchFsmByte<g_nNibbleLength, TStateIdx, TOutputIdx> TNibbleSearchFsm;
 	typedef CSearchFsmByte<g_nByteLength, TStateIdx, TOutputIdx> TOctetSearchFsm;
+	typedef CSearchFsmClassed<g_nByteLength, TStateIdx, TOutputIdx> TOctetClassedSearchFsm;
+	typedef CSearchFsmComb<g_nByteLength, TStateIdx, TOutputIdx> TOctetCombSearchFsm;
+	typedef CSearchFsmSplit<g_nByteLength, TStateIdx, TOutputIdx> TOctetSplitSearchFsm;
 
 	// time measurement results structure
 	struct STimeings { // tim
 		long double dTotalTime;
-		long double dCpuTime;
+		long double dCpuTime; // of the thread
+		long double dUserTime; // of the process, as the kernel time
 		long double dKernelTime;
 	};
 
 	struct SFsmTableSize {
 		unsigned int dwTotalSize;
 		unsigned int dwMainTableSize;
+		unsigned int dwColdTableSize; // rarely accessed part of the main table, if it is split
 		unsigned int dwOutputTableSize;
 	};
 
 	struct SFsmStatistics {
 		unsigned int dwStatesCount;
+		unsigned int dwUnoptimizedStatesCount; // states count before optimization or minimization
 		unsigned int dwOutputCellsCount;
 		unsigned int dwCollisionsCount;
+		unsigned int dwSymbolClassesCount; // for SearchFSMs with symbol classes only, 0 otherwise
 		SFsmTableSize tableSize;
 		SFsmTableSize tableMinSize;
+		STimeings timTablesGeneration; // CFsmCreator::GenerateTables (and optimization or minimization)
+		STimeings timWrapCreation; // CFsmCreator::CreateFsmWrap or CreateByteFsmWrap
 	};
 
 	struct SEnginePerformance {
 		bool fSuccess;
 		STimeings timInitialization;
 		STimeings timOperating;
-		unsigned int dwBytesCount; // overall bytes processed
-		unsigned int dwHits;
+		uint64_t qwBytesCount; // overall bytes processed
+		uint64_t qwHits;
 
 		// memory requirements and other statistics
 		unsigned int dwMemoryRequirements; // total memory requirements
@@ -70,12 +90,38 @@ public:
 	bool CreateFsm(bool fVerbose = false);
 	bool TraceFsm(int nDataLength);
 	bool TestCorrectness(unsigned int dwTestBytesCount, int nPrintHits, /* out, optional */ unsigned int *pdwHits = NULL);
+	bool TestParallelCorrectness(unsigned int dwTestBytesCount, int nThreads, /* out, optional */ unsigned int *pdwHits = NULL);
+	bool TestInterleavedCorrectness(unsigned int dwTestBytesCount);
+	bool TestCursorsCorrectness(unsigned int dwTestBytesCount, int nChannels);
+	bool TestKernelsCorrectness(unsigned int dwTestBytesCount); // of CRegisterMatcher
+	bool TestAutoCorrectness(unsigned int dwTestBytesCount, /* out, optional */ int *pnStateIdxSize = NULL);
+	bool TestFileCorrectness(unsigned int dwTestBytesCount, const std::string &sFileName);
+	bool TestParallelGeneration(int nThreads, /* out */ STimeings *pSequential, /* out */ STimeings *pParallel);
 
 	// test engines' performance
 	bool TestBitFsmRate(unsigned int dwTestBytesCount, bool fOptimize, /* out */ SEnginePerformance *pResult);
 	bool TestNibbleFsmRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
 	bool TestOctetFsmRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+	bool TestOctetClassedFsmRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+	bool TestOctetCombFsmRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+	bool TestOctetSplitFsmRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+	bool TestLazyFsmRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+	bool TestOctetFsmInterleavedRate(unsigned int dwTestBytesCount, int nStreams, bool fPrefetch,
+		/* out */ SEnginePerformance *pResult);
+	bool TestOctetFsmParallelRate(unsigned int dwTestBytesCount, int nThreads, /* out */ SEnginePerformance *pResult);
+	bool TestMinimalTypesFsmRate(unsigned int dwTestBytesCount, int nBitsAtOnce, /* out */ SEnginePerformance *pResult);
+	bool TestOctetFsmFileRate(unsigned int dwTestBytesCount, const std::string &sFileName, /* out */ SEnginePerformance *pResult);
 	bool TestRegisterRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+	bool TestBitapRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+	bool TestRegisterMatcherRate(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+
+	// test the ready tables of the creator, the wrap copy shares them with the caller's one
+	bool TestFsmWrapRate(unsigned int dwTestBytesCount, const CFsmCreator &creator,
+		const CFsmCreator::SFsmWrap<TBitSearchFsm> &wrap, /* out */ SEnginePerformance *pResult);
+	bool TestFsmWrapRate(unsigned int dwTestBytesCount, const CFsmCreator &creator,
+		const CFsmCreator::SFsmWrap<TNibbleSearchFsm> &wrap, /* out */ SEnginePerformance *pResult);
+	bool TestFsmWrapRate(unsigned int dwTestBytesCount, const CFsmCreator &creator,
+		const CFsmCreator::SFsmWrap<TOctetSearchFsm> &wrap, /* out */ SEnginePerformance *pResult);
 
 public: // table size calculating methods
 	template <class TSearchFsm>
@@ -84,33 +130,87 @@ public: // table size calculating methods
 	template <class TSearchFsm>
 	static SFsmTableSize GetMinimalTableSize(const CFsmCreator::SFsmWrap<TSearchFsm>& fsm);
 
+	template <class TSearchFsm>
+	static SFsmTableSize GetTableSize(const typename TSearchFsm::STable &table);
+
+	template <class TSearchFsm>
+	static SFsmTableSize GetMinimalTableSize(const typename TSearchFsm::STable &table);
+
 private:
 	static SPatternsStats AnalysePatterns(const TPatterns& patterns);
-	static unsigned int GetMinimalDataSize(unsigned int nMaxValue);
+	static std::vector<unsigned char> GenerateTestData(unsigned int dwBytesCount);
+	unsigned int GetWarmUpBytes() const;
+	const CFsmCreator::SSizeEstimate& GetSizeEstimate();
+	bool FitsTableBudget(int nBitsAtOnce, /* out, optional */ uint64_t *pqwPredictedBytes = NULL);
+	bool FitsCombTableBudget(/* out, optional */ uint64_t *pqwPredictedBytes = NULL); // octet
+	bool CheckTableBudget(int nBitsAtOnce, /* out */ SEnginePerformance *pResult);
 
 	template <class TSearchEngine>
 	bool TestEnginePerformance(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
 
+	template <class TSearchEngine>
+	void MeasureEnginePerformance(unsigned int dwTestBytesCount, typename TSearchEngine::TSearchData *pSearchData,
+		/* in, out */ SEnginePerformance *pPerformance);
+
+	template <class TSearchFsm>
+	bool TestWrapPerformance(unsigned int dwTestBytesCount, const CFsmCreator &creator,
+		const CFsmCreator::SFsmWrap<TSearchFsm> &wrap, /* out */ SEnginePerformance *pResult);
+
+	template <int nBitsAtOnce>
+	bool TestMinimalTypesPerformance(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+
+	template <int nStreams, bool fPrefetch>
+	bool TestInterleavedPerformance(unsigned int dwTestBytesCount, /* out */ SEnginePerformance *pResult);
+
+	template <int nStreams, bool fPrefetch>
+	bool TestInterleavedStreams(const TOctetSearchFsm::STable &table, const std::vector<unsigned char> &data);
+
+	template <class TSearchFsm>
+	bool TestCursors(const CCompiledFsm<TSearchFsm> &compiled, const std::vector<unsigned char> &data, int nChannels,
+		const char *szName);
+
+	template <class TSearchFsm>
+	static bool TestFileRefused(const std::string &sFileName, CFsmCreator::EBitOrder bitOrder, uint64_t qwFingerprint,
+		CFsmFile::EStatus statusExpected, const char *szCase);
+	static bool SaveFilePart(const std::string &sFileName, const std::string &sPartFileName, uint64_t qwBytes);
+
 private:
 	template <bool fOptimize> class CBitFsmSearch;
 	class CNibbleFsmSearch;
 	class COctetFsmSearch;
+	class COctetClassedFsmSearch;
+	class COctetCombFsmSearch;
+	class COctetSplitFsmSearch;
+	class CLazyFsmSearch;
 	class CRegisterSearch;
+	class CBitapSearch;
+	class CRegisterMatcherSearch;
+	template <class TSearchFsm> class CWrapFsmSearch;
+	class CMappedFsmSearch;
+	class CAutoFsmSearch;
+
+	// visitor for CSearchFsmAuto, measures the performance of the concrete SearchFSM
+	class CMeasureVisitor;
+
+	// sink for SearchFSM Scan methods, the findings are collected by CFindingsBuffer
+	class CHitsCounter;
 
 private:
-	struct SFinding {
-		int nPatternIdx;
-		int nErrors;
-		unsigned int dwPosition;
-	};
-	typedef QList<SFinding> TFindingsList;
+	typedef std::vector<SFinding> TFindingsList;
 
+	static void PlantPattern(const SPattern &pattern, int nErrors, uint64_t qwBitOffset,
+		/* in, out */ std::vector<unsigned char> *pData);
+	static void AppendFindings(void *pList, const SFinding *pFindings, size_t nCount); // CFindingsBuffer flush callback
+	static bool AreEqual(const CFindingsBuffer &findings1, const CFindingsBuffer &findings2);
 	static bool AreEqual(const TFindingsList &list1, const TFindingsList &list2);
 	static bool AreEqual(const SFinding &finding1, const SFinding &finding2);
-	void DumpFinding(int nBitsProcessed, const TBitSearchFsm::TOutput &out);
+	static bool AreEqual(const CFsmCreator::STableCell &cell1, const CFsmCreator::STableCell &cell2);
+	void DumpFinding(uint64_t qwBitsProcessed, const TBitSearchFsm::TOutput &out);
 
 private:
 	TPatterns m_patterns;
+	bool m_fSizeEstimated;
+	CFsmCreator::SSizeEstimate m_sizeEstimate; // of the tables, made on demand
 };
 
 #endif // FSMTEST_H
@@ -0,0 +1,127 @@
+#line 2 "PosixTimer.h" // Make __FILE__ omit the path
+
+#ifndef POSIXTIMER_H
+#define POSIXTIMER_H
+
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+// the per-thread usage is Linux-specific, the whole process is measured on the other systems
+#ifdef RUSAGE_THREAD
+#define POSIX_TIMER_USAGE RUSAGE_THREAD
+#else
+#define POSIX_TIMER_USAGE RUSAGE_SELF
+#endif
+
+class CPosixTimer { // timer, the same interface as of CWinTimer
+public:
+	/// Common type for time and duration
+	typedef long double TTime; // t
+
+public:
+	CPosixTimer() {Start();} ///< Create timer. Timer is started immediately.
+
+public:
+	/// Start/restart timer from zero. \sa Stop, GetDuration
+	void Start();
+
+	/// Stop (pause) timer. Time is frozen. \sa Start, GetDuration
+	void Stop();
+
+	/// Get real number of seconds for current thread (CLOCK_THREAD_CPUTIME_ID).
+	/** \sa Start, Stop, GetUserDuration, GetKernelDuration, GetTotalDuration */
+	TTime GetThreadDuration() const;
+
+	/// Get real number of seconds for current thread in user mode (getrusage).
+	/** \sa Start, Stop, GetThreadDuration, GetKernelDuration, GetTotalDuration */
+	TTime GetUserDuration() const;
+
+	/// Get real number of seconds for current thread in kernel mode (getrusage).
+	/** \sa Start, Stop, GetThreadDuration, GetUserDuration, GetTotalDuration */
+	TTime GetKernelDuration() const;
+
+	/// Get real number of seconds elapsed since start moment (CLOCK_MONOTONIC).
+	/** \sa Start, Stop, GetThreadDuration, GetUserDuration, GetKernelDuration */
+	TTime GetTotalDuration() const;
+
+private:
+	static TTime GetClock(clockid_t clock);
+	static TTime TimeValToTime(const struct timeval &tv);
+
+private:
+	// start times
+	TTime m_tStartTimeThread; // thread CPU time
+	TTime m_tStartTimeUser; // thread in user mode
+	TTime m_tStartTimeKernel; // thread in kernel mode
+	TTime m_tStartTimeSystem; // total real time
+
+	// start-to-stop durations
+	TTime m_tThreadDuration;
+	TTime m_tUserDuration;
+	TTime m_tKernelDuration;
+	TTime m_tTotalDuration;
+	bool m_fRunning;
+};
+
+
+// implementation
+void inline CPosixTimer::Start() {
+	struct rusage usage;
+	getrusage(POSIX_TIMER_USAGE, &usage);
+	m_tStartTimeUser = TimeValToTime(usage.ru_utime);
+	m_tStartTimeKernel = TimeValToTime(usage.ru_stime);
+	m_tStartTimeThread = GetClock(CLOCK_THREAD_CPUTIME_ID);
+	m_tStartTimeSystem = GetClock(CLOCK_MONOTONIC);
+
+	m_tThreadDuration = 0;
+	m_tUserDuration = 0;
+	m_tKernelDuration = 0;
+	m_tTotalDuration = 0;
+
+	m_fRunning = true;
+}
+
+void inline CPosixTimer::Stop() {
+	if (!m_fRunning) return;
+	TTime tStopTimeSystem = GetClock(CLOCK_MONOTONIC);
+	TTime tStopTimeThread = GetClock(CLOCK_THREAD_CPUTIME_ID);
+	struct rusage usage;
+	getrusage(POSIX_TIMER_USAGE, &usage);
+
+	m_tThreadDuration = tStopTimeThread - m_tStartTimeThread;
+	m_tUserDuration = TimeValToTime(usage.ru_utime) - m_tStartTimeUser;
+	m_tKernelDuration = TimeValToTime(usage.ru_stime) - m_tStartTimeKernel;
+	m_tTotalDuration = tStopTimeSystem - m_tStartTimeSystem;
+
+	m_fRunning = false;
+}
+
+CPosixTimer::TTime inline CPosixTimer::GetThreadDuration() const {
+	return m_tThreadDuration;
+}
+
+CPosixTimer::TTime inline CPosixTimer::GetUserDuration() const {
+	return m_tUserDuration;
+}
+
+CPosixTimer::TTime inline CPosixTimer::GetKernelDuration() const {
+	return m_tKernelDuration;
+}
+
+CPosixTimer::TTime inline CPosixTimer::GetTotalDuration() const {
+	return m_tTotalDuration;
+}
+
+// private members
+CPosixTimer::TTime inline CPosixTimer::GetClock(clockid_t clock) {
+	struct timespec ts = {0, 0};
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + ts.tv_nsec * (TTime)1e-9;
+}
+
+CPosixTimer::TTime inline CPosixTimer::TimeValToTime(const struct timeval &tv) {
+	return tv.tv_sec + tv.tv_usec * (TTime)1e-6;
+}
+
+#endif // POSIXTIMER_H
@@ -1,8 +1,43 @@
 #ifndef SEARCHENGINES_H
 #define SEARCHENGINES_H
 
+#include <memory>
+
 #include "FsmTest.h"
+#include "../SearchFSM/SearchFsmAuto.h"
+#include "../SearchFSM/FsmFile.h"
+#include "../SearchFSM/BitapMatcher.h"
+#include "../SearchFSM/RegisterMatcher.h"
 #include "ShiftRegister.h"
+#include "Timer.h"
+
+// forward definitions
+CFsmTest::STimeings GetTimings(const CTimer &timer);
+
+/// CFsmTest::CHitsCounter - sink for SearchFSM Scan methods, only counts the hits
+class CFsmTest::CHitsCounter {
+public:
+	CHitsCounter(): m_cHits(0) {}
+
+public:
+	template <class TOutput>
+	void operator()(uint64_t, const TOutput&) {
+		m_cHits++;
+	}
+
+	template <class TOutput>
+	void operator()(int, uint64_t, const TOutput&) { // for interleaved scanning
+		m_cHits++;
+	}
+
+	uint64_t GetHitsCount() const {
+		return m_cHits;
+	}
+
+private:
+	uint64_t m_cHits;
+};
+
 
 /// CFsmTest::CBitFsmSearch - search with a bit SearchFSM
 template <bool fOptimize>
@@ -11,7 +46,10 @@ public: // data
 	struct TSearchData {
 		CFsmCreator::SFsmWrap<CFsmTest::TBitSearchFsm> wrap;
 		unsigned int dwCollisionsCount;
-		unsigned int dwBits;
+		unsigned int dwUnoptimizedStatesCount;
+		uint64_t qwBits;
+		CFsmTest::STimeings timTablesGeneration;
+		CFsmTest::STimeings timWrapCreation;
 	};
 
 public: // initialization & statictics
@@ -21,19 +59,27 @@ public: // initialization & statictics
 	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
 
 public: // working methods
-	static CFsmTest::TFindingsList ProcessByte(const unsigned char bData, TSearchData *pSearchData);
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
 	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
 };
 
 // implementation
 template <bool fOptimize>
 typename CFsmTest::CBitFsmSearch<fOptimize>::TSearchData CFsmTest::CBitFsmSearch<fOptimize>::InitEngine(const TPatterns &patterns) {
+	CTimer timer;
 	CFsmCreator fsm(patterns);
 	fsm.GenerateTables();
 	if (fOptimize) {
 		fsm.OptimizeTables();
 	}
-	TSearchData data = {fsm.CreateFsmWrap<TBitSearchFsm>(), fsm.GetCollisionsCount(), 0};
+	timer.Stop();
+	CFsmTest::STimeings timTablesGeneration = GetTimings(timer);
+
+	timer.Start();
+	TSearchData data = {fsm.CreateFsmWrap<TBitSearchFsm>(), fsm.GetCollisionsCount(), (unsigned int)fsm.GetUnoptimizedStatesCount(), 0,
+		timTablesGeneration, STimeings()};
+	timer.Stop();
+	data.timWrapCreation = GetTimings(timer);
 	data.wrap.fsm.Reset();
 
 	return data;
@@ -47,9 +93,13 @@ unsigned int CFsmTest::CBitFsmSearch<fOptimize>::GetMemoryRequirements(const typ
 template <bool fOptimize>
 CFsmTest::SFsmStatistics CFsmTest::CBitFsmSearch<fOptimize>::GetFsmStatistics(const typename CFsmTest::CBitFsmSearch<fOptimize>::TSearchData &data) {
 	CFsmTest::SFsmStatistics stats;
-	stats.dwStatesCount = data.wrap.m_rows.count();
-	stats.dwOutputCellsCount = data.wrap.m_outputTable.count();
+	stats.dwStatesCount = (int)data.wrap.m_rows.size();
+	stats.dwUnoptimizedStatesCount = data.dwUnoptimizedStatesCount;
+	stats.dwOutputCellsCount = (int)data.wrap.m_outputTable.size();
 	stats.dwCollisionsCount = data.dwCollisionsCount;
+	stats.dwSymbolClassesCount = 0;
+	stats.timTablesGeneration = data.timTablesGeneration;
+	stats.timWrapCreation = data.timWrapCreation;
 	stats.tableSize = CFsmTest::GetTableSize(data.wrap);
 	stats.tableMinSize = CFsmTest::GetMinimalTableSize(data.wrap);
 
@@ -57,52 +107,20 @@ CFsmTest::SFsmStatistics CFsmTest::CBitFsmSearch<fOptimize>::GetFsmStatistics(co
 }
 
 template <bool fOptimize>
-CFsmTest::TFindingsList CFsmTest::CBitFsmSearch<fOptimize>::ProcessByte(const unsigned char bData, typename CFsmTest::CBitFsmSearch<fOptimize>::TSearchData *pSearchData) {
-	TFindingsList result;
-	int nBit;
-	for (nBit = 0; nBit < BITS_IN_BYTE; nBit++) {
-		// obtain next bit
-		unsigned char bBit = GetHiBit(bData, nBit);
-
-		// process bit by FSM
-		unsigned int dwOut = pSearchData->wrap.fsm.PushBit(bBit);
-		pSearchData->dwBits++;
-		while (dwOut != TBitSearchFsm::sm_outputNull) {
-			const TBitSearchFsm::TOutput &out = pSearchData->wrap.fsm.GetOutput(dwOut);
-			if (out.stepBack <= pSearchData->dwBits) { // enough data
-				SFinding finding;
-				finding.nPatternIdx = out.patternIdx;
-				finding.nErrors = out.errorsCount;
-				unsigned int dwPosition = pSearchData->dwBits - out.stepBack;
-				finding.dwPosition = dwPosition;
-				result << finding;
-				dwOut = out.idxNextOutput;
-			}
-			dwOut = out.idxNextOutput;
-		}
-	}
-
-	return result;
+void CFsmTest::CBitFsmSearch<fOptimize>::ProcessByte(const unsigned char bData, typename CFsmTest::CBitFsmSearch<fOptimize>::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->wrap.fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
 }
 
 template <bool fOptimize>
 unsigned int CFsmTest::CBitFsmSearch<fOptimize>::ProcessByteIdle(const unsigned char bData, typename CFsmTest::CBitFsmSearch<fOptimize>::TSearchData *pSearchData) {
-	unsigned int cHits = 0;
-	int nBit;
-	for (nBit = 0; nBit < BITS_IN_BYTE; nBit++) {
-		// obtain next bit
-		unsigned char bBit = GetHiBit(bData, nBit);
-
-		// process bit by FSM
-		unsigned int dwOut = pSearchData->wrap.fsm.PushBit(bBit);
-		while (dwOut != TBitSearchFsm::sm_outputNull) {
-			cHits++;
-			const TBitSearchFsm::TOutput &out = pSearchData->wrap.fsm.GetOutput(dwOut);
-			dwOut = out.idxNextOutput;
-		}
-	}
+	CHitsCounter counter;
+	pSearchData->wrap.fsm.Scan(&bData, 1, counter);
 
-	return cHits;
+	return counter.GetHitsCount();
 }
 
 
@@ -112,7 +130,10 @@ public: // data
 	struct TSearchData {
 		CFsmCreator::SFsmWrap<CFsmTest::TNibbleSearchFsm> wrap;
 		unsigned int dwCollisionsCount;
-		unsigned int dwBits;
+		unsigned int dwUnoptimizedStatesCount;
+		uint64_t qwBits;
+		CFsmTest::STimeings timTablesGeneration;
+		CFsmTest::STimeings timWrapCreation;
 	};
 
 public: // initialization & statictics
@@ -122,15 +143,24 @@ public: // initialization & statictics
 	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
 
 public: // working methods
-	static CFsmTest::TFindingsList ProcessByte(const unsigned char bData, TSearchData *pSearchData);
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
 	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
 };
 
 // implementation
 CFsmTest::CNibbleFsmSearch::TSearchData CFsmTest::CNibbleFsmSearch::InitEngine(const TPatterns &patterns) {
+	CTimer timer;
 	CFsmCreator fsm(patterns);
 	fsm.GenerateTables();
-	TSearchData data = {fsm.CreateByteFsmWrap<TNibbleSearchFsm>(), fsm.GetCollisionsCount(), 0};
+	fsm.MinimizeTables();
+	timer.Stop();
+	CFsmTest::STimeings timTablesGeneration = GetTimings(timer);
+
+	timer.Start();
+	TSearchData data = {fsm.CreateByteFsmWrap<TNibbleSearchFsm>(), fsm.GetCollisionsCount(), (unsigned int)fsm.GetUnoptimizedStatesCount(), 0,
+		timTablesGeneration, STimeings()};
+	timer.Stop();
+	data.timWrapCreation = GetTimings(timer);
 	data.wrap.fsm.Reset();
 
 	return data;
@@ -142,74 +172,34 @@ unsigned int CFsmTest::CNibbleFsmSearch::GetMemoryRequirements(const CFsmTest::C
 
 CFsmTest::SFsmStatistics CFsmTest::CNibbleFsmSearch::GetFsmStatistics(const CFsmTest::CNibbleFsmSearch::TSearchData &data) {
 	CFsmTest::SFsmStatistics stats;
-	stats.dwStatesCount = data.wrap.m_rows.count();
-	stats.dwOutputCellsCount = data.wrap.m_outputTable.count();
+	stats.dwStatesCount = (int)data.wrap.m_rows.size();
+	stats.dwUnoptimizedStatesCount = data.dwUnoptimizedStatesCount;
+	stats.dwOutputCellsCount = (int)data.wrap.m_outputTable.size();
 	stats.dwCollisionsCount = data.dwCollisionsCount;
+	stats.dwSymbolClassesCount = 0;
+	stats.timTablesGeneration = data.timTablesGeneration;
+	stats.timWrapCreation = data.timWrapCreation;
 	stats.tableSize = CFsmTest::GetTableSize(data.wrap);
 	stats.tableMinSize = CFsmTest::GetMinimalTableSize(data.wrap);
 
 	return stats;
 }
 
-CFsmTest::TFindingsList CFsmTest::CNibbleFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::CNibbleFsmSearch::TSearchData *pSearchData) {
+void CFsmTest::CNibbleFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::CNibbleFsmSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
 	// process the two nibbles of the byte
-	TFindingsList result;
-
-	// Higher nibble
-	unsigned int dwOut = pSearchData->wrap.fsm.PushByte(HiNibble(bData));
-	pSearchData->dwBits += g_nNibbleLength;
-	while (dwOut != TNibbleSearchFsm::sm_outputNull) {
-		const TNibbleSearchFsm::TOutput &out = pSearchData->wrap.fsm.GetOutput(dwOut);
-		if (out.stepBack <= pSearchData->dwBits) { // enough data
-			SFinding finding;
-			finding.nPatternIdx = out.patternIdx;
-			finding.nErrors = out.errorsCount;
-			unsigned int dwPosition = pSearchData->dwBits - out.stepBack;
-			finding.dwPosition = dwPosition;
-			result << finding;
-		}
-		dwOut = out.idxNextOutput;
-	}
-	// Lowwer nibble
-	dwOut = pSearchData->wrap.fsm.PushByte(LoNibble(bData));
-	pSearchData->dwBits += g_nNibbleLength;
-	while (dwOut != TNibbleSearchFsm::sm_outputNull) {
-		const TNibbleSearchFsm::TOutput &out = pSearchData->wrap.fsm.GetOutput(dwOut);
-		if (out.stepBack <= pSearchData->dwBits) { // enough data
-			SFinding finding;
-			finding.nPatternIdx = out.patternIdx;
-			finding.nErrors = out.errorsCount;
-			unsigned int dwPosition = pSearchData->dwBits - out.stepBack;
-			finding.dwPosition = dwPosition;
-			result << finding;
-		}
-		dwOut = out.idxNextOutput;
-	}
-
-	return result;
-
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->wrap.fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
 }
 
 unsigned int CFsmTest::CNibbleFsmSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::CNibbleFsmSearch::TSearchData *pSearchData) {
 	// process the two nibbles of the byte
-	unsigned int cHits = 0;
+	CHitsCounter counter;
+	pSearchData->wrap.fsm.Scan(&bData, 1, counter);
 
-	// Higher nibble
-	unsigned int dwOut = pSearchData->wrap.fsm.PushByte(HiNibble(bData));
-	while (dwOut != TNibbleSearchFsm::sm_outputNull) {
-		const TNibbleSearchFsm::TOutput &out = pSearchData->wrap.fsm.GetOutput(dwOut);
-		cHits++;
-		dwOut = out.idxNextOutput;
-	}
-	// Lowwer nibble
-	dwOut = pSearchData->wrap.fsm.PushByte(LoNibble(bData));
-	while (dwOut != TNibbleSearchFsm::sm_outputNull) {
-		const TNibbleSearchFsm::TOutput &out = pSearchData->wrap.fsm.GetOutput(dwOut);
-		cHits++;
-		dwOut = out.idxNextOutput;
-	}
-
-	return cHits;
+	return counter.GetHitsCount();
 }
 
 
@@ -219,7 +209,10 @@ public: // data
 	struct TSearchData {
 		CFsmCreator::SFsmWrap<CFsmTest::TOctetSearchFsm> wrap;
 		unsigned int dwCollisionsCount;
-		unsigned int dwBits;
+		unsigned int dwUnoptimizedStatesCount;
+		uint64_t qwBits;
+		CFsmTest::STimeings timTablesGeneration;
+		CFsmTest::STimeings timWrapCreation;
 	};
 
 public: // initialization & statictics
@@ -229,15 +222,24 @@ public: // initialization & statictics
 	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
 
 public: // working methods
-	static CFsmTest::TFindingsList ProcessByte(const unsigned char bData, TSearchData *pSearchData);
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
 	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
 };
 
 // implementation
 CFsmTest::COctetFsmSearch::TSearchData CFsmTest::COctetFsmSearch::InitEngine(const TPatterns &patterns) {
+	CTimer timer;
 	CFsmCreator fsm(patterns);
 	fsm.GenerateTables();
-	TSearchData data = {fsm.CreateByteFsmWrap<TOctetSearchFsm>(), fsm.GetCollisionsCount(), 0};
+	fsm.MinimizeTables();
+	timer.Stop();
+	CFsmTest::STimeings timTablesGeneration = GetTimings(timer);
+
+	timer.Start();
+	TSearchData data = {fsm.CreateByteFsmWrap<TOctetSearchFsm>(), fsm.GetCollisionsCount(), (unsigned int)fsm.GetUnoptimizedStatesCount(), 0,
+		timTablesGeneration, STimeings()};
+	timer.Stop();
+	data.timWrapCreation = GetTimings(timer);
 	data.wrap.fsm.Reset();
 
 	return data;
@@ -249,47 +251,623 @@ unsigned int CFsmTest::COctetFsmSearch::GetMemoryRequirements(const CFsmTest::CO
 
 CFsmTest::SFsmStatistics CFsmTest::COctetFsmSearch::GetFsmStatistics(const CFsmTest::COctetFsmSearch::TSearchData &data) {
 	CFsmTest::SFsmStatistics stats;
-	stats.dwStatesCount = data.wrap.m_rows.count();
-	stats.dwOutputCellsCount = data.wrap.m_outputTable.count();
+	stats.dwStatesCount = (int)data.wrap.m_rows.size();
+	stats.dwUnoptimizedStatesCount = data.dwUnoptimizedStatesCount;
+	stats.dwOutputCellsCount = (int)data.wrap.m_outputTable.size();
 	stats.dwCollisionsCount = data.dwCollisionsCount;
+	stats.dwSymbolClassesCount = 0;
+	stats.timTablesGeneration = data.timTablesGeneration;
+	stats.timWrapCreation = data.timWrapCreation;
 	stats.tableSize = CFsmTest::GetTableSize(data.wrap);
 	stats.tableMinSize = CFsmTest::GetMinimalTableSize(data.wrap);
 
 	return stats;
 }
 
-CFsmTest::TFindingsList CFsmTest::COctetFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::COctetFsmSearch::TSearchData *pSearchData) {
+void CFsmTest::COctetFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::COctetFsmSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
 	// process the byte at once
-	TFindingsList result;
-	unsigned int dwOut = pSearchData->wrap.fsm.PushByte(bData);
-	pSearchData->dwBits += g_nByteLength;
-	while (dwOut != TOctetSearchFsm::sm_outputNull) {
-		const TOctetSearchFsm::TOutput &out = pSearchData->wrap.fsm.GetOutput(dwOut);
-		if (out.stepBack <= pSearchData->dwBits) { // enough data
-			SFinding finding;
-			finding.nPatternIdx = out.patternIdx;
-			finding.nErrors = out.errorsCount;
-			unsigned int dwPosition = pSearchData->dwBits - out.stepBack;
-			finding.dwPosition = dwPosition;
-			result << finding;
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->wrap.fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+unsigned int CFsmTest::COctetFsmSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::COctetFsmSearch::TSearchData *pSearchData) {
+	// process the byte at once
+	CHitsCounter counter;
+	pSearchData->wrap.fsm.Scan(&bData, 1, counter);
+
+	return counter.GetHitsCount();
+}
+
+
+/// CFsmTest::CWrapFsmSearch - search with a ready byte SearchFSM of any index types (see CSearchFsmAuto)
+template <class TSearchFsm>
+class CFsmTest::CWrapFsmSearch {
+public: // data
+	struct TSearchData {
+		CFsmCreator::SFsmWrap<TSearchFsm> wrap;
+		unsigned int dwCollisionsCount;
+		unsigned int dwUnoptimizedStatesCount;
+		uint64_t qwBits;
+		CFsmTest::STimeings timTablesGeneration;
+		CFsmTest::STimeings timWrapCreation;
+	};
+
+public: // statictics
+	static unsigned int GetMemoryRequirements(const TSearchData &data);
+	static bool IsFsm() {return true;}
+	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
+};
+
+// implementation
+template <class TSearchFsm>
+unsigned int CFsmTest::CWrapFsmSearch<TSearchFsm>::GetMemoryRequirements(const typename CFsmTest::CWrapFsmSearch<TSearchFsm>::TSearchData &data) {
+	return CFsmTest::GetTableSize(data.wrap).dwTotalSize;
+}
+
+template <class TSearchFsm>
+CFsmTest::SFsmStatistics CFsmTest::CWrapFsmSearch<TSearchFsm>::GetFsmStatistics(const typename CFsmTest::CWrapFsmSearch<TSearchFsm>::TSearchData &data) {
+	CFsmTest::SFsmStatistics stats;
+	stats.dwStatesCount = (int)data.wrap.m_rows.size();
+	stats.dwUnoptimizedStatesCount = data.dwUnoptimizedStatesCount;
+	stats.dwOutputCellsCount = (int)data.wrap.m_outputTable.size();
+	stats.dwCollisionsCount = data.dwCollisionsCount;
+	stats.dwSymbolClassesCount = 0;
+	stats.timTablesGeneration = data.timTablesGeneration;
+	stats.timWrapCreation = data.timWrapCreation;
+	stats.tableSize = CFsmTest::GetTableSize(data.wrap);
+	stats.tableMinSize = CFsmTest::GetMinimalTableSize(data.wrap);
+
+	return stats;
+}
+
+template <class TSearchFsm>
+void CFsmTest::CWrapFsmSearch<TSearchFsm>::ProcessByte(const unsigned char bData, typename CFsmTest::CWrapFsmSearch<TSearchFsm>::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->wrap.fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+template <class TSearchFsm>
+unsigned int CFsmTest::CWrapFsmSearch<TSearchFsm>::ProcessByteIdle(const unsigned char bData, typename CFsmTest::CWrapFsmSearch<TSearchFsm>::TSearchData *pSearchData) {
+	CHitsCounter counter;
+	pSearchData->wrap.fsm.Scan(&bData, 1, counter);
+
+	return counter.GetHitsCount();
+}
+
+
+/// CFsmTest::CMappedFsmSearch - search with an octet SearchFSM loaded from the file (see CFsmFileMapping)
+class CFsmTest::CMappedFsmSearch {
+public: // data
+	typedef CFsmFileMapping<CFsmTest::TOctetSearchFsm> TMapping;
+	struct TSearchData {
+		std::shared_ptr<TMapping> pMapping;
+		CFsmTest::TOctetSearchFsm fsm;
+		unsigned int dwUnoptimizedStatesCount;
+		uint64_t qwBits;
+		CFsmTest::STimeings timTablesGeneration;
+		CFsmTest::STimeings timWrapCreation; // file mapping
+	};
+
+public: // statictics
+	static unsigned int GetMemoryRequirements(const TSearchData &data);
+	static bool IsFsm() {return true;}
+	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
+};
+
+// implementation
+unsigned int CFsmTest::CMappedFsmSearch::GetMemoryRequirements(const CFsmTest::CMappedFsmSearch::TSearchData &data) {
+	return CFsmTest::GetTableSize<TOctetSearchFsm>(data.fsm.GetTable()).dwTotalSize;
+}
+
+CFsmTest::SFsmStatistics CFsmTest::CMappedFsmSearch::GetFsmStatistics(const CFsmTest::CMappedFsmSearch::TSearchData &data) {
+	const TOctetSearchFsm::STable &table = data.fsm.GetTable();
+	CFsmTest::SFsmStatistics stats;
+	stats.dwStatesCount = table.statesCount;
+	stats.dwUnoptimizedStatesCount = data.dwUnoptimizedStatesCount;
+	stats.dwOutputCellsCount = table.outputsCount;
+	stats.dwCollisionsCount = 0;
+	stats.dwSymbolClassesCount = 0;
+	stats.timTablesGeneration = data.timTablesGeneration;
+	stats.timWrapCreation = data.timWrapCreation;
+	stats.tableSize = CFsmTest::GetTableSize<TOctetSearchFsm>(table);
+	stats.tableMinSize = CFsmTest::GetMinimalTableSize<TOctetSearchFsm>(table);
+
+	return stats;
+}
+
+void CFsmTest::CMappedFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::CMappedFsmSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+unsigned int CFsmTest::CMappedFsmSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::CMappedFsmSearch::TSearchData *pSearchData) {
+	CHitsCounter counter;
+	pSearchData->fsm.Scan(&bData, 1, counter);
+
+	return counter.GetHitsCount();
+}
+
+
+/// CFsmTest::CMeasureVisitor - visitor for CSearchFsmAuto::Dispatch, measures the concrete SearchFSM
+class CFsmTest::CMeasureVisitor {
+public:
+	CMeasureVisitor(CFsmTest *pTest, unsigned int dwTestBytesCount, const CFsmCreator &creator,
+		const STimeings &timTablesGeneration, const STimeings &timWrapCreation, SEnginePerformance *pPerformance):
+		m_pTest(pTest), m_dwTestBytesCount(dwTestBytesCount), m_creator(creator),
+		m_timTablesGeneration(timTablesGeneration), m_timWrapCreation(timWrapCreation), m_pPerformance(pPerformance)
+	{}
+
+public:
+	template <class TSearchFsm>
+	void operator()(CFsmCreator::SFsmWrap<TSearchFsm> &wrap) {
+		typename CWrapFsmSearch<TSearchFsm>::TSearchData data = {wrap, m_creator.GetCollisionsCount(),
+			(unsigned int)m_creator.GetUnoptimizedStatesCount(), 0, m_timTablesGeneration, m_timWrapCreation};
+		data.wrap.fsm.Reset();
+		m_pTest->MeasureEnginePerformance<CWrapFsmSearch<TSearchFsm> >(m_dwTestBytesCount, &data, m_pPerformance);
+	}
+
+private:
+	CFsmTest *m_pTest;
+	unsigned int m_dwTestBytesCount;
+	const CFsmCreator &m_creator;
+	STimeings m_timTablesGeneration;
+	STimeings m_timWrapCreation;
+	SEnginePerformance *m_pPerformance;
+};
+
+
+/// CFsmTest::CAutoFsmSearch - search with an octet SearchFSM of the narrowest index types (see CSearchFsmAuto)
+class CFsmTest::CAutoFsmSearch {
+public: // data
+	typedef CSearchFsmAuto<CFsmTest::g_nByteLength> TSearchFsmAuto;
+	struct TSearchData {
+		TSearchFsmAuto fsm; // the concrete SearchFSM and its state are kept by the instance
+		uint64_t qwBits;
+	};
+
+public: // initialization
+	static TSearchData InitEngine(const TPatterns& patterns);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+
+private:
+	// visitor scanning the byte with the concrete SearchFSM
+	struct SScanVisitor {
+		unsigned char bData;
+		CFindingsBuffer *pFindings;
+
+		template <class TSearchFsm>
+		void operator()(CFsmCreator::SFsmWrap<TSearchFsm> &wrap) {
+			wrap.fsm.Scan(&bData, 1, *pFindings);
 		}
-		dwOut = out.idxNextOutput;
+	};
+};
+
+// implementation
+CFsmTest::CAutoFsmSearch::TSearchData CFsmTest::CAutoFsmSearch::InitEngine(const TPatterns &patterns) {
+	CFsmCreator fsm(patterns);
+	fsm.GenerateTables();
+	fsm.MinimizeTables();
+	TSearchData data = {TSearchFsmAuto(fsm), 0};
+
+	return data;
+}
+
+void CFsmTest::CAutoFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::CAutoFsmSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	SScanVisitor visitor = {bData, pFindings};
+	pSearchData->fsm.Dispatch(visitor);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+
+/// CFsmTest::COctetClassedFsmSearch - search with a 8-bit SearchFSM with symbol equivalence classes
+class CFsmTest::COctetClassedFsmSearch {
+public: // data
+	struct TSearchData {
+		CFsmCreator::SFsmClassedWrap<CFsmTest::TOctetClassedSearchFsm> wrap;
+		unsigned int dwCollisionsCount;
+		unsigned int dwUnoptimizedStatesCount;
+		uint64_t qwBits;
+		CFsmTest::STimeings timTablesGeneration;
+		CFsmTest::STimeings timWrapCreation;
+	};
+
+public: // initialization & statictics
+	static TSearchData InitEngine(const TPatterns& patterns);
+	static unsigned int GetMemoryRequirements(const TSearchData &data);
+	static bool IsFsm() {return true;}
+	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
+
+private:
+	static CFsmTest::SFsmTableSize GetTableSize(const TSearchData &data, bool fMinimal);
+};
+
+// implementation
+CFsmTest::COctetClassedFsmSearch::TSearchData CFsmTest::COctetClassedFsmSearch::InitEngine(const TPatterns &patterns) {
+	CTimer timer;
+	CFsmCreator fsm(patterns);
+	fsm.GenerateTables();
+	fsm.MinimizeTables();
+	timer.Stop();
+	CFsmTest::STimeings timTablesGeneration = GetTimings(timer);
+
+	timer.Start();
+	TSearchData data = {fsm.CreateClassedFsmWrap<TOctetClassedSearchFsm>(), fsm.GetCollisionsCount(), (unsigned int)fsm.GetUnoptimizedStatesCount(), 0,
+		timTablesGeneration, STimeings()};
+	timer.Stop();
+	data.timWrapCreation = GetTimings(timer);
+	data.wrap.fsm.Reset();
+
+	return data;
+}
+
+unsigned int CFsmTest::COctetClassedFsmSearch::GetMemoryRequirements(const CFsmTest::COctetClassedFsmSearch::TSearchData &data) {
+	return GetTableSize(data, false).dwTotalSize;
+}
+
+CFsmTest::SFsmStatistics CFsmTest::COctetClassedFsmSearch::GetFsmStatistics(const CFsmTest::COctetClassedFsmSearch::TSearchData &data) {
+	CFsmTest::SFsmStatistics stats;
+	stats.dwStatesCount = data.wrap.fsm.GetTable().statesCount;
+	stats.dwUnoptimizedStatesCount = data.dwUnoptimizedStatesCount;
+	stats.dwOutputCellsCount = (int)data.wrap.m_outputTable.size();
+	stats.dwCollisionsCount = data.dwCollisionsCount;
+	stats.dwSymbolClassesCount = data.wrap.fsm.GetTable().nClassesCount;
+	stats.timTablesGeneration = data.timTablesGeneration;
+	stats.timWrapCreation = data.timWrapCreation;
+	stats.tableSize = GetTableSize(data, false);
+	stats.tableMinSize = GetTableSize(data, true);
+
+	return stats;
+}
+
+void CFsmTest::COctetClassedFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::COctetClassedFsmSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	// process the byte at once
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->wrap.fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+unsigned int CFsmTest::COctetClassedFsmSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::COctetClassedFsmSearch::TSearchData *pSearchData) {
+	// process the byte at once
+	CHitsCounter counter;
+	pSearchData->wrap.fsm.Scan(&bData, 1, counter);
+
+	return counter.GetHitsCount();
+}
+
+CFsmTest::SFsmTableSize CFsmTest::COctetClassedFsmSearch::GetTableSize(const CFsmTest::COctetClassedFsmSearch::TSearchData &data, bool fMinimal) {
+	const TOctetClassedSearchFsm::STable &table = data.wrap.fsm.GetTable();
+	unsigned int dwCellSize = sizeof(TOctetClassedSearchFsm::TTableCell);
+	unsigned int dwOutputCellSize = sizeof(TOctetClassedSearchFsm::TOutput);
+	if (fMinimal) {
+		CFsmCreator::SIndexSizes sizes = CFsmCreator::GetTableIndexSizes<TOctetClassedSearchFsm>(table);
+		dwCellSize = sizes.nStateIdxSize + sizes.nOutputIdxSize;
+		dwOutputCellSize = sizes.nPatternIdxSize + sizes.nStepBackSize + sizes.nErrorsCountSize + sizes.nOutputIdxSize;
 	}
 
-	return result;
+	// the main table includes the symbol classes map
+	SFsmTableSize size;
+	size.dwMainTableSize = (unsigned int)table.statesCount * table.nClassesCount * dwCellSize +
+		TOctetClassedSearchFsm::g_nColumnsCount * sizeof(TOctetClassedSearchFsm::TClassIdx);
+	size.dwColdTableSize = 0;
+	size.dwOutputTableSize = (unsigned int)table.outputsCount * dwOutputCellSize;
+	size.dwTotalSize = size.dwMainTableSize + size.dwOutputTableSize + sizeof(TOctetClassedSearchFsm::STable);
+
+	return size;
 }
 
-unsigned int CFsmTest::COctetFsmSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::COctetFsmSearch::TSearchData *pSearchData) {
+
+/// CFsmTest::COctetCombFsmSearch - search with a 8-bit SearchFSM with comb-compressed table
+class CFsmTest::COctetCombFsmSearch {
+public: // data
+	struct TSearchData {
+		CFsmCreator::SFsmCombWrap<CFsmTest::TOctetCombSearchFsm> wrap;
+		unsigned int dwCollisionsCount;
+		unsigned int dwUnoptimizedStatesCount;
+		uint64_t qwBits;
+		CFsmTest::STimeings timTablesGeneration;
+		CFsmTest::STimeings timWrapCreation;
+	};
+
+public: // initialization & statictics
+	static TSearchData InitEngine(const TPatterns& patterns);
+	static unsigned int GetMemoryRequirements(const TSearchData &data);
+	static bool IsFsm() {return true;}
+	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
+
+private:
+	static CFsmTest::SFsmTableSize GetTableSize(const TSearchData &data, bool fMinimal);
+};
+
+// implementation
+CFsmTest::COctetCombFsmSearch::TSearchData CFsmTest::COctetCombFsmSearch::InitEngine(const TPatterns &patterns) {
+	CTimer timer;
+	CFsmCreator fsm(patterns);
+	fsm.GenerateTables();
+	fsm.MinimizeTables();
+	timer.Stop();
+	CFsmTest::STimeings timTablesGeneration = GetTimings(timer);
+
+	timer.Start();
+	TSearchData data = {fsm.CreateCombFsmWrap<TOctetCombSearchFsm>(), fsm.GetCollisionsCount(), (unsigned int)fsm.GetUnoptimizedStatesCount(), 0,
+		timTablesGeneration, STimeings()};
+	timer.Stop();
+	data.timWrapCreation = GetTimings(timer);
+	data.wrap.fsm.Reset();
+
+	return data;
+}
+
+unsigned int CFsmTest::COctetCombFsmSearch::GetMemoryRequirements(const CFsmTest::COctetCombFsmSearch::TSearchData &data) {
+	return GetTableSize(data, false).dwTotalSize;
+}
+
+CFsmTest::SFsmStatistics CFsmTest::COctetCombFsmSearch::GetFsmStatistics(const CFsmTest::COctetCombFsmSearch::TSearchData &data) {
+	CFsmTest::SFsmStatistics stats;
+	stats.dwStatesCount = data.wrap.fsm.GetTable().statesCount;
+	stats.dwUnoptimizedStatesCount = data.dwUnoptimizedStatesCount;
+	stats.dwOutputCellsCount = (int)data.wrap.m_outputTable.size();
+	stats.dwCollisionsCount = data.dwCollisionsCount;
+	stats.dwSymbolClassesCount = 0;
+	stats.timTablesGeneration = data.timTablesGeneration;
+	stats.timWrapCreation = data.timWrapCreation;
+	stats.tableSize = GetTableSize(data, false);
+	stats.tableMinSize = GetTableSize(data, true);
+
+	return stats;
+}
+
+void CFsmTest::COctetCombFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::COctetCombFsmSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
 	// process the byte at once
-	unsigned int cHits = 0;
-	unsigned int dwOut = pSearchData->wrap.fsm.PushByte(bData);
-	while (dwOut != TOctetSearchFsm::sm_outputNull) {
-		const TOctetSearchFsm::TOutput &out = pSearchData->wrap.fsm.GetOutput(dwOut);
-		cHits++;
-		dwOut = out.idxNextOutput;
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->wrap.fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+unsigned int CFsmTest::COctetCombFsmSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::COctetCombFsmSearch::TSearchData *pSearchData) {
+	// process the byte at once
+	CHitsCounter counter;
+	pSearchData->wrap.fsm.Scan(&bData, 1, counter);
+
+	return counter.GetHitsCount();
+}
+
+CFsmTest::SFsmTableSize CFsmTest::COctetCombFsmSearch::GetTableSize(const CFsmTest::COctetCombFsmSearch::TSearchData &data, bool fMinimal) {
+	const TOctetCombSearchFsm::STable &table = data.wrap.fsm.GetTable();
+	unsigned int dwCombCellSize = sizeof(TOctetCombSearchFsm::SCombCell);
+	unsigned int dwDefaultCellSize = sizeof(TOctetCombSearchFsm::SDefaultCell);
+	unsigned int dwStateSize = sizeof(TOctetCombSearchFsm::SStateInfo);
+	unsigned int dwOutputCellSize = sizeof(TOctetCombSearchFsm::TOutput);
+	unsigned int dwBaseStateSize = sizeof(TOctetCombSearchFsm::TStateIdx);
+	if (fMinimal) {
+		// bases and default row offsets are limited by the comb and default rows sizes, not by the states count
+		CFsmCreator::SIndexSizes sizes = CFsmCreator::GetTableIndexSizes<TOctetCombSearchFsm>(table);
+		dwBaseStateSize = sizes.nStateIdxSize;
+		int nBaseSize = CFsmCreator::GetMinimalDataSize(std::max(table.combCellsCount,
+			table.defaultRowsCount * TOctetCombSearchFsm::g_nColumnsCount));
+		dwCombCellSize = 3 * nBaseSize + sizes.nOutputIdxSize;
+		dwDefaultCellSize = 2 * nBaseSize + sizes.nOutputIdxSize;
+		dwStateSize = 2 * nBaseSize;
+		dwOutputCellSize = sizes.nPatternIdxSize + sizes.nStepBackSize + sizes.nErrorsCountSize + sizes.nOutputIdxSize;
 	}
 
-	return cHits;
+	// the main table includes the comb, the default rows and the states' entry points
+	SFsmTableSize size;
+	size.dwMainTableSize = table.combCellsCount * dwCombCellSize +
+		table.defaultRowsCount * TOctetCombSearchFsm::g_nColumnsCount * dwDefaultCellSize +
+		(unsigned int)table.statesCount * dwStateSize;
+	size.dwColdTableSize = (table.combCellsCount - TOctetCombSearchFsm::g_nColumnsCount + 1) * dwBaseStateSize; // for GetState
+	size.dwOutputTableSize = (unsigned int)table.outputsCount * dwOutputCellSize;
+	size.dwTotalSize = size.dwMainTableSize + size.dwColdTableSize + size.dwOutputTableSize + sizeof(TOctetCombSearchFsm::STable);
+
+	return size;
+}
+
+
+/// CFsmTest::COctetSplitFsmSearch - search with a 8-bit SearchFSM with split hot and cold tables
+class CFsmTest::COctetSplitFsmSearch {
+public: // data
+	struct TSearchData {
+		CFsmCreator::SFsmSplitWrap<CFsmTest::TOctetSplitSearchFsm> wrap;
+		unsigned int dwCollisionsCount;
+		unsigned int dwUnoptimizedStatesCount;
+		uint64_t qwBits;
+		CFsmTest::STimeings timTablesGeneration;
+		CFsmTest::STimeings timWrapCreation;
+	};
+
+public: // initialization & statictics
+	static TSearchData InitEngine(const TPatterns& patterns);
+	static unsigned int GetMemoryRequirements(const TSearchData &data);
+	static bool IsFsm() {return true;}
+	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
+
+private:
+	static CFsmTest::SFsmTableSize GetTableSize(const TSearchData &data, bool fMinimal);
+};
+
+// implementation
+CFsmTest::COctetSplitFsmSearch::TSearchData CFsmTest::COctetSplitFsmSearch::InitEngine(const TPatterns &patterns) {
+	CTimer timer;
+	CFsmCreator fsm(patterns);
+	fsm.GenerateTables();
+	fsm.MinimizeTables();
+	timer.Stop();
+	CFsmTest::STimeings timTablesGeneration = GetTimings(timer);
+
+	timer.Start();
+	TSearchData data = {fsm.CreateSplitFsmWrap<TOctetSplitSearchFsm>(), fsm.GetCollisionsCount(), (unsigned int)fsm.GetUnoptimizedStatesCount(), 0,
+		timTablesGeneration, STimeings()};
+	timer.Stop();
+	data.timWrapCreation = GetTimings(timer);
+	data.wrap.fsm.Reset();
+
+	return data;
+}
+
+unsigned int CFsmTest::COctetSplitFsmSearch::GetMemoryRequirements(const CFsmTest::COctetSplitFsmSearch::TSearchData &data) {
+	return GetTableSize(data, false).dwTotalSize;
+}
+
+CFsmTest::SFsmStatistics CFsmTest::COctetSplitFsmSearch::GetFsmStatistics(const CFsmTest::COctetSplitFsmSearch::TSearchData &data) {
+	CFsmTest::SFsmStatistics stats;
+	stats.dwStatesCount = data.wrap.fsm.GetTable().statesCount;
+	stats.dwUnoptimizedStatesCount = data.dwUnoptimizedStatesCount;
+	stats.dwOutputCellsCount = (int)data.wrap.m_outputTable.size();
+	stats.dwCollisionsCount = data.dwCollisionsCount;
+	stats.dwSymbolClassesCount = 0;
+	stats.timTablesGeneration = data.timTablesGeneration;
+	stats.timWrapCreation = data.timWrapCreation;
+	stats.tableSize = GetTableSize(data, false);
+	stats.tableMinSize = GetTableSize(data, true);
+
+	return stats;
+}
+
+void CFsmTest::COctetSplitFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::COctetSplitFsmSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	// process the byte at once
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->wrap.fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+unsigned int CFsmTest::COctetSplitFsmSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::COctetSplitFsmSearch::TSearchData *pSearchData) {
+	// process the byte at once
+	CHitsCounter counter;
+	pSearchData->wrap.fsm.Scan(&bData, 1, counter);
+
+	return counter.GetHitsCount();
+}
+
+CFsmTest::SFsmTableSize CFsmTest::COctetSplitFsmSearch::GetTableSize(const CFsmTest::COctetSplitFsmSearch::TSearchData &data, bool fMinimal) {
+	const TOctetSplitSearchFsm::STable &table = data.wrap.fsm.GetTable();
+	unsigned int dwCellSize = sizeof(TOctetSplitSearchFsm::TStateIdx);
+	unsigned int dwOutputRefSize = sizeof(TOctetSplitSearchFsm::SOutputRef);
+	unsigned int dwOutputCellSize = sizeof(TOctetSplitSearchFsm::TOutput);
+	if (fMinimal) {
+		// the state index takes one more bit for the output flag
+		CFsmCreator::SIndexSizes sizes = CFsmCreator::GetTableIndexSizes<TOctetSplitSearchFsm>(table);
+		dwCellSize = CFsmCreator::GetMinimalDataSize((unsigned int)table.statesCount * 2);
+		dwOutputRefSize = sizeof(unsigned char) + sizes.nOutputIdxSize;
+		dwOutputCellSize = sizes.nPatternIdxSize + sizes.nStepBackSize + sizes.nErrorsCountSize + sizes.nOutputIdxSize;
+	}
+
+	// the hot table is the main one, the cold table holds the refs to the outputs
+	SFsmTableSize size;
+	size.dwMainTableSize = (unsigned int)table.statesCount * TOctetSplitSearchFsm::g_nColumnsCount * dwCellSize;
+	size.dwColdTableSize = table.outputRefsCount * dwOutputRefSize + ((unsigned int)table.statesCount + 1) * sizeof(unsigned int);
+	size.dwOutputTableSize = (unsigned int)table.outputsCount * dwOutputCellSize;
+	size.dwTotalSize = size.dwMainTableSize + size.dwColdTableSize + size.dwOutputTableSize + sizeof(TOctetSplitSearchFsm::STable);
+
+	return size;
+}
+
+
+/// CFsmTest::CLazyFsmSearch - search with a 8-bit SearchFSM built on demand
+class CFsmTest::CLazyFsmSearch {
+public: // data
+	struct TSearchData {
+		CLazySearchFsm fsm;
+		uint64_t qwBits;
+	};
+
+public: // initialization & statictics
+	static TSearchData InitEngine(const TPatterns& patterns);
+	static unsigned int GetMemoryRequirements(const TSearchData &data);
+	static bool IsFsm() {return true;}
+	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
+};
+
+// implementation
+CFsmTest::CLazyFsmSearch::TSearchData CFsmTest::CLazyFsmSearch::InitEngine(const TPatterns &patterns) {
+	TSearchData data = {CLazySearchFsm(patterns, g_nLazyFsmMaxStates), 0};
+	return data;
+}
+
+unsigned int CFsmTest::CLazyFsmSearch::GetMemoryRequirements(const CFsmTest::CLazyFsmSearch::TSearchData &data) {
+	// the cache is filled while scanning, so its limit is the requirement
+	return data.fsm.GetMaxStatesCount() * CLazySearchFsm::g_nColumnsCount * sizeof(CLazySearchFsm::TTableCell);
+}
+
+CFsmTest::SFsmStatistics CFsmTest::CLazyFsmSearch::GetFsmStatistics(const CFsmTest::CLazyFsmSearch::TSearchData &data) {
+	// the tables are not generated, the cache limit is given instead
+	CFsmTest::SFsmStatistics stats;
+	stats.dwStatesCount = data.fsm.GetMaxStatesCount();
+	stats.dwUnoptimizedStatesCount = data.fsm.GetMaxStatesCount();
+	stats.dwOutputCellsCount = 0;
+	stats.dwCollisionsCount = 0;
+	stats.dwSymbolClassesCount = 0;
+	stats.timTablesGeneration = STimeings();
+	stats.timWrapCreation = STimeings();
+	SFsmTableSize size;
+	size.dwMainTableSize = GetMemoryRequirements(data);
+	size.dwColdTableSize = 0;
+	size.dwOutputTableSize = 0;
+	size.dwTotalSize = size.dwMainTableSize;
+	stats.tableSize = size;
+	stats.tableMinSize = size;
+
+	return stats;
+}
+
+void CFsmTest::CLazyFsmSearch::ProcessByte(const unsigned char bData, CFsmTest::CLazyFsmSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	// process the byte at once
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->fsm.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+unsigned int CFsmTest::CLazyFsmSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::CLazyFsmSearch::TSearchData *pSearchData) {
+	// process the byte at once
+	CHitsCounter counter;
+	pSearchData->fsm.Scan(&bData, 1, counter);
+
+	return counter.GetHitsCount();
 }
 
 
@@ -297,11 +875,11 @@ unsigned int CFsmTest::COctetFsmSearch::ProcessByteIdle(const unsigned char bDat
 class CFsmTest::CRegisterSearch {
 public: // data
 	struct TSearchData {
-		QList<CShiftRegister::SPattern> patterns;
+		std::vector<CShiftRegister::SPattern> patterns;
 		unsigned int dwPatternsCount;
 		TPatterns initialPatterns;
 		CShiftRegister reg;
-		unsigned int dwBits;
+		uint64_t qwBits;
 	};
 
 public: // initialization & statictics
@@ -311,7 +889,7 @@ public: // initialization & statictics
 	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
 
 public: // working methods
-	static CFsmTest::TFindingsList ProcessByte(const unsigned char bData, TSearchData *pSearchData);
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
 	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
 };
 
@@ -320,14 +898,14 @@ CFsmTest::CRegisterSearch::TSearchData CFsmTest::CRegisterSearch::InitEngine(con
 	// prepare shift register and test patterns
 	int nMaxPatternLength = AnalysePatterns(patterns).nMaxLength;
 	TSearchData data;
-	data.dwPatternsCount = patterns.count();
+	data.dwPatternsCount = (int)patterns.size();
 	data.initialPatterns = patterns;
 	data.reg.Init(nMaxPatternLength);
 	int idx;
-	for (idx = 0; idx < patterns.count(); idx++) {
-		data.patterns.append(data.reg.ConvertPattern(patterns[idx]));
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
+		data.patterns.push_back(data.reg.ConvertPattern(patterns[idx]));
 	}
-	data.dwBits = 0;
+	data.qwBits = 0;
 
 	return data;
 }
@@ -340,8 +918,9 @@ CFsmTest::SFsmStatistics CFsmTest::CRegisterSearch::GetFsmStatistics(const CFsmT
 	return CFsmTest::SFsmStatistics();
 }
 
-CFsmTest::TFindingsList CFsmTest::CRegisterSearch::ProcessByte(const unsigned char bData, CFsmTest::CRegisterSearch::TSearchData *pSearchData) {
-	TFindingsList result;
+void CFsmTest::CRegisterSearch::ProcessByte(const unsigned char bData, CFsmTest::CRegisterSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
 	int nBit;
 	for (nBit = 0; nBit < BITS_IN_BYTE; nBit++) {
 		// obtain next bit
@@ -349,25 +928,18 @@ CFsmTest::TFindingsList CFsmTest::CRegisterSearch::ProcessByte(const unsigned ch
 
 		// process bit with the register
 		pSearchData->reg.PushBit(bBit);
-		pSearchData->dwBits++;
+		pSearchData->qwBits++;
 		unsigned int dwPatternIdx;
 		for (dwPatternIdx = 0; dwPatternIdx < pSearchData->dwPatternsCount; dwPatternIdx++) {
 			unsigned int dwErrors = 0;
 			if (pSearchData->reg.TestPattern(pSearchData->patterns[dwPatternIdx], &dwErrors)) {
 				unsigned int dwPatternLength = pSearchData->initialPatterns[dwPatternIdx].nLength;
-				if (dwPatternLength <= pSearchData->dwBits) { // register is full
-					SFinding finding;
-					finding.nPatternIdx = dwPatternIdx;
-					finding.nErrors = dwErrors;
-					unsigned int dwPosition = pSearchData->dwBits - dwPatternLength;
-					finding.dwPosition = dwPosition;
-					result << finding;
+				if (dwPatternLength <= pSearchData->qwBits) { // register is full
+					pFindings->Add(dwPatternIdx, dwErrors, pSearchData->qwBits - dwPatternLength);
 				}
 			}
 		}
 	}
-
-	return result;
 }
 
 unsigned int CFsmTest::CRegisterSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::CRegisterSearch::TSearchData *pSearchData) {
@@ -391,4 +963,117 @@ unsigned int CFsmTest::CRegisterSearch::ProcessByteIdle(const unsigned char bDat
 }
 
 
+/// CFsmTest::CBitapSearch - bit-parallel search without the tables
+class CFsmTest::CBitapSearch {
+public: // data
+	struct TSearchData {
+		CBitapMatcher matcher;
+		uint64_t qwBits;
+	};
+
+public: // initialization & statictics
+	static TSearchData InitEngine(const TPatterns& patterns);
+	static unsigned int GetMemoryRequirements(const TSearchData &data);
+	static bool IsFsm() {return false;}
+	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
+};
+
+// implementation
+CFsmTest::CBitapSearch::TSearchData CFsmTest::CBitapSearch::InitEngine(const TPatterns &patterns) {
+	TSearchData data = {CBitapMatcher(patterns), 0};
+	return data;
+}
+
+unsigned int CFsmTest::CBitapSearch::GetMemoryRequirements(const CFsmTest::CBitapSearch::TSearchData &data) {
+	return data.matcher.GetMemoryUsage();
+}
+
+CFsmTest::SFsmStatistics CFsmTest::CBitapSearch::GetFsmStatistics(const CFsmTest::CBitapSearch::TSearchData&) {
+	return CFsmTest::SFsmStatistics();
+}
+
+void CFsmTest::CBitapSearch::ProcessByte(const unsigned char bData, CFsmTest::CBitapSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	// process the byte at once
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->matcher.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+unsigned int CFsmTest::CBitapSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::CBitapSearch::TSearchData *pSearchData) {
+	// process the byte at once
+	CHitsCounter counter;
+	pSearchData->matcher.Scan(&bData, 1, counter);
+
+	return counter.GetHitsCount();
+}
+
+
+/// CFsmTest::CRegisterMatcherSearch - shift register search vectorized by the window offsets; the idle
+/// processing collects the bytes into blocks, as a byte fills only a part of the lanes
+class CFsmTest::CRegisterMatcherSearch {
+public: // data
+	struct TSearchData {
+		CRegisterMatcher matcher;
+		uint64_t qwBits;
+		unsigned char bsBlock[CRegisterMatcher::g_nBlockBytes]; // collected by ProcessByteIdle
+		int nBlockBytes;
+	};
+
+public: // initialization & statictics
+	static TSearchData InitEngine(const TPatterns& patterns, CRegisterMatcher::EKernel kernel = CRegisterMatcher::kernel_Auto);
+	static unsigned int GetMemoryRequirements(const TSearchData &data);
+	static bool IsFsm() {return false;}
+	static CFsmTest::SFsmStatistics GetFsmStatistics(const TSearchData &data);
+
+public: // working methods
+	static void ProcessByte(const unsigned char bData, TSearchData *pSearchData, /* out */ CFindingsBuffer *pFindings);
+	static unsigned int ProcessByteIdle(const unsigned char bData, TSearchData *pSearchData);
+};
+
+// implementation
+CFsmTest::CRegisterMatcherSearch::TSearchData CFsmTest::CRegisterMatcherSearch::InitEngine(const TPatterns &patterns,
+	CRegisterMatcher::EKernel kernel)
+{
+	TSearchData data = {CRegisterMatcher(patterns, kernel), 0, {0}, 0};
+	return data;
+}
+
+unsigned int CFsmTest::CRegisterMatcherSearch::GetMemoryRequirements(const CFsmTest::CRegisterMatcherSearch::TSearchData &data) {
+	return data.matcher.GetMemoryUsage();
+}
+
+CFsmTest::SFsmStatistics CFsmTest::CRegisterMatcherSearch::GetFsmStatistics(const CFsmTest::CRegisterMatcherSearch::TSearchData&) {
+	return CFsmTest::SFsmStatistics();
+}
+
+void CFsmTest::CRegisterMatcherSearch::ProcessByte(const unsigned char bData, CFsmTest::CRegisterMatcherSearch::TSearchData *pSearchData,
+	CFindingsBuffer *pFindings)
+{
+	// process the byte at once
+	pFindings->SetBitsBefore(pSearchData->qwBits);
+	pSearchData->matcher.Scan(&bData, 1, *pFindings);
+	pSearchData->qwBits += BITS_IN_BYTE;
+}
+
+unsigned int CFsmTest::CRegisterMatcherSearch::ProcessByteIdle(const unsigned char bData, CFsmTest::CRegisterMatcherSearch::TSearchData *pSearchData) {
+	// the hits are counted by the whole blocks, the last incomplete one isn't processed
+	pSearchData->bsBlock[pSearchData->nBlockBytes++] = bData;
+	if (pSearchData->nBlockBytes < CRegisterMatcher::g_nBlockBytes) {
+		return 0;
+	}
+
+	CHitsCounter counter;
+	pSearchData->matcher.Scan(pSearchData->bsBlock, CRegisterMatcher::g_nBlockBytes, counter);
+	pSearchData->nBlockBytes = 0;
+
+	return counter.GetHitsCount();
+}
+
+
 #endif // SEARCHENGINES_H
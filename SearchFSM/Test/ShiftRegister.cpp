@@ -20,14 +20,14 @@ void CShiftRegister::Init(unsigned int dwLength) {
 	if (dwLength % g_nChunkLength != 0) { // some extra bits
 		nChunks++;
 	}
-	m_Data.fill(0, nChunks);
+	m_Data.assign(nChunks, 0);
 }
 
 // preparing methods
 CShiftRegister::SPattern CShiftRegister::ConvertPattern(const ::SPattern &pattern) {
 	SPattern result;
-	result.pattern.fill(0, m_Data.length());
-	result.mask.fill(0, m_Data.length());
+	result.pattern.assign((int)m_Data.size(), 0);
+	result.mask.assign((int)m_Data.size(), 0);
 	int nBit;
 	for (nBit = 0; nBit < pattern.nLength; nBit++) {
 		PushBit(GetBit(pattern, nBit), &result.pattern);
@@ -40,7 +40,7 @@ CShiftRegister::SPattern CShiftRegister::ConvertPattern(const ::SPattern &patter
 }
 
 unsigned int CShiftRegister::RequiredMemorySize() const {
-	return m_Data.count() * sizeof(TChunk);
+	return (int)m_Data.size() * sizeof(TChunk);
 }
 
 // working methods
@@ -55,7 +55,7 @@ bool CShiftRegister::TestPattern(const SPattern &pattern, unsigned int *pdwError
 
 	int idx;
 	unsigned int cErrors = 0;
-	for (idx = 0; idx < m_Data.length(); idx++) {
+	for (idx = 0; idx < (int)m_Data.size(); idx++) {
 		const TChunk chunkDiff = (pChunks[idx] ^ pPatternChunks[idx]) & pMaskChunks[idx];
 		cErrors += WeightTable(chunkDiff);
 	}
@@ -74,7 +74,7 @@ void CShiftRegister::PushBit(unsigned char bBit, CShiftRegister::TData *pData) {
 	TChunk carry = bBit;
 	TChunk *pChunks = pData->data();
 	int idx;
-	for (idx = 0; idx < pData->length(); idx++) {
+	for (idx = 0; idx < (int)pData->size(); idx++) {
 		const TChunk chunk = pChunks[idx];
 		pChunks[idx] = (chunk << 1) | carry;
 		carry = (chunk >> (g_nChunkLength - 1)) & (TChunk)0x01;
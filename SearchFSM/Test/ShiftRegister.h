@@ -3,14 +3,14 @@
 #ifndef SHIFTREGISTER_H
 #define SHIFTREGISTER_H
 
-#include <QVector>
+#include <vector>
 
 #include "../SearchFSM/Common.h"
 
 class CShiftRegister {
 public:
 	typedef unsigned int TChunk;
-	typedef QVector <TChunk> TData;
+	typedef std::vector<TChunk> TData;
 
 	struct SPattern { // local format for quick comparison
 		TData pattern;
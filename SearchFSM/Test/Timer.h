@@ -0,0 +1,15 @@
+#line 2 "Timer.h" // Make __FILE__ omit the path
+
+#ifndef TIMER_H
+#define TIMER_H
+
+// the timing backend of the platform, all of them have the same interface
+#ifdef _WIN32
+#include "WinTimer.h"
+typedef CWinTimer CTimer;
+#else
+#include "PosixTimer.h"
+typedef CPosixTimer CTimer;
+#endif
+
+#endif // TIMER_H
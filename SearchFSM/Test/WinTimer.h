@@ -34,7 +34,7 @@ public:
 	/** \sa Start, Stop, GetThreadDuration, GetUserDuration, GetTotalDuration */
 	TTime GetKernelDuration() const;
 
-	/// Get real number of seconds elapsed since start moment.
+	/// Get real number of seconds elapsed since start moment (performance counter).
 	/** \sa Start, Stop, GetThreadDuration, GetUserDuration, GetKernelDuration */
 	TTime GetTotalDuration() const;
 
@@ -47,12 +47,12 @@ private:
 	// start times
 	TWinTime m_wtStartTimeUser; // thread in kernel mode
 	TWinTime m_wtStartTimeKernel; // thread in core mode
-	TWinTime m_wtStartTimeSystem; // total real time
+	LARGE_INTEGER m_liStartCounter; // total real time
 
 	// start-to-stop durations
 	TWinTime m_wtUserDuration;
 	TWinTime m_wtKernelDuration;
-	TWinTime m_wtTotalDuration;
+	TTime m_tTotalDuration;
 	bool m_fRunning;
 };
 
@@ -61,25 +61,27 @@ private:
 void inline CWinTimer::Start() {
 	TWinTime wtDummy;
 	GetThreadTimes(GetCurrentThread(), &wtDummy, &wtDummy, &m_wtStartTimeKernel, &m_wtStartTimeUser);
-	GetSystemTimeAsFileTime(&m_wtStartTimeSystem);
+	QueryPerformanceCounter(&m_liStartCounter);
 
 	TWinTime wtZero = {0, 0};
 	m_wtUserDuration = wtZero;
 	m_wtKernelDuration = wtZero;
-	m_wtTotalDuration = wtZero;
+	m_tTotalDuration = 0;
 
 	m_fRunning = true;
 }
 
 void inline CWinTimer::Stop() {
 	if (!m_fRunning) return;
-	TWinTime wtDummy, wtStopTimeKernel, wtStopTimeUser, wtStopTimeSystem;
+	LARGE_INTEGER liStopCounter, liFrequency;
+	QueryPerformanceCounter(&liStopCounter);
+	TWinTime wtDummy, wtStopTimeKernel, wtStopTimeUser;
 	GetThreadTimes(GetCurrentThread(), &wtDummy, &wtDummy, &wtStopTimeKernel, &wtStopTimeUser);
-	GetSystemTimeAsFileTime(&wtStopTimeSystem);
 
 	m_wtUserDuration = Diff(wtStopTimeUser, m_wtStartTimeUser);
 	m_wtKernelDuration = Diff(wtStopTimeKernel, m_wtStartTimeKernel);
-	m_wtTotalDuration = Diff(wtStopTimeSystem, m_wtStartTimeSystem);
+	QueryPerformanceFrequency(&liFrequency); // fixed at boot
+	m_tTotalDuration = (TTime)(liStopCounter.QuadPart - m_liStartCounter.QuadPart) / liFrequency.QuadPart;
 
 	m_fRunning = false;
 }
@@ -97,7 +99,7 @@ CWinTimer::TTime inline CWinTimer::GetKernelDuration() const {
 }
 
 CWinTimer::TTime inline CWinTimer::GetTotalDuration() const {
-	return WinTimeToTime(m_wtTotalDuration);
+	return m_tTotalDuration;
 }
 
 // private members
@@ -1,65 +1,84 @@
 #line 2 "main.cpp" // Make __FILE__ omit the path
 
-#include <QCoreApplication>
-#include <QDateTime>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
 
 #include "../SearchFSM/SearchFsm.h"
 #include "../SearchFSM/FsmCreator.h"
+#include "../SearchFSM/Concurrent.h"
 #include "FsmTest.h"
+#include "EngineTuner.h"
+#include "BenchmarkRunner.h"
 
 const int g_nTraceBits = 70;
 const int g_nTestCorrectnessBytes = 1024 * 1024 * 1024; // 1024 MiB
 const int g_nFastTestCorrectnessBytes = 1024 * 1024; // 1 MiB
 const int g_nTestSpeedBytes = 100 * 1024 * 1024; // 100 MiB
-
-void Print(const QString &s) {
-	printf("%s", s.toLocal8Bit().constData());
+const int g_nTuneBytes = 4 * 1024 * 1024; // 4 MiB per engine
+const int g_nTestChannels = 1024; // streams scanned through the cursors
+const char *g_szFsmFileName = "SearchFsm8.tbl"; // temporary file for the saved tables
+const int g_nDefaultWarmUpRuns = 1; // per engine
+const int g_nDefaultRuns = 3; // per engine, the median is reported
+
+void Print(const std::string &s) {
+	printf("%s", s.c_str());
 }
 
 void Print(const SPattern &pattern) {
-	QString sPattern = PatternToString(pattern);
-	sPattern = QString("%1, %2 errors\n").arg(sPattern).arg(pattern.nMaxErrors);
-	Print(sPattern);
+	printf("%s, %i errors\n", PatternToString(pattern).c_str(), pattern.nMaxErrors);
 }
 
 void PrintPatterns(const TPatterns &patterns) {
 	int idx;
-	for (idx = 0; idx < patterns.count(); idx++) {
+	for (idx = 0; idx < (int)patterns.size(); idx++) {
 		printf("#%i ", idx);
 		Print(patterns[idx]);
 	}
 }
 
-QString DoubleToString(double dValue, int nPrecision) {
+std::string DoubleToString(double dValue, int nPrecision) {
 	double dPart = dValue;
 	while (nPrecision > 0 && dPart >= 1) { // part has at least one nonzero digit
 		nPrecision--;
 		dPart /= 10; // crop digit
 	}
-	return QString::number(dValue, 'f', nPrecision);
+	char szValue[64];
+	snprintf(szValue, sizeof(szValue), "%.*f", nPrecision, dValue);
+	return szValue;
 }
 
-QString DataSizeToString(unsigned int dwSize) {
-	const unsigned int g_dwKibi = 1024;
-	const unsigned int g_dwMebi = g_dwKibi * g_dwKibi;
+std::string DataSizeToString(uint64_t qwSize) {
+	const uint64_t g_qwKibi = 1024;
+	const uint64_t g_qwMebi = g_qwKibi * g_qwKibi;
 	const int g_nPrecision = 3;
-	if (dwSize < g_dwKibi) {
-		return QString("%1 B").arg(dwSize);
+	if (qwSize < g_qwKibi) {
+		char szSize[16];
+		snprintf(szSize, sizeof(szSize), "%u B", (unsigned int)qwSize);
+		return szSize;
 
-	} else if (dwSize < g_dwMebi) { // kibibytes
-		double dKibibytes = (double)dwSize / g_dwKibi;
-		return QString("%1 KiB").arg(DoubleToString(dKibibytes, g_nPrecision));
+	} else if (qwSize < g_qwMebi) { // kibibytes
+		double dKibibytes = (double)qwSize / g_qwKibi;
+		return DoubleToString(dKibibytes, g_nPrecision) + " KiB";
 
 	} else { // mebibytes
-		double dMebibytes = (double)dwSize / g_dwMebi;
-		return QString("%1 MiB").arg(DoubleToString(dMebibytes, g_nPrecision));
+		double dMebibytes = (double)qwSize / g_qwMebi;
+		return DoubleToString(dMebibytes, g_nPrecision) + " MiB";
 	}
 }
 
 void PrintTableSize(const CFsmTest::SFsmTableSize &size) {
-	Print(QString("FSM table: %1\n").arg(DataSizeToString(size.dwMainTableSize)));
-	Print(QString("Output table: %1\n").arg(DataSizeToString(size.dwOutputTableSize)));
-	Print(QString("Total size: %1\n").arg(DataSizeToString(size.dwTotalSize)));
+	printf("FSM table: %s\n", DataSizeToString(size.dwMainTableSize).c_str());
+	if (size.dwColdTableSize > 0) {
+		printf("FSM cold table: %s\n", DataSizeToString(size.dwColdTableSize).c_str());
+	}
+	printf("Output table: %s\n", DataSizeToString(size.dwOutputTableSize).c_str());
+	printf("Total size: %s\n", DataSizeToString(size.dwTotalSize).c_str());
 }
 
 void PrintTimings(const char *szPrefix, const CFsmTest::STimeings &timings) {
@@ -80,9 +99,17 @@ void PrintTimings(const char *szPrefix, const CFsmTest::STimeings &timings) {
 
 void PrintFsmStatistics(const CFsmTest::SFsmStatistics &stats) {
 	printf("FSM statistics: %i states, %i output elements.\n", stats.dwStatesCount, stats.dwOutputCellsCount);
+	if (stats.dwUnoptimizedStatesCount != stats.dwStatesCount) {
+		printf("FSM optimization: %i states before, %i states after\n", stats.dwUnoptimizedStatesCount, stats.dwStatesCount);
+	}
+	if (stats.dwSymbolClassesCount > 0) {
+		printf("FSM input symbols form %i equivalence classes\n", stats.dwSymbolClassesCount);
+	}
 	if (stats.dwCollisionsCount > 0) {
 		printf("FSM state hashes have %i collisions\n", stats.dwCollisionsCount);
 	}
+	PrintTimings("Tables generation", stats.timTablesGeneration);
+	PrintTimings("Wrap creation", stats.timWrapCreation);
 
 	printf("Default FSM memory requirements:\n");
 	PrintTableSize(stats.tableSize);
@@ -91,37 +118,79 @@ void PrintFsmStatistics(const CFsmTest::SFsmStatistics &stats) {
 	PrintTableSize(stats.tableMinSize);
 }
 
-void PrintEnginePerformance(const char *szEngineName, const CFsmTest::SEnginePerformance &performance) {
+void PrintEnginePerformance(const char *szEngineName, const CBenchmarkRunner::SResult &result) {
+	const CFsmTest::SEnginePerformance &performance = result.performance;
 	printf("= Results for %s =\n", szEngineName);
 	PrintTimings("Initialization", performance.timInitialization);
 	PrintTimings("Operating", performance.timOperating);
 
-	long double dRate = performance.dwBytesCount / performance.timOperating.dTotalTime;
-	Print(QString("Total rate: %1/s, found %2 entries\n").arg(DataSizeToString(dRate)).arg(performance.dwHits));
+	long double dRate = performance.qwBytesCount / performance.timOperating.dTotalTime;
+	printf("Total rate: %s/s, found %llu entries\n", DataSizeToString((uint64_t)dRate).c_str(),
+		(unsigned long long)performance.qwHits);
+	if (result.nRuns > 1) {
+		const CBenchmarkRunner::SStatistics &stat = result.statOperating;
+		printf("Operating in %i runs: min %Lg s, median %Lg s, p90 %Lg s, max %Lg s\n", result.nRuns, stat.dMin,
+			stat.dMedian, stat.dPercentile90, stat.dMax);
+	}
 
-	Print(QString("Total memory requirements: %1\n").arg(DataSizeToString(performance.dwMemoryRequirements)));
+	printf("Total memory requirements: %s\n", DataSizeToString(performance.dwMemoryRequirements).c_str());
 	if (performance.fIsFsm) { // results for some SearchFSM engine
 		PrintFsmStatistics(performance.fsmStatistics);
 	}
 	puts("");
 }
 
-void PrintEnginePerformance(const char *szEngineName, bool fSuccess, const CFsmTest::SEnginePerformance &performance) {
-	if (fSuccess) {
-		PrintEnginePerformance(szEngineName, performance);
+void PrintEngineResult(const char *szEngineName, const CBenchmarkRunner::SResult &result) {
+	if (result.fSuccess) {
+		PrintEnginePerformance(szEngineName, result);
 	} else {
 		printf("= FAILED to test %s =\n\n", szEngineName);
 	}
 }
 
+void PrintTuning(const CEngineTuner::SDecision &decision) {
+	const CEngineTuner::SCacheSizes &caches = decision.caches;
+	printf("Caches: L1 %s, L2 %s, L3 %s\n", DataSizeToString(caches.dwL1).c_str(), DataSizeToString(caches.dwL2).c_str(),
+		DataSizeToString(caches.dwL3).c_str());
+	printf("Bit SearchFSM: %llu states predicted, %u minimized\n", (unsigned long long)decision.sizeEstimate.qwStatesCount,
+		decision.dwStatesCount);
+	int idx;
+	for (idx = 0; idx < (int)decision.candidates.size(); idx++) {
+		const CEngineTuner::SCandidate &candidate = decision.candidates[idx];
+		std::string sLine = std::string(CEngineTuner::GetEngineName(candidate.engine)) + ": estimated " +
+			DataSizeToString(candidate.dwEstimatedSize) + " (" + CEngineTuner::GetCacheLevelName(candidate.cacheLevel) + ")";
+		if (!candidate.fCalibrated) {
+			sLine += ", skipped";
+		} else if (candidate.dRate > 0) {
+			sLine += ", rate " + DataSizeToString((uint64_t)candidate.dRate) + "/s";
+		} else {
+			sLine += ", FAILED";
+		}
+		Print(sLine + "\n");
+	}
+	printf("Chosen engine: %s\n", CEngineTuner::GetEngineName(decision.engine));
+}
+
+struct SEngineResult {
+	CBenchmarkRunner::SResult result;
+	bool fSameData; // the test data is processed as is, the hits are comparable with the register search
+};
+
 struct STestResult {
-	CFsmTest::SEnginePerformance perfRegister;
-	CFsmTest::SEnginePerformance perfFsm1;
-	CFsmTest::SEnginePerformance perfFsm4;
-	CFsmTest::SEnginePerformance perfFsm8;
+	CEngineTuner::EEngine tunedEngine;
+	uint64_t qwReferenceHits; // of the register search
+	std::vector<SEngineResult> engines;
 };
 
-STestResult TestSpeed(const TPatterns patterns) {
+void AddEngineResult(const char *szEngineName, const CBenchmarkRunner &runner, bool fSameData, STestResult *pResult) {
+	PrintEngineResult(szEngineName, runner.GetResult());
+	SEngineResult engine;
+	engine.result = runner.GetResult();
+	engine.fSameData = fSameData;
+	pResult->engines.push_back(engine);
+}
+
+STestResult TestSpeed(const TPatterns patterns, const CBenchmarkRunner::SSettings &settings) {
 	CFsmTest tester(patterns);
 	printf("\nPatterns for tests:\n");
 	PrintPatterns(patterns);
@@ -130,29 +199,180 @@ STestResult TestSpeed(const TPatterns patterns) {
 	unsigned int dwHits;
 	bool fOk = tester.TestCorrectness(g_nFastTestCorrectnessBytes, 0, &dwHits);
 	puts(fOk? "OK" : "FAIL");
-	Print(QString("Tested on %1 data, found %2 entries\n").arg(DataSizeToString(g_nFastTestCorrectnessBytes)).arg(dwHits));
+	printf("Tested on %s data, found %u entries\n", DataSizeToString(g_nFastTestCorrectnessBytes).c_str(), dwHits);
+
+	int nIdealThreads = GetIdealThreadCount();
+	printf("Test parallel correctness (%i threads)...", nIdealThreads);
+	fOk = tester.TestParallelCorrectness(g_nFastTestCorrectnessBytes, nIdealThreads);
+	puts(fOk? "OK" : "FAIL");
+
+	printf("Test interleaved correctness...");
+	fOk = tester.TestInterleavedCorrectness(g_nFastTestCorrectnessBytes);
+	puts(fOk? "OK" : "FAIL");
+
+	printf("Test cursors correctness (%i channels)...", g_nTestChannels);
+	fOk = tester.TestCursorsCorrectness(g_nFastTestCorrectnessBytes, g_nTestChannels);
+	puts(fOk? "OK" : "FAIL");
+
+	printf("Test parallel tables generation (%i threads)...", nIdealThreads);
+	CFsmTest::STimeings timSequential, timParallel;
+	fOk = tester.TestParallelGeneration(nIdealThreads, &timSequential, &timParallel);
+	puts(fOk? "OK" : "FAIL");
+	if (fOk) {
+		PrintTimings("Sequential generation", timSequential);
+		PrintTimings("Parallel generation", timParallel);
+	}
+
+	printf("Tune the engine (on %s data per engine)...", DataSizeToString(g_nTuneBytes).c_str());
+	CEngineTuner tuner(patterns);
+	fOk = tuner.Tune(g_nTuneBytes);
+	puts(fOk? "OK" : "FAIL");
+	PrintTuning(tuner.GetDecision());
 
-	Print(QString("\nSpeed tests (on %1 data):\n\n").arg(DataSizeToString(g_nTestSpeedBytes)));
+	printf("\nSpeed tests (on %s data, %i warm-up and %i measured runs):\n\n", DataSizeToString(g_nTestSpeedBytes).c_str(),
+		settings.nWarmUpRuns, settings.nRuns);
 	STestResult result;
+	result.tunedEngine = tuner.GetDecision().engine;
+	result.qwReferenceHits = 0;
+	CBenchmarkRunner runner(settings);
 	CFsmTest::SEnginePerformance performance;
-	bool fSuccess = tester.TestBitFsmRate(g_nTestSpeedBytes, false, &performance);
-	PrintEnginePerformance("Bit SearchFSM (FSM-1)", fSuccess, performance);
-	result.perfFsm1 = performance;
-
-	tester.TestBitFsmRate(g_nTestSpeedBytes, true, &performance);
-	PrintEnginePerformance("Optimized Bit SearchFSM (FSM-1 opt)", fSuccess, performance);
+	bool fSuccess;
+
+	runner.Start("FSM-1");
+	do {
+		fSuccess = tester.TestBitFsmRate(g_nTestSpeedBytes, false, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Bit SearchFSM (FSM-1)", runner, true, &result);
+
+	runner.Start("FSM-1opt");
+	do {
+		fSuccess = tester.TestBitFsmRate(g_nTestSpeedBytes, true, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Optimized Bit SearchFSM (FSM-1 opt)", runner, true, &result);
+
+	runner.Start("FSM-4");
+	do {
+		fSuccess = tester.TestNibbleFsmRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Nibble SearchFSM (FSM-4)", runner, true, &result);
+
+	runner.Start("FSM-8");
+	do {
+		fSuccess = tester.TestOctetFsmRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Octet SearchFSM (FSM-8)", runner, true, &result);
+
+	runner.Start("FSM-8cls");
+	do {
+		fSuccess = tester.TestOctetClassedFsmRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Octet SearchFSM with symbol classes (FSM-8 cls)", runner, true, &result);
+
+	runner.Start("FSM-8comb");
+	do {
+		fSuccess = tester.TestOctetCombFsmRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Octet SearchFSM with comb-compressed table (FSM-8 comb)", runner, true, &result);
+
+	runner.Start("FSM-8split");
+	do {
+		fSuccess = tester.TestOctetSplitFsmRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Octet SearchFSM with split hot and cold tables (FSM-8 split)", runner, true, &result);
+
+	runner.Start("FSM-8lazy");
+	do {
+		fSuccess = tester.TestLazyFsmRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Octet SearchFSM built on demand (FSM-8 lazy)", runner, true, &result);
+
+	runner.Start("FSM-4min");
+	do {
+		fSuccess = tester.TestMinimalTypesFsmRate(g_nTestSpeedBytes, CFsmTest::g_nNibbleLength, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Nibble SearchFSM with minimal index types (FSM-4 min)", runner, true, &result);
+
+	runner.Start("FSM-8min");
+	do {
+		fSuccess = tester.TestMinimalTypesFsmRate(g_nTestSpeedBytes, CFsmTest::g_nByteLength, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Octet SearchFSM with minimal index types (FSM-8 min)", runner, true, &result);
+
+	runner.Start("FSM-8file");
+	do {
+		fSuccess = tester.TestOctetFsmFileRate(g_nTestSpeedBytes, g_szFsmFileName, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Octet SearchFSM loaded from the mapped file (FSM-8 file)", runner, true, &result);
+
+	// interleaved streams: 4, 8, 16 and 16 with prefetch
+	const int g_nStreamsTests = 4;
+	const int g_nStreams[g_nStreamsTests] = {4, 8, 16, 16};
+	const bool g_fPrefetch[g_nStreamsTests] = {false, false, false, true};
+	char szId[32], szName[128];
+	int idxStreams;
+	for (idxStreams = 0; idxStreams < g_nStreamsTests; idxStreams++) {
+		int nStreams = g_nStreams[idxStreams];
+		bool fPrefetch = g_fPrefetch[idxStreams];
+		snprintf(szId, sizeof(szId), "FSM-8x%i%s", nStreams, fPrefetch? "p" : "");
+		runner.Start(szId);
+		do {
+			fSuccess = tester.TestOctetFsmInterleavedRate(g_nTestSpeedBytes, nStreams, fPrefetch, &performance);
+		} while (runner.AddRun(fSuccess, performance));
+		snprintf(szName, sizeof(szName), "Octet SearchFSM, %i interleaved streams%s (%s)", nStreams,
+			fPrefetch? " with prefetch" : "", szId);
+		AddEngineResult(szName, runner, false, &result);
+	}
 
-	fSuccess = tester.TestNibbleFsmRate(g_nTestSpeedBytes, &performance);
-	PrintEnginePerformance("Nibble SearchFSM (FSM-4)", fSuccess, performance);
-	result.perfFsm4 = performance;
+	// parallel scanning of one stream: 1, 2, 4... threads and all the cores
+	long double dSingleThreadRate = 0;
+	int nThreads = 1;
+	while (true) {
+		snprintf(szId, sizeof(szId), "FSM-8||%i", nThreads);
+		runner.Start(szId);
+		do {
+			fSuccess = tester.TestOctetFsmParallelRate(g_nTestSpeedBytes, nThreads, &performance);
+		} while (runner.AddRun(fSuccess, performance));
+		snprintf(szName, sizeof(szName), "Parallel Octet SearchFSM, %i threads (%s)", nThreads, szId);
+		AddEngineResult(szName, runner, false, &result);
+		const CBenchmarkRunner::SResult &parallel = runner.GetResult();
+		if (parallel.fSuccess) {
+			long double dRate = CBenchmarkRunner::GetRate(parallel.performance.qwBytesCount, parallel.statOperating.dMedian);
+			if (nThreads == 1) {
+				dSingleThreadRate = dRate;
+			} else if (dSingleThreadRate > 0) {
+				printf("Speedup on %i threads: %Lg\n\n", nThreads, dRate / dSingleThreadRate);
+			}
+		}
 
-	fSuccess = tester.TestOctetFsmRate(g_nTestSpeedBytes, &performance);
-	PrintEnginePerformance("Octet SearchFSM (FSM-8)", fSuccess, performance);
-	result.perfFsm8 = performance;
+		if (nThreads >= nIdealThreads) {
+			break;
+		}
+		nThreads *= 2;
+		if (nThreads > nIdealThreads) {
+			nThreads = nIdealThreads;
+		}
+	}
 
-	fSuccess = tester.TestRegisterRate(g_nTestSpeedBytes, &performance);
-	PrintEnginePerformance("Register search", fSuccess, performance);
-	result.perfRegister = performance;
+	runner.Start("reg");
+	do {
+		fSuccess = tester.TestRegisterRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Register search", runner, true, &result);
+	result.qwReferenceHits = runner.GetResult().performance.qwHits;
+
+	runner.Start("bitap");
+	do {
+		fSuccess = tester.TestBitapRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	AddEngineResult("Bitap search", runner, true, &result);
+
+	// the hits of the whole blocks only
+	runner.Start("vreg");
+	do {
+		fSuccess = tester.TestRegisterMatcherRate(g_nTestSpeedBytes, &performance);
+	} while (runner.AddRun(fSuccess, performance));
+	snprintf(szName, sizeof(szName), "Vectorized register search (%s)", CRegisterMatcher::GetKernelName());
+	AddEngineResult(szName, runner, false, &result);
 
 	return result;
 }
@@ -161,7 +381,7 @@ SPattern::TData GenerateData(int nBytes) {
 	SPattern::TData data;
 	int idx;
 	for (idx = 0; idx < nBytes; idx++) {
-		data << rand();
+		data.push_back((unsigned char)rand());
 	}
 
 	return data;
@@ -190,23 +410,27 @@ struct STest {
 	bool fMasked;
 	STestResult result;
 };
-typedef QList<STest> TTestList;
+typedef std::vector<STest> TTestList;
 
 void PrintTestLabel(const STest& test) {
-	static const QString g_sTestLabelPattern = "%1, begin test: %3 bits, %4 errors, %5 mask, %2 patterns\n";
-
-	QString sTimestamp = QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss.zzz");
-	QString sTestLabel = g_sTestLabelPattern.arg(sTimestamp).arg(test.nPatternsCount).arg(test.nPatternsLength)
-			.arg(test.nErrorsCount).arg(test.fMasked? "with" : "no");
-	fputs(sTestLabel.toLocal8Bit().constData(), stderr);
+	std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+	time_t tNow = std::chrono::system_clock::to_time_t(now);
+	int nMilliseconds = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+	char szTimestamp[32];
+	strftime(szTimestamp, sizeof(szTimestamp), "%d.%m.%Y %H:%M:%S", localtime(&tNow));
+
+	fprintf(stderr, "%s.%03i, begin test: %i bits, %i errors, %s mask, %i patterns\n", szTimestamp, nMilliseconds,
+		test.nPatternsLength, test.nErrorsCount, test.fMasked? "with" : "no", test.nPatternsCount);
 }
 
-TTestList TestOnPatterns(int nMaxCount, int nLength, int nErrors = 0, bool fMasked = false) {
+TTestList TestOnPatterns(const CBenchmarkRunner::SSettings &settings, int nMaxCount, int nLength, int nErrors = 0,
+	bool fMasked = false)
+{
 	TTestList testList;
 	TPatterns patterns;
 	int idx;
 	for (idx = 0; idx < nMaxCount; idx++) {
-		patterns << GeneratePattern(nLength, nErrors, fMasked);
+		patterns.push_back(GeneratePattern(nLength, nErrors, fMasked));
 		STest test;
 		test.nPatternsCount = idx + 1;
 		test.nPatternsLength = nLength;
@@ -214,88 +438,102 @@ TTestList TestOnPatterns(int nMaxCount, int nLength, int nErrors = 0, bool fMask
 		test.fMasked = fMasked;
 		puts("\n--------------------");
 		PrintTestLabel(test);
-		test.result = TestSpeed(patterns);
+		test.result = TestSpeed(patterns, settings);
 
-		testList << test;
+		testList.push_back(test);
 	}
 
 	return testList;
 }
 
-void DumpPerformance(const CFsmTest::SEnginePerformance &perf, unsigned int dwHits, bool fIsFsm) {
-	// init-time, rate, mem-req
-	if (perf.fSuccess) {
-		if (perf.dwHits != dwHits) {
-			printf("FAIL");
-		}
-		long double dRate = perf.dwBytesCount / perf.timOperating.dTotalTime;
-		printf("%Lg\t%Lg\t%i\t", perf.timInitialization.dTotalTime, dRate, perf.dwMemoryRequirements);
-	} else {
-		printf("X\tX\tX\t");
-	}
-
-	// states
-	if (fIsFsm) {
-		if (perf.fSuccess && perf.fIsFsm) {
-			printf("%i\t", perf.fsmStatistics.dwStatesCount/*, perf.fsmStatistics.tableSize.dwTotalSize*/);
-		} else {
-			printf("X\t");
-		}
-	}
-}
-
-void DumpTestList(const TTestList &list) {
-	printf("\nlength\tcount\terrors\tmasked\thits\t");
-	printf("reg:init-time\trate\tmemory\t");
-	printf("FSM-1:init-time\trate\tmemory\tstates\t");
-	printf("FSM-4:init-time\trate\tmemory\tstates\t");
-	printf("FSM-8:init-time\trate\tmemory\tstates");
-
+void DumpTestList(const TTestList &list, CBenchmarkReport::EFormat format) {
+	CBenchmarkReport report(format);
 	int idx;
-	for (idx = 0; idx < list.count(); idx++) {
+	for (idx = 0; idx < (int)list.size(); idx++) {
 		const STest &test = list[idx];
-		unsigned int dwHits = test.result.perfRegister.dwHits;
-		printf("\n%i\t%i\t%i\t%s\t%u\t", test.nPatternsLength, test.nPatternsCount, test.nErrorsCount, test.fMasked? "masked" : "no mask", dwHits);
 		const STestResult &result = test.result;
-		DumpPerformance(result.perfRegister, dwHits, false);
-		DumpPerformance(result.perfFsm1, dwHits, true);
-		DumpPerformance(result.perfFsm4, dwHits, true);
-		DumpPerformance(result.perfFsm8, dwHits, true);
+		CBenchmarkReport::TFields testCase;
+		testCase.push_back(CBenchmarkReport::Field("length", (unsigned int)test.nPatternsLength));
+		testCase.push_back(CBenchmarkReport::Field("count", (unsigned int)test.nPatternsCount));
+		testCase.push_back(CBenchmarkReport::Field("errors", (unsigned int)test.nErrorsCount));
+		testCase.push_back(CBenchmarkReport::Field("masked", test.fMasked));
+		testCase.push_back(CBenchmarkReport::Field("tuned", std::string(CEngineTuner::GetEngineName(result.tunedEngine))));
+
+		int idxEngine;
+		for (idxEngine = 0; idxEngine < (int)result.engines.size(); idxEngine++) {
+			const SEngineResult &engine = result.engines[idxEngine];
+			report.Add(testCase, engine.result, engine.fSameData, result.qwReferenceHits);
+		}
 	}
 
-	printf("\n\n");
+	puts("");
+	report.Write(stdout);
+	puts("");
 }
 
-void BunchTest(int nErrors, bool fMasked, int nReduction = 0, int nSubReduction = 0) {
-	QList<int> LengthsList;
-	LengthsList << 8 << 28 << 32 << 48 << 65 << 165;
+void BunchTest(const CBenchmarkRunner::SSettings &settings, CBenchmarkReport::EFormat format, int nErrors, bool fMasked,
+	int nReduction = 0, int nSubReduction = 0)
+{
+	const int g_nLengths[] = {8, 28, 32, 48, 65, 165};
+	const int g_nLengthsCount = sizeof(g_nLengths) / sizeof(g_nLengths[0]);
 	int idx;
-	for (idx = 0; idx < LengthsList.count() - nReduction; idx++) {
-		int nLength = LengthsList[idx];
+	for (idx = 0; idx < g_nLengthsCount - nReduction; idx++) {
+		int nLength = g_nLengths[idx];
 		int nPatternsCount = 6;
-		if (idx == LengthsList.count() - nReduction - 1) {
+		if (idx == g_nLengthsCount - nReduction - 1) {
 			nPatternsCount -= nSubReduction;
 		}
-		TTestList testList = TestOnPatterns(nPatternsCount, nLength, nErrors, fMasked);
-		DumpTestList(testList);
+		TTestList testList = TestOnPatterns(settings, nPatternsCount, nLength, nErrors, fMasked);
+		DumpTestList(testList, format);
 	}
 }
 
+void PrintUsage(const char *szProgram) {
+	fprintf(stderr, "Usage: %s [--format csv|json] [--warmup N] [--runs N]\n", szProgram);
+	fprintf(stderr, "  --format  results table format, CSV by default\n");
+	fprintf(stderr, "  --warmup  dropped runs of each engine, %i by default\n", g_nDefaultWarmUpRuns);
+	fprintf(stderr, "  --runs    measured runs of each engine, %i by default, the median is reported\n", g_nDefaultRuns);
+}
+
 int main(int argc, char *argv[]) {
-	QCoreApplication a(argc, argv);
-
-	BunchTest(0, false);
-	BunchTest(1, false);
-	BunchTest(2, false);
-	BunchTest(3, false);
-	BunchTest(4, false, 0, 4);
-	BunchTest(5, false, 4, 1);
-	BunchTest(0, true);
-	BunchTest(1, true, 4, 3);
-	BunchTest(2, true, 4, 4);
-	BunchTest(3, true, 4, 5);
-	BunchTest(4, true, 5);
-	BunchTest(5, true, 5);
+	CBenchmarkRunner::SSettings settings = {g_nDefaultWarmUpRuns, g_nDefaultRuns};
+	CBenchmarkReport::EFormat format = CBenchmarkReport::format_Csv;
+	int idxArg;
+	for (idxArg = 1; idxArg < argc; idxArg++) {
+		const char *szArg = argv[idxArg];
+		const char *szValue = idxArg + 1 < argc? argv[idxArg + 1] : NULL;
+		if (szValue == NULL) {
+			PrintUsage(argv[0]);
+			return 1;
+		}
+		idxArg++;
+
+		if (strcmp(szArg, "--format") == 0 && strcmp(szValue, "csv") == 0) {
+			format = CBenchmarkReport::format_Csv;
+		} else if (strcmp(szArg, "--format") == 0 && strcmp(szValue, "json") == 0) {
+			format = CBenchmarkReport::format_Json;
+		} else if (strcmp(szArg, "--warmup") == 0 && atoi(szValue) >= 0) {
+			settings.nWarmUpRuns = atoi(szValue);
+		} else if (strcmp(szArg, "--runs") == 0 && atoi(szValue) > 0) {
+			settings.nRuns = atoi(szValue);
+		} else {
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	BunchTest(settings, format, 0, false);
+	BunchTest(settings, format, 1, false);
+	BunchTest(settings, format, 2, false);
+	BunchTest(settings, format, 3, false);
+	BunchTest(settings, format, 4, false, 0, 4);
+	BunchTest(settings, format, 5, false, 4, 1);
+	BunchTest(settings, format, 0, true);
+	BunchTest(settings, format, 1, true, 4, 3);
+	BunchTest(settings, format, 2, true, 4, 4);
+	BunchTest(settings, format, 3, true, 4, 5);
+	BunchTest(settings, format, 4, true, 5);
+	BunchTest(settings, format, 5, true, 5);
 
 	return 0;
 }